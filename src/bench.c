@@ -0,0 +1,368 @@
+/*
+ - RISC-V Sim benchmark suite
+ - Runs a fixed set of workloads on the kernel and reports speed along with block cache and TLB hit rates
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rskapi.h"
+#include "riscv64.h"
+
+// Guest memory layout: code at BENCH_CODE, data for the streaming workload at BENCH_SRC and BENCH_DST
+#define BENCH_RAM_SIZE 0x400000
+#define BENCH_CODE     0x1000
+#define BENCH_SRC      0x100000
+#define BENCH_DST      0x200000
+
+#define REGISTER_COUNT 32
+
+// ---------- Instruction Encoding ----------
+
+static word enc_r(word opcode, word funct3, word funct7, word rd, word rs1, word rs2) {
+    return opcode | (rd << 7) | (funct3 << 12) | (rs1 << 15) | (rs2 << 20) | (funct7 << 25);
+}
+
+static word enc_i(word opcode, word funct3, word rd, word rs1, sword imm) {
+    return opcode | (rd << 7) | (funct3 << 12) | (rs1 << 15) | (((word) imm & 0xfff) << 20);
+}
+
+static word enc_s(word funct3, word rs1, word rs2, sword imm) {
+    word bits = (word) imm;
+    return 0x23 | ((bits & 0x1f) << 7) | (funct3 << 12) | (rs1 << 15) | (rs2 << 20) | (((bits >> 5) & 0x7f) << 25);
+}
+
+static word enc_b(word funct3, word rs1, word rs2, sword offset) {
+    word bits = (word) offset;
+    return 0x63 | (((bits >> 11) & 1) << 7) | (((bits >> 1) & 0xf) << 8) | (funct3 << 12) | (rs1 << 15) | (rs2 << 20)
+        | (((bits >> 5) & 0x3f) << 25) | (((bits >> 12) & 1) << 31);
+}
+
+#define LUI(rd, imm)        (0x37 | ((rd) << 7) | ((word) (imm) << 12))
+#define ADDI(rd, rs1, imm)  enc_i(0x13, 0, rd, rs1, imm)
+#define XORI(rd, rs1, imm)  enc_i(0x13, 4, rd, rs1, imm)
+#define ORI(rd, rs1, imm)   enc_i(0x13, 6, rd, rs1, imm)
+#define ANDI(rd, rs1, imm)  enc_i(0x13, 7, rd, rs1, imm)
+#define SLLI(rd, rs1, imm)  enc_i(0x13, 1, rd, rs1, imm)
+#define SRLI(rd, rs1, imm)  enc_i(0x13, 5, rd, rs1, imm)
+#define ADD(rd, rs1, rs2)   enc_r(0x33, 0, 0x00, rd, rs1, rs2)
+#define SUB(rd, rs1, rs2)   enc_r(0x33, 0, 0x20, rd, rs1, rs2)
+#define MUL(rd, rs1, rs2)   enc_r(0x33, 0, 0x01, rd, rs1, rs2)
+#define LD(rd, rs1, imm)    enc_i(0x03, 3, rd, rs1, imm)
+#define SD(rs1, rs2, imm)   enc_s(3, rs1, rs2, imm)
+#define BEQ(rs1, rs2, off)  enc_b(0, rs1, rs2, off)
+#define BNE(rs1, rs2, off)  enc_b(1, rs1, rs2, off)
+#define BGE(rs1, rs2, off)  enc_b(5, rs1, rs2, off)
+#define BLTU(rs1, rs2, off) enc_b(6, rs1, rs2, off)
+#define EBREAK              0x00100073
+
+// ---------- Workloads ----------
+
+// Program being written into guest RAM
+typedef struct bench_asm {
+    byte* ram;
+    dword at;
+} bench_asm_t;
+
+static void emit(bench_asm_t* a, word instr) {
+    memcpy(a->ram + a->at, &instr, sizeof(instr));
+    a->at += 4;
+}
+
+// Offset from the next instruction to <label> (for backward branches)
+static sword back_to(const bench_asm_t* a, dword label) {
+    return (sword) (label - a->at);
+}
+
+// Tight ALU loop: a dependent chain of immediate and register arithmetic (10 instructions per iteration)
+static void workload_alu(bench_asm_t* a, word scale) {
+    emit(a, LUI(2, 0x300 * scale));
+    dword loop = a->at;
+    emit(a, ADDI(6, 6, 7));
+    emit(a, XORI(7, 6, 0x55));
+    emit(a, SLLI(8, 7, 3));
+    emit(a, ADD(9, 9, 8));
+    emit(a, SRLI(10, 9, 5));
+    emit(a, SUB(11, 11, 10));
+    emit(a, ORI(12, 11, 0x0f));
+    emit(a, ANDI(13, 12, 0x7f0));
+    emit(a, ADDI(2, 2, -1));
+    emit(a, BNE(2, 0, back_to(a, loop)));
+    emit(a, EBREAK);
+}
+
+// Memory streaming: copy 1 MiB of dwords over and over (more pages than the TLB holds)
+static void workload_memory(bench_asm_t* a, word scale) {
+    emit(a, LUI(20, BENCH_SRC >> 12));
+    emit(a, LUI(21, BENCH_DST >> 12));
+    emit(a, ADDI(3, 0, 32 * scale));
+    dword outer = a->at;
+    emit(a, ADDI(5, 20, 0));
+    emit(a, ADDI(6, 21, 0));
+    emit(a, LUI(7, 0x20));
+    dword inner = a->at;
+    emit(a, LD(8, 5, 0));
+    emit(a, SD(6, 8, 0));
+    emit(a, LD(9, 5, 8));
+    emit(a, SD(6, 9, 8));
+    emit(a, ADDI(5, 5, 16));
+    emit(a, ADDI(6, 6, 16));
+    emit(a, ADDI(7, 7, -2));
+    emit(a, BNE(7, 0, back_to(a, inner)));
+    emit(a, ADDI(3, 3, -1));
+    emit(a, BNE(3, 0, back_to(a, outer)));
+    emit(a, EBREAK);
+}
+
+// Bulk memory: the 1 MiB copy as a plain one-dword-per-iteration loop, followed by a fill of the destination (the loops the kernel runs as memmove/memset)
+static void workload_bulk(bench_asm_t* a, word scale) {
+    emit(a, LUI(20, BENCH_SRC >> 12));
+    emit(a, LUI(21, BENCH_DST >> 12));
+    emit(a, LUI(22, (BENCH_SRC + 0x100000) >> 12));
+    emit(a, LUI(23, (BENCH_DST + 0x100000) >> 12));
+    emit(a, ADDI(3, 0, 32 * scale));
+    dword outer = a->at;
+    emit(a, ADDI(5, 20, 0));
+    emit(a, ADDI(6, 21, 0));
+    dword copy = a->at;
+    emit(a, LD(8, 5, 0));
+    emit(a, SD(6, 8, 0));
+    emit(a, ADDI(5, 5, 8));
+    emit(a, ADDI(6, 6, 8));
+    emit(a, BNE(5, 22, back_to(a, copy)));
+    emit(a, ADDI(6, 21, 0));
+    dword fill = a->at;
+    emit(a, SD(6, 3, 0));
+    emit(a, ADDI(6, 6, 8));
+    emit(a, BNE(6, 23, back_to(a, fill)));
+    emit(a, ADDI(3, 3, -1));
+    emit(a, BNE(3, 0, back_to(a, outer)));
+    emit(a, EBREAK);
+}
+
+// Branch-heavy code: short blocks selected by the high bits of a linear congruential sequence
+static void workload_branch(bench_asm_t* a, word scale) {
+    emit(a, LUI(2, 0x100 * scale));
+    emit(a, ADDI(10, 0, 0x123));
+    dword loop = a->at;
+    emit(a, SLLI(11, 10, 5));
+    emit(a, ADD(10, 10, 11));
+    emit(a, ADDI(10, 10, 59));
+    emit(a, SRLI(12, 10, 37));
+    emit(a, ANDI(12, 12, 1));
+    emit(a, BEQ(12, 0, 8));
+    emit(a, ADDI(13, 13, 1));
+    emit(a, SRLI(12, 10, 45));
+    emit(a, ANDI(12, 12, 1));
+    emit(a, BNE(12, 0, 8));
+    emit(a, ADDI(14, 14, 1));
+    emit(a, BGE(10, 0, 8));
+    emit(a, ADDI(15, 15, 1));
+    emit(a, BLTU(13, 14, 8));
+    emit(a, ADDI(16, 16, 1));
+    emit(a, ADDI(2, 2, -1));
+    emit(a, BNE(2, 0, back_to(a, loop)));
+    emit(a, EBREAK);
+}
+
+// Multiply-heavy code (rv64m): chained and independent products
+static void workload_mul(bench_asm_t* a, word scale) {
+    emit(a, LUI(2, 0x300 * scale));
+    emit(a, ADDI(5, 0, 3));
+    emit(a, ADDI(6, 0, 5));
+    dword loop = a->at;
+    emit(a, MUL(7, 7, 5));
+    emit(a, ADD(7, 7, 6));
+    emit(a, MUL(8, 8, 7));
+    emit(a, ADDI(8, 8, 1));
+    emit(a, MUL(9, 7, 8));
+    emit(a, ADD(10, 10, 9));
+    emit(a, MUL(11, 10, 10));
+    emit(a, ADDI(2, 2, -1));
+    emit(a, BNE(2, 0, back_to(a, loop)));
+    emit(a, EBREAK);
+}
+
+static const struct {
+    const char* name;
+    void (*build)(bench_asm_t* a, word scale);
+} workloads[] = {
+    { "alu",    workload_alu },
+    { "memory", workload_memory },
+    { "branch", workload_branch },
+    { "mul",    workload_mul },
+    { "bulk",   workload_bulk },
+};
+
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+// ---------- Benchmark Services ----------
+
+// Everything the workloads touch is mapped, so any callback is a bug in a workload
+static int bench_failed = 0;
+
+static void bench_fail(const char* what, dword address) {
+    fprintf(stderr, "Unexpected %s @ %016lx\n", what, address);
+    bench_failed = 1;
+}
+
+static dword z_bench_load_dword(dword address) { bench_fail("load", address); return 0; }
+static void z_bench_store_dword(dword address, dword value) { bench_fail("store", address); }
+
+static word z_bench_load_word(dword address) { bench_fail("load", address); return 0; }
+static void z_bench_store_word(dword address, word value) { bench_fail("store", address); }
+
+static hword z_bench_load_hword(dword address) { bench_fail("load", address); return 0; }
+static void z_bench_store_hword(dword address, hword value) { bench_fail("store", address); }
+
+static byte z_bench_load_byte(dword address) { bench_fail("load", address); return 0; }
+static void z_bench_store_byte(dword address, byte value) { bench_fail("store", address); }
+
+static void z_bench_log_trace(unsigned step, dword pc, dword *registers) { return; }
+
+static void z_bench_log_message(const char *msg) { return; }
+static void z_bench_panic(const char *msg)       { fprintf(stderr, "PANIC: %s\n", msg); bench_failed = 1; }
+
+static const rsk_host_services_t bench_services = {
+    .mem_load_dword =  z_bench_load_dword,
+    .mem_store_dword = z_bench_store_dword,
+    .mem_load_word =   z_bench_load_word,
+    .mem_store_word =  z_bench_store_word,
+    .mem_load_hword =  z_bench_load_hword,
+    .mem_store_hword = z_bench_store_hword,
+    .mem_load_byte =   z_bench_load_byte,
+    .mem_store_byte =  z_bench_store_byte,
+    .log_trace =       z_bench_log_trace,
+    .log_msg =         z_bench_log_message,
+    .panic =           z_bench_panic
+};
+
+// ---------- Benchmark Driver ----------
+
+static double bench_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+// Percentage of <total> events that were not <misses> (100 if there were none)
+static double hit_rate(dword total, dword misses) {
+    if (0 == total) return 100.0;
+    return 100.0 * (double) (total - misses) / (double) total;
+}
+
+// Return the value of the rsk_info entry "<name>=value" (NULL if there is none)
+static const char* info_value(const char* name) {
+    size_t length = strlen(name);
+    for (const char* const* info = rsk_info(); NULL != *info; info++) {
+        if (0 == strncmp(*info, name, length) && '=' == (*info)[length]) return *info + length + 1;
+    }
+    return NULL;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "usage: %s [-j] [-k] [-x SCALE] [-s CSV_FILE] [WORKLOAD ...]\n", program);
+    fprintf(stderr, "  -j           enable the JIT (rc_jit)\n");
+    fprintf(stderr, "  -k           simulate the default I-cache and D-cache (rc_cache_on); load/store hit rates are then D-cache hit rates\n");
+    fprintf(stderr, "  -x SCALE     multiply the length of every workload by SCALE (default 1)\n");
+    fprintf(stderr, "  -s CSV_FILE  append the stats to CSV_FILE, in the format of rsh.py --stats-log\n");
+    fprintf(stderr, "workloads:");
+    for (size_t w = 0; w < WORKLOAD_COUNT; w++) fprintf(stderr, " %s", workloads[w].name);
+    fprintf(stderr, " (default: all)\n");
+}
+
+int main(int argc, char** argv) {
+    rsk_config_t config = rc_nothing;
+    int scale = 1;
+    const char* csv_path = NULL;
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "jkx:s:h"))) {
+        switch (opt) {
+            case 'j': config |= rc_jit; break;
+            case 'k': config |= rc_cache_on; break;
+            case 'x': scale = atoi(optarg); break;
+            case 's': csv_path = optarg; break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (scale < 1 || scale > 16) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // run the named workloads (or all of them) in suite order
+    int selected[WORKLOAD_COUNT] = { 0 };
+    for (int i = optind; i < argc; i++) {
+        size_t w = 0;
+        while (w < WORKLOAD_COUNT && 0 != strcmp(argv[i], workloads[w].name)) w++;
+        if (WORKLOAD_COUNT == w) {
+            usage(argv[0]);
+            return 2;
+        }
+        selected[w] = 1;
+    }
+    if (optind == argc) {
+        for (size_t w = 0; w < WORKLOAD_COUNT; w++) selected[w] = 1;
+    }
+
+    FILE* csv = NULL;
+    if (NULL != csv_path && NULL == (csv = fopen(csv_path, "a"))) {
+        fprintf(stderr, "%s: cannot open file\n", csv_path);
+        return 1;
+    }
+    const char* author = info_value("author");
+
+    byte* ram = (byte*) calloc(BENCH_RAM_SIZE, 1);
+    if (NULL == ram) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    printf("%-8s %12s %9s %9s %8s %8s %8s %8s %18s\n", "workload", "instructions", "seconds", "MIPS", "ns/instr", "blocks%", "loads%", "stores%", "registers");
+    for (size_t w = 0; w < WORKLOAD_COUNT; w++) {
+        if (!selected[w]) continue;
+
+        riscv_cpu_t* cpu = cpu_init(NULL, &bench_services);
+        if (NULL == cpu) return 1;
+        memset(ram, 0, BENCH_RAM_SIZE);
+        cpu_map_ram(cpu, ram, 0, BENCH_RAM_SIZE, 1);
+
+        bench_asm_t a = { ram, BENCH_CODE };
+        workloads[w].build(&a, (word) scale);
+        cpu_set_config(cpu, config);
+        cpu_set_pc(cpu, BENCH_CODE);
+
+        double start = bench_seconds();
+        cpu_run(cpu, 0);
+        double span = bench_seconds() - start;
+
+        rsk_stat_t stats;
+        dword lookups, decodes;
+        cpu_fill_stats(cpu, &stats);
+        cpu_block_stats(cpu, &lookups, &decodes);
+
+        // a fingerprint of the final registers, to compare cores and the JIT
+        dword registers = 0;
+        for (int i = 1; i < REGISTER_COUNT; i++) registers = (registers ^ cpu_read_register(cpu, i)) * 0x100000001b3;
+
+        printf("%-8s %12u %9.4f %9.1f %8.2f %8.2f %8.2f %8.2f   %016lx\n", workloads[w].name, stats.instructions, span,
+            stats.instructions / span / 1e6, span * 1e9 / stats.instructions,
+            hit_rate(lookups, decodes), hit_rate(stats.loads, stats.load_misses), hit_rate(stats.stores, stats.store_misses), registers);
+
+        if (NULL != csv) {
+            fprintf(csv, "%s,%s,%.9g,%u,%u,%u,%u,%u\r\n", (NULL != author) ? author : "", workloads[w].name, span,
+                stats.instructions, stats.loads, stats.load_misses, stats.stores, stats.store_misses);
+        }
+        cpu_free(cpu);
+    }
+
+    free(ram);
+    if (NULL != csv) fclose(csv);
+    return bench_failed ? 1 : 0;
+}
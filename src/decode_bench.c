@@ -0,0 +1,109 @@
+/*
+ - Instruction decode microbenchmark
+ - Compares the linear registry search against the decode table lookup
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+// Built directly against the simulator source so the registry internals are visible
+#include "riscv64.c"
+
+#define BENCH_WORDS      4096
+#define BENCH_ITERATIONS 4000
+
+// ---------- Benchmark Services ----------
+
+dword z_bench_load_dword(dword address) { return 0; }
+void z_bench_store_dword(dword address, dword value) { return; }
+
+word z_bench_load_word(dword address) { return 0; }
+void z_bench_store_word(dword address, word value) { return; }
+
+hword z_bench_load_hword(dword address) { return 0; }
+void z_bench_store_hword(dword address, hword value) { return; }
+
+byte z_bench_load_byte(dword address) { return 0; }
+void z_bench_store_byte(dword address, byte value) { return; }
+
+void z_bench_log_trace(unsigned step, dword pc, dword *registers) { return; }
+
+void z_bench_log_message(const char *msg) { return; }
+void z_bench_panic(const char *msg)       { fprintf(stderr, "%s\n", msg); }
+
+rsk_host_services_t bench_services = {
+    .mem_load_dword =  z_bench_load_dword,
+    .mem_store_dword = z_bench_store_dword,
+    .mem_load_word =   z_bench_load_word,
+    .mem_store_word =  z_bench_store_word,
+    .mem_load_hword =  z_bench_load_hword,
+    .mem_store_hword = z_bench_store_hword,
+    .mem_load_byte =   z_bench_load_byte,
+    .mem_store_byte =  z_bench_store_byte,
+    .log_trace =       z_bench_log_trace,
+    .log_msg =         z_bench_log_message,
+    .panic =           z_bench_panic
+};
+
+// ---------- Timing ----------
+
+static double bench_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+// Time BENCH_ITERATIONS passes of a lookup function over the instruction words and return lookups per second
+static double bench_lookups(const riscv_registry_t* const registry, riscv_instr_t* (*lookup)(const riscv_registry_t* const, word), const word* words, size_t* checksum) {
+    size_t sum = 0;
+
+    double start = bench_seconds();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        for (size_t w = 0; w < BENCH_WORDS; w++) {
+            sum += (size_t) lookup(registry, words[w]);
+        }
+    }
+    double span = bench_seconds() - start;
+
+    *checksum = sum;
+    return ((double) BENCH_ITERATIONS * BENCH_WORDS) / span;
+}
+
+int main() {
+    riscv_cpu_t* cpu = cpu_init(NULL, &bench_services);
+    if (NULL == cpu) return 1;
+    const riscv_registry_t* registry = cpu->instruction_set;
+
+    // every registered instruction type, with pseudo-random bits outside of its mask, weighted evenly
+    word words[BENCH_WORDS];
+    word noise = 0x2545f491;
+    for (size_t w = 0; w < BENCH_WORDS; w++) {
+        const riscv_instr_t* itype = &registry->types[w % registry->count];
+        noise ^= noise << 13;
+        noise ^= noise >> 17;
+        noise ^= noise << 5;
+        words[w] = itype->required_bits | (noise & ~itype->mask);
+    }
+
+    // both paths must agree before their speed means anything
+    for (size_t w = 0; w < BENCH_WORDS; w++) {
+        if (registry_search(registry, words[w]) != registry_decode(registry, words[w])) {
+            fprintf(stderr, "Decode mismatch for %#.8x\n", words[w]);
+            return 1;
+        }
+    }
+
+    size_t linear_sum, table_sum;
+    double linear = bench_lookups(registry, registry_search, words, &linear_sum);
+    double table = bench_lookups(registry, registry_decode, words, &table_sum);
+    if (linear_sum != table_sum) {
+        fprintf(stderr, "Decode checksum mismatch\n");
+        return 1;
+    }
+
+    printf("%zu instruction types registered\n", registry->count);
+    printf("registry_search: %14.0f lookups/s\n", linear);
+    printf("registry_decode: %14.0f lookups/s (%.2fx)\n", table, table / linear);
+    cpu_free(cpu);
+    return 0;
+}
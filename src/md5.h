@@ -0,0 +1,37 @@
+/*
+ - MD5 message digest (RFC 1321)
+ - Used by native host tools to report the same RAM checksums as rsh.py
+*/
+
+#ifndef SIM_MD5
+#define SIM_MD5
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Length of an MD5 digest in bytes
+#define MD5_DIGEST_SIZE 16
+
+// Length of an MD5 digest as a NUL-terminated hex string
+#define MD5_HEX_SIZE (2 * MD5_DIGEST_SIZE + 1)
+
+// Running MD5 computation state
+typedef struct md5_context {
+    uint32_t state[4];
+    uint64_t length;
+    uint8_t block[64];
+} md5_context_t;
+
+// Start a new digest
+void md5_init(md5_context_t* ctx);
+
+// Add <size> bytes of <data> to the digest
+void md5_update(md5_context_t* ctx, const void* data, size_t size);
+
+// Finish the digest and write it to <digest>
+void md5_final(md5_context_t* ctx, uint8_t digest[MD5_DIGEST_SIZE]);
+
+// Digest <size> bytes of <data> and write the result as a lowercase hex string (like hashlib's hexdigest())
+void md5_hex(const void* data, size_t size, char hex[MD5_HEX_SIZE]);
+
+#endif
@@ -1,11 +1,73 @@
+// (for memfd_create)
+#define _GNU_SOURCE
+
 #include "riscv64.h"
 
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// vector stores for bulk fills
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 // ---------- RISC-V Instruction Definitions ----------
 
+// The encoding format of an instruction type (determines how its immediate is decoded)
+typedef enum riscv64_instruction_format {
+	rf_r,
+	rf_i,
+	rf_s,
+	rf_b,
+	rf_u,
+	rf_j,
+} riscv_format_t;
+
+// The operands shown by the disassembly of an instruction type, e.g. "add x1, x2, x3" (immediates are printed in hex unless negative)
+typedef enum riscv64_disassembly_syntax {
+	// name only: ebreak
+	ds_none,
+
+	// rd and the U type immediate: lui x1, 0x1000
+	ds_upper,
+
+	// rd and the J type offset: jal x1, 0x10
+	ds_jump,
+
+	// rd, rs1 and the I type immediate: addi x1, x2, -3
+	ds_imm,
+
+	// rd, rs1 and the shift amount: slli x1, x2, 0x3
+	ds_shift,
+
+	// rd, rs1 and rs2: add x1, x2, x3
+	ds_reg,
+
+	// rd and an I type offset from rs1: lw x1, 0x8(x2)
+	ds_load,
+
+	// rs2 and an S type offset from rs1: sw x3, 0x8(x2)
+	ds_store,
+
+	// rs1, rs2 and the B type offset: beq x2, x3, -8
+	ds_branch,
+} riscv_syntax_t;
+
+// A predecoded instruction; see riscv64_decoded_instruction below
+typedef struct riscv64_decoded_instruction riscv_op_t;
+
 // A RISC-V instruction type; used for decoding, disassembly, and execution
 typedef struct riscv64_instruction_type {
     // The name of this instruction type
@@ -17,55 +79,85 @@ typedef struct riscv64_instruction_type {
 	// Required bits within the mask for this instruction type
 	const word required_bits;
 
-	// Disassemble an instruction of this type, putting the result into the provided string buffer. Returns the length of the complete disassembled instruction. If the buffer is not large enough to hold the instruction, the resulting string will be terminated early.
-	size_t (*disassemble)(riscv_cpu_t* const cpu, word instr, char* buffer, size_t buffer_size);
+	// Encoding format of this instruction type
+	const riscv_format_t format;
 
-	// Execute an instruction of this type and return 1 if pc was changed (zero otherwise)
-	void (*execute)(riscv_cpu_t* const cpu, word instr, int* updated_pc, int* loaded, int* stored);
+	// Operands shown when disassembling an instruction of this type
+	const riscv_syntax_t syntax;
+
+	// Execute a predecoded instruction of this type, setting the flags if pc was changed, memory was loaded, or memory was stored
+	void (*execute)(riscv_cpu_t* const cpu, const riscv_op_t* const op, int* updated_pc, int* loaded, int* stored);
 } riscv_instr_t;
 
-// A set of potentially many lists of instruction types
-typedef struct riscv64_instruction_type_registry {
-    // The number of instruction types in the registry
-    size_t count;
+// An instruction with its fields already extracted, ready to be executed
+struct riscv64_decoded_instruction {
+	// Execution function of the instruction's type
+	void (*execute)(riscv_cpu_t* const cpu, const riscv_op_t* const op, int* updated_pc, int* loaded, int* stored);
 
-    // TODO: redesign so that instructions can be added individually with automatically resizing array
-    // An array of pointers to RISC-V 64 bit instruction type structs
-    riscv_instr_t** type_links;
-} riscv_registry_t;
+	// The instruction's type
+	const riscv_instr_t* itype;
 
-// ---------- Instruction Definition Functions -----------
+	// Sign-extended immediate value (zero for R type instructions)
+	sdword imm;
 
-// Append a set of instruction types to a registry and return the number of instructions added
-size_t registry_append(riscv_registry_t* const registry, size_t new_types_count, riscv_instr_t* const new_types) {
-    size_t og_reg_count = registry->count;
+	// The encoded instruction
+	word instr;
 
-    // resize registry
-    if (NULL == registry->type_links) {
-        registry->type_links = (riscv_instr_t**) malloc(new_types_count * sizeof(riscv_instr_t*));
-        if (NULL == registry->type_links) return 0;
-    } else {
-        riscv_instr_t** new_type_links = (riscv_instr_t**) realloc(registry->type_links, (og_reg_count + new_types_count) * sizeof(riscv_instr_t*));
-        
-        if (NULL == new_type_links) return 0;
+	// Register indices
+	byte rd;
+	byte rs1;
+	byte rs2;
 
-        registry->type_links = new_type_links;
-    }
+#ifdef RISCV_THREADED_CORE
+	// Dispatch label of the threaded core (see cpu_run_block_threaded)
+	const void* label;
+#endif
 
-    registry->count = og_reg_count + new_types_count;
+#ifdef RISCV_PERF_COUNTERS
+	// Index of the instruction's type in the registry (see cpu->perf)
+	size_t perf_type;
+#endif
+};
 
-    // append type pointers
-    for (size_t i = 0; i < new_types_count; i ++) {
-        registry->type_links[og_reg_count + i] = &(new_types[i]);
-    }
+// Number of decode table slots (one for each combination of the opcode and funct3 fields)
+#define DECODE_SLOT_COUNT 1024
 
-    return new_types_count;
-}
+// Number of candidate lists in a split decode table slot (one for each funct7 value)
+#define DECODE_FUNCT7_COUNT 128
+
+// A slot of the decode table, selected by the opcode and funct3 fields of an instruction
+typedef struct riscv64_decode_slot {
+    // NULL-terminated list of the instruction types that may match (used if no candidate depends on funct7)
+    riscv_instr_t** candidates;
+
+    // Candidate lists indexed by funct7 (NULL unless a candidate in this slot depends on funct7)
+    riscv_instr_t*** by_funct7;
+} riscv_decode_slot_t;
+
+// The instruction types known to the CPU, indexed for decoding
+typedef struct riscv64_instruction_type_registry {
+    // The number of instruction types in the registry
+    size_t count;
+
+    // The instruction types, in matching order (a table generated from the instruction set headers)
+    riscv_instr_t* types;
+
+    // Decode index over types (built by registry_build_decode, empty until then)
+    riscv_decode_slot_t decode[DECODE_SLOT_COUNT];
+
+    // Storage for all of the NULL-terminated candidate lists referenced by the decode index
+    riscv_instr_t** decode_lists;
+
+    // Storage for the funct7 tables of split decode slots
+    riscv_instr_t*** decode_splits;
+} riscv_registry_t;
+
+// ---------- Instruction Definition Functions -----------
 
 // Return the pointer to the first instruction in the registry that matches the instruction (or NULL if no match was found)
 riscv_instr_t* registry_search(const riscv_registry_t* const registry, word instr) {
     for (size_t i = 0; i < registry->count; i++) {
-        riscv_instr_t* itype = registry->type_links[i];
+        riscv_instr_t* itype = &registry->types[i];
         if ((itype->mask & instr) == itype->required_bits) return itype;
     }
 
@@ -119,6 +211,133 @@ static inline byte mask_instr_rs2(word instruction) { return (byte) ((instructio
 // Isolate the funct7 field of an R format instruction
 static inline byte mask_instr_funct7(word instruction) { return (byte) ((instruction & INSTR_FUNCT7) >> 25); }
 
+// ---------- Instruction Decode Table ----------
+
+// Fields of an instruction that are used to index the decode table
+#define DECODE_KEY_MASK (INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7)
+
+// Construct the opcode and funct3 bits of an instruction from a decode slot index
+static inline word decode_slot_key(size_t slot) {
+    return ((word) (slot & 0x7f)) | (((word) (slot >> 7)) << 12);
+}
+
+// Return the decode slot index of an instruction
+static inline size_t decode_slot_index(word instr) {
+    return (((size_t) mask_instr_funct3(instr)) << 7) | mask_instr_opcode(instr);
+}
+
+// Return 1 if an instruction type can match some instruction whose <key_mask> bits are given by <key>
+static inline int decode_compatible(const riscv_instr_t* const itype, word key, word key_mask) {
+    return ((itype->required_bits ^ key) & itype->mask & key_mask) == 0;
+}
+
+// Fill <list> (if not NULL) with the registry's candidates for a decode key, in registry order. Returns the length of the list, including its NULL terminator.
+static size_t decode_fill_list(const riscv_registry_t* const registry, word key, word key_mask, riscv_instr_t** list) {
+    size_t count = 0;
+
+    for (size_t i = 0; i < registry->count; i++) {
+        riscv_instr_t* itype = &registry->types[i];
+        if (!decode_compatible(itype, key, key_mask)) continue;
+
+        if (NULL != list) list[count] = itype;
+        count++;
+    }
+
+    if (NULL != list) list[count] = NULL;
+    return count + 1;
+}
+
+// Return 1 if any candidate for a decode slot depends on the funct7 field
+static int decode_slot_splits(const riscv_registry_t* const registry, size_t slot) {
+    word key = decode_slot_key(slot);
+
+    for (size_t i = 0; i < registry->count; i++) {
+        riscv_instr_t* itype = &registry->types[i];
+        if ((itype->mask & INSTR_FUNCT7) && decode_compatible(itype, key, INSTR_OPCODE | INSTR_FUNCT3)) return 1;
+    }
+
+    return 0;
+}
+
+// Release the decode index of a registry
+void registry_free_decode(riscv_registry_t* const registry) {
+    free(registry->decode_lists);
+    free(registry->decode_splits);
+
+    registry->decode_lists = NULL;
+    registry->decode_splits = NULL;
+    for (size_t i = 0; i < DECODE_SLOT_COUNT; i++) {
+        registry->decode[i].candidates = NULL;
+        registry->decode[i].by_funct7 = NULL;
+    }
+}
+
+// (Re)build the decode index of a registry from its current instruction types. Returns 0 on allocation failure (the registry is then left without an index).
+int registry_build_decode(riscv_registry_t* const registry) {
+    registry_free_decode(registry);
+
+    // size the candidate list and funct7 table storage
+    size_t list_total = 0;
+    size_t split_total = 0;
+    for (size_t slot = 0; slot < DECODE_SLOT_COUNT; slot++) {
+        word key = decode_slot_key(slot);
+
+        if (!decode_slot_splits(registry, slot)) {
+            list_total += decode_fill_list(registry, key, INSTR_OPCODE | INSTR_FUNCT3, NULL);
+            continue;
+        }
+
+        split_total += DECODE_FUNCT7_COUNT;
+        for (word funct7 = 0; funct7 < DECODE_FUNCT7_COUNT; funct7++) {
+            list_total += decode_fill_list(registry, key | (funct7 << 25), DECODE_KEY_MASK, NULL);
+        }
+    }
+
+    registry->decode_lists = (riscv_instr_t**) malloc(list_total * sizeof(riscv_instr_t*));
+    registry->decode_splits = (riscv_instr_t***) malloc((split_total ? split_total : 1) * sizeof(riscv_instr_t**));
+    if (NULL == registry->decode_lists || NULL == registry->decode_splits) {
+        registry_free_decode(registry);
+        return 0;
+    }
+
+    // fill the candidate lists
+    riscv_instr_t** list = registry->decode_lists;
+    riscv_instr_t*** split = registry->decode_splits;
+    for (size_t slot = 0; slot < DECODE_SLOT_COUNT; slot++) {
+        word key = decode_slot_key(slot);
+
+        if (!decode_slot_splits(registry, slot)) {
+            registry->decode[slot].candidates = list;
+            list += decode_fill_list(registry, key, INSTR_OPCODE | INSTR_FUNCT3, list);
+            continue;
+        }
+
+        registry->decode[slot].by_funct7 = split;
+        for (word funct7 = 0; funct7 < DECODE_FUNCT7_COUNT; funct7++) {
+            split[funct7] = list;
+            list += decode_fill_list(registry, key | (funct7 << 25), DECODE_KEY_MASK, list);
+        }
+        split += DECODE_FUNCT7_COUNT;
+    }
+
+    return 1;
+}
+
+// Return the pointer to the first instruction in the registry that matches the instruction (or NULL if no match was found), using the decode index if it has been built
+riscv_instr_t* registry_decode(const riscv_registry_t* const registry, word instr) {
+    const riscv_decode_slot_t* const slot = &registry->decode[decode_slot_index(instr)];
+
+    riscv_instr_t** list = slot->candidates;
+    if (NULL != slot->by_funct7) list = slot->by_funct7[mask_instr_funct7(instr)];
+    else if (NULL == list) return registry_search(registry, instr);
+
+    for (; NULL != *list; list++) {
+        if (((*list)->mask & instr) == (*list)->required_bits) return *list;
+    }
+
+    return NULL;
+}
+
 // ---------- Instruction Immediate Decoding Functions ----------
 
 // Decode an unsigned immediate value from an I type instruction
@@ -178,27 +397,96 @@ static inline sword jtype_imm(word instr) {
 	return (((sword) unsigned_jtype_imm(instr)) << 11) >> 11;
 }
 
-// ---------- Disassembly/Execution Function Names ----------
-
-#define DISASM_DEF(name) size_t z_disasm_##name(riscv_cpu_t* const cpu, word instr, char* buffer, size_t buffer_size)
-#define EXEC_DEF(name)   void z_exec_##name(riscv_cpu_t* const cpu, word instr, int* updated_pc, int* loaded, int* stored)
-
-#define DISASM_FMT(format, ...) snprintf(buffer, buffer_size, format __VA_OPT__(, ) __VA_ARGS__)
-
-#define INSTR_LINKS(name) .disassemble = z_disasm_##name , .execute = z_exec_##name
+// ---------- Instruction Predecoding ----------
+
+// Extract the fields of an instruction of type <itype> into <op>
+static void op_decode(const riscv_instr_t* const itype, word instr, riscv_op_t* const op) {
+	op->execute = itype->execute;
+	op->itype = itype;
+	op->instr = instr;
+	op->rd = mask_instr_rd(instr);
+	op->rs1 = mask_instr_rs1(instr);
+	op->rs2 = mask_instr_rs2(instr);
+
+	switch (itype->format) {
+		case rf_i: op->imm = itype_imm(instr); break;
+		case rf_s: op->imm = stype_imm(instr); break;
+		case rf_b: op->imm = btype_imm(instr); break;
+		case rf_u: op->imm = utype_imm(instr); break;
+		case rf_j: op->imm = jtype_imm(instr); break;
+		default:   op->imm = 0; break;
+	}
+}
 
-#define GET_FUNCT7 mask_instr_funct7(instr)
-#define GET_RS2    mask_instr_rs2(instr)
-#define GET_RS1    mask_instr_rs1(instr)
-#define GET_FUNCT3 mask_instr_funct3(instr)
-#define GET_RD     mask_instr_rd(instr)
-#define GET_OPCODE mask_instr_opcode(instr)
+// ---------- Disassembly ----------
+
+// Disassemble <instr>, an instruction of type <itype>, into <buffer>. Returns the length of the complete disassembled instruction; if the buffer is not large enough to hold it, the string is terminated early.
+static size_t disasm_instr(const riscv_instr_t* const itype, word instr, char* buffer, size_t buffer_size) {
+	const char* name = itype->name;
+	byte rd = mask_instr_rd(instr);
+	byte rs1 = mask_instr_rs1(instr);
+	byte rs2 = mask_instr_rs2(instr);
+
+	sword imm;
+	switch (itype->syntax) {
+		case ds_upper:
+			imm = utype_imm(instr);
+			return snprintf(buffer, buffer_size, imm < 0 ? "%s x%hhu, %d" : "%s x%hhu, %#x", name, rd, imm);
+		case ds_jump:
+			imm = jtype_imm(instr);
+			return snprintf(buffer, buffer_size, imm < 0 ? "%s x%hhu, %d" : "%s x%hhu, %#x", name, rd, imm);
+		case ds_imm:
+			imm = itype_imm(instr);
+			return snprintf(buffer, buffer_size, imm < 0 ? "%s x%hhu, x%hhu, %d" : "%s x%hhu, x%hhu, %#x", name, rd, rs1, imm);
+		case ds_shift:
+			return snprintf(buffer, buffer_size, "%s x%hhu, x%hhu, %#x", name, rd, rs1, (word) ((BITSMASK(25, 20) & instr) >> 20));
+		case ds_reg:
+			return snprintf(buffer, buffer_size, "%s x%hhu, x%hhu, x%hhu", name, rd, rs1, rs2);
+		case ds_load:
+			imm = itype_imm(instr);
+			return snprintf(buffer, buffer_size, imm < 0 ? "%s x%hhu, %d(x%hhu)" : "%s x%hhu, %#x(x%hhu)", name, rd, imm, rs1);
+		case ds_store:
+			imm = stype_imm(instr);
+			return snprintf(buffer, buffer_size, imm < 0 ? "%s x%hhu, %d(x%hhu)" : "%s x%hhu, %#x(x%hhu)", name, rs2, imm, rs1);
+		case ds_branch:
+			imm = btype_imm(instr);
+			return snprintf(buffer, buffer_size, imm < 0 ? "%s x%hhu, x%hhu, %d" : "%s x%hhu, x%hhu, %#x", name, rs1, rs2, imm);
+		default:
+			return snprintf(buffer, buffer_size, "%s", name);
+	}
+}
 
+// ---------- Execution Function Names ----------
+
+#ifdef RISCV_THREADED_CORE
+// the threaded core inlines execution functions into its dispatch loop (they stay addressable for the function pointer core)
+#define EXEC_DEF(name)   static inline __attribute__((always_inline)) void z_exec_##name(riscv_cpu_t* const cpu, const riscv_op_t* const op, int* updated_pc, int* loaded, int* stored)
+#else
+#define EXEC_DEF(name)   void z_exec_##name(riscv_cpu_t* const cpu, const riscv_op_t* const op, int* updated_pc, int* loaded, int* stored)
+#endif
+
+// predecoded fields (only available in execution functions)
+#define OP_RD      (op->rd)
+#define OP_RS1     (op->rs1)
+#define OP_RS2     (op->rs2)
+#define OP_IMM     (op->imm)
+#define OP_SHAMT   ((byte) (op->imm & 0x3f))
+#define OP_SHAMT_W ((byte) (op->imm & 0x1f))
+
+#ifdef RISCV_THREADED_CORE
+// predecoded register indices are 5 bit fields, so no bounds checks are needed (x0 is re-zeroed after every instruction instead of filtering writes)
+#define READ_REG(index)         (cpu->x[index])
+#define WRITE_REG(index, value) (cpu->x[index] = (value))
+
+#define GET_PC       (cpu->pc)
+#define SET_PC(addr) *updated_pc = 1; cpu->pc = (addr)
+#else
 #define READ_REG(index)         cpu_read_register(cpu, index)
 #define WRITE_REG(index, value) cpu_write_register(cpu, index, value)
 
 #define GET_PC       cpu_get_pc(cpu)
 #define SET_PC(addr) *updated_pc = 1; cpu_set_pc(cpu, addr)
+#endif
 
 #define STORE_BYTE(addr, value)  *stored=1; cpu_store_byte(cpu, addr, value)
 #define STORE_HWORD(addr, value) *stored=1; cpu_store_hword(cpu, addr, value)
@@ -210,37 +498,525 @@ static inline sword jtype_imm(word instr) {
 #define LOAD_WORD(addr)  cpu_load_word(cpu, addr)
 #define LOAD_DWORD(addr) cpu_load_dword(cpu, addr)
 
-// ---------- Instruction Set Headers ----------
+// ---------- CPU Constants (for verbosity) ----------
 
-#include "rv64i_instr.h"
-extern const size_t rv64i_size;
-extern riscv_instr_t rv64i_instructions[];
+#define REGISTER_COUNT 32
 
-#include "rv64m_instr.h"
-extern const size_t rv64m_size;
-extern riscv_instr_t rv64m_instructions[];
+// ---------- JIT Data Structures ----------
 
-// ---------- CPU Constants (for verbosity) ----------
+#ifdef RISCV_JIT
+// Number of times a block is entered before the JIT compiles it
+#define JIT_THRESHOLD 64
 
-#define REGISTER_COUNT 32
+// Size of the executable memory holding compiled blocks (everything in it is discarded once it fills up)
+#define JIT_ARENA_SIZE ((size_t) 4 << 20)
+
+// Upper bound on the machine code emitted for a single block
+#define JIT_BLOCK_CODE_MAX (64 + 256 * BLOCK_MAX_OPS)
+
+// A compiled block: runs the whole block, leaves pc at the next instruction, and returns the number of instructions executed (fewer than the block holds only if a store modified code)
+typedef size_t (*riscv_jit_code_t)(riscv_cpu_t* const cpu);
+
+// Executable memory for compiled blocks, allocated the first time a block gets hot
+typedef struct riscv64_jit {
+	byte* code;
+	size_t used;
+
+	// Set if the executable memory could not be allocated (the JIT then stays off)
+	int failed;
+} riscv_jit_t;
+#endif
+
+// ---------- Bulk Memory Idiom Data Structures ----------
+
+// Loops run as bulk memory operations
+typedef enum riscv64_idiom_kind {
+	ik_none,
+	// Every iteration loads an element through one pointer and stores it through another (memcpy)
+	ik_copy,
+	// Every iteration stores a register the loop doesn't change through a pointer (memset)
+	ik_fill,
+} riscv_idiom_kind_t;
+
+// Loop conditions of recognized loops (the branch back to the start of the block)
+typedef enum riscv64_idiom_cond {
+	ic_ne,
+	ic_lt,
+	ic_ltu,
+} riscv_idiom_cond_t;
+
+// Most registers a recognized loop may step (e.g. source and destination pointers and a counter)
+#define IDIOM_INDUCTION_MAX 3
+
+// Most bytes moved by one bulk operation (so a long copy still checks for signals now and then)
+#define IDIOM_CHUNK_MAX ((dword) 1 << 20)
+
+// A copy or fill loop: a block ending in a branch back to its own start, that otherwise holds only its element access(es) and addi increments of its induction registers
+typedef struct riscv64_idiom {
+	riscv_idiom_kind_t kind;
+
+	// Bytes per element, and whether the load sign-extends it
+	byte width;
+	int load_signed;
+
+	// Register each element is loaded into (copies) or stored from (fills)
+	byte value;
+
+	// Pointer registers, with the displacement of their element from the pointer's value at the start of an iteration
+	byte dst;
+	sdword dst_offset;
+	byte src;
+	sdword src_offset;
+
+	// Registers stepped once per iteration, and their steps
+	byte induction[IDIOM_INDUCTION_MAX];
+	sdword step[IDIOM_INDUCTION_MAX];
+	size_t induction_count;
+
+	// Loop condition: the induction register compared (as an index into induction), and the register it's compared with
+	riscv_idiom_cond_t cond;
+	size_t counter;
+	byte bound;
+} riscv_idiom_t;
+
+// ---------- Block Cache Data Structures ----------
+
+// Link register conventions of a control transfer: jal/jalr writing ra (or t0) is a call, and jalr through one of them without linking is a return
+typedef enum riscv64_link {
+	rl_none,
+	rl_call,
+	rl_return,
+} riscv_link_t;
+
+// Number of blocks held by the (direct-mapped) block cache
+#define BLOCK_CACHE_SIZE 512
+
+// Maximum number of instructions in a single block
+#define BLOCK_MAX_OPS 32
+
+// A straight-line run of predecoded instructions, ending at a control transfer (or before an ebreak, undecodable instruction, or breakpoint)
+typedef struct riscv64_block {
+	// Block cache epoch the block was decoded in (it only holds a decoded run while this is the CPU's current epoch, see BLOCK_VALID)
+	dword epoch;
+
+	// Address of the first instruction
+	dword start;
+
+	// Address just past the last instruction
+	dword end;
+
+	// Number of decoded instructions (zero if the first instruction is an ebreak, cannot be decoded, or has a breakpoint)
+	size_t count;
+
+	// How the last instruction links (riscv_link_t, for the profiler's shadow call stack)
+	int link;
+
+	// Nonzero if the block is empty because of a breakpoint at its address (blocks end before any other breakpoint)
+	int breakpoint;
+
+	// What the block does if it's a copy or fill loop
+	riscv_idiom_t idiom;
+
+#ifdef RISCV_THREADED_CORE
+	// Nonzero once the dispatch labels of the ops have been filled in
+	int threaded;
+#endif
+
+#ifdef RISCV_JIT
+	// Number of times this block was entered while not compiled, and its compiled code (NULL until it gets hot)
+	size_t entries;
+	riscv_jit_code_t jit;
+#endif
+
+	// The decoded instructions
+	riscv_op_t ops[BLOCK_MAX_OPS];
+} riscv_block_t;
+
+// Nonzero if <block> of <cpu> holds a decoded run (flushing the block cache starts a new epoch, and a single block is discarded by clearing its epoch)
+#define BLOCK_VALID(cpu, block) ((block)->epoch == (cpu)->block_epoch)
+
+// ---------- Guest RAM Data Structures ----------
+
+// Maximum number of RAM/ROM regions that can be mapped at once
+#define RAM_REGION_MAX 8
+
+// A flat region of host memory serving as guest RAM (or ROM)
+typedef struct riscv64_ram_region {
+	// Host address of the first byte of the region
+	byte* base;
+
+	// Guest address of the first byte of the region
+	dword address;
+
+	// Size of the region in bytes
+	dword length;
+
+	// Nonzero if guest stores may modify the region
+	int writable;
+
+	// Nonzero if the region is a copy-on-write mapping owned by the CPU (see cpu_fork), which is unmapped along with the region
+	int owned;
+} riscv_ram_t;
+
+// A frozen copy of a CPU's RAM regions that forked CPUs map copy-on-write
+typedef struct riscv64_fork_image {
+	// Nonzero while fd holds the RAM as of <instructions> executed and <stores> made
+	int valid;
+	int fd;
+	dword instructions;
+	dword stores;
+
+	// Offset of each writable region within the image file
+	size_t offsets[RAM_REGION_MAX];
+} riscv_fork_t;
+
+// ---------- Software TLB Data Structures ----------
+
+#define TLB_PAGE_BITS 12
+#define TLB_PAGE_SIZE ((dword) 1 << TLB_PAGE_BITS)
+#define TLB_PAGE_MASK (TLB_PAGE_SIZE - 1)
+
+// Number of entries in the (direct-mapped) TLB
+#define TLB_SIZE 256
+
+// Page tag that never matches (pages are aligned, so their addresses have no low bits set)
+#define TLB_INVALID ((dword) -1)
+
+// A cached translation of a guest page, for loads and for stores
+typedef struct riscv64_tlb_entry {
+	// Guest page translated for loads
+	dword read_page;
+
+	// Guest page translated for stores
+	dword write_page;
+
+	// Host address of the start of read_page (NULL if loads from it go to the host services, e.g. MMIO)
+	byte* read_host;
+
+	// Host address of the start of write_page (NULL if stores to it must take the slow path: MMIO, ROM, or pages holding cached code)
+	byte* write_host;
+} riscv_tlb_entry_t;
+
+// ---------- Cache Model Data Structures ----------
+
+// Geometry the caches start out with: 16 KiB, 64-byte lines, 4 ways, LRU
+#define CACHE_DEFAULT_SIZE 16384
+#define CACHE_DEFAULT_LINE 64
+#define CACHE_DEFAULT_WAYS 4
+
+// Tree PLRU keeps ways - 1 bits per set in a word
+#define CACHE_WAYS_MAX 32
+
+// Tag that never matches, marking an empty way (tags are the line address bits above the set index, which leave the top bits clear for any guest address below 256 GiB)
+#define CACHE_INVALID ((word) -1)
+
+// Kinds of cache access, indexing the access and miss counters
+typedef enum riscv64_cache_access {
+	ca_fetch,
+	ca_load,
+	ca_store,
+	CACHE_ACCESS_KINDS,
+} riscv_cache_access_t;
+
+// A set-associative cache; only the line addresses it holds are modeled, not the data
+typedef struct riscv64_cache {
+	// Geometry (the line size and set count are powers of two)
+	byte line_bits;
+	byte set_bits;
+	dword set_mask;
+	dword ways;
+	rsk_cache_policy_t policy;
+
+	// Tags of the lines held by each set, <ways> per set (kept to 32 bits, so the tags of a set share a host cache line or two). LRU keeps each set ordered from most to least recently used; PLRU keeps lines in place and tracks them with a tree of bits per set.
+	word* tags;
+	word* plru;
+
+	// Accesses and misses, by kind
+	dword accesses[CACHE_ACCESS_KINDS];
+	dword misses[CACHE_ACCESS_KINDS];
+} riscv_cache_t;
+
+// ---------- Binary Trace Data Structures ----------
+
+// Largest possible trace record: pc, register mask, and a new value for every register but x0
+#define TRACE_RECORD_MAX (sizeof(dword) + sizeof(word) + (REGISTER_COUNT - 1) * sizeof(dword))
+
+// Smallest usable trace buffer
+#define TRACE_BUFFER_MIN (sizeof(rsk_trace_chunk_t) + 16 * TRACE_RECORD_MAX)
+
+// Trace output state: the binary trace (see rsk_trace_chunk_t for the format), and the delta trace callback
+typedef struct riscv64_trace {
+	// Chunk being filled: an rsk_trace_chunk_t header followed by the records (NULL if no trace is set up)
+	byte* buffer;
+	size_t capacity;
+	size_t used;
+
+	// Destination of completed chunks (one of the two)
+	rsk_trace_sink_t sink;
+	FILE* file;
+
+	// Register values as of the last record, for finding the registers each instruction changed
+	dword registers[REGISTER_COUNT];
+
+	// Callback that rc_trace_log reports register changes to instead of log_trace (NULL if there is none), the register values it was last told about, and whether they may be out of date (changed by the host between runs)
+	rsk_trace_delta_t delta;
+	dword delta_registers[REGISTER_COUNT];
+	int delta_stale;
+} riscv_trace_t;
+
+// ---------- Profiler Data Structures ----------
+
+// Calls deeper than this share the sample stacks of their ancestors
+#define PROFILE_STACK_MAX 64
+
+// Initial number of slots in the table of sampled stacks (it doubles as it fills up)
+#define PROFILE_SLOTS_MIN 1024
+
+// A distinct sampled stack: its frames (outermost call site first, sampled pc last) and the number of samples
+typedef struct riscv64_profile_stack {
+	dword hash;
+	size_t depth;
+	size_t frames;
+	dword count;
+} riscv_profile_stack_t;
+
+// Sampling profiler state (see cpu_profile_start)
+typedef struct riscv64_profile {
+	// Instructions between samples (0 while not profiling), and instructions left until the next sample
+	dword interval;
+	dword countdown;
+
+	// Shadow call stack: addresses of the calls that have not returned yet (depth may exceed PROFILE_STACK_MAX)
+	dword calls[PROFILE_STACK_MAX];
+	size_t depth;
+
+	// Open addressing table of sampled stacks (entries with a zero count are free)
+	riscv_profile_stack_t* slots;
+	size_t slot_count;
+	size_t used;
+
+	// Storage for the frames of every sampled stack
+	dword* frames;
+	size_t frames_capacity;
+	size_t frames_used;
+
+	// Samples lost to allocation failures
+	dword dropped;
+} riscv_profile_t;
+
+// ---------- Stats Page Data Structures ----------
+
+// Live counters page state (see cpu_stats_publish)
+typedef struct riscv64_publish {
+	// The shared mapping of the page (NULL while not publishing)
+	rsk_stats_page_t* page;
+
+	// Instructions between updates, and instructions left until the next update
+	dword interval;
+	dword countdown;
+
+	// The (wrapping) CPU stats at the last update, whose differences the page adds up
+	rsk_stat_t last;
+} riscv_publish_t;
+
+// ---------- MMIO Log Data Structures ----------
+
+// What happens to the accesses that go to the host services
+typedef enum riscv64_mmio_mode {
+	mm_off,
+	mm_record,
+	mm_replay,
+} riscv_mmio_mode_t;
+
+// MMIO record/replay state (see cpu_mmio_record and cpu_mmio_replay)
+typedef struct riscv64_mmio {
+	riscv_mmio_mode_t mode;
+
+	// Log being recorded
+	FILE* file;
+
+	// Mapping of the log being replayed, its events, and the index of the next one
+	void* map;
+	size_t map_size;
+	const rsk_mmio_event_t* events;
+	size_t next;
+
+	// Progress of the current (or last) replay
+	rsk_mmio_status_t status;
+} riscv_mmio_t;
+
+// ---------- Debugger Data Structures ----------
+
+// A watched address range [start, end), and the accesses (rsk_watch_t) it stops on
+typedef struct riscv64_watchpoint {
+	dword start;
+	dword end;
+	int kind;
+} riscv_watchpoint_t;
+
+// Breakpoints and watchpoints (see cpu_break_set and cpu_watch_set)
+typedef struct riscv64_debug {
+	dword breakpoints[RSK_BREAKPOINT_MAX];
+	size_t breakpoint_count;
+
+	// Watchpoints, and how many of them stop on loads
+	riscv_watchpoint_t watchpoints[RSK_WATCHPOINT_MAX];
+	size_t watch_count;
+	size_t load_watches;
+
+	// pc and instruction count of the last breakpoint stop (a run resumed from there executes the instruction at the breakpoint)
+	dword resume_pc;
+	unsigned int resume_step;
+
+	// Address of a breakpoint being stepped over, which block_decode ignores
+	dword step_over;
+
+	// Where the last run stopped
+	rsk_debug_status_t status;
+} riscv_debug_t;
+
+// ---------- Performance Counter Data Structures ----------
+
+#ifdef RISCV_PERF_COUNTERS
+// Number of slots in the (open addressing) table of per-pc execution counts
+#define PERF_HOT_SIZE 4096
+
+// Slots probed for a pc before giving up on counting it
+#define PERF_HOT_PROBES 8
+
+// Host services timed by the performance counters (in rsk_host_services_t order)
+typedef enum riscv64_perf_callback {
+	cb_load_dword,
+	cb_store_dword,
+	cb_load_word,
+	cb_store_word,
+	cb_load_hword,
+	cb_store_hword,
+	cb_load_byte,
+	cb_store_byte,
+	cb_log_trace,
+} riscv_perf_callback_t;
+
+// Extended event counters (see rsk_stats_ex_t)
+typedef struct riscv64_perf {
+	// Execution counts indexed by instruction type (see riscv_op_t.perf_type)
+	dword executed[RSK_STATS_TYPES_MAX];
+	dword taken[RSK_STATS_TYPES_MAX];
+
+	dword branches_taken;
+	dword branches_not_taken;
+
+	// Host service calls indexed by riscv_perf_callback_t
+	dword calls[RSK_STATS_CALLBACKS];
+	dword total_ns[RSK_STATS_CALLBACKS];
+	dword latency[RSK_STATS_CALLBACKS][RSK_STATS_LATENCY_BUCKETS];
+
+	// Execution counts by pc (slots with a zero count are free)
+	dword hot_pc[PERF_HOT_SIZE];
+	dword hot_executed[PERF_HOT_SIZE];
+	dword hot_dropped;
+} riscv_perf_t;
+#endif
+
+// ---------- Instance Arena Data Structures ----------
+
+// A single allocation holding a CPU and the structures that live exactly as long as it does (its block cache), handed out by a bump allocator. Nothing in it is freed on its own: cpu_free releases the whole arena at once.
+typedef struct riscv64_arena {
+	byte* base;
+	size_t size;
+	size_t used;
+} riscv_arena_t;
+
+// Alignment of every arena allocation (a cache line)
+#define ARENA_ALIGN 64
 
 // ---------- CPU Data Structures ----------
 
 // RISC-V bit CPU struct
 typedef struct riscv64_cpu {
-    int is_running;
+    // Nonzero while a run is in progress (read by other threads, see cpu_run_async)
+    atomic_int is_running;
+
+    // Signals sent to the CPU that it has not acted on yet, one bit each (1 << rsk_signal_t); checked between blocks
+    atomic_uint mailbox;
+
+    // Background run started by cpu_run_async (only touched by the thread controlling the CPU)
+    int async;
+    pthread_t async_thread;
+    unsigned int async_cycles;
+    unsigned int async_executed;
 
     // Configuration setting
     rsk_config_t config;
 
     // Host services struct
     rsk_host_services_t host;
+
+	// The arena this CPU and its block cache were allocated from
+	riscv_arena_t arena;
+
+	// Guest RAM served directly by the CPU (everything else goes through the host services)
+	riscv_ram_t regions[RAM_REGION_MAX];
+	size_t region_count;
+
+	// Translation cache for the guest RAM regions
+	riscv_tlb_entry_t tlb[TLB_SIZE];
     
     // CPU statistics struct
     rsk_stat_t stats;
 
-	// A registry of implemented risc-v instruction types
-	riscv_registry_t instruction_set;
+	// The registry of implemented risc-v instruction types (shared by every CPU)
+	const riscv_registry_t* instruction_set;
+
+	// Block cache, indexed by start address, and its current epoch (never 0, so cleared blocks are never valid)
+	riscv_block_t* blocks;
+	dword block_epoch;
+
+	// Bounds of the address range covered by cached blocks (used to filter out stores that can't touch code)
+	dword code_low;
+	dword code_high;
+
+	// Set when a store invalidates a cached block
+	int code_modified;
+
+	// Block cache lookups, and how many of them had to decode a block
+	dword block_lookups;
+	dword block_decodes;
+
+	// Binary trace output
+	riscv_trace_t trace;
+
+	// Sampling profiler
+	riscv_profile_t profile;
+
+	// Live counters page
+	riscv_publish_t publish;
+
+	// MMIO log being recorded or replayed
+	riscv_mmio_t mmio;
+
+	// Breakpoints and watchpoints
+	riscv_debug_t debug;
+
+	// RAM image shared by the CPUs forked from this one
+	riscv_fork_t fork;
+
+	// Cache models, simulated while rc_cache_on is set
+	riscv_cache_t icache;
+	riscv_cache_t dcache;
+
+	// Set by a bulk loop that modeled its instruction fetches itself, so that the block run it ends leaves them out
+	int fetches_modeled;
+
+#ifdef RISCV_PERF_COUNTERS
+	// Extended event counters
+	riscv_perf_t perf;
+#endif
+
+#ifdef RISCV_JIT
+	// Compiled code of hot blocks
+	riscv_jit_t jit;
+#endif
 
     // Program counter
     dword pc;
@@ -249,134 +1025,1893 @@ typedef struct riscv64_cpu {
     dword x[REGISTER_COUNT];
 } riscv_cpu_t;
 
-// ---------- CPU Methods ----------
-
-riscv_cpu_t* cpu_init(riscv_cpu_t* cpu, const rsk_host_services_t* const services) {
-    if (NULL == cpu) {
-        // TODO: where should this be freed?
-        cpu = (riscv_cpu_t*) calloc(1, sizeof(riscv_cpu_t));
+// ---------- Instruction Set Headers ----------
 
-        // malloc failure
-        if (NULL == cpu) {
-            services->panic("Malloc failure during CPU initialization");
-            return NULL;
-        }
-    }
+// (included once the CPU struct is complete, so that execution functions may access it directly)
 
-    cpu->is_running = 0;
-	cpu->config = rc_nothing;
+#include "rv64i_instr.h"
+#include "rv64m_instr.h"
 
-	cpu->host.mem_load_byte   = services->mem_load_byte;
-	cpu->host.mem_store_byte  = services->mem_store_byte;
-	cpu->host.mem_load_hword  = services->mem_load_hword;
-	cpu->host.mem_store_hword = services->mem_store_hword;
-	cpu->host.mem_load_word   = services->mem_load_word;
-	cpu->host.mem_store_word  = services->mem_store_word;
-	cpu->host.mem_load_dword  = services->mem_load_dword;
-	cpu->host.mem_store_dword = services->mem_store_dword;
+// Every instruction set header lists its instruction types as X(name, format, syntax, mask, required bits, execution statements); these are the lists the CPU implements, in matching order
+#define RISCV_INSTRUCTIONS(X) RV64I_INSTRUCTIONS(X) RV64M_INSTRUCTIONS(X)
+
+// generate an execution function for each instruction type...
+#define RISCV_INSTR_EXEC(n, f, s, m, b, ...) EXEC_DEF(n) { __VA_ARGS__; }
+RISCV_INSTRUCTIONS(RISCV_INSTR_EXEC)
+#undef RISCV_INSTR_EXEC
+
+// ...and the table of instruction types that links them together with the rest of the descriptions
+#define RISCV_INSTR_TYPE(n, f, s, m, b, ...) { .name = #n, .mask = (m), .required_bits = (b), .format = (f), .syntax = (s), .execute = z_exec_##n },
+static riscv_instr_t riscv_instructions[] = {
+	RISCV_INSTRUCTIONS(RISCV_INSTR_TYPE)
+};
+#undef RISCV_INSTR_TYPE
+
+// The registry of the table, shared by every CPU (its decode index is built the first time a CPU is initialized)
+static riscv_registry_t riscv_registry = {
+	.count = sizeof(riscv_instructions) / sizeof(riscv_instr_t),
+	.types = riscv_instructions,
+};
+static pthread_once_t riscv_registry_once = PTHREAD_ONCE_INIT;
+
+// Build the decode index of the shared registry
+static void registry_init(void) {
+	registry_build_decode(&riscv_registry);
+}
 
-	cpu->host.log_trace = services->log_trace;
-	cpu->host.log_msg   = services->log_msg;
-	cpu->host.panic     = services->panic;
+// ---------- Binary Trace ----------
 
-	cpu->stats.instructions = 0;
-	cpu->stats.loads        = 0;
-	cpu->stats.load_misses  = 0;
-	cpu->stats.stores       = 0;
-	cpu->stats.store_misses = 0;
+// Start a new chunk, keyframed with the current registers
+static void trace_begin_chunk(riscv_cpu_t* const cpu) {
+	rsk_trace_chunk_t* chunk = (rsk_trace_chunk_t*) cpu->trace.buffer;
+	chunk->magic = RSK_TRACE_MAGIC;
+	chunk->version = RSK_TRACE_VERSION;
+	chunk->first_step = cpu->stats.instructions;
+	chunk->count = 0;
+	chunk->size = 0;
+	memcpy(chunk->registers, cpu->x, sizeof(cpu->x));
+	memcpy(cpu->trace.registers, cpu->x, sizeof(cpu->x));
 
-	// rv64i
-	registry_append(&cpu->instruction_set, rv64i_size, rv64i_instructions);
-	// rv64m
-	registry_append(&cpu->instruction_set, rv64m_size, rv64m_instructions);
+	cpu->trace.used = sizeof(rsk_trace_chunk_t);
+}
 
-	cpu->pc = 0;
-	for (int i = 0; i < REGISTER_COUNT; i++) cpu->x[i] = 0;
+// Hand the current chunk to its destination (if it holds any records) and start the next one
+static void trace_emit_chunk(riscv_cpu_t* const cpu) {
+	rsk_trace_chunk_t* chunk = (rsk_trace_chunk_t*) cpu->trace.buffer;
+
+	if (0 != chunk->count) {
+		chunk->size = cpu->trace.used - sizeof(rsk_trace_chunk_t);
+		if (NULL != cpu->trace.sink) {
+			cpu->trace.sink(cpu->trace.buffer, cpu->trace.used);
+		} else if (fwrite(cpu->trace.buffer, 1, cpu->trace.used, cpu->trace.file) != cpu->trace.used) {
+			cpu->host.panic("Failed to write binary trace");
+		}
+	}
 
-    return cpu;
+	trace_begin_chunk(cpu);
 }
 
-int cpu_is_running(const riscv_cpu_t* const cpu) {
-    if (NULL == cpu) return 0;
-    return cpu->is_running;
-}
+// Append a record for the instruction at <pc>, which could only have changed register <rd>
+static void trace_record(riscv_cpu_t* const cpu, dword pc, byte rd) {
+	if (cpu->trace.capacity - cpu->trace.used < TRACE_RECORD_MAX) {
+		// the instruction has run already, so the new keyframe gets <rd> from before it (the last value the old chunk recorded)
+		dword before = cpu->trace.registers[rd];
+		trace_emit_chunk(cpu);
+		((rsk_trace_chunk_t*) cpu->trace.buffer)->registers[rd] = before;
+		cpu->trace.registers[rd] = before;
+	}
 
-rsk_config_t cpu_get_config(const riscv_cpu_t* const cpu) {
-    if (NULL == cpu) return rc_nothing;
-    return cpu->config;
-}
+	word mask = 0;
+	if (0 != rd && cpu->x[rd] != cpu->trace.registers[rd]) {
+		mask = (word) 1 << rd;
+		cpu->trace.registers[rd] = cpu->x[rd];
+	}
 
-void cpu_set_config(riscv_cpu_t* const cpu, rsk_config_t config) {
-    if (NULL == cpu) return;
-    cpu->config = config;
+	byte* record = cpu->trace.buffer + cpu->trace.used;
+	memcpy(record, &pc, sizeof(pc));
+	memcpy(record + sizeof(pc), &mask, sizeof(mask));
+	cpu->trace.used += sizeof(pc) + sizeof(mask);
+	if (mask) {
+		memcpy(record + sizeof(pc) + sizeof(mask), &cpu->x[rd], sizeof(dword));
+		cpu->trace.used += sizeof(dword);
+	}
+
+	((rsk_trace_chunk_t*) cpu->trace.buffer)->count += 1;
 }
 
-byte cpu_load_byte(const riscv_cpu_t* const cpu, dword address) {
-    if (NULL == cpu) return 0;
-    return cpu->host.mem_load_byte(address);
+// Registers may have been changed by the host between runs; if so, restart the chunk so its keyframe picks them up
+static void trace_sync(riscv_cpu_t* const cpu) {
+	if (0 != memcmp(cpu->trace.registers, cpu->x, sizeof(cpu->x))) trace_emit_chunk(cpu);
 }
 
-void cpu_store_byte(const riscv_cpu_t* const cpu, dword address, byte value) {
-    if (NULL == cpu) return;
-    cpu->host.mem_store_byte(address, value);
+// Flush and release the trace buffer and file
+static void trace_close(riscv_cpu_t* const cpu) {
+	if (NULL != cpu->trace.buffer) trace_emit_chunk(cpu);
+	if (NULL != cpu->trace.file) fclose(cpu->trace.file);
+
+	free(cpu->trace.buffer);
+	cpu->trace.buffer = NULL;
+	cpu->trace.capacity = 0;
+	cpu->trace.used = 0;
+	cpu->trace.sink = NULL;
+	cpu->trace.file = NULL;
 }
 
-hword cpu_load_hword(const riscv_cpu_t* const cpu, dword address) {
-    if (NULL == cpu) return 0;
-    return cpu->host.mem_load_hword(address);
+// Allocate a trace buffer of <size> bytes (0 for the default size)
+static int trace_open(riscv_cpu_t* const cpu, size_t size) {
+	if (0 == size) size = RSK_TRACE_DEFAULT_SIZE;
+	if (size < TRACE_BUFFER_MIN) size = TRACE_BUFFER_MIN;
+
+	cpu->trace.buffer = (byte*) malloc(size);
+	if (NULL == cpu->trace.buffer) {
+		cpu->host.panic("Malloc failure while allocating the trace buffer");
+		return 0;
+	}
+	cpu->trace.capacity = size;
+	trace_begin_chunk(cpu);
+	return 1;
 }
 
-void cpu_store_hword(const riscv_cpu_t* const cpu, dword address, hword value) {
-    if (NULL == cpu) return;
-    cpu->host.mem_store_hword(address, value);
+int cpu_trace_sink(riscv_cpu_t* const cpu, rsk_trace_sink_t sink, size_t size) {
+    if (NULL == cpu || NULL == sink) return 0;
+	trace_close(cpu);
+
+	cpu->trace.sink = sink;
+	if (!trace_open(cpu, size)) {
+		cpu->trace.sink = NULL;
+		return 0;
+	}
+	return 1;
 }
 
-word cpu_load_word(const riscv_cpu_t* const cpu, dword address) {
-    if (NULL == cpu) return 0;
-    return cpu->host.mem_load_word(address);
+int cpu_trace_file(riscv_cpu_t* const cpu, const char* path, size_t size) {
+    if (NULL == cpu || NULL == path) return 0;
+	trace_close(cpu);
+
+	cpu->trace.file = fopen(path, "wb");
+	if (NULL == cpu->trace.file) return 0;
+	if (!trace_open(cpu, size)) {
+		trace_close(cpu);
+		return 0;
+	}
+	return 1;
 }
 
-void cpu_store_word(const riscv_cpu_t* const cpu, dword address, word value) {
-    if (NULL == cpu) return;
-    cpu->host.mem_store_word(address, value);
+void cpu_trace_flush(riscv_cpu_t* const cpu) {
+    if (NULL == cpu || NULL == cpu->trace.buffer) return;
+
+	trace_emit_chunk(cpu);
+	if (NULL != cpu->trace.file) fflush(cpu->trace.file);
 }
 
-dword cpu_load_dword(const riscv_cpu_t* const cpu, dword address) {
-    if (NULL == cpu) return 0;
-    return cpu->host.mem_load_dword(address);
+// Report the instruction at <pc>, which could only have changed register <rd>, to the delta trace callback
+static void trace_delta(riscv_cpu_t* const cpu, dword pc, byte rd) {
+	rsk_reg_delta_t deltas[REGISTER_COUNT];
+	size_t count = 0;
+
+	if (cpu->trace.delta_stale) {
+		// the first instruction after the host changed registers reports those as well
+		for (byte i = 1; i < REGISTER_COUNT; i++) {
+			if (cpu->x[i] == cpu->trace.delta_registers[i]) continue;
+			deltas[count].index = i;
+			deltas[count++].value = cpu->x[i];
+			cpu->trace.delta_registers[i] = cpu->x[i];
+		}
+		cpu->trace.delta_stale = 0;
+	} else if (0 != rd && cpu->x[rd] != cpu->trace.delta_registers[rd]) {
+		deltas[0].index = rd;
+		deltas[0].value = cpu->x[rd];
+		count = 1;
+		cpu->trace.delta_registers[rd] = cpu->x[rd];
+	}
+
+	cpu->trace.delta(cpu->stats.instructions, pc, deltas, count);
 }
 
-void cpu_store_dword(const riscv_cpu_t* const cpu, dword address, dword value) {
-    if (NULL == cpu) return;
-    cpu->host.mem_store_dword(address, value);
+// Registers may have been changed by the host between runs; if so, have the next delta catch up on them
+static void trace_delta_sync(riscv_cpu_t* const cpu) {
+	if (0 != memcmp(cpu->trace.delta_registers, cpu->x, sizeof(cpu->x))) cpu->trace.delta_stale = 1;
 }
 
-dword cpu_get_pc(const riscv_cpu_t* const cpu) {
+int cpu_trace_delta(riscv_cpu_t* const cpu, rsk_trace_delta_t callback) {
     if (NULL == cpu) return 0;
-    return cpu->pc;
-}
 
-void cpu_set_pc(riscv_cpu_t* const cpu, dword address) {
-    if (NULL == cpu) return;
-    cpu->pc = address;
+	cpu->trace.delta = callback;
+	memcpy(cpu->trace.delta_registers, cpu->x, sizeof(cpu->x));
+	cpu->trace.delta_stale = 0;
+	return 1;
 }
 
-dword cpu_read_register(const riscv_cpu_t* const cpu, byte index) {
-    if (NULL == cpu) return 0;
+// ---------- Performance Counters ----------
 
-	if (0 > index || index >= REGISTER_COUNT) {
-        cpu->host.panic("Register access out of bounds");
-        return 0;
-    }
+// Nanoseconds on the monotonic clock
+static inline dword perf_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (dword) ts.tv_sec * 1000000000 + (dword) ts.tv_nsec;
+}
 
-	if (0 == index) return 0;
-	return cpu->x[index];
+#ifdef RISCV_PERF_COUNTERS
+static const char* const perf_callback_names[RSK_STATS_CALLBACKS] = {
+	"mem_load_dword",
+	"mem_store_dword",
+	"mem_load_word",
+	"mem_store_word",
+	"mem_load_hword",
+	"mem_store_hword",
+	"mem_load_byte",
+	"mem_store_byte",
+	"log_trace",
+};
+
+// Count a host service call that started at <start>
+static inline void perf_callback(riscv_cpu_t* const cpu, riscv_perf_callback_t callback, dword start) {
+	dword ns = perf_now() - start;
+	size_t bucket = (0 == ns) ? 0 : (size_t) (63 - __builtin_clzll(ns));
+	if (bucket >= RSK_STATS_LATENCY_BUCKETS) bucket = RSK_STATS_LATENCY_BUCKETS - 1;
+
+	cpu->perf.calls[callback] += 1;
+	cpu->perf.total_ns[callback] += ns;
+	cpu->perf.latency[callback][bucket] += 1;
 }
 
-void cpu_write_register(riscv_cpu_t* const cpu, byte index, dword value) {
-    if (NULL == cpu) return;
+// Call a host service, timing it (HOST_CALL evaluates to the result of <call>)
+#define HOST_CALL(callback, call) ({ dword perf_start = perf_now(); __auto_type perf_result = (call); perf_callback(cpu, callback, perf_start); perf_result; })
+#define HOST_CALL_VOID(callback, call) do { dword perf_start = perf_now(); (call); perf_callback(cpu, callback, perf_start); } while (0)
 
-	if (0 > index || index >= REGISTER_COUNT) {
+// Return the registry index of an instruction type (RSK_STATS_TYPES_MAX if it has none that can be counted)
+static size_t perf_type_index(const riscv_cpu_t* const cpu, const riscv_instr_t* const itype) {
+	size_t index = (size_t) (itype - cpu->instruction_set->types);
+	return (index < RSK_STATS_TYPES_MAX) ? index : RSK_STATS_TYPES_MAX;
+}
+
+// Count the execution of <op> at <pc>
+static inline void perf_count(riscv_cpu_t* const cpu, const riscv_op_t* const op, dword pc, int updated_pc) {
+	if (op->perf_type < RSK_STATS_TYPES_MAX) {
+		cpu->perf.executed[op->perf_type] += 1;
+		if (updated_pc) cpu->perf.taken[op->perf_type] += 1;
+	}
+	if (mask_instr_opcode(op->instr) == OPCODE(1100011)) {
+		if (updated_pc) cpu->perf.branches_taken += 1;
+		else cpu->perf.branches_not_taken += 1;
+	}
+
+	// instructions are word aligned, so the low bits of the pc carry no information
+	size_t slot = (size_t) (((pc >> 2) * 0x9e3779b97f4a7c15) >> 52) & (PERF_HOT_SIZE - 1);
+	for (size_t probe = 0; probe < PERF_HOT_PROBES; probe++) {
+		size_t i = (slot + probe) & (PERF_HOT_SIZE - 1);
+		if (0 == cpu->perf.hot_executed[i]) cpu->perf.hot_pc[i] = pc;
+		if (cpu->perf.hot_pc[i] == pc) {
+			cpu->perf.hot_executed[i] += 1;
+			return;
+		}
+	}
+	cpu->perf.hot_dropped += 1;
+}
+#else
+#define HOST_CALL(callback, call) (call)
+#define HOST_CALL_VOID(callback, call) (call)
+#endif
+
+int cpu_fill_stats_ex(const riscv_cpu_t* const cpu, rsk_stats_ex_t* stats) {
+	if (NULL == cpu || NULL == stats) return 0;
+#ifdef RISCV_PERF_COUNTERS
+	stats->type_count = 0;
+	for (size_t i = 0; i < cpu->instruction_set->count && i < RSK_STATS_TYPES_MAX; i++) {
+		stats->types[i].name = cpu->instruction_set->types[i].name;
+		stats->types[i].executed = cpu->perf.executed[i];
+		stats->types[i].taken = cpu->perf.taken[i];
+		stats->type_count++;
+	}
+
+	stats->branches_taken = cpu->perf.branches_taken;
+	stats->branches_not_taken = cpu->perf.branches_not_taken;
+
+	for (size_t c = 0; c < RSK_STATS_CALLBACKS; c++) {
+		stats->callbacks[c].name = perf_callback_names[c];
+		stats->callbacks[c].calls = cpu->perf.calls[c];
+		stats->callbacks[c].total_ns = cpu->perf.total_ns[c];
+		memcpy(stats->callbacks[c].latency, cpu->perf.latency[c], sizeof(stats->callbacks[c].latency));
+	}
+
+	// insertion into the (short) sorted hot list
+	stats->hot_count = 0;
+	for (size_t i = 0; i < PERF_HOT_SIZE; i++) {
+		dword executed = cpu->perf.hot_executed[i];
+		if (0 == executed) continue;
+		if (RSK_STATS_HOT_MAX == stats->hot_count && executed <= stats->hot[RSK_STATS_HOT_MAX - 1].executed) continue;
+
+		size_t at = (stats->hot_count < RSK_STATS_HOT_MAX) ? stats->hot_count++ : RSK_STATS_HOT_MAX - 1;
+		while (at > 0 && stats->hot[at - 1].executed < executed) {
+			stats->hot[at] = stats->hot[at - 1];
+			at--;
+		}
+		stats->hot[at].pc = cpu->perf.hot_pc[i];
+		stats->hot[at].executed = executed;
+	}
+	stats->hot_dropped = cpu->perf.hot_dropped;
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+// ---------- Sampling Profiler ----------
+
+// Hash a stack of frames (FNV-1a)
+static dword profile_hash(const dword* frames, size_t depth) {
+	dword hash = 0xcbf29ce484222325;
+	for (size_t i = 0; i < depth; i++) {
+		hash ^= frames[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+// Return the free or matching slot for a stack in a table of <slot_count> slots
+static riscv_profile_stack_t* profile_slot(riscv_profile_stack_t* slots, size_t slot_count, const dword* pool, const dword* frames, size_t depth, dword hash) {
+	for (size_t i = (size_t) hash & (slot_count - 1);; i = (i + 1) & (slot_count - 1)) {
+		riscv_profile_stack_t* slot = &slots[i];
+		if (0 == slot->count) return slot;
+		if (slot->hash == hash && slot->depth == depth && 0 == memcmp(pool + slot->frames, frames, depth * sizeof(dword))) return slot;
+	}
+}
+
+// Double the slot table (returns 0 if it can't be allocated)
+static int profile_grow_slots(riscv_profile_t* const profile) {
+	size_t slot_count = profile->slot_count * 2;
+	riscv_profile_stack_t* slots = (riscv_profile_stack_t*) calloc(slot_count, sizeof(riscv_profile_stack_t));
+	if (NULL == slots) return 0;
+
+	for (size_t i = 0; i < profile->slot_count; i++) {
+		riscv_profile_stack_t* old = &profile->slots[i];
+		if (0 == old->count) continue;
+		*profile_slot(slots, slot_count, profile->frames, profile->frames + old->frames, old->depth, old->hash) = *old;
+	}
+
+	free(profile->slots);
+	profile->slots = slots;
+	profile->slot_count = slot_count;
+	return 1;
+}
+
+// Count a sample of the current call stack, with the current pc as its innermost frame
+static void profile_sample(riscv_cpu_t* const cpu) {
+	riscv_profile_t* const profile = &cpu->profile;
+
+	dword frames[PROFILE_STACK_MAX + 1];
+	size_t depth = (profile->depth < PROFILE_STACK_MAX) ? profile->depth : PROFILE_STACK_MAX;
+	memcpy(frames, profile->calls, depth * sizeof(dword));
+	frames[depth++] = cpu->pc;
+	dword hash = profile_hash(frames, depth);
+
+	riscv_profile_stack_t* slot = profile_slot(profile->slots, profile->slot_count, profile->frames, frames, depth, hash);
+	if (0 != slot->count) {
+		slot->count += 1;
+		return;
+	}
+
+	// a new stack: keep the table at most half full, and copy its frames into the pool
+	if (2 * (profile->used + 1) > profile->slot_count) {
+		if (!profile_grow_slots(profile)) {
+			profile->dropped += 1;
+			return;
+		}
+		slot = profile_slot(profile->slots, profile->slot_count, profile->frames, frames, depth, hash);
+	}
+	if (profile->frames_capacity - profile->frames_used < depth) {
+		size_t capacity = 2 * profile->frames_capacity + depth;
+		dword* pool = (dword*) realloc(profile->frames, capacity * sizeof(dword));
+		if (NULL == pool) {
+			profile->dropped += 1;
+			return;
+		}
+		profile->frames = pool;
+		profile->frames_capacity = capacity;
+	}
+
+	memcpy(profile->frames + profile->frames_used, frames, depth * sizeof(dword));
+	slot->hash = hash;
+	slot->depth = depth;
+	slot->frames = profile->frames_used;
+	slot->count = 1;
+	profile->frames_used += depth;
+	profile->used += 1;
+}
+
+// Classify how the control transfer <op> links
+static int op_link(const riscv_op_t* const op) {
+	byte opcode = mask_instr_opcode(op->instr);
+	if ((opcode == OPCODE(1101111) || opcode == OPCODE(1100111)) && (1 == op->rd || 5 == op->rd)) return rl_call;
+	if (opcode == OPCODE(1100111) && 0 == op->rd && (1 == op->rs1 || 5 == op->rs1)) return rl_return;
+	return rl_none;
+}
+
+// Follow calls and returns of the <executed> instructions just run from the block at <block_pc>, and take a sample if one is due
+static inline void profile_step(riscv_cpu_t* const cpu, dword block_pc, size_t executed) {
+	riscv_profile_t* const profile = &cpu->profile;
+	if (0 == executed) return;
+
+	// only the last instruction of a block can transfer control, and it only ran if the whole block did
+	const riscv_block_t* const block = &cpu->blocks[(block_pc >> 2) & (BLOCK_CACHE_SIZE - 1)];
+	if (rl_none != block->link && BLOCK_VALID(cpu, block) && block->start == block_pc && block->count == executed) {
+		if (rl_call == block->link) {
+			if (profile->depth < PROFILE_STACK_MAX) profile->calls[profile->depth] = block->end - 4;
+			profile->depth += 1;
+		} else if (profile->depth > 0) {
+			// (returns from functions entered before profiling began are ignored)
+			profile->depth -= 1;
+		}
+	}
+
+	// cpu_run never lets a block run past the next sample
+	if (executed >= profile->countdown) {
+		profile_sample(cpu);
+		profile->countdown = profile->interval;
+	} else {
+		profile->countdown -= (dword) executed;
+	}
+}
+
+// Stop profiling and discard the samples
+static void profile_close(riscv_cpu_t* const cpu) {
+	free(cpu->profile.slots);
+	free(cpu->profile.frames);
+	memset(&cpu->profile, 0, sizeof(cpu->profile));
+}
+
+int cpu_profile_start(riscv_cpu_t* const cpu, dword interval) {
+    if (NULL == cpu) return 0;
+	profile_close(cpu);
+	if (0 == interval) return 1;
+
+	cpu->profile.slots = (riscv_profile_stack_t*) calloc(PROFILE_SLOTS_MIN, sizeof(riscv_profile_stack_t));
+	if (NULL == cpu->profile.slots) {
+		cpu->host.panic("Malloc failure while allocating the profile");
+		return 0;
+	}
+	cpu->profile.slot_count = PROFILE_SLOTS_MIN;
+	cpu->profile.interval = interval;
+	cpu->profile.countdown = interval;
+	return 1;
+}
+
+int cpu_profile_write(const riscv_cpu_t* const cpu, const char* path) {
+    if (NULL == cpu || NULL == path) return 0;
+
+	FILE* file = fopen(path, "w");
+	if (NULL == file) return 0;
+
+	for (size_t i = 0; i < cpu->profile.slot_count; i++) {
+		const riscv_profile_stack_t* slot = &cpu->profile.slots[i];
+		if (0 == slot->count) continue;
+
+		for (size_t f = 0; f < slot->depth; f++) {
+			fprintf(file, "%s%#lx", (0 == f) ? "" : ";", cpu->profile.frames[slot->frames + f]);
+		}
+		fprintf(file, " %lu\n", slot->count);
+	}
+
+	int ok = !ferror(file);
+	return (0 == fclose(file)) && ok;
+}
+
+// Defined with cpu_fork, but snapshot restores also drop the RAM image
+static void fork_close(riscv_cpu_t* const cpu);
+
+// ---------- Snapshots ----------
+
+#define SNAPSHOT_MAGIC 0x4b534e53
+#define SNAPSHOT_VERSION 1
+
+// Snapshot file header, followed by <region_count> regions
+typedef struct riscv64_snapshot_header {
+	// SNAPSHOT_MAGIC ("SNSK") and SNAPSHOT_VERSION
+	word magic;
+	word version;
+
+	rsk_config_t config;
+	rsk_stat_t stats;
+	dword pc;
+	dword x[REGISTER_COUNT];
+
+	dword region_count;
+} riscv_snapshot_header_t;
+
+// A saved RAM region, followed by <page_count> pages: each one a dword offset into the region and then its contents (TLB_PAGE_SIZE bytes, or less for a final partial page), with all-zero pages left out
+typedef struct riscv64_snapshot_region {
+	dword address;
+	dword length;
+	dword page_count;
+} riscv_snapshot_region_t;
+
+// Return nonzero if <size> bytes at <data> are all zero
+static int snapshot_is_zero(const byte* data, size_t size) {
+	static const byte zero[TLB_PAGE_SIZE];
+	return 0 == memcmp(data, zero, size);
+}
+
+// Return the mapped writable region at exactly <address> and <length> (NULL if there is none)
+static riscv_ram_t* snapshot_region(riscv_cpu_t* const cpu, dword address, dword length) {
+	for (size_t i = 0; i < cpu->region_count; i++) {
+		riscv_ram_t* region = &cpu->regions[i];
+		if (region->writable && region->address == address && region->length == length) return region;
+	}
+	return NULL;
+}
+
+// Walk the regions of a mapped snapshot, checking that each fits the file and matches a mapped region; with <apply> set, also copy them into RAM. Returns 0 if the snapshot doesn't fit.
+static int snapshot_walk(riscv_cpu_t* const cpu, const byte* data, size_t size, int apply) {
+	riscv_snapshot_header_t header;
+	memcpy(&header, data, sizeof(header));
+
+	size_t at = sizeof(header);
+	for (dword r = 0; r < header.region_count; r++) {
+		riscv_snapshot_region_t saved;
+		if (size - at < sizeof(saved)) return 0;
+		memcpy(&saved, data + at, sizeof(saved));
+		at += sizeof(saved);
+
+		riscv_ram_t* region = snapshot_region(cpu, saved.address, saved.length);
+		if (NULL == region) return 0;
+		if (apply) memset(region->base, 0, region->length);
+
+		for (dword p = 0; p < saved.page_count; p++) {
+			dword offset;
+			if (size - at < sizeof(offset)) return 0;
+			memcpy(&offset, data + at, sizeof(offset));
+			at += sizeof(offset);
+
+			if (offset >= region->length || 0 != (offset & TLB_PAGE_MASK)) return 0;
+			size_t page_size = (region->length - offset < TLB_PAGE_SIZE) ? region->length - offset : TLB_PAGE_SIZE;
+			if (size - at < page_size) return 0;
+			if (apply) memcpy(region->base + offset, data + at, page_size);
+			at += page_size;
+		}
+	}
+	return at == size;
+}
+
+int cpu_snapshot_save(const riscv_cpu_t* const cpu, const char* path) {
+    if (NULL == cpu || NULL == path) return 0;
+
+	FILE* file = fopen(path, "wb");
+	if (NULL == file) return 0;
+
+	riscv_snapshot_header_t header = { 0 };
+	header.magic = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.config = cpu->config;
+	header.stats = cpu->stats;
+	header.pc = cpu->pc;
+	memcpy(header.x, cpu->x, sizeof(header.x));
+	for (size_t i = 0; i < cpu->region_count; i++) header.region_count += cpu->regions[i].writable ? 1 : 0;
+	fwrite(&header, sizeof(header), 1, file);
+
+	// only RAM is saved (ROM is the host's to map again)
+	for (size_t i = 0; i < cpu->region_count; i++) {
+		const riscv_ram_t* const region = &cpu->regions[i];
+		if (!region->writable) continue;
+
+		riscv_snapshot_region_t saved = { region->address, region->length, 0 };
+		for (dword offset = 0; offset < region->length; offset += TLB_PAGE_SIZE) {
+			size_t page_size = (region->length - offset < TLB_PAGE_SIZE) ? region->length - offset : TLB_PAGE_SIZE;
+			if (!snapshot_is_zero(region->base + offset, page_size)) saved.page_count++;
+		}
+		fwrite(&saved, sizeof(saved), 1, file);
+
+		for (dword offset = 0; offset < region->length; offset += TLB_PAGE_SIZE) {
+			size_t page_size = (region->length - offset < TLB_PAGE_SIZE) ? region->length - offset : TLB_PAGE_SIZE;
+			if (snapshot_is_zero(region->base + offset, page_size)) continue;
+			fwrite(&offset, sizeof(offset), 1, file);
+			fwrite(region->base + offset, 1, page_size, file);
+		}
+	}
+
+	int ok = !ferror(file);
+	return (0 == fclose(file)) && ok;
+}
+
+int cpu_snapshot_restore(riscv_cpu_t* const cpu, const char* path) {
+    if (NULL == cpu || NULL == path) return 0;
+
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0) return 0;
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(riscv_snapshot_header_t)) {
+		close(fd);
+		return 0;
+	}
+
+	// pages are copied straight out of the mapped file
+	size_t size = (size_t) st.st_size;
+	void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == mapped) return 0;
+	const byte* data = (const byte*) mapped;
+
+	// nothing is changed unless the whole snapshot fits the mapped RAM
+	riscv_snapshot_header_t header;
+	memcpy(&header, data, sizeof(header));
+	int ok = SNAPSHOT_MAGIC == header.magic && SNAPSHOT_VERSION == header.version && snapshot_walk(cpu, data, size, 0);
+	if (ok) {
+		snapshot_walk(cpu, data, size, 1);
+		cpu->config = header.config;
+		cpu->stats = header.stats;
+		cpu->publish.last = cpu->stats;
+		cpu->pc = header.pc;
+		memcpy(cpu->x, header.x, sizeof(cpu->x));
+		cpu->x[0] = 0;
+
+		// the restored RAM holds different code (and forks need a new image of it)
+		cpu_flush_blocks(cpu);
+		fork_close(cpu);
+	}
+
+	munmap(mapped, size);
+	return ok;
+}
+
+// ---------- Cache Model ----------
+
+static int cache_power_of_two(dword value) {
+	return 0 != value && 0 == (value & (value - 1));
+}
+
+// Empty <cache> and reset its counters
+static void cache_clear(riscv_cache_t* const cache) {
+	if (NULL == cache->tags) return;
+
+	size_t sets = (size_t) cache->set_mask + 1;
+	for (size_t i = 0; i < sets * cache->ways; i++) cache->tags[i] = CACHE_INVALID;
+	memset(cache->plru, 0, sets * sizeof(word));
+	memset(cache->accesses, 0, sizeof(cache->accesses));
+	memset(cache->misses, 0, sizeof(cache->misses));
+}
+
+// Give <cache> the geometry in <config> (empty, with its counters reset). Returns 0, changing nothing, if the geometry is invalid or the tag arrays cannot be allocated.
+static int cache_configure(riscv_cache_t* const cache, const rsk_cache_config_t* const config) {
+	if (!cache_power_of_two(config->size) || !cache_power_of_two(config->line_size) || !cache_power_of_two(config->ways)) return 0;
+	if (config->line_size < 4 || config->ways > CACHE_WAYS_MAX || config->size / config->line_size < config->ways) return 0;
+	if (rcp_lru != config->policy && rcp_plru != config->policy) return 0;
+
+	size_t sets = config->size / config->line_size / config->ways;
+	word* tags = (word*) malloc(sets * config->ways * sizeof(word));
+	word* plru = (word*) malloc(sets * sizeof(word));
+	if (NULL == tags || NULL == plru) {
+		free(tags);
+		free(plru);
+		return 0;
+	}
+
+	free(cache->tags);
+	free(cache->plru);
+	cache->tags = tags;
+	cache->plru = plru;
+
+	cache->line_bits = 0;
+	while (((dword) 1 << cache->line_bits) < config->line_size) cache->line_bits++;
+	cache->set_bits = 0;
+	while (((size_t) 1 << cache->set_bits) < sets) cache->set_bits++;
+	cache->set_mask = (dword) sets - 1;
+	cache->ways = config->ways;
+	cache->policy = config->policy;
+	cache_clear(cache);
+	return 1;
+}
+
+// Describe the geometry of <cache> as an rsk_cache_config_t
+static rsk_cache_config_t cache_geometry(const riscv_cache_t* const cache) {
+	rsk_cache_config_t config;
+	config.line_size = (dword) 1 << cache->line_bits;
+	config.ways = cache->ways;
+	config.size = ((dword) cache->set_mask + 1) * cache->ways * config.line_size;
+	config.policy = cache->policy;
+	return config;
+}
+
+// Return 1 if <cache> already has the geometry in <config>
+static int cache_has_geometry(const riscv_cache_t* const cache, const rsk_cache_config_t* const config) {
+	if (NULL == cache->tags) return 0;
+
+	rsk_cache_config_t geometry = cache_geometry(cache);
+	return geometry.size == config->size && geometry.line_size == config->line_size && geometry.ways == config->ways && geometry.policy == config->policy;
+}
+
+// Make <cache> an exact copy of <source> (geometry, contents, and counters). Returns 0 if the tag arrays cannot be allocated.
+static int cache_copy(riscv_cache_t* const cache, const riscv_cache_t* const source) {
+	if (NULL == source->tags) return 1;
+
+	rsk_cache_config_t config = cache_geometry(source);
+	if (!cache_configure(cache, &config)) return 0;
+
+	size_t sets = (size_t) source->set_mask + 1;
+	memcpy(cache->tags, source->tags, sets * source->ways * sizeof(word));
+	memcpy(cache->plru, source->plru, sets * sizeof(word));
+	memcpy(cache->accesses, source->accesses, sizeof(cache->accesses));
+	memcpy(cache->misses, source->misses, sizeof(cache->misses));
+	return 1;
+}
+
+static void cache_free(riscv_cache_t* const cache) {
+	free(cache->tags);
+	free(cache->plru);
+	cache->tags = NULL;
+	cache->plru = NULL;
+}
+
+// Mark <way> of a PLRU set as just used: every node of the tree on its path points away from it
+static inline void cache_plru_touch(const riscv_cache_t* const cache, word* const bits, dword way) {
+	for (dword node = way + cache->ways; node > 1; node >>= 1) {
+		if (node & 1) *bits &= ~((word) 1 << (node >> 1));
+		else *bits |= (word) 1 << (node >> 1);
+	}
+}
+
+// Find <line> in its set, filling it in on a miss (evicting a line if the set is full). Returns nonzero on a hit.
+static int cache_lookup(riscv_cache_t* const cache, dword line) {
+	size_t index = line & cache->set_mask;
+	word* const set = cache->tags + index * cache->ways;
+	word tag = (word) (line >> cache->set_bits);
+
+	// LRU sets are kept in recency order (see cache_is_recent for the fast path): a single pass moves the line to the front while shifting the lines it passes down a way, so on a miss the least recently used line (or an empty way, as those sort last) drops out
+	if (rcp_lru == cache->policy) {
+		word carry = tag;
+		for (dword way = 0; way < cache->ways; way++) {
+			word held = set[way];
+			set[way] = carry;
+			if (held == tag) return 1;
+			carry = held;
+		}
+		return 0;
+	}
+
+	// PLRU: lines stay in place, and empty ways are filled before the tree picks a victim
+	word* const bits = &cache->plru[index];
+	dword empty = cache->ways;
+	for (dword way = 0; way < cache->ways; way++) {
+		if (set[way] == tag) {
+			cache_plru_touch(cache, bits, way);
+			return 1;
+		}
+		if (CACHE_INVALID == set[way] && empty == cache->ways) empty = way;
+	}
+
+	dword victim = empty;
+	if (victim == cache->ways) {
+		dword node = 1;
+		while (node < cache->ways) node = 2 * node + ((*bits >> node) & 1);
+		victim = node - cache->ways;
+	}
+	set[victim] = tag;
+	cache_plru_touch(cache, bits, victim);
+	return 0;
+}
+
+// Nonzero if <line> is the most recently used line of its LRU set, which a hit leaves just as it is (the fast path for the lookups that hit the same line again and again)
+static inline int cache_is_recent(const riscv_cache_t* const cache, dword line) {
+	return rcp_lru == cache->policy && cache->tags[(line & cache->set_mask) * cache->ways] == (word) (line >> cache->set_bits);
+}
+
+// Nonzero if <cache> holds <line> (without counting as a use of it)
+static inline int cache_holds(const riscv_cache_t* const cache, dword line) {
+	const word* const set = cache->tags + (line & cache->set_mask) * cache->ways;
+	word tag = (word) (line >> cache->set_bits);
+	for (dword way = 0; way < cache->ways; way++) {
+		if (set[way] == tag) return 1;
+	}
+	return 0;
+}
+
+// Model a data access of <size> bytes at <address> (one that straddles two lines misses if either of them does)
+static inline void cache_data(riscv_cpu_t* const cpu, dword address, dword size, riscv_cache_access_t kind) {
+	riscv_cache_t* const cache = &cpu->dcache;
+	if (NULL == cache->tags) return;
+
+	dword first = address >> cache->line_bits;
+	dword last = (address + size - 1) >> cache->line_bits;
+	cache->accesses[kind] += 1;
+
+	if (first == last && cache_is_recent(cache, first)) return;
+
+	int hit = cache_lookup(cache, first);
+	if (last != first) hit = cache_lookup(cache, last) && hit;
+	if (!hit) cache->misses[kind] += 1;
+}
+
+// Model the instruction fetches of <executed> instructions run in sequence from <pc> (every instruction counts as a fetch, and every line it takes to hold them is looked up once)
+static inline void cache_fetch(riscv_cpu_t* const cpu, dword pc, size_t executed) {
+	riscv_cache_t* const cache = &cpu->icache;
+	if (cpu->fetches_modeled) {
+		cpu->fetches_modeled = 0;
+		return;
+	}
+	if (0 == executed || NULL == cache->tags) return;
+
+	cache->accesses[ca_fetch] += executed;
+	dword last = (pc + 4 * (dword) executed - 1) >> cache->line_bits;
+	for (dword line = pc >> cache->line_bits; line <= last; line++) {
+		if (!cache_is_recent(cache, line) && !cache_lookup(cache, line)) cache->misses[ca_fetch] += 1;
+	}
+}
+
+// Model <iterations> runs of the loop of <count> instructions at <pc>. Once every line of the loop is held, the runs left can only hit them, and a run of hits on lines the cache holds leaves it just as a single hit on each would, so they are looked up once more at most.
+static void cache_loop(riscv_cpu_t* const cpu, dword pc, size_t count, dword iterations) {
+	riscv_cache_t* const cache = &cpu->icache;
+	if (NULL == cache->tags) return;
+
+	dword first = pc >> cache->line_bits;
+	dword last = (pc + 4 * (dword) count - 1) >> cache->line_bits;
+	for (dword done = 0; done < iterations; done++) {
+		int held = 1;
+		for (dword line = first; held && line <= last; line++) held = cache_holds(cache, line);
+		cache_fetch(cpu, pc, count);
+		if (held) {
+			cache->accesses[ca_fetch] += (iterations - done - 1) * (dword) count;
+			return;
+		}
+	}
+}
+
+// Model <count> iterations of a copy (<copy> set: loading <width> bytes at <src>, then storing them to <dst>) or fill loop (storing to <dst> only) that steps forward an element per iteration. The elements that stay within the lines the one before them ended in hit those lines as long as the cache holds them, which leaves it just as a single hit on each would (see cache_loop), so lines are looked up about once each.
+static void cache_stream(riscv_cpu_t* const cpu, int copy, dword src, dword dst, dword width, dword count) {
+	riscv_cache_t* const cache = &cpu->dcache;
+	if (NULL == cache->tags) return;
+
+	// (element widths are powers of two)
+	int width_bits = __builtin_ctzll(width);
+	dword done = 0;
+	while (done < count) {
+		dword src_at = src + done * width;
+		dword dst_at = dst + done * width;
+		if (copy) cache_data(cpu, src_at, width, ca_load);
+		cache_data(cpu, dst_at, width, ca_store);
+		done++;
+
+		// whole elements left before the end of the last lines used
+		dword dst_line = (dst + done * width - 1) >> cache->line_bits;
+		dword run = (((dst_line + 1) << cache->line_bits) - (dst + done * width)) >> width_bits;
+		dword src_line = 0;
+		if (copy) {
+			src_line = (src + done * width - 1) >> cache->line_bits;
+			dword src_run = (((src_line + 1) << cache->line_bits) - (src + done * width)) >> width_bits;
+			if (src_run < run) run = src_run;
+		}
+		if (run > count - done) run = count - done;
+		if (0 == run || !cache_holds(cache, dst_line) || (copy && !cache_holds(cache, src_line))) continue;
+
+		// (an element within a single line of each stream was just such a hit already, so only those straddling two lines leave them to be looked up again)
+		if ((dst_at >> cache->line_bits) != dst_line || (copy && (src_at >> cache->line_bits) != src_line)) {
+			if (copy) cache_lookup(cache, src_line);
+			cache_lookup(cache, dst_line);
+		}
+		if (copy) cache->accesses[ca_load] += run;
+		cache->accesses[ca_store] += run;
+		done += run;
+	}
+}
+
+int cpu_cache_config(riscv_cpu_t* const cpu, const rsk_cache_config_t* const icache, const rsk_cache_config_t* const dcache) {
+	if (NULL == cpu) return 0;
+
+	// validate and allocate both before changing either
+	riscv_cache_t new_icache = {0}, new_dcache = {0};
+	if ((NULL != icache && !cache_configure(&new_icache, icache)) || (NULL != dcache && !cache_configure(&new_dcache, dcache))) {
+		cache_free(&new_icache);
+		cache_free(&new_dcache);
+		return 0;
+	}
+
+	if (NULL != icache) {
+		cache_free(&cpu->icache);
+		cpu->icache = new_icache;
+	}
+	if (NULL != dcache) {
+		cache_free(&cpu->dcache);
+		cpu->dcache = new_dcache;
+	}
+	cache_clear(&cpu->icache);
+	cache_clear(&cpu->dcache);
+	return 1;
+}
+
+void cpu_cache_report(const riscv_cpu_t* const cpu, rsk_cache_stats_t* const stats) {
+	if (NULL == cpu || NULL == stats) return;
+
+	stats->fetches      = cpu->icache.accesses[ca_fetch];
+	stats->fetch_misses = cpu->icache.misses[ca_fetch];
+	stats->loads        = cpu->dcache.accesses[ca_load];
+	stats->load_misses  = cpu->dcache.misses[ca_load];
+	stats->stores       = cpu->dcache.accesses[ca_store];
+	stats->store_misses = cpu->dcache.misses[ca_store];
+}
+
+// ---------- Stats Page ----------
+
+// Fraction of <accesses> that weren't <misses> (1 if there were no accesses)
+static double publish_hit_rate(dword accesses, dword misses) {
+	if (0 == accesses) return 1.0;
+	return 1.0 - (double) misses / (double) accesses;
+}
+
+// Bring the page up to date (<running> is nonzero if the run goes on afterwards)
+static void publish_update(riscv_cpu_t* const cpu, int running) {
+	rsk_stats_page_t* const page = cpu->publish.page;
+
+	// (only this CPU writes the page, so the previous values can be read back as they are)
+	const rsk_stats_page_t last = *page;
+	dword now = perf_now();
+	dword load_diff = (unsigned int) (cpu->stats.loads - cpu->publish.last.loads);
+	dword store_diff = (unsigned int) (cpu->stats.stores - cpu->publish.last.stores);
+	dword load_miss_diff = (unsigned int) (cpu->stats.load_misses - cpu->publish.last.load_misses);
+	dword store_miss_diff = (unsigned int) (cpu->stats.store_misses - cpu->publish.last.store_misses);
+	dword instruction_diff = (unsigned int) (cpu->stats.instructions - cpu->publish.last.instructions);
+	cpu->publish.last = cpu->stats;
+
+	// seqlock write: readers throw away any copy taken while the sequence was odd or changed
+	__atomic_store_n(&page->sequence, last.sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	page->running = (word) running;
+	page->updates = last.updates + 1;
+	page->time_ns = now;
+	page->instructions = last.instructions + instruction_diff;
+	page->loads = last.loads + load_diff;
+	page->stores = last.stores + store_diff;
+	page->load_misses = last.load_misses + load_miss_diff;
+	page->store_misses = last.store_misses + store_miss_diff;
+	page->fetches = cpu->icache.accesses[ca_fetch];
+	page->fetch_misses = cpu->icache.misses[ca_fetch];
+	page->cache_loads = cpu->dcache.accesses[ca_load];
+	page->cache_load_misses = cpu->dcache.misses[ca_load];
+	page->cache_stores = cpu->dcache.accesses[ca_store];
+	page->cache_store_misses = cpu->dcache.misses[ca_store];
+	page->block_lookups = cpu->block_lookups;
+	page->block_decodes = cpu->block_decodes;
+	page->pc = cpu->pc;
+
+	// (the cache model counters start over when a cache is configured)
+	dword elapsed = now - last.time_ns;
+	page->mips = (0 == elapsed) ? 0.0 : (double) instruction_diff * 1000.0 / (double) elapsed;
+	page->tlb_hit_rate = publish_hit_rate(load_diff + store_diff, load_miss_diff + store_miss_diff);
+	page->block_hit_rate = publish_hit_rate(page->block_lookups - last.block_lookups, page->block_decodes - last.block_decodes);
+	if (page->fetches < last.fetches || page->cache_loads < last.cache_loads || page->cache_stores < last.cache_stores) {
+		page->icache_hit_rate = publish_hit_rate(page->fetches, page->fetch_misses);
+		page->dcache_hit_rate = publish_hit_rate(page->cache_loads + page->cache_stores, page->cache_load_misses + page->cache_store_misses);
+	} else {
+		page->icache_hit_rate = publish_hit_rate(page->fetches - last.fetches, page->fetch_misses - last.fetch_misses);
+		page->dcache_hit_rate = publish_hit_rate(page->cache_loads - last.cache_loads + page->cache_stores - last.cache_stores,
+			page->cache_load_misses - last.cache_load_misses + page->cache_store_misses - last.cache_store_misses);
+	}
+
+	__atomic_store_n(&page->sequence, last.sequence + 2, __ATOMIC_RELEASE);
+}
+
+// Count the <executed> instructions just run, updating the page if an update is due
+static inline void publish_step(riscv_cpu_t* const cpu, size_t executed) {
+	// cpu_run never lets a block run past the next update
+	if (executed >= cpu->publish.countdown) {
+		publish_update(cpu, 1);
+		cpu->publish.countdown = cpu->publish.interval;
+	} else {
+		cpu->publish.countdown -= (dword) executed;
+	}
+}
+
+// Stop publishing (the page keeps its last contents)
+static void publish_close(riscv_cpu_t* const cpu) {
+	if (NULL != cpu->publish.page) munmap(cpu->publish.page, sizeof(rsk_stats_page_t));
+	memset(&cpu->publish, 0, sizeof(cpu->publish));
+}
+
+int cpu_stats_publish(riscv_cpu_t* const cpu, const char* path, dword interval) {
+    if (NULL == cpu) return 0;
+	publish_close(cpu);
+	if (NULL == path) return 1;
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return 0;
+	if (0 != ftruncate(fd, sizeof(rsk_stats_page_t))) {
+		close(fd);
+		return 0;
+	}
+	void* page = mmap(NULL, sizeof(rsk_stats_page_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (MAP_FAILED == page) return 0;
+
+	// (the file starts out zeroed, so the sequence is even before the first update)
+	cpu->publish.page = (rsk_stats_page_t*) page;
+	cpu->publish.interval = (0 == interval) ? RSK_STATS_PAGE_INTERVAL : interval;
+	cpu->publish.countdown = cpu->publish.interval;
+	cpu->publish.last = cpu->stats;
+	cpu->publish.page->version = RSK_STATS_PAGE_VERSION;
+	cpu->publish.page->size = sizeof(rsk_stats_page_t);
+	cpu->publish.page->start_ns = perf_now();
+	cpu->publish.page->time_ns = cpu->publish.page->start_ns;
+	cpu->publish.page->fetches = cpu->icache.accesses[ca_fetch];
+	cpu->publish.page->fetch_misses = cpu->icache.misses[ca_fetch];
+	cpu->publish.page->cache_loads = cpu->dcache.accesses[ca_load];
+	cpu->publish.page->cache_load_misses = cpu->dcache.misses[ca_load];
+	cpu->publish.page->cache_stores = cpu->dcache.accesses[ca_store];
+	cpu->publish.page->cache_store_misses = cpu->dcache.misses[ca_store];
+	cpu->publish.page->block_lookups = cpu->block_lookups;
+	cpu->publish.page->block_decodes = cpu->block_decodes;
+	cpu->publish.page->pc = cpu->pc;
+	__atomic_store_n(&cpu->publish.page->magic, RSK_STATS_PAGE_MAGIC, __ATOMIC_RELEASE);
+	return 1;
+}
+
+// ---------- MMIO Record/Replay ----------
+
+// Stop recording or replaying (the status of the last replay is kept), returning 0 if the recorded log couldn't be written out
+static int mmio_close(riscv_cpu_t* const cpu) {
+	riscv_mmio_t* const mmio = &cpu->mmio;
+	int ok = 1;
+	if (NULL != mmio->file) ok = (0 == fclose(mmio->file));
+	if (NULL != mmio->map) munmap(mmio->map, mmio->map_size);
+
+	mmio->mode = mm_off;
+	mmio->file = NULL;
+	mmio->map = NULL;
+	mmio->map_size = 0;
+	mmio->events = NULL;
+	mmio->next = 0;
+	return ok;
+}
+
+int cpu_mmio_record(riscv_cpu_t* const cpu, const char* path) {
+    if (NULL == cpu) return 0;
+	int ok = mmio_close(cpu);
+	if (NULL == path) return ok;
+
+	FILE* file = fopen(path, "wb");
+	if (NULL == file) return 0;
+	rsk_mmio_header_t header = { RSK_MMIO_MAGIC, RSK_MMIO_VERSION };
+	if (1 != fwrite(&header, sizeof(header), 1, file)) {
+		fclose(file);
+		return 0;
+	}
+
+	cpu->mmio.mode = mm_record;
+	cpu->mmio.file = file;
+	return 1;
+}
+
+int cpu_mmio_replay(riscv_cpu_t* const cpu, const char* path) {
+    if (NULL == cpu) return 0;
+	mmio_close(cpu);
+	if (NULL == path) return 1;
+
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0) return 0;
+	if (0 != fstat(fd, &st) || (size_t) st.st_size < sizeof(rsk_mmio_header_t) || 0 != ((size_t) st.st_size - sizeof(rsk_mmio_header_t)) % sizeof(rsk_mmio_event_t)) {
+		close(fd);
+		return 0;
+	}
+	void* map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == map) return 0;
+
+	rsk_mmio_header_t header;
+	memcpy(&header, map, sizeof(header));
+	if (RSK_MMIO_MAGIC != header.magic || RSK_MMIO_VERSION != header.version) {
+		munmap(map, (size_t) st.st_size);
+		return 0;
+	}
+
+	// (the header keeps the events 8-byte aligned in the page-aligned mapping)
+	riscv_mmio_t* const mmio = &cpu->mmio;
+	mmio->mode = mm_replay;
+	mmio->map = map;
+	mmio->map_size = (size_t) st.st_size;
+	mmio->events = (const rsk_mmio_event_t*) ((const byte*) map + sizeof(header));
+	memset(&mmio->status, 0, sizeof(mmio->status));
+	mmio->status.events = ((size_t) st.st_size - sizeof(header)) / sizeof(rsk_mmio_event_t);
+	return 1;
+}
+
+int cpu_mmio_replay_status(const riscv_cpu_t* const cpu, rsk_mmio_status_t* const status) {
+	if (NULL == cpu || NULL == status) return 0;
+	*status = cpu->mmio.status;
+	return status->diverged;
+}
+
+// Name of the kind of access <event> describes, for messages
+static const char* mmio_event_kind(const rsk_mmio_event_t* const event) {
+	if (0 == event->size) return "nothing";
+	return event->store ? "store" : "load";
+}
+
+// Match <actual> against the next event of the log being replayed, returning that event, or NULL (after reporting the divergence and ending the replay) if it doesn't match
+static const rsk_mmio_event_t* mmio_replay_next(riscv_cpu_t* const cpu, const rsk_mmio_event_t* const actual) {
+	riscv_mmio_t* const mmio = &cpu->mmio;
+	const rsk_mmio_event_t* expected = (mmio->next < mmio->status.events) ? &mmio->events[mmio->next] : NULL;
+	if (NULL != expected && expected->step == actual->step && expected->address == actual->address && expected->size == actual->size
+		&& expected->store == actual->store && (!actual->store || expected->value == actual->value)) {
+		mmio->next += 1;
+		mmio->status.replayed = mmio->next;
+		return expected;
+	}
+
+	mmio->status.diverged = 1;
+	if (NULL != expected) mmio->status.expected = *expected;
+	mmio->status.actual = *actual;
+
+	char message[256];
+	const rsk_mmio_event_t* const want = &mmio->status.expected;
+	snprintf(message, sizeof(message), "MMIO replay diverged at step %lu (pc %#lx): expected %s of %u bytes at %#lx (step %lu), got %s of %u bytes at %#lx",
+		actual->step, cpu->pc, mmio_event_kind(want), (unsigned) want->size, want->address, want->step,
+		mmio_event_kind(actual), (unsigned) actual->size, actual->address);
+	cpu->host.log_msg(message);
+
+	// the rest of the run is live, but only until the end of this block
+	mmio_close(cpu);
+	cpu_process_signal(cpu, rs_halt);
+	return NULL;
+}
+
+// Append an access made through the host services to the log being recorded
+static void mmio_record(riscv_cpu_t* const cpu, dword address, dword value, dword size, int store) {
+	rsk_mmio_event_t event = { cpu->stats.instructions, address, value, (word) size, (word) store };
+	fwrite(&event, sizeof(event), 1, cpu->mmio.file);
+}
+
+// Load <size> bytes at <address> through the host services (or from the log being replayed)
+static dword cpu_host_load(riscv_cpu_t* const cpu, dword address, dword size) {
+	if (mm_replay == cpu->mmio.mode) {
+		rsk_mmio_event_t actual = { cpu->stats.instructions, address, 0, (word) size, 0 };
+		const rsk_mmio_event_t* event = mmio_replay_next(cpu, &actual);
+		if (NULL != event) return event->value;
+	}
+
+	dword value;
+	switch (size) {
+		case 1: value = HOST_CALL(cb_load_byte, cpu->host.mem_load_byte(address)); break;
+		case 2: value = HOST_CALL(cb_load_hword, cpu->host.mem_load_hword(address)); break;
+		case 4: value = HOST_CALL(cb_load_word, cpu->host.mem_load_word(address)); break;
+		default: value = HOST_CALL(cb_load_dword, cpu->host.mem_load_dword(address)); break;
+	}
+	if (mm_record == cpu->mmio.mode) mmio_record(cpu, address, value, size, 0);
+	return value;
+}
+
+// Store the low <size> bytes of <value> at <address> through the host services (or check them against the log being replayed)
+static void cpu_host_store(riscv_cpu_t* const cpu, dword address, dword value, dword size) {
+	if (mm_replay == cpu->mmio.mode) {
+		rsk_mmio_event_t actual = { cpu->stats.instructions, address, value, (word) size, 1 };
+		if (NULL != mmio_replay_next(cpu, &actual)) return;
+	}
+
+	switch (size) {
+		case 1: HOST_CALL_VOID(cb_store_byte, cpu->host.mem_store_byte(address, (byte) value)); break;
+		case 2: HOST_CALL_VOID(cb_store_hword, cpu->host.mem_store_hword(address, (hword) value)); break;
+		case 4: HOST_CALL_VOID(cb_store_word, cpu->host.mem_store_word(address, (word) value)); break;
+		default: HOST_CALL_VOID(cb_store_dword, cpu->host.mem_store_dword(address, value)); break;
+	}
+	if (mm_record == cpu->mmio.mode) mmio_record(cpu, address, value, size, 1);
+}
+
+// ---------- Forked CPUs ----------
+
+// Round <size> up to a multiple of the host page size
+static size_t fork_page_round(size_t size) {
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	return (size + page - 1) / page * page;
+}
+
+// Drop the RAM image (CPUs already forked from it keep their mappings)
+static void fork_close(riscv_cpu_t* const cpu) {
+	if (cpu->fork.valid) close(cpu->fork.fd);
+	cpu->fork.valid = 0;
+}
+
+// Make sure the RAM image matches the current RAM, writing a new one if the CPU has run or stored since the last. Returns 0 on failure.
+static int fork_image(riscv_cpu_t* const cpu) {
+	if (cpu->fork.valid && cpu->fork.instructions == cpu->stats.instructions && cpu->fork.stores == cpu->stats.stores) return 1;
+	fork_close(cpu);
+
+#ifdef MFD_CLOEXEC
+	int fd = memfd_create("rsk_fork", MFD_CLOEXEC);
+#else
+	FILE* temp = tmpfile();
+	int fd = (NULL == temp) ? -1 : dup(fileno(temp));
+	if (NULL != temp) fclose(temp);
+#endif
+	if (fd < 0) return 0;
+
+	// zero pages are left as holes, so the image only takes up memory for the pages in use
+	size_t size = 0;
+	for (size_t i = 0; i < cpu->region_count; i++) {
+		const riscv_ram_t* const region = &cpu->regions[i];
+		if (!region->writable) continue;
+		cpu->fork.offsets[i] = size;
+		size += fork_page_round(region->length);
+	}
+	int ok = 0 == ftruncate(fd, (off_t) size);
+
+	for (size_t i = 0; ok && i < cpu->region_count; i++) {
+		const riscv_ram_t* const region = &cpu->regions[i];
+		if (!region->writable) continue;
+
+		for (dword offset = 0; ok && offset < region->length; offset += TLB_PAGE_SIZE) {
+			size_t page_size = (region->length - offset < TLB_PAGE_SIZE) ? region->length - offset : TLB_PAGE_SIZE;
+			if (snapshot_is_zero(region->base + offset, page_size)) continue;
+			ok = pwrite(fd, region->base + offset, page_size, (off_t) (cpu->fork.offsets[i] + offset)) == (ssize_t) page_size;
+		}
+	}
+	if (!ok) {
+		close(fd);
+		return 0;
+	}
+
+	cpu->fork.valid = 1;
+	cpu->fork.fd = fd;
+	cpu->fork.instructions = cpu->stats.instructions;
+	cpu->fork.stores = cpu->stats.stores;
+	return 1;
+}
+
+// Release a RAM region's memory if the CPU owns it
+static void ram_release(riscv_ram_t* const region) {
+	if (region->owned) munmap(region->base, fork_page_round(region->length));
+	region->owned = 0;
+}
+
+riscv_cpu_t* cpu_fork(riscv_cpu_t* const parent, const rsk_host_services_t* const services) {
+	if (NULL == parent) return NULL;
+
+	if (!fork_image(parent)) {
+		parent->host.log_msg("Unable to write the RAM image for a forked CPU");
+		return NULL;
+	}
+
+	riscv_cpu_t* child = cpu_init(NULL, (NULL != services) ? services : &parent->host);
+	if (NULL == child) return NULL;
+
+	// RAM becomes a private mapping of the image (so pages are only copied once either CPU writes them); ROM is shared as it is
+	for (size_t i = 0; i < parent->region_count; i++) {
+		riscv_ram_t region = parent->regions[i];
+		region.owned = 0;
+		if (region.writable) {
+			void* base = mmap(NULL, fork_page_round(region.length), PROT_READ | PROT_WRITE, MAP_PRIVATE, parent->fork.fd, (off_t) parent->fork.offsets[i]);
+			if (MAP_FAILED == base) {
+				parent->host.log_msg("Unable to map the RAM of a forked CPU");
+				cpu_free(child);
+				return NULL;
+			}
+			region.base = (byte*) base;
+			region.owned = 1;
+		}
+		child->regions[child->region_count++] = region;
+	}
+
+	if (!cache_copy(&child->icache, &parent->icache) || !cache_copy(&child->dcache, &parent->dcache)) {
+		parent->host.log_msg("Unable to copy the cache models of a forked CPU");
+		cpu_free(child);
+		return NULL;
+	}
+
+	child->config = parent->config;
+	child->stats = parent->stats;
+	child->pc = parent->pc;
+	memcpy(child->x, parent->x, sizeof(child->x));
+	return child;
+}
+
+// ---------- Instance Arena ----------
+
+// Bytes of the arena of one CPU: the CPU itself and its block cache, with room to align each
+#define ARENA_CPU_SIZE (sizeof(riscv_cpu_t) + BLOCK_CACHE_SIZE * sizeof(riscv_block_t) + 2 * ARENA_ALIGN)
+
+// Allocate an arena of at least <size> bytes in a single allocation. Returns 0 if it cannot be allocated.
+static int arena_create(riscv_arena_t* const arena, size_t size) {
+	size = (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+	void* base = aligned_alloc(ARENA_ALIGN, size);
+	if (NULL == base) return 0;
+
+	arena->base = (byte*) base;
+	arena->size = size;
+	arena->used = 0;
+	return 1;
+}
+
+// Allocate <size> bytes (not cleared) from <arena>, or return NULL if it is full
+static void* arena_alloc(riscv_arena_t* const arena, size_t size) {
+	size_t start = (arena->used + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+	if (start > arena->size || size > arena->size - start) return NULL;
+
+	arena->used = start + size;
+	return arena->base + start;
+}
+
+// Release <arena>, and with it everything allocated from it
+static void arena_release(const riscv_arena_t arena) {
+	free(arena.base);
+}
+
+// ---------- CPU Methods ----------
+
+riscv_cpu_t* cpu_init(riscv_cpu_t* cpu, const rsk_host_services_t* const services) {
+    if (NULL == cpu) {
+        // the CPU and its block cache share one arena, released by cpu_free
+        riscv_arena_t arena;
+        if (!arena_create(&arena, ARENA_CPU_SIZE)) {
+            services->panic("Malloc failure during CPU initialization");
+            return NULL;
+        }
+
+        cpu = (riscv_cpu_t*) arena_alloc(&arena, sizeof(riscv_cpu_t));
+        memset(cpu, 0, sizeof(riscv_cpu_t));
+        cpu->arena = arena;
+
+        // (no block is valid in epoch 0)
+        cpu->blocks = (riscv_block_t*) arena_alloc(&cpu->arena, BLOCK_CACHE_SIZE * sizeof(riscv_block_t));
+        for (size_t i = 0; i < BLOCK_CACHE_SIZE; i++) cpu->blocks[i].epoch = 0;
+    }
+
+    // (stopping any background run first)
+    if (cpu->async) cpu_process_signal(cpu, rs_halt);
+    cpu_wait(cpu);
+    cpu->is_running = 0;
+    cpu->mailbox = 0;
+	cpu->config = rc_nothing;
+	trace_close(cpu);
+	cpu->trace.delta = NULL;
+	profile_close(cpu);
+	publish_close(cpu);
+	mmio_close(cpu);
+	memset(&cpu->mmio.status, 0, sizeof(cpu->mmio.status));
+	memset(&cpu->debug, 0, sizeof(cpu->debug));
+	cpu->debug.resume_pc = (dword) -1;
+	cpu->debug.step_over = (dword) -1;
+
+	cpu->host.mem_load_byte   = services->mem_load_byte;
+	cpu->host.mem_store_byte  = services->mem_store_byte;
+	cpu->host.mem_load_hword  = services->mem_load_hword;
+	cpu->host.mem_store_hword = services->mem_store_hword;
+	cpu->host.mem_load_word   = services->mem_load_word;
+	cpu->host.mem_store_word  = services->mem_store_word;
+	cpu->host.mem_load_dword  = services->mem_load_dword;
+	cpu->host.mem_store_dword = services->mem_store_dword;
+
+	cpu->host.log_trace = services->log_trace;
+	cpu->host.log_msg   = services->log_msg;
+	cpu->host.panic     = services->panic;
+
+	for (size_t i = 0; i < cpu->region_count; i++) ram_release(&cpu->regions[i]);
+	cpu->region_count = 0;
+	fork_close(cpu);
+	cpu_flush_tlb(cpu);
+
+	cpu->stats.instructions = 0;
+	cpu->stats.loads        = 0;
+	cpu->stats.load_misses  = 0;
+	cpu->stats.stores       = 0;
+	cpu->stats.store_misses = 0;
+	cpu->block_lookups = 0;
+	cpu->block_decodes = 0;
+#ifdef RISCV_PERF_COUNTERS
+	memset(&cpu->perf, 0, sizeof(cpu->perf));
+#endif
+
+	// rv64i and rv64m, indexed by opcode/funct3/funct7
+	pthread_once(&riscv_registry_once, registry_init);
+	cpu->instruction_set = &riscv_registry;
+	if (NULL == riscv_registry.decode_lists) {
+		cpu->host.log_msg("Unable to build the decode table; falling back to linear instruction search");
+	}
+
+	// block cache (emptied by starting a new epoch, so compiled code of earlier runs can be overwritten as well)
+	cpu_flush_blocks(cpu);
+#ifdef RISCV_JIT
+	cpu->jit.used = 0;
+#endif
+
+	// cache models (back to their default geometry, empty; tag arrays that already have it are reused)
+	rsk_cache_config_t cache_default = { CACHE_DEFAULT_SIZE, CACHE_DEFAULT_LINE, CACHE_DEFAULT_WAYS, rcp_lru };
+	if (cache_has_geometry(&cpu->icache, &cache_default) && cache_has_geometry(&cpu->dcache, &cache_default)) {
+		cache_clear(&cpu->icache);
+		cache_clear(&cpu->dcache);
+	} else if (!cpu_cache_config(cpu, &cache_default, &cache_default)) {
+		services->panic("Malloc failure during CPU initialization");
+		cpu_free(cpu);
+		return NULL;
+	}
+
+	cpu->pc = 0;
+	for (int i = 0; i < REGISTER_COUNT; i++) cpu->x[i] = 0;
+
+    return cpu;
+}
+
+void cpu_free(riscv_cpu_t* const cpu) {
+    if (NULL == cpu) return;
+
+	if (cpu->async) cpu_process_signal(cpu, rs_halt);
+	cpu_wait(cpu);
+	trace_close(cpu);
+	profile_close(cpu);
+	publish_close(cpu);
+	mmio_close(cpu);
+	fork_close(cpu);
+	for (size_t i = 0; i < cpu->region_count; i++) ram_release(&cpu->regions[i]);
+#ifdef RISCV_JIT
+	if (NULL != cpu->jit.code) munmap(cpu->jit.code, JIT_ARENA_SIZE);
+#endif
+	cache_free(&cpu->icache);
+	cache_free(&cpu->dcache);
+
+	// (the CPU itself is in the arena)
+	arena_release(cpu->arena);
+}
+
+int cpu_is_running(const riscv_cpu_t* const cpu) {
+    if (NULL == cpu) return 0;
+    return atomic_load_explicit(&cpu->is_running, memory_order_acquire);
+}
+
+rsk_config_t cpu_get_config(const riscv_cpu_t* const cpu) {
+    if (NULL == cpu) return rc_nothing;
+    return cpu->config;
+}
+
+void cpu_set_config(riscv_cpu_t* const cpu, rsk_config_t config) {
+    if (NULL == cpu) return;
+    cpu->config = config;
+}
+
+// Return the host address of <size> bytes of guest RAM at <address>, searching the mapped regions (NULL if those bytes don't all lie within one region, or if <for_store> is set and the region is read-only)
+static byte* cpu_region_pointer(const riscv_cpu_t* const cpu, dword address, dword size, int for_store) {
+	for (size_t i = 0; i < cpu->region_count; i++) {
+		const riscv_ram_t* const region = &cpu->regions[i];
+
+		dword offset = address - region->address;
+		if (offset < region->length && size <= region->length - offset) {
+			if (for_store && !region->writable) return NULL;
+			return region->base + offset;
+		}
+	}
+
+	return NULL;
+}
+
+// Read a little-endian value of <size> bytes from host memory
+static inline dword ram_read(const byte* const host, size_t size) {
+	dword value = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(&value, host, size);
+#else
+	for (size_t i = size; i > 0; i--) value = (value << 8) | host[i - 1];
+#endif
+	return value;
+}
+
+// Write a little-endian value of <size> bytes to host memory
+static inline void ram_write(byte* const host, dword value, size_t size) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(host, &value, size);
+#else
+	for (size_t i = 0; i < size; i++) host[i] = (byte) (value >> (8 * i));
+#endif
+}
+
+// ---------- Breakpoints and Watchpoints ----------
+
+// Return 1 if there is a breakpoint at <address>
+static int debug_has_breakpoint(const riscv_cpu_t* const cpu, dword address) {
+	for (size_t i = 0; i < cpu->debug.breakpoint_count; i++) {
+		if (cpu->debug.breakpoints[i] == address) return 1;
+	}
+	return 0;
+}
+
+// Discard the cached blocks starting at, running through, or ending right before <address>, so that they are decoded again around (or, once it is cleared, across) its breakpoint
+static void debug_invalidate(riscv_cpu_t* const cpu, dword address) {
+	if (NULL == cpu->blocks) return;
+
+	for (size_t i = 0; i < BLOCK_CACHE_SIZE; i++) {
+		riscv_block_t* block = &cpu->blocks[i];
+		if (BLOCK_VALID(cpu, block) && block->start <= address && address <= block->end) block->epoch = 0;
+	}
+}
+
+int cpu_break_set(riscv_cpu_t* const cpu, dword address) {
+	if (NULL == cpu) return 0;
+	if (debug_has_breakpoint(cpu, address)) return 1;
+	if (RSK_BREAKPOINT_MAX == cpu->debug.breakpoint_count) return 0;
+
+	cpu->debug.breakpoints[cpu->debug.breakpoint_count++] = address;
+	debug_invalidate(cpu, address);
+	return 1;
+}
+
+int cpu_break_clear(riscv_cpu_t* const cpu, dword address) {
+	if (NULL == cpu) return 0;
+
+	for (size_t i = 0; i < cpu->debug.breakpoint_count; i++) {
+		if (cpu->debug.breakpoints[i] != address) continue;
+
+		cpu->debug.breakpoints[i] = cpu->debug.breakpoints[--cpu->debug.breakpoint_count];
+		debug_invalidate(cpu, address);
+		return 1;
+	}
+	return 0;
+}
+
+// Return 1 if a watchpoint on <kind> accesses overlaps the page at <page>
+static int debug_page_watched(const riscv_cpu_t* const cpu, dword page, int kind) {
+	for (size_t i = 0; i < cpu->debug.watch_count; i++) {
+		const riscv_watchpoint_t* const watch = &cpu->debug.watchpoints[i];
+		if ((watch->kind & kind) && page < watch->end && page + TLB_PAGE_SIZE > watch->start) return 1;
+	}
+	return 0;
+}
+
+// Count the load watchpoints again and refill the TLB, which only leaves fast paths to pages that aren't watched
+static void debug_watches_changed(riscv_cpu_t* const cpu) {
+	cpu->debug.load_watches = 0;
+	for (size_t i = 0; i < cpu->debug.watch_count; i++) {
+		if (cpu->debug.watchpoints[i].kind & rw_load) cpu->debug.load_watches++;
+	}
+	cpu_flush_tlb(cpu);
+}
+
+int cpu_watch_set(riscv_cpu_t* const cpu, dword address, dword length, int kind) {
+	if (NULL == cpu || 0 == length || address + length < address) return 0;
+	if (0 == (kind & rw_access) || 0 != (kind & ~rw_access)) return 0;
+	if (RSK_WATCHPOINT_MAX == cpu->debug.watch_count) return 0;
+
+	riscv_watchpoint_t* const watch = &cpu->debug.watchpoints[cpu->debug.watch_count++];
+	watch->start = address;
+	watch->end = address + length;
+	watch->kind = kind;
+	debug_watches_changed(cpu);
+	return 1;
+}
+
+int cpu_watch_clear(riscv_cpu_t* const cpu, dword address, dword length) {
+	if (NULL == cpu) return 0;
+
+	size_t kept = 0;
+	for (size_t i = 0; i < cpu->debug.watch_count; i++) {
+		const riscv_watchpoint_t watch = cpu->debug.watchpoints[i];
+		if (watch.start != address || watch.end != address + length) cpu->debug.watchpoints[kept++] = watch;
+	}
+	if (kept == cpu->debug.watch_count) return 0;
+
+	cpu->debug.watch_count = kept;
+	debug_watches_changed(cpu);
+	return 1;
+}
+
+int cpu_debug_status(const riscv_cpu_t* const cpu, rsk_debug_status_t* const status) {
+	if (NULL == cpu || NULL == status) return 0;
+	*status = cpu->debug.status;
+	return cpu->debug.status.reason;
+}
+
+// Return 1 (noting the stop) if the run has to stop at the breakpoint at pc, which it doesn't if it is resuming from there
+static int debug_break(riscv_cpu_t* const cpu) {
+	if (cpu->pc == cpu->debug.resume_pc && cpu->stats.instructions == cpu->debug.resume_step) return 0;
+
+	cpu->debug.resume_pc = cpu->pc;
+	cpu->debug.resume_step = cpu->stats.instructions;
+	cpu->debug.status = (rsk_debug_status_t) { rb_breakpoint, cpu->stats.instructions, cpu->pc, 0, 0, 0 };
+	return 1;
+}
+
+// Stop the run right after the current instruction if its access of <size> bytes at <address> is watched (called on the slow paths of the TLB)
+static void debug_watch(riscv_cpu_t* const cpu, dword address, dword size, int store) {
+	int kind = store ? rw_store : rw_load;
+	for (size_t i = 0; i < cpu->debug.watch_count; i++) {
+		const riscv_watchpoint_t* const watch = &cpu->debug.watchpoints[i];
+		if (!(watch->kind & kind) || address >= watch->end || address + size <= watch->start) continue;
+
+		// (the step is filled in once the run stops, as the threaded core and the JIT only count instructions at the end of a block)
+		if (rb_none == cpu->debug.status.reason) cpu->debug.status = (rsk_debug_status_t) { rb_watchpoint, 0, cpu->pc, address, (word) size, (word) store };
+
+		// every core leaves the block after a store that sets code_modified, and the function pointer core after a load too
+		cpu->code_modified = 1;
+		cpu_process_signal(cpu, rs_halt);
+		return;
+	}
+}
+
+// Note where a run that stopped at a watchpoint stopped: right after the instruction that made the access
+static inline void debug_stopped(riscv_cpu_t* const cpu) {
+	if (rb_watchpoint == cpu->debug.status.reason) cpu->debug.status.step = cpu->stats.instructions - 1;
+}
+
+// ---------- Software TLB ----------
+
+// Return 1 if any cached block holds code from the page at <page>
+static int cpu_page_has_code(const riscv_cpu_t* const cpu, dword page) {
+	if (page >= cpu->code_high || page + TLB_PAGE_SIZE <= cpu->code_low) return 0;
+
+	for (size_t i = 0; i < BLOCK_CACHE_SIZE; i++) {
+		const riscv_block_t* const block = &cpu->blocks[i];
+		if (BLOCK_VALID(cpu, block) && 0 != block->count && page < block->end && page + TLB_PAGE_SIZE > block->start) return 1;
+	}
+
+	return 0;
+}
+
+// Fill the load (or, if <for_store> is set, the store) side of a TLB entry with the translation of the page at <page>, along with the other side if that is still empty
+static void tlb_fill(riscv_cpu_t* const cpu, riscv_tlb_entry_t* const entry, dword page, int for_store) {
+	const riscv_ram_t* region = NULL;
+	for (size_t i = 0; i < cpu->region_count; i++) {
+		dword offset = page - cpu->regions[i].address;
+		if (offset < cpu->regions[i].length && TLB_PAGE_SIZE <= cpu->regions[i].length - offset) {
+			region = &cpu->regions[i];
+			break;
+		}
+	}
+
+	byte* host = (NULL == region) ? NULL : region->base + (page - region->address);
+
+	// (filling only the side that missed keeps loads and stores to different pages with the same index from evicting each other)
+	if (!for_store || TLB_INVALID == entry->read_page) {
+		// loads from watched pages take the slow path, which checks the watchpoints
+		entry->read_page = page;
+		entry->read_host = (0 != cpu->debug.watch_count && debug_page_watched(cpu, page, rw_load)) ? NULL : host;
+	}
+
+	if (for_store || TLB_INVALID == entry->write_page) {
+		// stores to pages holding cached code (or watched) have to take the slow path, which invalidates blocks (and checks the watchpoints)
+		int fast_stores = NULL != region && region->writable && !cpu_page_has_code(cpu, page);
+		if (0 != cpu->debug.watch_count && debug_page_watched(cpu, page, rw_store)) fast_stores = 0;
+		entry->write_page = page;
+		entry->write_host = fast_stores ? host : NULL;
+	}
+}
+
+// Return the TLB entry for <address>
+static inline riscv_tlb_entry_t* tlb_entry(riscv_cpu_t* const cpu, dword address) {
+	return &cpu->tlb[(address >> TLB_PAGE_BITS) & (TLB_SIZE - 1)];
+}
+
+// Return the host address to read <size> bytes at <address> from (or NULL if the host services must handle the read); data loads (<data> set, unlike instruction fetches) count their misses and check the watchpoints on the slow path
+static inline const byte* tlb_read_pointer(riscv_cpu_t* const cpu, dword address, dword size, int data) {
+	riscv_tlb_entry_t* entry = tlb_entry(cpu, address);
+	dword page = address & ~TLB_PAGE_MASK;
+	dword offset = address & TLB_PAGE_MASK;
+
+	if (entry->read_page != page) {
+		// (fetches aren't counted as loads, so their misses aren't load misses either)
+		if (data) cpu->stats.load_misses += 1;
+		tlb_fill(cpu, entry, page, 0);
+	}
+
+	if (NULL != entry->read_host && offset + size <= TLB_PAGE_SIZE) return entry->read_host + offset;
+
+	// partially mapped, watched, or MMIO page, or page-straddling access
+	if (data && 0 != cpu->debug.watch_count) debug_watch(cpu, address, size, 0);
+	return cpu_region_pointer(cpu, address, size, 0);
+}
+
+// Return the host address to load <size> bytes at <address> from (or NULL if the host services must handle the load)
+static inline const byte* tlb_load_pointer(riscv_cpu_t* const cpu, dword address, dword size) {
+	return tlb_read_pointer(cpu, address, size, 1);
+}
+
+// Return the host address to store <size> bytes at <address> to without further checks (or NULL if the store must take the slow path)
+static inline byte* tlb_store_pointer(riscv_cpu_t* const cpu, dword address, dword size) {
+	riscv_tlb_entry_t* entry = tlb_entry(cpu, address);
+	dword page = address & ~TLB_PAGE_MASK;
+	dword offset = address & TLB_PAGE_MASK;
+
+	if (entry->write_page != page) {
+		cpu->stats.store_misses += 1;
+		tlb_fill(cpu, entry, page, 1);
+	}
+
+	if (NULL != entry->write_host && offset + size <= TLB_PAGE_SIZE) return entry->write_host + offset;
+
+	if (0 != cpu->debug.watch_count) debug_watch(cpu, address, size, 1);
+	return NULL;
+}
+
+// Stop fast-path stores to the pages spanned by [start, end)
+static void tlb_protect_code(riscv_cpu_t* const cpu, dword start, dword end) {
+	for (dword page = start & ~TLB_PAGE_MASK; page < end; page += TLB_PAGE_SIZE) {
+		riscv_tlb_entry_t* entry = tlb_entry(cpu, page);
+		if (entry->write_page == page) entry->write_host = NULL;
+	}
+}
+
+void cpu_flush_tlb(riscv_cpu_t* const cpu) {
+    if (NULL == cpu) return;
+
+	for (size_t i = 0; i < TLB_SIZE; i++) {
+		cpu->tlb[i].read_page = TLB_INVALID;
+		cpu->tlb[i].write_page = TLB_INVALID;
+		cpu->tlb[i].read_host = NULL;
+		cpu->tlb[i].write_host = NULL;
+	}
+}
+
+// ---------- Memory Access Methods ----------
+
+int cpu_map_ram(riscv_cpu_t* const cpu, void* base, dword address, dword length, int writable) {
+    if (NULL == cpu) return 0;
+
+	// drop any regions overlapping the new one
+	size_t kept = 0;
+	for (size_t i = 0; i < cpu->region_count; i++) {
+		riscv_ram_t region = cpu->regions[i];
+		int overlaps = address < region.address + region.length && region.address < address + length;
+		if (!overlaps) cpu->regions[kept++] = region;
+		else ram_release(&region);
+	}
+	cpu->region_count = kept;
+	fork_close(cpu);
+
+	// translations and cached blocks may refer to the old mapping
+	cpu_flush_tlb(cpu);
+	cpu_flush_blocks(cpu);
+
+	if (NULL == base || 0 == length) return 1;
+	if (cpu->region_count == RAM_REGION_MAX) {
+		cpu->host.log_msg("Too many RAM regions mapped");
+		return 0;
+	}
+
+	riscv_ram_t* region = &cpu->regions[cpu->region_count++];
+	region->base = (byte*) base;
+	region->address = address;
+	region->length = length;
+	region->writable = writable;
+	region->owned = 0;
+	return 1;
+}
+
+// Fetch an instruction word (not counted as a data load)
+static inline word cpu_fetch_word(riscv_cpu_t* const cpu, dword address) {
+	// (instruction fetches don't set off watchpoints)
+	const byte* host = tlb_read_pointer(cpu, address, 4, 0);
+	if (NULL != host) return (word) ram_read(host, 4);
+	return HOST_CALL(cb_load_word, cpu->host.mem_load_word(address));
+}
+
+byte cpu_load_byte(riscv_cpu_t* const cpu, dword address) {
+    if (NULL == cpu) return 0;
+	cpu->stats.loads += 1;
+	if (cpu->config & rc_cache_on) cache_data(cpu, address, 1, ca_load);
+
+	const byte* host = tlb_load_pointer(cpu, address, 1);
+	if (NULL != host) return (byte) ram_read(host, 1);
+    return (byte) cpu_host_load(cpu, address, 1);
+}
+
+void cpu_store_byte(riscv_cpu_t* const cpu, dword address, byte value) {
+    if (NULL == cpu) return;
+	cpu->stats.stores += 1;
+	if (cpu->config & rc_cache_on) cache_data(cpu, address, 1, ca_store);
+
+	byte* host = tlb_store_pointer(cpu, address, 1);
+	if (NULL != host) {
+		ram_write(host, value, 1);
+		return;
+	}
+
+	host = cpu_region_pointer(cpu, address, 1, 1);
+	if (NULL != host) ram_write(host, value, 1);
+	else cpu_host_store(cpu, address, value, 1);
+
+    cpu_invalidate_code(cpu, address, 1);
+}
+
+hword cpu_load_hword(riscv_cpu_t* const cpu, dword address) {
+    if (NULL == cpu) return 0;
+	cpu->stats.loads += 1;
+	if (cpu->config & rc_cache_on) cache_data(cpu, address, 2, ca_load);
+
+	const byte* host = tlb_load_pointer(cpu, address, 2);
+	if (NULL != host) return (hword) ram_read(host, 2);
+    return (hword) cpu_host_load(cpu, address, 2);
+}
+
+void cpu_store_hword(riscv_cpu_t* const cpu, dword address, hword value) {
+    if (NULL == cpu) return;
+	cpu->stats.stores += 1;
+	if (cpu->config & rc_cache_on) cache_data(cpu, address, 2, ca_store);
+
+	byte* host = tlb_store_pointer(cpu, address, 2);
+	if (NULL != host) {
+		ram_write(host, value, 2);
+		return;
+	}
+
+	host = cpu_region_pointer(cpu, address, 2, 1);
+	if (NULL != host) ram_write(host, value, 2);
+	else cpu_host_store(cpu, address, value, 2);
+
+    cpu_invalidate_code(cpu, address, 2);
+}
+
+word cpu_load_word(riscv_cpu_t* const cpu, dword address) {
+    if (NULL == cpu) return 0;
+	cpu->stats.loads += 1;
+	if (cpu->config & rc_cache_on) cache_data(cpu, address, 4, ca_load);
+
+	const byte* host = tlb_load_pointer(cpu, address, 4);
+	if (NULL != host) return (word) ram_read(host, 4);
+    return (word) cpu_host_load(cpu, address, 4);
+}
+
+void cpu_store_word(riscv_cpu_t* const cpu, dword address, word value) {
+    if (NULL == cpu) return;
+	cpu->stats.stores += 1;
+	if (cpu->config & rc_cache_on) cache_data(cpu, address, 4, ca_store);
+
+	byte* host = tlb_store_pointer(cpu, address, 4);
+	if (NULL != host) {
+		ram_write(host, value, 4);
+		return;
+	}
+
+	host = cpu_region_pointer(cpu, address, 4, 1);
+	if (NULL != host) ram_write(host, value, 4);
+	else cpu_host_store(cpu, address, value, 4);
+
+    cpu_invalidate_code(cpu, address, 4);
+}
+
+dword cpu_load_dword(riscv_cpu_t* const cpu, dword address) {
+    if (NULL == cpu) return 0;
+	cpu->stats.loads += 1;
+	if (cpu->config & rc_cache_on) cache_data(cpu, address, 8, ca_load);
+
+	const byte* host = tlb_load_pointer(cpu, address, 8);
+	if (NULL != host) return (dword) ram_read(host, 8);
+    return (dword) cpu_host_load(cpu, address, 8);
+}
+
+void cpu_store_dword(riscv_cpu_t* const cpu, dword address, dword value) {
+    if (NULL == cpu) return;
+	cpu->stats.stores += 1;
+	if (cpu->config & rc_cache_on) cache_data(cpu, address, 8, ca_store);
+
+	byte* host = tlb_store_pointer(cpu, address, 8);
+	if (NULL != host) {
+		ram_write(host, value, 8);
+		return;
+	}
+
+	host = cpu_region_pointer(cpu, address, 8, 1);
+	if (NULL != host) ram_write(host, value, 8);
+	else cpu_host_store(cpu, address, value, 8);
+
+    cpu_invalidate_code(cpu, address, 8);
+}
+
+dword cpu_get_pc(const riscv_cpu_t* const cpu) {
+    if (NULL == cpu) return 0;
+    return cpu->pc;
+}
+
+void cpu_set_pc(riscv_cpu_t* const cpu, dword address) {
+    if (NULL == cpu) return;
+    cpu->pc = address;
+}
+
+dword cpu_read_register(const riscv_cpu_t* const cpu, byte index) {
+    if (NULL == cpu) return 0;
+
+	if (0 > index || index >= REGISTER_COUNT) {
+        cpu->host.panic("Register access out of bounds");
+        return 0;
+    }
+
+	if (0 == index) return 0;
+	return cpu->x[index];
+}
+
+void cpu_write_register(riscv_cpu_t* const cpu, byte index, dword value) {
+    if (NULL == cpu) return;
+
+	if (0 > index || index >= REGISTER_COUNT) {
         cpu->host.panic("Register access out of bounds");
         return;
     }
@@ -385,17 +2920,45 @@ void cpu_write_register(riscv_cpu_t* const cpu, byte index, dword value) {
 	cpu->x[index] = value;
 }
 
+// Version of the rsk_state_t fields the kernel and the host both know, or 0 if <state> lacks even those of version 1
+static int state_version(const rsk_state_t* const state) {
+	if (NULL == state || state->version < 1 || state->size < offsetof(rsk_state_t, x) + sizeof(state->x)) return 0;
+	return (state->version < RSK_STATE_VERSION) ? (int) state->version : RSK_STATE_VERSION;
+}
+
+int cpu_get_state(const riscv_cpu_t* const cpu, rsk_state_t* const state) {
+	if (NULL == cpu) return 0;
+
+	int version = state_version(state);
+	if (0 == version) return 0;
+
+	state->pc = cpu->pc;
+	memcpy(state->x, cpu->x, sizeof(state->x));
+	state->x[0] = 0;
+	return version;
+}
+
+int cpu_set_state(riscv_cpu_t* const cpu, const rsk_state_t* const state) {
+	if (NULL == cpu) return 0;
+
+	int version = state_version(state);
+	if (0 == version) return 0;
+
+	cpu->pc = state->pc;
+	memcpy(cpu->x + 1, state->x + 1, sizeof(state->x) - sizeof(state->x[0]));
+	return version;
+}
+
 void cpu_process_signal(riscv_cpu_t* const cpu, rsk_signal_t signal) {
     if (NULL == cpu) return;
 
-    if (signal == rs_halt) {
-        cpu->is_running = 0;
-    }
+    // the run loop picks it up at the next block boundary, whichever thread it is on
+    atomic_fetch_or_explicit(&cpu->mailbox, 1u << signal, memory_order_release);
 }
 
 void cpu_log_trace(riscv_cpu_t* const cpu) {
     if (NULL == cpu) return;
-    cpu->host.log_trace(cpu->stats.instructions, cpu->pc, cpu->x);
+    HOST_CALL_VOID(cb_log_trace, cpu->host.log_trace(cpu->stats.instructions, cpu->pc, cpu->x));
 }
 
 void cpu_log_message(const riscv_cpu_t* cpu, const char* const message) {
@@ -416,6 +2979,12 @@ void cpu_fill_stats(const riscv_cpu_t* const cpu, rsk_stat_t* stats) {
     stats->stores = cpu->stats.stores;
     stats->load_misses = cpu->stats.load_misses;
     stats->store_misses = cpu->stats.store_misses;
+
+    // with the cache model on, misses are D-cache misses rather than TLB misses
+    if (cpu->config & rc_cache_on) {
+        stats->load_misses = (unsigned int) cpu->dcache.misses[ca_load];
+        stats->store_misses = (unsigned int) cpu->dcache.misses[ca_store];
+    }
 }
 
 unsigned int cpu_stat_instructions(riscv_cpu_t* const cpu) {
@@ -423,7 +2992,7 @@ unsigned int cpu_stat_instructions(riscv_cpu_t* const cpu) {
 }
 
 const char* const cpu_identify_instr(riscv_cpu_t* const cpu, word instr) {
-    riscv_instr_t* itype = registry_search(&cpu->instruction_set, instr);
+    riscv_instr_t* itype = registry_decode(cpu->instruction_set, instr);
     if (NULL == itype) return NULL;
     return itype->name;
 }
@@ -439,52 +3008,888 @@ void cpu_disassemble_instr(riscv_cpu_t* const cpu, char* buffer, size_t buffer_s
 	bps -= 13;
 
 	// get the instruction type
-	riscv_instr_t* itype = registry_search(&cpu->instruction_set, instr);
+	riscv_instr_t* itype = registry_decode(cpu->instruction_set, instr);
 	if (NULL == itype) {
 		bp[0] = '?';
 		bp[1] = '\0';
+		return;
 	}
 
 	// disassemble instruction
-	itype->disassemble(cpu, instr, bp, bps);
+	disasm_instr(itype, instr, bp, bps);
 }
 
 void cpu_disassemble(riscv_cpu_t* const cpu, char* buffer, size_t buffer_size) {
     if (NULL == cpu) return;
 
-    word instr = cpu->host.mem_load_word(cpu->pc);
+    word instr = cpu_fetch_word(cpu, cpu->pc);
     cpu_disassemble_instr(cpu, buffer, buffer_size, instr);
 }
 
-int cpu_execute(riscv_cpu_t* const cpu) {
-    if (NULL == cpu) return 0;
-	cpu->is_running = 1;
+// ---------- Bulk Memory Idioms ----------
 
-	// get current instruction an add to disasm buffer
-	word instr = cpu->host.mem_load_word(cpu->pc);
-	if (instr == RV64I_EBREAK) {
-		cpu->is_running = 0;
-		return 0;
+// (extended counters have to see every instruction and access, so PERF=1 builds leave the recognizer out, and every loop is stepped)
+#ifndef RISCV_PERF_COUNTERS
+// Index of <reg> among the induction registers of <idiom>, or -1 if the loop doesn't step it
+static int idiom_induction(const riscv_idiom_t* const idiom, byte reg) {
+	for (size_t i = 0; i < idiom->induction_count; i++) {
+		if (idiom->induction[i] == reg) return (int) i;
 	}
+	return -1;
+}
 
-	// get the instruction type
-	riscv_instr_t* itype = registry_search(&cpu->instruction_set, instr);
-	if (NULL == itype) {
-		cpu->host.panic("Unrecognized instruction!");
-        cpu->is_running = 0;
+// Recognize <block> as a copy or fill loop (see riscv_idiom_t), leaving its idiom kind ik_none otherwise
+static void idiom_recognize(riscv_block_t* const block) {
+	typedef void (*riscv_exec_t)(riscv_cpu_t* const, const riscv_op_t* const, int*, int*, int*);
+	static const struct { riscv_exec_t execute; byte width; int is_signed; int is_store; } accesses[] = {
+		{ z_exec_lb, 1, 1, 0 },
+		{ z_exec_lbu, 1, 0, 0 },
+		{ z_exec_lh, 2, 1, 0 },
+		{ z_exec_lhu, 2, 0, 0 },
+		{ z_exec_lw, 4, 1, 0 },
+		{ z_exec_lwu, 4, 0, 0 },
+		{ z_exec_ld, 8, 0, 0 },
+		{ z_exec_sb, 1, 0, 1 },
+		{ z_exec_sh, 2, 0, 1 },
+		{ z_exec_sw, 4, 0, 1 },
+		{ z_exec_sd, 8, 0, 1 },
+	};
+	const size_t access_count = sizeof(accesses) / sizeof(accesses[0]);
+
+	riscv_idiom_t* const idiom = &block->idiom;
+	idiom->kind = ik_none;
+	idiom->induction_count = 0;
+	if (block->count < 3) return;
+
+	const riscv_op_t* const branch = &block->ops[block->count - 1];
+	if (z_exec_bne == branch->execute) idiom->cond = ic_ne;
+	else if (z_exec_blt == branch->execute) idiom->cond = ic_lt;
+	else if (z_exec_bltu == branch->execute) idiom->cond = ic_ltu;
+	else return;
+	if (block->end - 4 + (dword) branch->imm != block->start) return;
+
+	// the body: at most one load, exactly one store, and addi increments of distinct registers
+	int load = -1, store = -1;
+	byte load_width = 0;
+	size_t increment_at[IDIOM_INDUCTION_MAX];
+	for (size_t i = 0; i + 1 < block->count; i++) {
+		const riscv_op_t* const op = &block->ops[i];
+		if (z_exec_addi == op->execute && op->rd == op->rs1 && 0 != op->rd) {
+			if (IDIOM_INDUCTION_MAX == idiom->induction_count || idiom_induction(idiom, op->rd) >= 0) return;
+			increment_at[idiom->induction_count] = i;
+			idiom->induction[idiom->induction_count] = op->rd;
+			idiom->step[idiom->induction_count++] = op->imm;
+			continue;
+		}
+
+		size_t a = 0;
+		while (a < access_count && accesses[a].execute != op->execute) a++;
+		if (a == access_count) return;
+		if (accesses[a].is_store) {
+			if (store >= 0) return;
+			store = (int) i;
+			idiom->width = accesses[a].width;
+		} else {
+			if (load >= 0 || store >= 0) return;
+			load = (int) i;
+			load_width = accesses[a].width;
+			idiom->load_signed = accesses[a].is_signed;
+		}
+	}
+	if (store < 0) return;
+
+	// the destination steps forward one element per iteration (the element is addressed from its value at the time of the store)
+	const riscv_op_t* const st = &block->ops[store];
+	int dst = idiom_induction(idiom, st->rs1);
+	if (dst < 0 || idiom->step[dst] != idiom->width) return;
+	idiom->dst = st->rs1;
+	idiom->dst_offset = st->imm + ((increment_at[dst] < (size_t) store) ? idiom->width : 0);
+
+	if (load >= 0) {
+		// copies store the element just loaded, through a source stepping the same way
+		const riscv_op_t* const ld = &block->ops[load];
+		int src = idiom_induction(idiom, ld->rs1);
+		if (load_width != idiom->width || src < 0 || idiom->step[src] != idiom->width || ld->rd != st->rs2 || 0 == ld->rd || idiom_induction(idiom, ld->rd) >= 0) return;
+		idiom->src = ld->rs1;
+		idiom->src_offset = ld->imm + ((increment_at[src] < (size_t) load) ? idiom->width : 0);
+		idiom->value = ld->rd;
+	} else {
+		// fills store a register the loop leaves alone
+		if (idiom_induction(idiom, st->rs2) >= 0) return;
+		idiom->value = st->rs2;
+	}
+
+	// the branch compares an induction register with a register the loop leaves alone (ordered comparisons only count up)
+	int counter = idiom_induction(idiom, branch->rs1);
+	idiom->bound = branch->rs2;
+	if (counter < 0 && ic_ne == idiom->cond) {
+		counter = idiom_induction(idiom, branch->rs2);
+		idiom->bound = branch->rs1;
+	}
+	if (counter < 0 || idiom_induction(idiom, idiom->bound) >= 0 || (load >= 0 && idiom->bound == idiom->value)) return;
+	if (0 == idiom->step[counter] || (ic_ne != idiom->cond && idiom->step[counter] < 0)) return;
+	idiom->counter = (size_t) counter;
+
+	idiom->kind = (load >= 0) ? ik_copy : ik_fill;
+}
+#endif
+
+// Number of iterations left in the loop of <idiom> (counting the current one), or 0 if it can't be worked out without running it
+static dword idiom_iterations(const riscv_cpu_t* const cpu, const riscv_idiom_t* const idiom) {
+	// after n iterations, the branch compares counter + n * step with the bound
+	dword counter = cpu->x[idiom->induction[idiom->counter]];
+	dword bound = cpu->x[idiom->bound];
+	sdword step = idiom->step[idiom->counter];
+
+	if (ic_ne == idiom->cond) {
+		dword distance = (step > 0) ? bound - counter : counter - bound;
+		dword stride = (step > 0) ? (dword) step : -(dword) step;
+		if (0 == distance || 0 != distance % stride) return 0;
+		return distance / stride;
+	}
+
+	// ordered comparisons: the loop runs until the counter reaches the bound, which it must do without wrapping around
+	dword stride = (dword) step;
+	if (ic_lt == idiom->cond) {
+		if ((sdword) counter >= (sdword) bound || (sdword) bound > INT64_MAX - step) return 1;
+	} else {
+		if (counter >= bound || bound > UINT64_MAX - stride) return 1;
+	}
+	dword distance = bound - counter;
+	return distance / stride + ((0 != distance % stride) ? 1 : 0);
+}
+
+// Store <count> elements of <width> bytes, each holding the low bytes of <value>, to <host>
+static void idiom_fill(byte* const host, dword value, byte width, size_t count) {
+	size_t size = count * width;
+	if (1 == width) {
+		memset(host, (int) (value & 0xff), size);
+		return;
+	}
+
+	// widths are powers of two, so 16 bytes of the pattern repeat in step with the elements
+	byte pattern[16];
+	for (size_t i = 0; i < sizeof(pattern); i++) pattern[i] = (byte) (value >> (8 * (i % width)));
+
+	size_t done = 0;
+#if defined(__SSE2__)
+	__m128i vector = _mm_loadu_si128((const __m128i*) pattern);
+	for (; done + sizeof(pattern) <= size; done += sizeof(pattern)) _mm_storeu_si128((__m128i*) (host + done), vector);
+#elif defined(__ARM_NEON)
+	uint8x16_t vector = vld1q_u8(pattern);
+	for (; done + sizeof(pattern) <= size; done += sizeof(pattern)) vst1q_u8(host + done, vector);
+#endif
+	for (; done < size; done++) host[done] = pattern[done % sizeof(pattern)];
+}
+
+// Run the whole iterations of the copy or fill loop in <block> but the last (which leaves the loop, and so is left to the interpreter), up to <budget> instructions, as a single bulk operation on host memory. With the cache model on, the accesses of the bulk iterations are modeled along with it, a line at a time. Returns the number of instructions accounted for, or 0 if the loop has to be stepped as usual: while every instruction or access must be seen (tracing, profiling, watchpoints), when the trip count isn't known beforehand, or when any element is outside mapped RAM (i.e. MMIO), in cached code, or in an overlap that a forward copy doesn't preserve.
+static size_t idiom_run(riscv_cpu_t* const cpu, const riscv_block_t* const block, size_t budget) {
+	const riscv_idiom_t* const idiom = &block->idiom;
+	if ((cpu->config & (rc_trace_log | rc_trace_binary)) || 0 != cpu->profile.interval || 0 != cpu->debug.watch_count) return 0;
+
+	dword iterations = idiom_iterations(cpu, idiom);
+	if (iterations < 2) return 0;
+	dword bulk = iterations - 1;
+	if (bulk > budget / block->count) bulk = budget / block->count;
+	if (bulk > IDIOM_CHUNK_MAX / idiom->width) bulk = IDIOM_CHUNK_MAX / idiom->width;
+	if (0 == bulk) return 0;
+
+	dword size = bulk * idiom->width;
+	dword dst_address = cpu->x[idiom->dst] + (dword) idiom->dst_offset;
+	byte* dst = cpu_region_pointer(cpu, dst_address, size, 1);
+	if (NULL == dst || (dst_address < cpu->code_high && cpu->code_low < dst_address + size)) return 0;
+
+	dword src_address = 0;
+	if (ik_copy == idiom->kind) {
+		src_address = cpu->x[idiom->src] + (dword) idiom->src_offset;
+		const byte* src = cpu_region_pointer(cpu, src_address, size, 0);
+		if (NULL == src || (src_address < dst_address && dst_address < src_address + size)) return 0;
+
+		// the value register ends up holding the last element loaded (read before the copy can overwrite it)
+		dword last = ram_read(src + size - idiom->width, idiom->width);
+		if (idiom->load_signed && idiom->width < 8) {
+			byte shift = (byte) (64 - 8 * idiom->width);
+			last = (dword) ((sdword) (last << shift) >> shift);
+		}
+		memmove(dst, src, size);
+		cpu->x[idiom->value] = last;
+		cpu->stats.loads += (unsigned int) bulk;
+	} else {
+		idiom_fill(dst, cpu->x[idiom->value], idiom->width, bulk);
+	}
+
+	if (cpu->config & rc_cache_on) {
+		cache_stream(cpu, ik_copy == idiom->kind, src_address, dst_address, idiom->width, bulk);
+		cache_loop(cpu, block->start, block->count, bulk);
+		cpu->fetches_modeled = 1;
+	}
+
+	for (size_t i = 0; i < idiom->induction_count; i++) cpu->x[idiom->induction[i]] += bulk * (dword) idiom->step[i];
+	cpu->stats.stores += (unsigned int) bulk;
+	cpu->stats.instructions += (unsigned int) (bulk * block->count);
+	return bulk * block->count;
+}
+
+// ---------- Block Cache Methods ----------
+
+// Return 1 if an instruction transfers control (and so must be the last instruction of a block)
+static inline int op_ends_block(word instr) {
+	byte opcode = mask_instr_opcode(instr);
+	return opcode == OPCODE(1100011) || opcode == OPCODE(1101111) || opcode == OPCODE(1100111) || opcode == OPCODE(1110011);
+}
+
+// Decode the straight-line run of instructions starting at <address> into <block>
+static void block_decode(riscv_cpu_t* const cpu, riscv_block_t* const block, dword address) {
+	block->epoch = cpu->block_epoch;
+	block->start = address;
+	block->count = 0;
+	block->breakpoint = 0;
+#ifdef RISCV_THREADED_CORE
+	block->threaded = 0;
+#endif
+#ifdef RISCV_JIT
+	block->entries = 0;
+	block->jit = NULL;
+#endif
+
+	dword pc = address;
+	while (block->count < BLOCK_MAX_OPS) {
+		// (a breakpoint always starts a block of its own, which is left empty so that every core hands it to cpu_run_block)
+		if (0 != cpu->debug.breakpoint_count && pc != cpu->debug.step_over && debug_has_breakpoint(cpu, pc)) {
+			block->breakpoint = (0 == block->count);
+			break;
+		}
+
+		word instr = cpu_fetch_word(cpu, pc);
+		if (instr == RV64I_EBREAK) break;
+
+		riscv_instr_t* itype = registry_decode(cpu->instruction_set, instr);
+		if (NULL == itype) break;
+
+		op_decode(itype, instr, &block->ops[block->count]);
+#ifdef RISCV_PERF_COUNTERS
+		block->ops[block->count].perf_type = perf_type_index(cpu, itype);
+#endif
+		block->count++;
+		pc += 4;
+
+		if (op_ends_block(instr)) break;
+	}
+	block->end = pc;
+
+	if (0 == block->count) {
+		block->link = rl_none;
+		block->idiom.kind = ik_none;
+		return;
+	}
+	block->link = op_link(&block->ops[block->count - 1]);
+#ifdef RISCV_PERF_COUNTERS
+	block->idiom.kind = ik_none;
+#else
+	idiom_recognize(block);
+#endif
+	if (block->start < cpu->code_low) cpu->code_low = block->start;
+	if (block->end > cpu->code_high) cpu->code_high = block->end;
+	tlb_protect_code(cpu, block->start, block->end);
+}
+
+// Return the cached block starting at <address>, decoding it first if necessary
+static inline riscv_block_t* block_lookup(riscv_cpu_t* const cpu, dword address) {
+	riscv_block_t* block = &cpu->blocks[(address >> 2) & (BLOCK_CACHE_SIZE - 1)];
+	cpu->block_lookups += 1;
+	if (!BLOCK_VALID(cpu, block) || block->start != address) {
+		cpu->block_decodes += 1;
+		block_decode(cpu, block, address);
+	}
+	return block;
+}
+
+void cpu_block_stats(const riscv_cpu_t* const cpu, dword* lookups, dword* decodes) {
+	if (NULL == cpu) return;
+	*lookups = cpu->block_lookups;
+	*decodes = cpu->block_decodes;
+}
+
+void cpu_flush_blocks(riscv_cpu_t* const cpu) {
+	if (NULL == cpu || NULL == cpu->blocks) return;
+
+	// a new epoch invalidates every block at once (they are only cleared one by one if the epoch wraps around)
+	if (0 == ++cpu->block_epoch) {
+		for (size_t i = 0; i < BLOCK_CACHE_SIZE; i++) cpu->blocks[i].epoch = 0;
+		cpu->block_epoch = 1;
+	}
+	cpu->code_low = (dword) -1;
+	cpu->code_high = 0;
+	cpu->code_modified = 0;
+
+	// pages that held code can take fast stores again once they are refilled
+	for (size_t i = 0; i < TLB_SIZE; i++) cpu->tlb[i].write_page = TLB_INVALID;
+}
+
+void cpu_invalidate_code(riscv_cpu_t* const cpu, dword address, dword size) {
+	if (NULL == cpu || NULL == cpu->blocks) return;
+	if (address >= cpu->code_high || address + size <= cpu->code_low) return;
+
+	for (size_t i = 0; i < BLOCK_CACHE_SIZE; i++) {
+		riscv_block_t* block = &cpu->blocks[i];
+		if (!BLOCK_VALID(cpu, block) || 0 == block->count) continue;
+
+		if (address < block->end && address + size > block->start) {
+			block->epoch = 0;
+			cpu->code_modified = 1;
+		}
+	}
+}
+
+// Execute up to <budget> instructions from the block at pc. Returns the number of instructions executed, and sets <halted> if the block starts with an ebreak, an undecodable instruction, or a breakpoint.
+static size_t cpu_run_block(riscv_cpu_t* const cpu, size_t budget, int* halted) {
+	riscv_block_t* block = block_lookup(cpu, cpu->pc);
+
+	if (0 == block->count) {
+		if (block->breakpoint) {
+			if (debug_break(cpu)) {
+				*halted = 1;
+				return 0;
+			}
+
+			// resuming: step over the breakpoint in a block decoded without it (with no bulk shortcut past it), then empty it again
+			cpu->debug.step_over = cpu->pc;
+			block_decode(cpu, block, cpu->pc);
+			cpu->debug.step_over = (dword) -1;
+			block->idiom.kind = ik_none;
+			size_t executed = cpu_run_block(cpu, budget, halted);
+			block->epoch = 0;
+			return executed;
+		}
+		if (cpu_fetch_word(cpu, cpu->pc) != RV64I_EBREAK) cpu->host.panic("Unrecognized instruction!");
+		*halted = 1;
 		return 0;
 	}
 
+	if (ik_none != block->idiom.kind) {
+		size_t bulk = idiom_run(cpu, block, budget);
+		if (0 != bulk) return bulk;
+	}
+
+	int trace = (cpu->config & rc_trace_log) != 0;
+	int binary_trace = (cpu->config & rc_trace_binary) && NULL != cpu->trace.buffer;
+	size_t count = (block->count < budget) ? block->count : budget;
+
+	size_t executed = 0;
+	while (executed < count) {
+		const riscv_op_t* const op = &block->ops[executed];
+
+		int updated_pc = 0;
+		int loaded_val = 0;
+		int stored_val = 0;
+
+		dword old_pc = cpu->pc;
+		op->execute(cpu, op, &updated_pc, &loaded_val, &stored_val);
+		cpu->x[0] = 0;
+		if (!updated_pc) cpu->pc += 4;
+#ifdef RISCV_PERF_COUNTERS
+		perf_count(cpu, op, old_pc, updated_pc);
+#endif
+
+		if (trace) {
+			if (NULL == cpu->trace.delta) HOST_CALL_VOID(cb_log_trace, cpu->host.log_trace(cpu->stats.instructions, old_pc, cpu->x));
+			else HOST_CALL_VOID(cb_log_trace, trace_delta(cpu, old_pc, op->rd));
+		}
+		if (binary_trace) trace_record(cpu, old_pc, op->rd);
+		cpu->stats.instructions += 1;
+		executed++;
+
+		// the rest of this block may have just been overwritten (or a watchpoint went off)
+		if ((stored_val || loaded_val) && cpu->code_modified) {
+			cpu->code_modified = 0;
+			break;
+		}
+	}
+
+	return executed;
+}
+
+#ifdef RISCV_THREADED_CORE
+// Threaded core: like cpu_run_block, but dispatches with computed gotos between labels that have the execution functions inlined into them (traced runs use cpu_run_block)
+static size_t cpu_run_block_threaded(riscv_cpu_t* const cpu, size_t budget, int* halted) {
+	typedef void (*riscv_exec_t)(riscv_cpu_t* const, const riscv_op_t* const, int*, int*, int*);
+	#define THREADED_ENTRY(name, ...) { z_exec_##name, &&threaded_##name },
+	static const struct { riscv_exec_t execute; const void* label; } dispatch[] = {
+		RISCV_INSTRUCTIONS(THREADED_ENTRY)
+	};
+	#undef THREADED_ENTRY
+
+	riscv_block_t* block = block_lookup(cpu, cpu->pc);
+	if (0 == block->count || (cpu->config & (rc_trace_log | rc_trace_binary)) || mm_off != cpu->mmio.mode || 0 != cpu->debug.load_watches) return cpu_run_block(cpu, budget, halted);
+	if (ik_none != block->idiom.kind) {
+		size_t bulk = idiom_run(cpu, block, budget);
+		if (0 != bulk) return bulk;
+	}
+
+	// resolve dispatch labels once per decoded block (types missing from the table are called through their function pointer)
+	if (!block->threaded) {
+		for (size_t i = 0; i < block->count; i++) {
+			riscv_op_t* op = &block->ops[i];
+			op->label = &&threaded_call;
+			for (size_t d = 0; d < sizeof(dispatch) / sizeof(dispatch[0]); d++) {
+				if (dispatch[d].execute == op->execute) op->label = dispatch[d].label;
+			}
+		}
+		block->threaded = 1;
+	}
+
+	size_t count = (block->count < budget) ? block->count : budget;
+	const riscv_op_t* op = block->ops;
+	const riscv_op_t* const end = op + count;
 	int updated_pc = 0;
-    int loaded_val = 0;
-    int stored_val = 0;
+	int loaded = 0;
+	int stored = 0;
+
+	// after each instruction: advance pc, stop if the rest of the block may have just been overwritten, and jump to the next label
+	#define THREADED_NEXT \
+		cpu->x[0] = 0; \
+		if (!updated_pc) cpu->pc += 4; \
+		if (stored && cpu->code_modified) { \
+			cpu->code_modified = 0; \
+			op++; \
+			goto threaded_done; \
+		} \
+		if (++op == end) goto threaded_done; \
+		updated_pc = 0; \
+		stored = 0; \
+		goto *op->label
+
+	#define THREADED_CASE(name, ...) threaded_##name: z_exec_##name(cpu, op, &updated_pc, &loaded, &stored); THREADED_NEXT;
+
+	goto *op->label;
+
+	RISCV_INSTRUCTIONS(THREADED_CASE)
+
+threaded_call:
+	op->execute(cpu, op, &updated_pc, &loaded, &stored);
+	THREADED_NEXT;
+
+	#undef THREADED_CASE
+	#undef THREADED_NEXT
+
+threaded_done:;
+	size_t executed = (size_t) (op - block->ops);
+	cpu->stats.instructions += executed;
+	return executed;
+}
+
+#define CPU_RUN_BLOCK cpu_run_block_threaded
+#else
+#define CPU_RUN_BLOCK cpu_run_block
+#endif
+
+// ---------- x86-64 JIT ----------
+
+#ifdef RISCV_JIT
+// Compiled code keeps the cpu pointer in rbx and three ints on the stack for the flags of execution functions: updated_pc at [rsp], loaded at [rsp + 4], stored at [rsp + 8]
+
+#define JIT_RAX 0
+#define JIT_RCX 1
+
+#define JIT_REG_OFFSET(index) ((word) (offsetof(riscv_cpu_t, x) + (index) * sizeof(dword)))
+#define JIT_PC_OFFSET         ((word) offsetof(riscv_cpu_t, pc))
+#define JIT_MODIFIED_OFFSET   ((word) offsetof(riscv_cpu_t, code_modified))
+
+static inline void jit_byte(byte** at, byte value) {
+	*(*at)++ = value;
+}
+
+static inline void jit_word(byte** at, word value) {
+	memcpy(*at, &value, sizeof(value));
+	*at += sizeof(value);
+}
+
+static inline void jit_dword(byte** at, dword value) {
+	memcpy(*at, &value, sizeof(value));
+	*at += sizeof(value);
+}
+
+static void jit_bytes(byte** at, const char* bytes, size_t count) {
+	memcpy(*at, bytes, count);
+	*at += count;
+}
+
+// mov <host>, [rbx + x[index]]
+static void jit_load_reg(byte** at, byte host, byte index) {
+	jit_bytes(at, "\x48\x8b", 2);
+	jit_byte(at, 0x83 | (host << 3));
+	jit_word(at, JIT_REG_OFFSET(index));
+}
+
+// mov [rbx + x[index]], rax
+static void jit_store_reg(byte** at, byte index) {
+	jit_bytes(at, "\x48\x89\x83", 3);
+	jit_word(at, JIT_REG_OFFSET(index));
+}
 
-    dword old_pc = cpu->pc;
-	itype->execute(cpu, instr, &updated_pc, &loaded_val, &stored_val);
-	if (!updated_pc) cpu->pc += 4;
+// mov rax, value; mov [rbx + pc], rax
+static void jit_set_pc(byte** at, dword value) {
+	jit_bytes(at, "\x48\xb8", 2);
+	jit_dword(at, value);
+	jit_bytes(at, "\x48\x89\x83", 3);
+	jit_word(at, JIT_PC_OFFSET);
+}
+
+// Return <executed> to the caller
+static void jit_return(byte** at, size_t executed) {
+	jit_byte(at, 0xb8);
+	jit_word(at, (word) executed);
+	jit_bytes(at, "\x48\x83\xc4\x10\x5b\xc3", 6);
+}
+
+// Return <executed> to the caller, continuing at <pc>
+static void jit_exit(byte** at, dword pc, size_t executed) {
+	jit_set_pc(at, pc);
+	jit_return(at, executed);
+}
+
+// Emit a conditional jump (0f <opcode> rel32) and return the address of its displacement, for jit_patch
+static byte* jit_jump(byte** at, byte opcode) {
+	jit_byte(at, 0x0f);
+	jit_byte(at, opcode);
+	byte* displacement = *at;
+	jit_word(at, 0);
+	return displacement;
+}
+
+// Point the jump with the displacement at <displacement> to <at>
+static void jit_patch(byte* displacement, const byte* at) {
+	word relative = (word) (at - (displacement + sizeof(word)));
+	memcpy(displacement, &relative, sizeof(relative));
+}
+
+// Emit native code for <op> (the instruction at <pc>, ending the block after <executed> instructions if it is the last one). Returns 0 if <op> has no native translation, 1 if it falls through to the next instruction, and 2 if it left the block.
+static int jit_emit_native(byte** at, const riscv_op_t* const op, dword pc, size_t executed, dword next) {
+	typedef void (*riscv_exec_t)(riscv_cpu_t* const, const riscv_op_t* const, int*, int*, int*);
+	const riscv_exec_t execute = op->execute;
+
+	// ALU instructions: <load> puts the operands in rax/rcx, <code> computes rax, and the result goes to rd (nothing at all happens for rd == x0)
+	const char* code = NULL;
+	size_t code_size = 0;
+	int imm = 0;
+	int shamt = 0;
+	int reg = 0;
+	int word_result = 0;
+
+	#define JIT_ALU(name, bytes, kind) if (z_exec_##name == execute) { code = bytes; code_size = sizeof(bytes) - 1; kind = 1; }
+	JIT_ALU(addi,  "\x48\x05", imm)
+	JIT_ALU(xori,  "\x48\x35", imm)
+	JIT_ALU(ori,   "\x48\x0d", imm)
+	JIT_ALU(andi,  "\x48\x25", imm)
+	JIT_ALU(slli,  "\x48\xc1\xe0", shamt)
+	JIT_ALU(srli,  "\x48\xc1\xe8", shamt)
+	JIT_ALU(srai,  "\x48\xc1\xf8", shamt)
+	JIT_ALU(add,   "\x48\x01\xc8", reg)
+	JIT_ALU(sub,   "\x48\x29\xc8", reg)
+	JIT_ALU(sll,   "\x48\xd3\xe0", reg)
+	JIT_ALU(srl,   "\x48\xd3\xe8", reg)
+	JIT_ALU(sra,   "\x48\xd3\xf8", reg)
+	JIT_ALU(xor,   "\x48\x31\xc8", reg)
+	JIT_ALU(or,    "\x48\x09\xc8", reg)
+	JIT_ALU(and,   "\x48\x21\xc8", reg)
+	JIT_ALU(mul,   "\x48\x0f\xaf\xc1", reg)
+
+	// word instructions compute eax, which is then sign-extended (32-bit x86 shifts mask their count to 5 bits, as sllw/srlw/sraw do)
+	#define JIT_ALU_W(name, bytes, kind) if (z_exec_##name == execute) { code = bytes; code_size = sizeof(bytes) - 1; kind = 1; word_result = 1; }
+	JIT_ALU_W(addiw, "\x05", imm)
+	JIT_ALU_W(slliw, "\xc1\xe0", shamt)
+	JIT_ALU_W(srliw, "\xc1\xe8", shamt)
+	JIT_ALU_W(sraiw, "\xc1\xf8", shamt)
+	JIT_ALU_W(addw,  "\x01\xc8", reg)
+	JIT_ALU_W(subw,  "\x29\xc8", reg)
+	JIT_ALU_W(sllw,  "\xd3\xe0", reg)
+	JIT_ALU_W(srlw,  "\xd3\xe8", reg)
+	JIT_ALU_W(sraw,  "\xd3\xf8", reg)
+	JIT_ALU_W(mulw,  "\x0f\xaf\xc1", reg)
+	#undef JIT_ALU_W
+	#undef JIT_ALU
+
+	if (NULL != code) {
+		if (0 == op->rd) return 1;
+
+		jit_load_reg(at, JIT_RAX, op->rs1);
+		if (reg) jit_load_reg(at, JIT_RCX, op->rs2);
+		jit_bytes(at, code, code_size);
+		if (imm) jit_word(at, (word) op->imm);
+		if (shamt) jit_byte(at, (byte) (op->imm & 0x3f));
+		if (word_result) jit_bytes(at, "\x48\x63\xc0", 3);
+		jit_store_reg(at, op->rd);
+		return 1;
+	}
+
+	if (z_exec_lui == execute) {
+		if (0 == op->rd) return 1;
+
+		// mov qword [rbx + x[rd]], imm32 (sign-extended, like the immediate)
+		jit_bytes(at, "\x48\xc7\x83", 3);
+		jit_word(at, JIT_REG_OFFSET(op->rd));
+		jit_word(at, (word) op->imm);
+		return 1;
+	}
+
+	if (z_exec_jal == execute) {
+		if (0 != op->rd) {
+			jit_bytes(at, "\x48\xb8", 2);
+			jit_dword(at, pc + 4);
+			jit_store_reg(at, op->rd);
+		}
+		jit_exit(at, pc + op->imm, executed);
+		return 2;
+	}
+
+	// branches: cmp rax, rcx and a jump to the taken exit with the condition code of the comparison
+	byte condition = 0;
+	if (z_exec_beq == execute)  condition = 0x84;
+	if (z_exec_bne == execute)  condition = 0x85;
+	if (z_exec_blt == execute)  condition = 0x8c;
+	if (z_exec_bge == execute)  condition = 0x8d;
+	if (z_exec_bltu == execute) condition = 0x82;
+	if (z_exec_bgeu == execute) condition = 0x83;
+	if (0 == condition) return 0;
+
+	jit_load_reg(at, JIT_RAX, op->rs1);
+	jit_load_reg(at, JIT_RCX, op->rs2);
+	jit_bytes(at, "\x48\x39\xc8", 3);
+	byte* taken = jit_jump(at, condition);
+	jit_exit(at, next, executed);
+	jit_patch(taken, *at);
+	jit_exit(at, pc + op->imm, executed);
+	return 2;
+}
+
+// Emit a call to the execution function of <op> (the instruction at <pc>), leaving the block after <executed> instructions if it stored over cached code or, when it is the <last> instruction, changed pc
+static void jit_emit_call(byte** at, const riscv_op_t* const op, dword pc, size_t executed, int last) {
+	// execution functions may read pc
+	jit_set_pc(at, pc);
+
+	// clear updated_pc and loaded, then stored
+	jit_bytes(at, "\x48\xc7\x04\x24\x00\x00\x00\x00", 8);
+	jit_bytes(at, "\xc7\x44\x24\x08\x00\x00\x00\x00", 8);
+
+	// op->execute(cpu, op, &updated_pc, &loaded, &stored)
+	jit_bytes(at, "\x48\x89\xdf", 3);
+	jit_bytes(at, "\x48\xbe", 2);
+	jit_dword(at, (dword) (uintptr_t) op);
+	jit_bytes(at, "\x48\x8d\x14\x24", 4);
+	jit_bytes(at, "\x48\x8d\x4c\x24\x04", 5);
+	jit_bytes(at, "\x4c\x8d\x44\x24\x08", 5);
+	jit_bytes(at, "\x48\xb8", 2);
+	jit_dword(at, (dword) (uintptr_t) op->execute);
+	jit_bytes(at, "\xff\xd0", 2);
+
+	// x[0] = 0
+	jit_bytes(at, "\x48\xc7\x83", 3);
+	jit_word(at, JIT_REG_OFFSET(0));
+	jit_word(at, 0);
+
+	// if (stored && cpu->code_modified) leave, as the rest of this block may have just been overwritten
+	jit_bytes(at, "\x83\x7c\x24\x08\x00", 5);
+	byte* no_store = jit_jump(at, 0x84);
+	jit_bytes(at, "\x83\xbb", 2);
+	jit_word(at, JIT_MODIFIED_OFFSET);
+	jit_byte(at, 0);
+	byte* unmodified = jit_jump(at, 0x84);
+	jit_bytes(at, "\xc7\x83", 2);
+	jit_word(at, JIT_MODIFIED_OFFSET);
+	jit_word(at, 0);
+	jit_exit(at, pc + 4, executed);
+	jit_patch(no_store, *at);
+	jit_patch(unmodified, *at);
+
+	// a control transfer that was taken has already set pc
+	if (last) {
+		jit_bytes(at, "\x83\x3c\x24\x00", 4);
+		byte* not_taken = jit_jump(at, 0x84);
+		jit_return(at, executed);
+		jit_patch(not_taken, *at);
+	}
+}
+
+// Discard all compiled code
+static void jit_flush(riscv_cpu_t* const cpu) {
+	for (size_t i = 0; i < BLOCK_CACHE_SIZE; i++) {
+		cpu->blocks[i].entries = 0;
+		cpu->blocks[i].jit = NULL;
+	}
+	cpu->jit.used = 0;
+}
+
+// Compile <block>, leaving block->jit NULL if there is no executable memory for it
+static void jit_compile(riscv_cpu_t* const cpu, riscv_block_t* const block) {
+	riscv_jit_t* const jit = &cpu->jit;
+	if (NULL == jit->code) {
+		if (jit->failed) return;
+
+		void* code = mmap(NULL, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (MAP_FAILED == code) {
+			jit->failed = 1;
+			cpu->host.log_msg("Unable to allocate executable memory; the JIT is disabled");
+			return;
+		}
+		jit->code = (byte*) code;
+		jit->used = 0;
+	}
+	if (JIT_ARENA_SIZE - jit->used < JIT_BLOCK_CODE_MAX) jit_flush(cpu);
+
+	byte* const start = jit->code + jit->used;
+	byte* at = start;
+
+	// push rbx; sub rsp, 16; mov rbx, rdi
+	jit_bytes(&at, "\x53\x48\x83\xec\x10\x48\x89\xfb", 8);
+
+	int left = 0;
+	for (size_t i = 0; i < block->count && !left; i++) {
+		const riscv_op_t* const op = &block->ops[i];
+		dword pc = block->start + 4 * i;
+		int last = (i + 1 == block->count);
+
+		int native = jit_emit_native(&at, op, pc, i + 1, block->end);
+		if (0 == native) jit_emit_call(&at, op, pc, i + 1, last);
+		left = (2 == native);
+	}
+	if (!left) jit_exit(&at, block->end, block->count);
+
+	// keep every block's entry point aligned
+	jit->used += ((size_t) (at - start) + 15) & ~(size_t) 15;
+	block->jit = (riscv_jit_code_t) start;
+}
+
+// JIT dispatch: run hot blocks as native code, and everything else (traced runs, blocks that don't fit the budget, and blocks that are still warming up) on the interpreter core
+static size_t cpu_run_block_jit(riscv_cpu_t* const cpu, size_t budget, int* halted) {
+	if (!(cpu->config & rc_jit) || (cpu->config & (rc_trace_log | rc_trace_binary)) || mm_off != cpu->mmio.mode || 0 != cpu->debug.load_watches) return CPU_RUN_BLOCK(cpu, budget, halted);
+
+	riscv_block_t* block = block_lookup(cpu, cpu->pc);
+	if (0 == block->count || block->count > budget || ik_none != block->idiom.kind) return CPU_RUN_BLOCK(cpu, budget, halted);
+
+	if (NULL == block->jit) {
+		if (++block->entries < JIT_THRESHOLD) return CPU_RUN_BLOCK(cpu, budget, halted);
+
+		jit_compile(cpu, block);
+		if (NULL == block->jit) return CPU_RUN_BLOCK(cpu, budget, halted);
+	}
+
+	size_t executed = block->jit(cpu);
+	cpu->stats.instructions += executed;
+	return executed;
+}
+
+#define CPU_DISPATCH_BLOCK cpu_run_block_jit
+#else
+#define CPU_DISPATCH_BLOCK CPU_RUN_BLOCK
+#endif
+
+int cpu_execute(riscv_cpu_t* const cpu) {
+    if (NULL == cpu) return 0;
+	atomic_store_explicit(&cpu->is_running, 1, memory_order_release);
+	if (NULL != cpu->trace.buffer) trace_sync(cpu);
+	if (NULL != cpu->trace.delta) trace_delta_sync(cpu);
+
+	int halted = 0;
+	dword block_pc = cpu->pc;
+	cpu->debug.status.reason = rb_none;
+	size_t executed = CPU_RUN_BLOCK(cpu, 1, &halted);
+	debug_stopped(cpu);
+	if (halted) atomic_store_explicit(&cpu->is_running, 0, memory_order_release);
+	if (0 != cpu->profile.interval) profile_step(cpu, block_pc, executed);
+	if (cpu->config & rc_cache_on) cache_fetch(cpu, block_pc, executed);
+	if (NULL != cpu->publish.page) publish_step(cpu, executed);
+
+	return (int) executed;
+}
+
+// Act on the signals in the mailbox, returning nonzero if the run has to stop
+static int cpu_take_mail(riscv_cpu_t* const cpu) {
+	unsigned int mail = atomic_exchange_explicit(&cpu->mailbox, 0, memory_order_acquire);
+	return 0 != (mail & (1u << rs_halt));
+}
+
+// Run like cpu_run, but without discarding halt signals sent beforehand
+static unsigned int cpu_run_mail(riscv_cpu_t* const cpu, unsigned int cycles) {
+	atomic_store_explicit(&cpu->is_running, 1, memory_order_release);
+	if (NULL != cpu->trace.buffer) trace_sync(cpu);
+	if (NULL != cpu->trace.delta) trace_delta_sync(cpu);
+
+	// signals are only observed between blocks (just a plain load unless one is waiting)
+	unsigned int executed = 0;
+	int halted = 0;
+	cpu->debug.status.reason = rb_none;
+	while (!halted) {
+		if (0 != atomic_load_explicit(&cpu->mailbox, memory_order_relaxed) && cpu_take_mail(cpu)) break;
+
+		size_t budget = (size_t) -1;
+		if (0 != cycles) {
+			if (executed >= cycles) break;
+			budget = cycles - executed;
+		}
+
+		// (a live counters page only needs the run to stop for its updates)
+		if (NULL != cpu->publish.page && budget > cpu->publish.countdown) budget = cpu->publish.countdown;
+		if (0 == cpu->profile.interval && !(cpu->config & rc_cache_on)) {
+			size_t block_executed = CPU_DISPATCH_BLOCK(cpu, budget, &halted);
+			if (NULL != cpu->publish.page) publish_step(cpu, block_executed);
+			executed += (unsigned int) block_executed;
+			continue;
+		}
+
+		// while profiling, stop at every sample point
+		dword block_pc = cpu->pc;
+		if (0 != cpu->profile.interval && budget > cpu->profile.countdown) budget = cpu->profile.countdown;
+		size_t block_executed = CPU_DISPATCH_BLOCK(cpu, budget, &halted);
+		if (0 != cpu->profile.interval) profile_step(cpu, block_pc, block_executed);
+		if (cpu->config & rc_cache_on) cache_fetch(cpu, block_pc, block_executed);
+		if (NULL != cpu->publish.page) publish_step(cpu, block_executed);
+		executed += (unsigned int) block_executed;
+	}
+
+	debug_stopped(cpu);
+	if (NULL != cpu->publish.page) publish_update(cpu, 0);
+	atomic_store_explicit(&cpu->is_running, 0, memory_order_release);
+	return executed;
+}
+
+unsigned int cpu_run(riscv_cpu_t* const cpu, unsigned int cycles) {
+    if (NULL == cpu) return 0;
+
+	// a halt sent while the CPU was stopped has nothing left to stop
+	atomic_fetch_and_explicit(&cpu->mailbox, ~(1u << rs_halt), memory_order_relaxed);
+	return cpu_run_mail(cpu, cycles);
+}
+
+// ---------- Background Runs ----------
 
-    if ((cpu->config & rc_trace_log) != 0) cpu->host.log_trace(cpu->stats.instructions, old_pc, cpu->x);
-    cpu->stats.instructions += 1;
+// Body of the thread started by cpu_run_async
+static void* cpu_async_main(void* arg) {
+	riscv_cpu_t* const cpu = (riscv_cpu_t*) arg;
+	cpu->async_executed = cpu_run_mail(cpu, cpu->async_cycles);
+	return NULL;
+}
+
+int cpu_run_async(riscv_cpu_t* const cpu, unsigned int cycles) {
+	if (NULL == cpu || cpu->async) return 0;
+
+	// the run counts as started (and halts sent from now on stop it) before the thread gets going
+	atomic_fetch_and_explicit(&cpu->mailbox, ~(1u << rs_halt), memory_order_relaxed);
+	atomic_store_explicit(&cpu->is_running, 1, memory_order_release);
+	cpu->async_cycles = cycles;
+	cpu->async_executed = 0;
+	if (0 != pthread_create(&cpu->async_thread, NULL, cpu_async_main, cpu)) {
+		atomic_store_explicit(&cpu->is_running, 0, memory_order_release);
+		return 0;
+	}
 
+	cpu->async = 1;
 	return 1;
 }
+
+unsigned int cpu_wait(riscv_cpu_t* const cpu) {
+	if (NULL == cpu || !cpu->async) return 0;
+
+	pthread_join(cpu->async_thread, NULL);
+	cpu->async = 0;
+	return cpu->async_executed;
+}
@@ -8,6 +8,19 @@
 
 #include "rskapi.h"
 
+// Performance counters (rsk_stats_report_ex) are collected by the call core, so building with RISCV_PERF_COUNTERS leaves out the threaded core and the JIT
+#ifdef RISCV_PERF_COUNTERS
+#undef RISCV_THREADED_CORE
+#ifndef RISCV_NO_JIT
+#define RISCV_NO_JIT
+#endif
+#endif
+
+// The JIT (rc_jit) is only built for x86-64 hosts (define RISCV_NO_JIT to leave it out)
+#if defined(__x86_64__) && defined(__unix__) && !defined(RISCV_NO_JIT)
+#define RISCV_JIT
+#endif
+
 // ---------- CPU Data Structures ----------
 
 // RISC-V bit CPU struct
@@ -15,9 +28,12 @@ typedef struct riscv64_cpu riscv_cpu_t;
 
 // ---------- CPU Methods ----------
 
-// Initialize the CPU with default values and the provided host services
+// Initialize the CPU with default values and the provided host services (allocating a new CPU if <cpu> is NULL)
 riscv_cpu_t* cpu_init(riscv_cpu_t* cpu, const rsk_host_services_t* const services);
 
+// Release a CPU allocated by cpu_init, along with everything it owns
+void cpu_free(riscv_cpu_t* const cpu);
+
 // Return 1 if the CPU is running, 0 otherwise
 int cpu_is_running(const riscv_cpu_t* const cpu);
 
@@ -27,29 +43,35 @@ rsk_config_t cpu_get_config(const riscv_cpu_t* const cpu);
 // Set the CPU's config setting
 void cpu_set_config(riscv_cpu_t* const cpu, rsk_config_t config);
 
+// Serve guest addresses [address, address + length) directly from the host memory at <base>, replacing any regions it overlaps (a NULL <base> only removes them). Stores to a region that isn't <writable> go to the host services. Returns 0 if too many regions are mapped.
+int cpu_map_ram(riscv_cpu_t* const cpu, void* base, dword address, dword length, int writable);
+
+// Discard every cached address translation
+void cpu_flush_tlb(riscv_cpu_t* const cpu);
+
 // Have the CPU load a byte value
-byte cpu_load_byte(const riscv_cpu_t* const cpu, dword address);
+byte cpu_load_byte(riscv_cpu_t* const cpu, dword address);
 
 // Have the CPU store a byte value
-void cpu_store_byte(const riscv_cpu_t* const cpu, dword address, byte value);
+void cpu_store_byte(riscv_cpu_t* const cpu, dword address, byte value);
 
 // Have the CPU load a hword value
-hword cpu_load_hword(const riscv_cpu_t* const cpu, dword address);
+hword cpu_load_hword(riscv_cpu_t* const cpu, dword address);
 
 // Have the CPU store a hword value
-void cpu_store_hword(const riscv_cpu_t* const cpu, dword address, hword value);
+void cpu_store_hword(riscv_cpu_t* const cpu, dword address, hword value);
 
 // Have the CPU load a word value
-word cpu_load_word(const riscv_cpu_t* const cpu, dword address);
+word cpu_load_word(riscv_cpu_t* const cpu, dword address);
 
 // Have the CPU store a word value
-void cpu_store_word(const riscv_cpu_t* const cpu, dword address, word value);
+void cpu_store_word(riscv_cpu_t* const cpu, dword address, word value);
 
 // Have the CPU load a dword value
-dword cpu_load_dword(const riscv_cpu_t* const cpu, dword address);
+dword cpu_load_dword(riscv_cpu_t* const cpu, dword address);
 
 // Have the CPU store a dword value
-void cpu_store_dword(const riscv_cpu_t* const cpu, dword address, dword value);
+void cpu_store_dword(riscv_cpu_t* const cpu, dword address, dword value);
 
 // Get the CPU's pc value
 dword cpu_get_pc(const riscv_cpu_t* const cpu);
@@ -63,6 +85,12 @@ dword cpu_read_register(const riscv_cpu_t* const cpu, byte index);
 // Safely write a value to a register. Calls the host service 'panic' if an illegal access occurs.
 void cpu_write_register(riscv_cpu_t* const cpu, byte index, dword value);
 
+// Copy the pc and registers into <state> (see rsk_state_t). Returns the version of the fields written, or 0 if <state> is too small.
+int cpu_get_state(const riscv_cpu_t* const cpu, rsk_state_t* const state);
+
+// Set the pc and registers from <state> (see rsk_state_t). Returns the version of the fields read, or 0 (changing nothing) if <state> is too small.
+int cpu_set_state(riscv_cpu_t* const cpu, const rsk_state_t* const state);
+
 // Have the CPU process a RISC-V signal
 void cpu_process_signal(riscv_cpu_t* const cpu, rsk_signal_t signal);
 
@@ -78,6 +106,9 @@ void cpu_panic(const riscv_cpu_t* const cpu, const char* message);
 // Have the CPU fill the provided stats struct with its current statistics
 void cpu_fill_stats(const riscv_cpu_t* const cpu, rsk_stat_t* stats);
 
+// Fill the provided extended stats struct (see rsk_stats_ex_t). Returns 0 if the CPU was built without RISCV_PERF_COUNTERS.
+int cpu_fill_stats_ex(const riscv_cpu_t* const cpu, rsk_stats_ex_t* stats);
+
 // Get the number of instructions executed by the cpu since initialization
 unsigned int cpu_stat_instructions(riscv_cpu_t* const cpu);
 
@@ -90,7 +121,85 @@ void cpu_disassemble_instr(riscv_cpu_t* const cpu, char* buffer, size_t buffer_s
 // Disassemble the current instruction
 void cpu_disassemble(riscv_cpu_t* const cpu, char* buffer, size_t buffer_size);
 
+// Report the number of block cache lookups since cpu_init, and how many of them missed (decoding a block)
+void cpu_block_stats(const riscv_cpu_t* const cpu, dword* lookups, dword* decodes);
+
+// Discard every cached block (required after the host modifies code in memory behind the CPU's back)
+void cpu_flush_blocks(riscv_cpu_t* const cpu);
+
+// Discard any cached blocks overlapping the <size> bytes at <address>
+void cpu_invalidate_code(riscv_cpu_t* const cpu, dword address, dword size);
+
 // Execute the instruction at pc and return 0 if ebreak was hit or an error occurred
 int cpu_execute(riscv_cpu_t* const cpu);
 
+// Execute <cycles> instructions (or until ebreak if <cycles> is 0), stopping early at ebreak, an error, or a halt signal. Returns the number of instructions executed.
+unsigned int cpu_run(riscv_cpu_t* const cpu, unsigned int cycles);
+
+// Start cpu_run(cpu, cycles) on a new background thread and return right away. Until cpu_wait returns, the controlling thread may only call cpu_is_running, cpu_process_signal, and cpu_wait. Returns 0 if a background run is already in progress or the thread cannot be started.
+int cpu_run_async(riscv_cpu_t* const cpu, unsigned int cycles);
+
+// Wait for the background run started by cpu_run_async to end, returning the number of instructions it executed (0 if there was none)
+unsigned int cpu_wait(riscv_cpu_t* const cpu);
+
+// Keep a live counters page in the file at <path> up to date, at least every <interval> instructions (0 for the default) and at the end of every run (NULL stops publishing). Returns 0 on failure.
+int cpu_stats_publish(riscv_cpu_t* const cpu, const char* path, dword interval);
+
+// Record the loads and stores that go to the host services into the MMIO log at <path> (NULL stops recording). Returns 0 on failure.
+int cpu_mmio_record(riscv_cpu_t* const cpu, const char* path);
+
+// Answer the loads and check the stores that would go to the host services from the MMIO log at <path>, until one doesn't match (NULL stops replaying). Returns 0 on failure.
+int cpu_mmio_replay(riscv_cpu_t* const cpu, const char* path);
+
+// Fill the provided struct with the progress of the current (or last) replay, returning nonzero if it diverged
+int cpu_mmio_replay_status(const riscv_cpu_t* const cpu, rsk_mmio_status_t* const status);
+
+// Stop runs before they execute the instruction at <address>. Returns 0 if no more breakpoints can be set.
+int cpu_break_set(riscv_cpu_t* const cpu, dword address);
+
+// Remove the breakpoint at <address>, returning 0 if there is none
+int cpu_break_clear(riscv_cpu_t* const cpu, dword address);
+
+// Stop runs right after a load or store (<kind>, an rsk_watch_t) overlapping [<address>, <address> + <length>). Returns 0 if the watchpoint is not valid or no more can be set.
+int cpu_watch_set(riscv_cpu_t* const cpu, dword address, dword length, int kind);
+
+// Remove the watchpoints set for [<address>, <address> + <length>), returning 0 if there are none
+int cpu_watch_clear(riscv_cpu_t* const cpu, dword address, dword length);
+
+// Fill the provided struct with where the last run stopped, returning the reason (rb_none if it didn't stop at a breakpoint or watchpoint)
+int cpu_debug_status(const riscv_cpu_t* const cpu, rsk_debug_status_t* const status);
+
+// Record a binary trace (while rc_trace_binary is set) into a buffer of <size> bytes, handing each full chunk to <sink>. Returns 0 on failure.
+int cpu_trace_sink(riscv_cpu_t* const cpu, rsk_trace_sink_t sink, size_t size);
+
+// Record a binary trace (while rc_trace_binary is set) into a buffer of <size> bytes, writing each full chunk to the file at <path>. Returns 0 on failure.
+int cpu_trace_file(riscv_cpu_t* const cpu, const char* path, size_t size);
+
+// Send the partially filled trace chunk to its destination
+void cpu_trace_flush(riscv_cpu_t* const cpu);
+
+// While rc_trace_log is set, report just the registers each instruction changed to <callback> instead of calling log_trace (NULL goes back to log_trace)
+int cpu_trace_delta(riscv_cpu_t* const cpu, rsk_trace_delta_t callback);
+
+// Start sampling the call stack every <interval> instructions, discarding any earlier samples (0 stops profiling). Returns 0 on failure.
+int cpu_profile_start(riscv_cpu_t* const cpu, dword interval);
+
+// Write the samples taken so far to the file at <path> as collapsed stacks. Returns 0 on failure.
+int cpu_profile_write(const riscv_cpu_t* const cpu, const char* path);
+
+// Save the registers, pc, config, stats, and the contents of every mapped RAM (writable) region to the file at <path>. Returns 0 on failure.
+int cpu_snapshot_save(const riscv_cpu_t* const cpu, const char* path);
+
+// Set the geometry of the I-cache and D-cache models (NULL keeps a cache's geometry), emptying both. Returns 0, changing nothing, if either geometry is invalid or cannot be allocated.
+int cpu_cache_config(riscv_cpu_t* const cpu, const rsk_cache_config_t* const icache, const rsk_cache_config_t* const dcache);
+
+// Fill the provided struct with the counters of the cache models
+void cpu_cache_report(const riscv_cpu_t* const cpu, rsk_cache_stats_t* const stats);
+
+// Create a new CPU in the same state as <parent>, bound to <services> (or the parent's, if NULL). The child's RAM regions are copy-on-write mappings of an image of the parent's RAM, which is shared by every fork made until the parent runs again. Returns NULL on failure.
+riscv_cpu_t* cpu_fork(riscv_cpu_t* const parent, const rsk_host_services_t* const services);
+
+// Restore a snapshot saved by cpu_snapshot_save into the same RAM regions (which must be mapped again first). Returns 0, changing nothing, if the file is unreadable or doesn't match the mapped regions.
+int cpu_snapshot_restore(riscv_cpu_t* const cpu, const char* path);
+
 #endif
\ No newline at end of file
@@ -3,6 +3,11 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "rskapi.h"
 #include "riscv64.h"
@@ -16,6 +21,13 @@
 
 #define DISASM_ASSERT(str_a) cpu_disassemble_instr(cpu, buffer, buffer_size, instr); if (NULL == str_a || 0 != strncmp(str_a, buffer, sizeof(str_a))) { fprintf(stderr, "Disassembly failed\nExpected: '%s'\nResult:   '%s'\n", str_a, buffer); }
 
+#define REG_ASSERT(index, value) if (cpu_read_register(cpu, index) != (dword) (value)) { fprintf(stderr, "Register check failed: x%d = %#lx (expected %#lx)\n", index, cpu_read_register(cpu, index), (dword) (value)); }
+
+#define VALUE_ASSERT(name, actual, expected) { dword z_actual = (dword) (actual); if (z_actual != (dword) (expected)) { fprintf(stderr, "Check failed: %s = %#lx (expected %#lx)\n", name, z_actual, (dword) (expected)); } }
+
+// Write an instruction into test RAM and advance the address
+#define EMIT(addr, instr) test_store_word(addr, instr); addr += 4
+
 // ---------- Preprocessor Bit Mask Construction ----------
 
 #define BITSMASK(high, low) ((__UINT64_MAX__ << (high + 1)) ^ (__UINT64_MAX__ << low))
@@ -43,6 +55,8 @@
 #define INSTR_OPCODE BITSMASK(6, 0)
 #define OPCODE(bits) (0b##bits & INSTR_OPCODE)
 
+#define INSTR_EBREAK (OPCODE(1110011) | RS2(00001))
+
 // ---------- Immediate Encoding Functions ----------
 
 const word itype_immediate(const sword value) {
@@ -50,7 +64,7 @@ const word itype_immediate(const sword value) {
 }
 
 const word stype_immediate(const sword value) {
-    return ((BITSMASK(11, 5) & value) << 20) | ((BITSMASK(4, 0) & value) << 6);
+    return ((BITSMASK(11, 5) & value) << 20) | ((BITSMASK(4, 0) & value) << 7);
 }
 
 const word btype_immediate(const sword value) {
@@ -71,19 +85,222 @@ const word jtype_immediate(const sword value) {
            ((BITSMASK(10, 1) & value) << 20);
 }
 
+// ---------- Test RAM ----------
+
+#define TESTING_RAM_SIZE 0x10000
+
+byte z_test_ram[TESTING_RAM_SIZE];
+
+// Load a little-endian value of <size> bytes from test RAM (addresses wrap around the RAM size)
+dword test_load(dword address, int size) {
+    dword value = 0;
+    for (int i = size - 1; i >= 0; i--) value = (value << 8) | z_test_ram[(address + i) % TESTING_RAM_SIZE];
+    return value;
+}
+
+// Store a little-endian value of <size> bytes to test RAM (addresses wrap around the RAM size)
+void test_store(dword address, dword value, int size) {
+    for (int i = 0; i < size; i++) z_test_ram[(address + i) % TESTING_RAM_SIZE] = (byte) (value >> (8 * i));
+}
+
+void test_store_word(dword address, word value) { test_store(address, value, 4); }
+
+// ---------- Test Trace Sink ----------
+
+#define TESTING_TRACE_SIZE 0x10000
+
+byte z_test_trace[TESTING_TRACE_SIZE];
+size_t z_test_trace_size = 0;
+size_t z_test_trace_chunks = 0;
+
+// Collect binary trace chunks in test memory
+void z_test_trace_sink(const void* chunk, size_t size) {
+    if (size > TESTING_TRACE_SIZE - z_test_trace_size) {
+        fprintf(stderr, "Test trace overflow\n");
+        return;
+    }
+    memcpy(z_test_trace + z_test_trace_size, chunk, size);
+    z_test_trace_size += size;
+    z_test_trace_chunks++;
+}
+
+// Replay the first <limit> records of the collected binary trace (all of them if <limit> is negative) into <registers>, returning the number replayed (or -1 if the chunks are malformed or their steps don't line up)
+long test_trace_replay_steps(dword* registers, long limit) {
+    long records = 0;
+    dword next_step = 0;
+
+    for (size_t at = 0; at < z_test_trace_size;) {
+        rsk_trace_chunk_t chunk;
+        memcpy(&chunk, z_test_trace + at, sizeof(chunk));
+        if (RSK_TRACE_MAGIC != chunk.magic || (records && chunk.first_step != next_step)) return -1;
+        at += sizeof(chunk);
+
+        memcpy(registers, chunk.registers, sizeof(chunk.registers));
+        for (dword r = 0; r < chunk.count; r++) {
+            if (records + (long) r == limit) return limit;
+            word mask;
+            memcpy(&mask, z_test_trace + at + sizeof(dword), sizeof(mask));
+            at += sizeof(dword) + sizeof(mask);
+
+            for (int i = 0; i < 32; i++) {
+                if (0 == (mask & ((word) 1 << i))) continue;
+                memcpy(&registers[i], z_test_trace + at, sizeof(dword));
+                at += sizeof(dword);
+            }
+        }
+
+        records += (long) chunk.count;
+        next_step = chunk.first_step + chunk.count;
+    }
+    return records;
+}
+
+// Replay the whole collected binary trace into <registers>
+long test_trace_replay(dword* registers) {
+    return test_trace_replay_steps(registers, -1);
+}
+
+// ---------- Test Delta Trace ----------
+
+dword z_test_delta_registers[32];
+size_t z_test_delta_calls = 0;
+size_t z_test_delta_changes = 0;
+dword z_test_delta_step = 0;
+
+// Apply each reported change to the test copy of the registers
+void z_test_trace_delta(unsigned step, dword pc, const rsk_reg_delta_t* deltas, size_t count) {
+    for (size_t i = 0; i < count; i++) z_test_delta_registers[deltas[i].index] = deltas[i].value;
+    z_test_delta_calls++;
+    z_test_delta_changes += count;
+    z_test_delta_step = step;
+}
+
+// ---------- Test Instruction Execution ----------
+
+#define TESTING_EXEC_ADDRESS 0x7800
+
+// Register fields of the instructions run by test_exec (x3 = x1 op x2, or x3 = x1 op imm)
+#define EXEC_R(opcode, funct3, funct7) (OPCODE(opcode) | FUNCT3(funct3) | FUNCT7(funct7) | RD(00011) | RS1(00001) | RS2(00010))
+#define EXEC_I(opcode, funct3, imm)    (OPCODE(opcode) | FUNCT3(funct3) | RD(00011) | RS1(00001) | itype_immediate(imm))
+
+// Run <instr> (followed by an ebreak) with x1 = <a>, x2 = <b>, and x3 = 0, returning the value it leaves in x3
+dword test_exec(riscv_cpu_t* const cpu, word instr, dword a, dword b) {
+    // stored through the CPU, so the block of the previous instruction is discarded
+    cpu_store_word(cpu, TESTING_EXEC_ADDRESS, instr);
+    cpu_store_word(cpu, TESTING_EXEC_ADDRESS + 4, INSTR_EBREAK);
+    cpu_write_register(cpu, 1, a);
+    cpu_write_register(cpu, 2, b);
+    cpu_write_register(cpu, 3, 0);
+    cpu_set_pc(cpu, TESTING_EXEC_ADDRESS);
+    cpu_run(cpu, 0);
+    return cpu_read_register(cpu, 3);
+}
+
+#define EXEC_ASSERT(name, instr, a, b, expected) VALUE_ASSERT(name, test_exec(cpu, instr, (dword) (a), (dword) (b)), expected)
+
+// Run the branch with <funct3> comparing x1 = <a> with x2 = <b> (to an ebreak just past the one test_exec places after it), returning 1 if it was taken
+int test_branch(riscv_cpu_t* const cpu, word funct3, dword a, dword b) {
+    cpu_store_word(cpu, TESTING_EXEC_ADDRESS + 8, INSTR_EBREAK);
+    test_exec(cpu, OPCODE(1100011) | funct3 | RS1(00001) | RS2(00010) | btype_immediate(8), a, b);
+    return TESTING_EXEC_ADDRESS + 8 == cpu_get_pc(cpu);
+}
+
+#define BRANCH_ASSERT(name, funct3, a, b, taken) VALUE_ASSERT(name, test_branch(cpu, FUNCT3(funct3), (dword) (a), (dword) (b)), taken)
+
+// ---------- Test Files and Commands ----------
+
+#define TESTING_OUTPUT_SIZE 0x4000
+
+// A loadable segment of a test ELF file: <file_size> bytes of <data> at file offset <offset>, loaded at <address> and zero-filled up to <mem_size>
+typedef struct test_segment {
+    dword address;
+    dword offset;
+    word flags;
+    const void* data;
+    dword file_size;
+    dword mem_size;
+} test_segment_t;
+
+// Write a RISC-V executable of the given segments to <path>, filling the gaps between them with <filler> bytes (returns 0 if the file can't be written)
+int test_write_elf(const char* path, dword entry, const test_segment_t* segments, size_t count, byte filler) {
+    size_t size = 64 + 56 * count;
+    for (size_t i = 0; i < count; i++) {
+        if (segments[i].offset + segments[i].file_size > size) size = segments[i].offset + segments[i].file_size;
+    }
+
+    byte image[TESTING_RAM_SIZE];
+    if (size > sizeof(image)) return 0;
+    memset(image, filler, size);
+
+    // ELF header (64-bit, little-endian, RISC-V executable) followed by the program headers
+    memset(image, 0, 64 + 56 * count);
+    memcpy(image, "\x7f" "ELF\x02\x01\x01", 7);
+    image[16] = 2;
+    image[18] = 0xf3;
+    image[20] = 1;
+    memcpy(image + 24, &entry, 8);
+    dword ph_offset = 64;
+    memcpy(image + 32, &ph_offset, 8);
+    image[52] = 64;
+    image[54] = 56;
+    image[56] = (byte) count;
+
+    for (size_t i = 0; i < count; i++) {
+        byte* ph = image + 64 + 56 * i;
+        word type = 1;
+        memcpy(ph, &type, 4);
+        memcpy(ph + 4, &segments[i].flags, 4);
+        memcpy(ph + 8, &segments[i].offset, 8);
+        memcpy(ph + 16, &segments[i].address, 8);
+        memcpy(ph + 24, &segments[i].address, 8);
+        memcpy(ph + 32, &segments[i].file_size, 8);
+        memcpy(ph + 40, &segments[i].mem_size, 8);
+        memcpy(image + segments[i].offset, segments[i].data, segments[i].file_size);
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (NULL == file) return 0;
+    size_t written = fwrite(image, 1, size, file);
+    return (0 == fclose(file)) && written == size;
+}
+
+// Run a shell <command>, collecting its standard output in <output> (truncated to TESTING_OUTPUT_SIZE), and return its exit status (-1 if it could not be run)
+int test_command(const char* command, char output[TESTING_OUTPUT_SIZE]) {
+    FILE* pipe = popen(command, "r");
+    if (NULL == pipe) return -1;
+
+    size_t size = fread(output, 1, TESTING_OUTPUT_SIZE - 1, pipe);
+    output[size] = '\0';
+    while (fgetc(pipe) != EOF) continue;
+
+    int status = pclose(pipe);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Count the lines of the file at <path> (-1 if it can't be read)
+long test_count_lines(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (NULL == file) return -1;
+
+    long lines = 0;
+    for (int c; EOF != (c = fgetc(file));) lines += ('\n' == c);
+    fclose(file);
+    return lines;
+}
+
 // ---------- Test Services ----------
 
-dword z_test_load_dword(dword address) { return 0; }
-void z_test_store_dword(dword address, dword value) { return; }
+dword z_test_load_dword(dword address) { return test_load(address, 8); }
+void z_test_store_dword(dword address, dword value) { test_store(address, value, 8); }
 
-word z_test_load_word(dword address) { return 0; }
-void z_test_store_word(dword address, word value) { return; }
+word z_test_load_word(dword address) { return (word) test_load(address, 4); }
+void z_test_store_word(dword address, word value) { test_store(address, value, 4); }
 
-hword z_test_load_hword(dword address) { return 0; }
-void z_test_store_hword(dword address, hword value) { return; }
+hword z_test_load_hword(dword address) { return (hword) test_load(address, 2); }
+void z_test_store_hword(dword address, hword value) { test_store(address, value, 2); }
 
-byte z_test_load_byte(dword address) { return 0; }
-void z_test_store_byte(dword address, byte value) { return; }
+byte z_test_load_byte(dword address) { return (byte) test_load(address, 1); }
+void z_test_store_byte(dword address, byte value) { test_store(address, value, 1); }
 
 void z_test_log_trace(unsigned step, dword pc, dword *registers) { return; }
 
@@ -104,4 +321,23 @@ rsk_host_services_t test_services = {
     .panic =           z_test_panic
 };
 
+// Messages logged through quiet_services, which are counted instead of printed (for tests that expect them)
+size_t z_test_quiet_messages = 0;
+
+void z_test_quiet_message(const char *msg) { z_test_quiet_messages++; }
+
+rsk_host_services_t quiet_services = {
+    .mem_load_dword =  z_test_load_dword,
+    .mem_store_dword = z_test_store_dword,
+    .mem_load_word =   z_test_load_word,
+    .mem_store_word =  z_test_store_word,
+    .mem_load_hword =  z_test_load_hword,
+    .mem_store_hword = z_test_store_hword,
+    .mem_load_byte =   z_test_load_byte,
+    .mem_store_byte =  z_test_store_byte,
+    .log_trace =       z_test_log_trace,
+    .log_msg =         z_test_quiet_message,
+    .panic =           z_test_panic
+};
+
 #endif
\ No newline at end of file
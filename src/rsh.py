@@ -5,6 +5,7 @@
 
 import argparse
 import ast
+import bisect
 import csv
 import ctypes
 import hashlib
@@ -86,6 +87,12 @@ MEM_SCALE = {
 # According to the RISC-V spec, EEI's may support misaligned loads/stores
 MEM_REQUIRE_ALIGNMENT = True
 
+# Number of instructions the kernel runs between heartbeats when tracing is off
+RUN_SLICE_CYCLES = 100000
+
+# How often (in seconds) the shell checks on a kernel running on its own thread (starting out 32x as often, for short runs)
+ASYNC_POLL_SECONDS = 0.05
+
 ELF_HEADER = struct.Struct("<4s5B7x2H1I3Q1I6H")
 EH_MAGIC = 0
 EH_CLASS = 1
@@ -112,8 +119,23 @@ PT_LOAD = 1
 
 SECTION_HEADER = struct.Struct("<2I4Q2I2Q")
 SH_NAME = 0
+SH_TYPE = 1
 SH_OFFSET = 4
 SH_SIZE = 5
+SH_LINK = 6
+
+SHT_SYMTAB = 2
+
+SYMBOL = struct.Struct("<IBBHQQ")
+ST_NAME = 0
+ST_INFO = 1
+ST_SHNDX = 3
+ST_VALUE = 4
+ST_SIZE = 5
+
+STT_NOTYPE = 0
+STT_FUNC = 2
+STB_LOCAL = 0
 
 # NOTE: ARM modes were removed without replacement
 
@@ -141,10 +163,22 @@ RC_NOTHING      = 0X00000000
 RC_TRACE_LOG    = 0X00000001
 RC_MPU_ON       = 0X00000002
 RC_CACHE_ON     = 0X00000004
+RC_TRACE_BINARY = 0X00000008
+RC_JIT          = 0X00000010
 
 # Signal enum
 RS_HALT = 0
 
+# Watchpoint kinds (bit flags)
+RW_LOAD   = 1
+RW_STORE  = 2
+RW_ACCESS = RW_LOAD | RW_STORE
+
+# Debug stop reasons
+RB_NONE       = 0
+RB_BREAKPOINT = 1
+RB_WATCHPOINT = 2
+
 # Poor-man's [thread-compatible] atexit alternative
 SHUTDOWN = []
 def shutdown():
@@ -161,11 +195,18 @@ def panic(msg, *args, **kwargs):
     shutdown()
     sys.exit(1)
 
+def miss_rate(misses, total):
+    """Format `misses` out of `total` accesses as a percentage ("n/a" if there were none, e.g. for programs without stores).
+    """
+    return "{0:.2f}%".format((misses / total) * 100) if total else "n/a"
+
 
 class ElfFile(object):
     """Simplistic ELF executable file loader for ARM(EL) binaries.
     """
     def __init__(self, filename):
+        self.filename = filename
+
         # Map the file into memory instead of slurping it into an array
         with open(filename, 'rb') as fd:
             self._raw = mmap.mmap(fd.fileno(), 0, access=mmap.ACCESS_READ)
@@ -220,6 +261,27 @@ class ElfFile(object):
                 chunk += b'\0'*(dst_size - src_size)
             yield (dst_addr, flags, chunk)
 
+    def symbols(self):
+        """Return the defined code/label symbols of the symbol table as a list of (address, size, name, is_func, is_global), sorted by address.
+        """
+        result = []
+        for sh in self._sections:
+            if sh[SH_TYPE] != SHT_SYMTAB:
+                continue
+            strtab = self._sections[sh[SH_LINK]]
+            strtab_data = self._raw[strtab[SH_OFFSET]:strtab[SH_OFFSET] + strtab[SH_SIZE]]
+            symtab_data = self._raw[sh[SH_OFFSET]:sh[SH_OFFSET] + sh[SH_SIZE]]
+            for sym in SYMBOL.iter_unpack(symtab_data):
+                kind = sym[ST_INFO] & 0xf
+                if sym[ST_SHNDX] == 0 or kind not in (STT_NOTYPE, STT_FUNC):
+                    continue
+                name_end = strtab_data.index(b'\0', sym[ST_NAME])
+                name = strtab_data[sym[ST_NAME]:name_end].decode('utf-8')
+                if name:
+                    result.append((sym[ST_VALUE], sym[ST_SIZE], name, kind == STT_FUNC, (sym[ST_INFO] >> 4) != STB_LOCAL))
+        result.sort()
+        return result
+
     def get_section(self, name):
         """Return the raw bytes of a named section (or None if there is no such section).
         """
@@ -234,6 +296,52 @@ class ElfFile(object):
             return self._raw[start:end]
 
 
+class ElfSymbolizer:
+    """Maps guest code addresses to the names of the functions (or labels) containing them.
+    """
+    def __init__(self, elf : ElfFile):
+        symbols = elf.symbols()
+        self._funcs = [(addr, size, name) for addr, size, name, is_func, _ in symbols if is_func and size]
+        # at each address, prefer functions over labels and global labels over local ones
+        labels = {}
+        for addr, _, name, is_func, is_global in symbols:
+            rank = (is_func, is_global)
+            if addr not in labels or rank > labels[addr][0]:
+                labels[addr] = (rank, name)
+        self._label_addrs = sorted(labels)
+        self._label_names = [labels[addr][1] for addr in self._label_addrs]
+        self._func_addrs = [addr for addr, _, _ in self._funcs]
+
+    def name(self, address : int) -> str:
+        """Return the name of the function containing `address` (or the closest label before it, or the address in hex).
+        """
+        i = bisect.bisect_right(self._func_addrs, address) - 1
+        if i >= 0 and address < self._funcs[i][0] + self._funcs[i][1]:
+            return self._funcs[i][2]
+        i = bisect.bisect_right(self._label_addrs, address) - 1
+        if i >= 0:
+            return self._label_names[i]
+        return "{0:#x}".format(address)
+
+    def collapse(self, path : str) -> None:
+        """Rewrite the collapsed stacks written by rsk_profile_write with symbol names (merging stacks that become identical).
+        """
+        stacks = {}
+        with open(path, "rt", encoding="ascii") as fd:
+            for line in fd:
+                frames, _, count = line.rpartition(" ")
+                if not frames:
+                    continue
+                names = [self.name(int(frame, 16)) for frame in frames.split(";")]
+                # consecutive frames in the same function are one frame (e.g. a sample taken right after a call)
+                merged = [n for i, n in enumerate(names) if i == 0 or n != names[i - 1]]
+                key = ";".join(merged)
+                stacks[key] = stacks.get(key, 0) + int(count)
+        with open(path, "wt", encoding="utf8") as fd:
+            for key, count in sorted(stacks.items()):
+                fd.write("{0} {1}\n".format(key, count))
+
+
 class RISCVSimElfCompatScript:
     """A bundle of name=value pair configuration settings that can be embedded in an ELF file.
 
@@ -263,10 +371,10 @@ class RISCVSimElfCompatScript:
     def apply(self, rsk):
         """Apply a compatibiliy setting script to an already-initialized/reset kernel.
         """
+        pc, registers = rsk.state_get()
         for reg, value in self._regs:
-            rsk.reg_set(reg, value)
-        if self._pc is not None:
-            rsk.pc_set(self._pc)
+            registers[reg] = value
+        rsk.state_set(self._pc if self._pc is not None else pc, registers)
 
 
 class rskHostServices(ctypes.Structure):
@@ -339,6 +447,183 @@ class rskHostStats(ctypes.Structure):
     ]
 
 
+RSK_STATE_VERSION = 1
+
+class rskState(ctypes.Structure):
+    """Architectural CPU state copied in/out by rsk_state_get/rsk_state_set (version 1 layout).
+    """
+
+    _fields_ = [
+        ("version", ctypes.c_uint),
+        ("size", ctypes.c_uint),
+        ("pc", ctypes.c_ulong),
+        ("x", ctypes.c_ulong * 32)
+    ]
+
+    def __init__(self):
+        super().__init__(RSK_STATE_VERSION, ctypes.sizeof(rskState))
+
+
+RCP_LRU  = 0
+RCP_PLRU = 1
+
+
+class rskCacheConfig(ctypes.Structure):
+    """Geometry of one cache of the kernel's cache model (see rsk_cache_config).
+    """
+
+    _fields_ = [
+        ("size", ctypes.c_ulong),
+        ("line_size", ctypes.c_ulong),
+        ("ways", ctypes.c_ulong),
+        ("policy", ctypes.c_int)
+    ]
+
+
+class rskCacheStats(ctypes.Structure):
+    """Counters of the kernel's cache model (see rsk_cache_report).
+    """
+
+    _fields_ = [
+        ("fetches", ctypes.c_ulong),
+        ("fetch_misses", ctypes.c_ulong),
+        ("loads", ctypes.c_ulong),
+        ("load_misses", ctypes.c_ulong),
+        ("stores", ctypes.c_ulong),
+        ("store_misses", ctypes.c_ulong)
+    ]
+
+
+class rskMmioEvent(ctypes.Structure):
+    """A load or store that went to the host services, as recorded in an MMIO log (see rsk_mmio_record).
+    """
+
+    _fields_ = [
+        ("step", ctypes.c_ulong),
+        ("address", ctypes.c_ulong),
+        ("value", ctypes.c_ulong),
+        ("size", ctypes.c_uint),
+        ("store", ctypes.c_uint)
+    ]
+
+
+class rskMmioStatus(ctypes.Structure):
+    """Progress of an MMIO replay (see rsk_mmio_replay_status).
+    """
+
+    _fields_ = [
+        ("events", ctypes.c_ulong),
+        ("replayed", ctypes.c_ulong),
+        ("diverged", ctypes.c_int),
+        ("expected", rskMmioEvent),
+        ("actual", rskMmioEvent)
+    ]
+
+
+class rskDebugStatus(ctypes.Structure):
+    """Where the last run stopped (see rsk_debug_status).
+    """
+
+    _fields_ = [
+        ("reason", ctypes.c_int),
+        ("step", ctypes.c_ulong),
+        ("pc", ctypes.c_ulong),
+        ("address", ctypes.c_ulong),
+        ("size", ctypes.c_uint),
+        ("store", ctypes.c_uint)
+    ]
+
+
+class rskRegDelta(ctypes.Structure):
+    """A register changed by an instruction (see rsk_trace_delta).
+    """
+
+    _fields_ = [
+        ("index", ctypes.c_ulong),
+        ("value", ctypes.c_ulong)
+    ]
+
+# void (*rsk_trace_delta_t)(unsigned step, dword pc, const rsk_reg_delta_t* deltas, size_t count);
+TRACE_DELTA_TYPE = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_uint64, ctypes.POINTER(rskRegDelta), ctypes.c_size_t)
+
+RSK_STATS_TYPES_MAX = 128
+RSK_STATS_CALLBACKS = 9
+RSK_STATS_LATENCY_BUCKETS = 32
+RSK_STATS_HOT_MAX = 16
+
+
+class rskStatsType(ctypes.Structure):
+    """Execution counts of one instruction type (see rskStatsEx).
+    """
+
+    _fields_ = [
+        ("name", ctypes.c_char_p),
+        ("executed", ctypes.c_uint64),
+        ("taken", ctypes.c_uint64)
+    ]
+
+
+class rskStatsCallback(ctypes.Structure):
+    """Call count and latency histogram of one host service (see rskStatsEx).
+    """
+
+    _fields_ = [
+        ("name", ctypes.c_char_p),
+        ("calls", ctypes.c_uint64),
+        ("total_ns", ctypes.c_uint64),
+        ("latency", ctypes.c_uint64 * RSK_STATS_LATENCY_BUCKETS)
+    ]
+
+
+class rskStatsHotPc(ctypes.Structure):
+    """Execution count of one instruction address (see rskStatsEx).
+    """
+
+    _fields_ = [
+        ("pc", ctypes.c_uint64),
+        ("executed", ctypes.c_uint64)
+    ]
+
+
+class rskStatsEx(ctypes.Structure):
+    """Extended stats counters published by kernels with the "stats_ex" feature.
+    """
+
+    _fields_ = [
+        ("type_count", ctypes.c_size_t),
+        ("types", rskStatsType * RSK_STATS_TYPES_MAX),
+        ("branches_taken", ctypes.c_uint64),
+        ("branches_not_taken", ctypes.c_uint64),
+        ("callbacks", rskStatsCallback * RSK_STATS_CALLBACKS),
+        ("hot_count", ctypes.c_size_t),
+        ("hot", rskStatsHotPc * RSK_STATS_HOT_MAX),
+        ("hot_dropped", ctypes.c_uint64)
+    ]
+
+    def dump(self, out=sys.stdout) -> None:
+        """Print the counters in a human-readable form.
+        """
+        types = sorted(self.types[:self.type_count], key=lambda t: t.executed, reverse=True)
+        print("Instruction mix:", file=out)
+        for t in types:
+            if t.executed:
+                print("  {0:<8} {1:>14,}  (taken: {2:,})".format(t.name.decode(), t.executed, t.taken), file=out)
+        print("Branches: {0:,} taken, {1:,} not taken".format(self.branches_taken, self.branches_not_taken), file=out)
+
+        print("Host callbacks:{0}".format("" if any(cb.calls for cb in self.callbacks) else " none"), file=out)
+        for cb in self.callbacks:
+            if cb.calls:
+                buckets = ", ".join("<{0}ns: {1:,}".format(1 << (i + 1), n) for i, n in enumerate(cb.latency) if n)
+                print("  {0:<16} {1:>12,} calls, {2:,.1f}ns average ({3})".format(
+                    cb.name.decode(), cb.calls, cb.total_ns / cb.calls, buckets), file=out)
+
+        print("Hot PCs:", file=out)
+        for hot in self.hot[:self.hot_count]:
+            print("  {0:016x} {1:>14,}".format(hot.pc, hot.executed), file=out)
+        if self.hot_dropped:
+            print("  ({0:,} executions at addresses that could not be counted)".format(self.hot_dropped), file=out)
+
+
 class rskMockHost:
     """Fake RISC-V Sim host used for sanity testing mockup simulators.
 
@@ -428,14 +713,21 @@ class RISCVSimShell:
     """
     
     MMIO_BASE = 0x80000000
+
+    # dword (*rsh_mmio_load_t)(dword address) and void (*rsh_mmio_store_t)(dword address, dword value) of the native host
+    MMIO_LOAD_TYPE = ctypes.CFUNCTYPE(ctypes.c_ulong, ctypes.c_ulong)
+    MMIO_STORE_TYPE = ctypes.CFUNCTYPE(None, ctypes.c_ulong, ctypes.c_ulong)
     
-    def __init__(self, mem_size, trace_log=None, debug_log=None, checksum=False, disasm_func=None, register_history=None):
+    def __init__(self, mem_size, trace_log=None, debug_log=None, checksum=False, disasm_func=None, register_history=None, native_host=None):
         """Create an RISC-V Sim host system with <mem_size> bytes of RAM.
         
         If <trace_log> is not None, generate a trace log to that file (STDERR if <trace_log> is '-').
         If <debug_log> is not None, generate a debug log to that file (STDERR if <debug_log> is '-').
 
         If <disasm_func> is non-None, call it to include the disassembly of the instruction executed for each trace log record.
+
+        If <native_host> is non-None, it is the loaded native host library (librsh.so), which then serves the kernel's
+        memory callbacks in C; only MMIO device handlers, trace logs, messages, and panics call back into Python.
         """
         # Ensure sane/legal memory sizes (word-aligned)
         assert (0x1000 <= mem_size < self.MMIO_BASE)
@@ -461,6 +753,7 @@ class RISCVSimShell:
         print(register_history)
         # Used to cache previous register values for log_trace()
         self._register_history = register_history
+        self._trace_delta = None
         
         # Set up host services callbacks
         hs = rskHostServices()
@@ -476,9 +769,24 @@ class RISCVSimShell:
         hs.log_msg = rskHostServices.LOG_MSG_TYPE(self.log_msg)
         hs.panic = rskHostServices.PANIC_TYPE(self.panic)
         self._hs = hs
+
+        # Or have the native host serve memory (it keeps our RAM array, and the callbacks above for everything else)
+        self._native = native_host
+        if native_host:
+            native_host.rsh_host_init.restype = ctypes.POINTER(rskHostServices)
+            native_host.rsh_host_init.argtypes = (ctypes.c_void_p, ctypes.c_ulong, ctypes.c_int,
+                                                  rskHostServices.LOG_TRACE_TYPE, rskHostServices.LOG_MSG_TYPE, rskHostServices.PANIC_TYPE)
+            native_host.rsh_host_mmio.restype = ctypes.c_int
+            native_host.rsh_host_load_elf.restype = ctypes.c_void_p
+            native_host.rsh_host_load_elf.argtypes = (ctypes.c_char_p,)
+            native_host.rsh_host_mmio.argtypes = (ctypes.c_ulong, self.MMIO_LOAD_TYPE, self.MMIO_STORE_TYPE)
+            self._hs = native_host.rsh_host_init(ctypes.addressof(self._ram), mem_size, int(MEM_REQUIRE_ALIGNMENT),
+                                                 hs.log_trace, hs.log_msg, hs.panic).contents
+            self._py_hs = hs  # (keeps the Python callbacks alive)
         
         # Create MMIO and heartbeat registries
         self._mmio = {}
+        self._mmio_callbacks = []
         self._beats = []
     
     # Host Services (callbacks)
@@ -647,6 +955,39 @@ class RISCVSimShell:
                 self._ram[address] = value
 
     def log_trace(self, step : int, pc : int, gprs) -> None:
+        if self._tlog:
+            changes = []
+            for i in range(32):
+                if self._register_history[i] != gprs[i]:
+                    changes.append((i, gprs[i]))
+                    self._register_history[i] = gprs[i]
+            self._log_entry(step, pc, changes)
+
+        self.heartbeat(step)
+
+    def log_trace_delta(self, step : int, pc : int, deltas, count : int) -> None:
+        """Trace callback for rsk_trace_delta: like log_trace, but the kernel only passes on the (index, value) pairs that changed.
+        """
+        if self._tlog:
+            changes = [(deltas[i].index, deltas[i].value) for i in range(count)]
+            if self._register_history is not None:
+                for i, value in changes:
+                    self._register_history[i] = value
+            self._log_entry(step, pc, changes)
+
+        self.heartbeat(step)
+
+    @property
+    def trace_delta_callback(self):
+        """The log_trace_delta callback, ready to hand to RISCVSimKernel.trace_delta.
+        """
+        if self._trace_delta is None:
+            self._trace_delta = TRACE_DELTA_TYPE(self.log_trace_delta)
+        return self._trace_delta
+
+    def _log_entry(self, step : int, pc : int, changes) -> None:
+        """Write the trace log entry for one instruction, given the (index, value) pairs of the registers it changed.
+        """
         if self._tlog:
             # Get checksum
             cksum = self.md5() if self._show_md5 else "-"*32
@@ -658,15 +999,13 @@ class RISCVSimShell:
             col_width = 4
             col = 0
             print("\t\t", end='', file=self._tlog)
-            for i in range(32):
-                if self._register_history[i] != gprs[i]:
-                    print("{0}={1:08x} ".format(i, gprs[i]), end='', file=self._tlog)
+            for i, value in changes:
+                print("{0}={1:08x} ".format(i, value), end='', file=self._tlog)
 
-                    col += 1
-                    if col == col_width:
-                        print('\n\t\t', end='', file=self._tlog)
-                        col = 0
-                    self._register_history[i] = gprs[i]
+                col += 1
+                if col == col_width:
+                    print('\n\t\t', end='', file=self._tlog)
+                    col = 0
             print("\n", end='', file=self._tlog)
             
             # Print dissasembly
@@ -677,9 +1016,6 @@ class RISCVSimShell:
 
             self._tlog.flush()
 
-        for listener in self._beats:
-            listener.heartbeat(step)
-
     def log_msg(self, msg):
         if self._dlog:
             print(msg.decode("ascii"), file=self._dlog)
@@ -691,18 +1027,39 @@ class RISCVSimShell:
     # Public (python-facing) utilities
     ###################################
 
+    def heartbeat(self, step : int) -> None:
+        """Notify all heartbeat listeners that <step> cycles have been reached.
+        """
+        for listener in self._beats:
+            listener.heartbeat(step)
+
+    @property
+    def ram(self):
+        """The ctypes array backing simulated RAM (guest address 0 is its first byte).
+        """
+        return self._ram
+
+    @property
+    def ram_size(self) -> int:
+        return self._ramlen
+
     def register_mmio(self, mmio_offset, on_load=mmio_nop_load, on_store=mmio_nop_store):
         """Register a load/store handler pair for MMIO accesses at MMIO_BASE + <mmio_offset>.
 
         If either (or both!) <on_load> or <on_store> is not provided, no-op defaults are used.
         """
         self._mmio[self.MMIO_BASE + mmio_offset] = (on_load, on_store)
+        if self._native:
+            callbacks = (self.MMIO_LOAD_TYPE(on_load), self.MMIO_STORE_TYPE(on_store))
+            self._mmio_callbacks.append(callbacks)
+            if not self._native.rsh_host_mmio(self.MMIO_BASE + mmio_offset, *callbacks):
+                panic("native host cannot register MMIO at {0:#x}".format(self.MMIO_BASE + mmio_offset))
 
     def register_heartbeat(self, listener):
         """Register a <listener> object with a heartbeat(cycles) method for heartbeat notifications.
 
         When a simulator is running with tracing enabled, all heartbeat listeners will be notified
-        with the current cycle count on each tracing callback.
+        with the current cycle count on each tracing callback (otherwise, after each bounded run slice).
         """
         self._beats.append(listener)
     
@@ -726,6 +1083,14 @@ class RISCVSimShell:
         return hash.hexdigest()
     
     def load_elf(self, obj: ElfFile):
+        # The native host maps the file into new RAM instead (read-only segments are not even copied)
+        if self._native:
+            ram = self._native.rsh_host_load_elf(obj.filename.encode("utf-8"))
+            if ram:
+                self._ram = (ctypes.c_ubyte * self._ramlen).from_address(ram)
+                return
+            print("WARNING: native host could not map {0}; copying it instead...".format(obj.filename))
+
         for addr, _, blob in obj.segments:
             for i, b in enumerate(blob):
                 self._ram[addr + i] = b
@@ -873,6 +1238,46 @@ class RISCVSimConsole:
         self._sink.flush()
 
 
+class RISCVSimDisasmCache:
+    """Memoized instruction disassembly for trace logs (a drop-in `disasm_func` for RISCVSimShell).
+
+    Disassembly is keyed by (address, instruction word), so rewritten code is still disassembled afresh.
+    The first miss in a page of RAM disassembles the whole page with one kernel call.
+    """
+    PAGE_SIZE = 0x1000
+
+    def __init__(self, rsk):
+        self._rsk = rsk
+        self._ram = None
+        self._cache = {}
+
+    def attach(self, ram) -> None:
+        """Prefetch misses from `ram` (a ctypes array holding guest address 0 onwards of the loaded program).
+        """
+        self._ram = ram
+
+    def __call__(self, address: int, instruction: int) -> str:
+        key = (address, instruction)
+        try:
+            return self._cache[key]
+        except KeyError:
+            pass
+
+        if self._ram is not None and address + 4 <= len(self._ram):
+            start = address & ~(self.PAGE_SIZE - 1)
+            count = (min(start + self.PAGE_SIZE, len(self._ram)) - start) // 4
+            base = ctypes.addressof(self._ram) + start
+            texts = self._rsk.disasm_range(start, base, count) or []
+            words = (ctypes.c_uint32 * count).from_address(base)
+            for i, text in enumerate(texts):
+                self._cache[(start + 4*i, words[i])] = text
+
+        text = self._cache.get(key)
+        if text is None:
+            text = self._cache[key] = self._rsk.disasm(address, instruction)
+        return text
+
+
 class RISCVSimKernel:
     """Wrapper/facade class representing a loaded RISC-V Sim kernel implementation.
     
@@ -881,6 +1286,19 @@ class RISCVSimKernel:
     def __init__(self, loaded_library):
         self._dll = loaded_library
         self._has_disasm = True    # disasm is a backwards compatible extension to API version 1.0 (see `info()`)
+        self._has_ram_map = False  # so is ram_map
+        self._has_trace_binary = False  # and trace_binary
+        self._has_stats_ex = False  # and stats_ex
+        self._has_profile = False  # and profile
+        self._has_snapshot = False  # and snapshot
+        self._has_disasm_range = False  # and disasm_range
+        self._has_state = False  # and state
+        self._has_async = False  # and async
+        self._has_cache = False  # and cache
+        self._has_trace_delta = False  # and trace_delta
+        self._has_stats_page = False  # and stats_page
+        self._has_mmio_replay = False  # and mmio_replay
+        self._has_debug = False  # and debug
         
         # rsk_info() -> char ** (NULL terminated list of NUL-terminated C strings)
         self._dll.rsk_info.restype = ctypes.POINTER(ctypes.c_char_p)
@@ -954,6 +1372,108 @@ class RISCVSimKernel:
             self._dll.rsk_disasm.restype = None
             self._dll.rsk_disasm.argtypes = (ctypes.c_ulong, ctypes.c_uint, ctypes.c_char_p, ctypes.c_size_t)
 
+        # "ram_map": the kernel can access RAM directly instead of calling back for every load/store
+        if "ram_map" in info:
+            self._has_ram_map = True
+            self._dll.rsk_ram_map.restype = None
+            self._dll.rsk_ram_map.argtypes = (ctypes.c_void_p, ctypes.c_ulong, ctypes.c_ulong)
+
+        # "state": the kernel can copy pc and all registers in/out in one call
+        if "state" in info:
+            self._has_state = True
+            self._dll.rsk_state_get.restype = ctypes.c_int
+            self._dll.rsk_state_get.argtypes = (ctypes.POINTER(rskState),)
+            self._dll.rsk_state_set.restype = ctypes.c_int
+            self._dll.rsk_state_set.argtypes = (ctypes.POINTER(rskState),)
+
+        # "async": the kernel can run on a thread of its own
+        if "async" in info:
+            self._has_async = True
+            self._dll.rsk_cpu_run_async.restype = ctypes.c_int
+            self._dll.rsk_cpu_run_async.argtypes = (ctypes.c_int,)
+            self._dll.rsk_cpu_wait.restype = ctypes.c_int
+            self._dll.rsk_cpu_wait.argtypes = ()
+
+        # "cache": the kernel models an I-cache and a D-cache (see rc_cache_on)
+        if "cache" in info:
+            self._has_cache = True
+            self._dll.rsk_cache_config.restype = ctypes.c_int
+            self._dll.rsk_cache_config.argtypes = (ctypes.POINTER(rskCacheConfig), ctypes.POINTER(rskCacheConfig))
+            self._dll.rsk_cache_report.restype = None
+            self._dll.rsk_cache_report.argtypes = (ctypes.POINTER(rskCacheStats),)
+
+        # "disasm_range": the kernel can disassemble a whole run of instructions in one call
+        if "disasm_range" in info:
+            self._has_disasm_range = True
+            self._dll.rsk_disasm_range.restype = ctypes.c_size_t
+            self._dll.rsk_disasm_range.argtypes = (ctypes.c_ulong, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_char_p, ctypes.c_size_t)
+
+        # "trace_binary": the kernel can write a compact binary trace log itself (see rc_trace_binary)
+        if "trace_binary" in info:
+            self._has_trace_binary = True
+            self._dll.rsk_trace_file.restype = ctypes.c_int
+            self._dll.rsk_trace_file.argtypes = (ctypes.c_char_p, ctypes.c_size_t)
+            self._dll.rsk_trace_flush.restype = None
+            self._dll.rsk_trace_flush.argtypes = ()
+
+        # "trace_delta": the kernel can pass on just the registers each traced instruction changed
+        if "trace_delta" in info:
+            self._has_trace_delta = True
+            self._dll.rsk_trace_delta.restype = ctypes.c_int
+            self._dll.rsk_trace_delta.argtypes = (TRACE_DELTA_TYPE,)
+
+        # "stats_page": the kernel can keep a live counters page up to date for other processes
+        if "stats_page" in info:
+            self._has_stats_page = True
+            self._dll.rsk_stats_publish.restype = ctypes.c_int
+            self._dll.rsk_stats_publish.argtypes = (ctypes.c_char_p, ctypes.c_ulong)
+
+        # "mmio_replay": the kernel can record the accesses that go to the host services, and replay them without the host
+        if "mmio_replay" in info:
+            self._has_mmio_replay = True
+            self._dll.rsk_mmio_record.restype = ctypes.c_int
+            self._dll.rsk_mmio_record.argtypes = (ctypes.c_char_p,)
+            self._dll.rsk_mmio_replay.restype = ctypes.c_int
+            self._dll.rsk_mmio_replay.argtypes = (ctypes.c_char_p,)
+            self._dll.rsk_mmio_replay_status.restype = ctypes.c_int
+            self._dll.rsk_mmio_replay_status.argtypes = (ctypes.POINTER(rskMmioStatus),)
+
+        # "debug": the kernel can stop runs at breakpoints and watchpoints
+        if "debug" in info:
+            self._has_debug = True
+            self._dll.rsk_break_set.restype = ctypes.c_int
+            self._dll.rsk_break_set.argtypes = (ctypes.c_ulong,)
+            self._dll.rsk_break_clear.restype = ctypes.c_int
+            self._dll.rsk_break_clear.argtypes = (ctypes.c_ulong,)
+            self._dll.rsk_watch_set.restype = ctypes.c_int
+            self._dll.rsk_watch_set.argtypes = (ctypes.c_ulong, ctypes.c_ulong, ctypes.c_int)
+            self._dll.rsk_watch_clear.restype = ctypes.c_int
+            self._dll.rsk_watch_clear.argtypes = (ctypes.c_ulong, ctypes.c_ulong)
+            self._dll.rsk_debug_status.restype = ctypes.c_int
+            self._dll.rsk_debug_status.argtypes = (ctypes.POINTER(rskDebugStatus),)
+
+        # "snapshot": the kernel can save and restore its state (with the mapped RAM)
+        if "snapshot" in info:
+            self._has_snapshot = True
+            self._dll.rsk_snapshot_save.restype = ctypes.c_int
+            self._dll.rsk_snapshot_save.argtypes = (ctypes.c_char_p,)
+            self._dll.rsk_snapshot_restore.restype = ctypes.c_int
+            self._dll.rsk_snapshot_restore.argtypes = (ctypes.c_char_p,)
+
+        # "profile": the kernel can sample the guest call stack
+        if "profile" in info:
+            self._has_profile = True
+            self._dll.rsk_profile_start.restype = ctypes.c_int
+            self._dll.rsk_profile_start.argtypes = (ctypes.c_ulong,)
+            self._dll.rsk_profile_write.restype = ctypes.c_int
+            self._dll.rsk_profile_write.argtypes = (ctypes.c_char_p,)
+
+        # "stats_ex": the kernel was built with extended performance counters
+        if "stats_ex" in info:
+            self._has_stats_ex = True
+            self._dll.rsk_stats_report_ex.restype = ctypes.c_int
+            self._dll.rsk_stats_report_ex.argtypes = (ctypes.POINTER(rskStatsEx),)
+
         return info
 
     def disasm(self, address: int, instruction: int) -> str:
@@ -968,7 +1488,168 @@ class RISCVSimKernel:
         buff = ctypes.create_string_buffer(blen)
         self._dll.rsk_disasm(address, instruction, buff, blen)
         return ctypes.string_at(buff).decode().strip()
+
+    def disasm_range(self, address: int, code: int, count: int) -> list:
+        """Disassembles the `count` instruction words at host address `code` (guest `address` onwards), returning a list of their disassembly.
+
+        Uses a single rsk_disasm_range(...) call [if available!], or else one rsk_disasm(...) call per instruction.
+        If the kernel doesn't implement rsk_disasm(...) either, returns None instead.
+        """
+        if not self._has_disasm:
+            return None
+        if not self._has_disasm_range:
+            return [self.disasm(address + 4*i, ctypes.c_uint32.from_address(code + 4*i).value) for i in range(count)]
+
+        blen = 128
+        buff = ctypes.create_string_buffer(blen * count)
+        self._dll.rsk_disasm_range(address, code, count, buff, blen)
+        return [ctypes.string_at(ctypes.addressof(buff) + blen*i).decode().strip() for i in range(count)]
     
+    def ram_map(self, ram, address : int, length : int) -> bool:
+        """Uses rsk_ram_map(...) [if available!] to let the kernel access `length` bytes of `ram` (a ctypes array) directly at guest `address`.
+
+        Returns False if the kernel doesn't implement rsk_ram_map(...).
+        """
+        if not self._has_ram_map:
+            return False
+        self._dll.rsk_ram_map(ctypes.addressof(ram), address, length)
+        return True
+
+    def trace_file(self, path : str, size : int = 0) -> bool:
+        """Uses rsk_trace_file(...) [if available!] to have the kernel write a binary trace to `path` while RC_TRACE_BINARY is set.
+
+        Returns False if the kernel doesn't implement rsk_trace_file(...) or the file could not be created.
+        """
+        if not self._has_trace_binary:
+            return False
+        return bool(self._dll.rsk_trace_file(path.encode("utf-8"), size))
+
+    def trace_flush(self) -> None:
+        """Uses rsk_trace_flush() [if available!] to write out the rest of the binary trace.
+        """
+        if self._has_trace_binary:
+            self._dll.rsk_trace_flush()
+
+    def trace_delta(self, callback) -> bool:
+        """Uses rsk_trace_delta(...) [if available!] to have RC_TRACE_LOG call `callback` (a TRACE_DELTA_TYPE, which the caller keeps alive) with just the changed registers instead of log_trace.
+
+        Returns False if the kernel doesn't implement rsk_trace_delta(...).
+        """
+        if not self._has_trace_delta:
+            return False
+        return bool(self._dll.rsk_trace_delta(callback))
+
+    def stats_publish(self, path : str, interval : int) -> bool:
+        """Uses rsk_stats_publish(...) [if available!] to keep the live counters page at `path` up to date every `interval` instructions (0 for the kernel's default; a `path` of None stops publishing).
+
+        Returns False if the kernel doesn't implement rsk_stats_publish(...) or the page could not be created.
+        """
+        if not self._has_stats_page:
+            return False
+        return bool(self._dll.rsk_stats_publish(None if path is None else path.encode("utf-8"), interval))
+
+    def mmio_record(self, path : str) -> bool:
+        """Uses rsk_mmio_record(...) [if available!] to log every load and store that reaches the host services to `path` (None stops recording and writes out the log).
+
+        Returns False if the kernel doesn't implement rsk_mmio_record(...) or the log could not be written.
+        """
+        if not self._has_mmio_replay:
+            return False
+        return bool(self._dll.rsk_mmio_record(None if path is None else path.encode("utf-8")))
+
+    def mmio_replay(self, path : str) -> bool:
+        """Uses rsk_mmio_replay(...) [if available!] to answer the loads and check the stores that would reach the host services from the MMIO log at `path` (None stops replaying).
+
+        Returns False if the kernel doesn't implement rsk_mmio_replay(...) or `path` is not an MMIO log.
+        """
+        if not self._has_mmio_replay:
+            return False
+        return bool(self._dll.rsk_mmio_replay(None if path is None else path.encode("utf-8")))
+
+    def mmio_replay_status(self) -> rskMmioStatus:
+        """Calls rsk_mmio_replay_status(...) [if available!] and returns the populated struct.
+
+        If the kernel doesn't implement rsk_mmio_replay_status(...), returns None instead.
+        """
+        if not self._has_mmio_replay:
+            return None
+        status = rskMmioStatus()
+        self._dll.rsk_mmio_replay_status(status)
+        return status
+
+    def break_set(self, address : int) -> bool:
+        """Uses rsk_break_set(...) [if available!] to stop runs before they execute the instruction at `address`.
+
+        Returns False if the kernel doesn't implement rsk_break_set(...) or has no room for another breakpoint.
+        """
+        if not self._has_debug:
+            return False
+        return bool(self._dll.rsk_break_set(address))
+
+    def break_clear(self, address : int) -> bool:
+        """Uses rsk_break_clear(...) [if available!] to remove the breakpoint at `address`.
+        """
+        if not self._has_debug:
+            return False
+        return bool(self._dll.rsk_break_clear(address))
+
+    def watch_set(self, address : int, length : int, kind : int = RW_ACCESS) -> bool:
+        """Uses rsk_watch_set(...) [if available!] to stop runs right after a load and/or store (`kind`, RW_*) overlapping [`address`, `address` + `length`).
+
+        Returns False if the kernel doesn't implement rsk_watch_set(...) or refuses the watchpoint.
+        """
+        if not self._has_debug:
+            return False
+        return bool(self._dll.rsk_watch_set(address, length, kind))
+
+    def watch_clear(self, address : int, length : int) -> bool:
+        """Uses rsk_watch_clear(...) [if available!] to remove the watchpoints set for [`address`, `address` + `length`).
+        """
+        if not self._has_debug:
+            return False
+        return bool(self._dll.rsk_watch_clear(address, length))
+
+    def debug_status(self) -> rskDebugStatus:
+        """Calls rsk_debug_status(...) [if available!] and returns the populated struct.
+
+        If the kernel doesn't implement rsk_debug_status(...), returns None instead.
+        """
+        if not self._has_debug:
+            return None
+        status = rskDebugStatus()
+        self._dll.rsk_debug_status(status)
+        return status
+
+    def snapshot_save(self, path : str) -> bool:
+        """Uses rsk_snapshot_save(...) [if available!] to save the CPU state and mapped RAM to `path`.
+        """
+        if not self._has_snapshot:
+            return False
+        return bool(self._dll.rsk_snapshot_save(path.encode("utf-8")))
+
+    def snapshot_restore(self, path : str) -> bool:
+        """Uses rsk_snapshot_restore(...) [if available!] to restore a snapshot saved by snapshot_save (into the same mapped RAM).
+        """
+        if not self._has_snapshot:
+            return False
+        return bool(self._dll.rsk_snapshot_restore(path.encode("utf-8")))
+
+    def profile_start(self, interval : int) -> bool:
+        """Uses rsk_profile_start(...) [if available!] to sample the guest call stack every `interval` instructions.
+
+        Returns False if the kernel doesn't implement rsk_profile_start(...) or the profile could not be allocated.
+        """
+        if not self._has_profile:
+            return False
+        return bool(self._dll.rsk_profile_start(interval))
+
+    def profile_write(self, path : str) -> bool:
+        """Uses rsk_profile_write(...) [if available!] to save the samples to `path` as collapsed stacks.
+        """
+        if not self._has_profile:
+            return False
+        return bool(self._dll.rsk_profile_write(path.encode("utf-8")))
+
     def init(self, host_services : rskHostServices) -> None:
         """Calls rsk_init(...), passing in a structure of callbacks.
         """
@@ -981,6 +1662,18 @@ class RISCVSimKernel:
         self._dll.rsk_stats_report(stats)
         return stats
     
+    def stats_ex(self) -> rskStatsEx:
+        """Calls rsk_stats_report_ex(...) [if available!] and returns the populated struct.
+
+        If the kernel doesn't implement rsk_stats_report_ex(...), returns None instead.
+        """
+        if not self._has_stats_ex:
+            return None
+        stats = rskStatsEx()
+        if not self._dll.rsk_stats_report_ex(stats):
+            return None
+        return stats
+
     def config_get(self) -> int:
         """Pass-through to rsk_config_get()...
         """
@@ -1010,6 +1703,26 @@ class RISCVSimKernel:
         """Calls rsk_pc_get(value).
         """
         self._dll.rsk_pc_set(value)
+
+    def state_get(self) -> tuple:
+        """Returns (pc, [x0, ..., x31]) with one rsk_state_get(...) call [if available!], or else with rsk_pc_get()/rsk_reg_get(...) calls.
+        """
+        state = rskState()
+        if self._has_state and self._dll.rsk_state_get(ctypes.byref(state)):
+            return state.pc, list(state.x)
+        return self.pc_get(), [self.reg_get(i) for i in range(32)]
+
+    def state_set(self, pc : int, registers : list) -> None:
+        """Sets pc and all 32 `registers` with one rsk_state_set(...) call [if available!], or else with rsk_pc_set()/rsk_reg_set(...) calls.
+        """
+        state = rskState()
+        state.pc = pc
+        state.x[:] = registers
+        if self._has_state and self._dll.rsk_state_set(ctypes.byref(state)):
+            return
+        for i, value in enumerate(registers):
+            self.reg_set(i, value)
+        self.pc_set(pc)
     
     def is_running(self) -> bool:
         """Calls rsk_cpu_running() and returns the result.
@@ -1026,6 +1739,45 @@ class RISCVSimKernel:
         """
         self._dll.rsk_cpu_signal(signal)
 
+    def run_async(self, cycles : int) -> bool:
+        """Uses rsk_cpu_run_async(cycles) [if available!] to start running on a kernel thread, returning right away.
+
+        Returns False if the kernel doesn't implement rsk_cpu_run_async(...) or could not start the thread.
+        """
+        if not self._has_async:
+            return False
+        return bool(self._dll.rsk_cpu_run_async(cycles))
+
+    def wait(self) -> int:
+        """Uses rsk_cpu_wait() [if available!] to wait for the end of a run_async run, returning the number of instructions it executed.
+        """
+        if not self._has_async:
+            return 0
+        return self._dll.rsk_cpu_wait()
+
+
+    def cache_config(self, icache : tuple, dcache : tuple) -> bool:
+        """Uses rsk_cache_config(...) [if available!] to set the geometry of the I-cache and the D-cache.
+
+        Each geometry is a (size, line_size, ways, policy) tuple, or None to leave that cache as it is.
+        Returns False if the kernel doesn't implement rsk_cache_config(...) or refused a geometry.
+        """
+        if not self._has_cache:
+            return False
+        configs = [rskCacheConfig(*geometry) if geometry else None for geometry in (icache, dcache)]
+        return bool(self._dll.rsk_cache_config(*configs))
+
+    def cache_stats(self) -> rskCacheStats:
+        """Calls rsk_cache_report(...) [if available!] and returns the populated struct.
+
+        If the kernel doesn't implement rsk_cache_report(...), returns None instead.
+        """
+        if not self._has_cache:
+            return None
+        stats = rskCacheStats()
+        self._dll.rsk_cache_report(stats)
+        return stats
+
 
 def mockup_tests(rsk : RISCVSimKernel) -> None:
     """Perform a round of mockup testing on a given kernel (starting with init testing).
@@ -1073,6 +1825,15 @@ def mockup_tests(rsk : RISCVSimKernel) -> None:
     if rsk.pc_get() != value:
         panic("Unable to verify that rsk_pc_set/rsk_pc_get work...")
 
+    # Does the batched state access agree with the single register accessors?
+    pc, registers = rsk.state_get()
+    if pc != value or registers != [0] + regvalues:
+        panic("Unable to verify that rsk_state_get works...")
+    rsk.state_set(value ^ 4, registers[::-1])
+    if rsk.pc_get() != value ^ 4 or rsk.reg_get(0) != 0 or rsk.reg_get(1) != registers[30]:
+        panic("Unable to verify that rsk_state_set works...")
+    rsk.state_set(pc, registers)
+
     # How about step counts?
     rsk.run(1)
     if rsk.stats().instructions != 1:
@@ -1094,15 +1855,34 @@ def scaled_size(text : str) -> int:
         else:
             return int(size) * MEM_SCALE[scale]
 
+def cache_geometry(text : str) -> tuple:
+    """Parse a cache geometry given as SIZE[:LINE[:WAYS[:POLICY]]] (e.g. "32k:64:8:plru") into a (size, line_size, ways, policy) tuple.
+    """
+    fields = text.strip().lower().split(":")
+    if len(fields) > 4:
+        raise ValueError(text)
+    policies = {"lru": RCP_LRU, "plru": RCP_PLRU}
+    size = scaled_size(fields[0])
+    line_size = int(fields[1]) if len(fields) > 1 else 64
+    ways = int(fields[2]) if len(fields) > 2 else 4
+    policy = fields[3] if len(fields) > 3 else "lru"
+    if policy not in policies:
+        raise ValueError(policy)
+    return (size, line_size, ways, policies[policy])
+
 # NOTE: ARM FIQ mode was removed without a replacement
 def main(argv) -> None:
     ap = argparse.ArgumentParser()
+    ap.add_argument("-b", "--binary-trace", dest="binary_trace", metavar="FILE", default=None,
+                    help="Have the kernel save a binary trace log to FILE (if supported; convert it with trace2log).")
     ap.add_argument("-c", "--checksum", dest="checksum", action="store_true", default=False,
                     help="Compute and display the RAM checksum with every trace log entry (SLOW).")
     ap.add_argument("-D", "--disasm", dest="disasm", action="store_true", default=False,
                     help="Include ARM instruction disassembly in each trace log record (if kernel supports).")
     ap.add_argument("-d", "--debug-log", dest="debug_log", metavar="FILE", default=None,
                     help="Save debug log messages to FILE (or STDERR if FILE is '-')")
+    ap.add_argument("-H", "--native-host", dest="native_host", metavar="LIBRARY", default=None,
+                    help="Serve RAM and MMIO dispatch from the native host LIBRARY (librsh.so) instead of Python callbacks.")
     ap.add_argument("-i", "--console-input", dest="input_file", metavar="FILE", default=None,
                     help="Take console input from playback FILE instead of host TTY.")
     ap.add_argument("-p", "--pause", dest="pause", action="store_true", default=False,
@@ -1113,8 +1893,36 @@ def main(argv) -> None:
                     help="Save trace log messages to FILE (or STDERR if FILE is '-')")
     ap.add_argument("-k", "--cache", action="store_true", default=False,
                     help="Enable memory cache (if implemented by KERNEL)")
+    ap.add_argument("--icache", dest="icache", metavar="SIZE[:LINE[:WAYS[:lru|plru]]]", type=cache_geometry, default=None,
+                    help="Geometry of the instruction cache modeled by --cache (default: 16k:64:4:lru)")
+    ap.add_argument("--dcache", dest="dcache", metavar="SIZE[:LINE[:WAYS[:lru|plru]]]", type=cache_geometry, default=None,
+                    help="Geometry of the data cache modeled by --cache (default: 16k:64:4:lru)")
+    ap.add_argument("-j", "--jit", action="store_true", default=False,
+                    help="Compile hot code to host machine code (if implemented by KERNEL; has no effect while tracing)")
+    ap.add_argument("-P", "--profile", dest="profile", metavar="FILE", default=None,
+                    help="Sample the guest call stack (if supported) and save it to FILE as collapsed stacks for flamegraph.pl")
+    ap.add_argument("--profile-interval", dest="profile_interval", metavar="N", type=int, default=1000,
+                    help="Instructions between profile samples (default: 1000)")
+    ap.add_argument("--save-snapshot", dest="save_snapshot", metavar="FILE", default=None,
+                    help="Save the CPU state and RAM to FILE (if supported) when the program ends, or after --snapshot-after instructions")
+    ap.add_argument("--snapshot-after", dest="snapshot_after", metavar="N", type=int, default=0,
+                    help="Save the --save-snapshot checkpoint after N instructions, then keep running")
+    ap.add_argument("--restore-snapshot", dest="restore_snapshot", metavar="FILE", default=None,
+                    help="Start from the CPU state and RAM saved in FILE (by a run of the same program with the same --ram)")
     ap.add_argument("-s", "--stats-log", dest="stats_log", metavar="CSV_FILE", default=None,
                     help="Append performance stats to CSV_FILE")
+    ap.add_argument("--stats-page", dest="stats_page", metavar="FILE", default=None,
+                    help="Publish live performance stats in FILE (if supported, e.g. under /dev/shm) for build/statsmon to watch")
+    ap.add_argument("--stats-interval", dest="stats_interval", metavar="N", type=int, default=0,
+                    help="Instructions between --stats-page updates (default: chosen by KERNEL)")
+    ap.add_argument("--record-mmio", dest="record_mmio", metavar="FILE", default=None,
+                    help="Record every MMIO load and store (including console input) to FILE (if supported) for --replay-mmio")
+    ap.add_argument("--replay-mmio", dest="replay_mmio", metavar="FILE", default=None,
+                    help="Replay the MMIO recorded in FILE instead of calling the devices, and report where the run diverges from it")
+    ap.add_argument("--break", dest="breakpoints", metavar="ADDR", action="append", default=[],
+                    help="Stop the run before the instruction at ADDR (if supported; may be repeated)")
+    ap.add_argument("--watch", dest="watchpoints", metavar="ADDR[:LEN]", action="append", default=[],
+                    help="Stop the run right after a load or store touching LEN bytes (default 1) at ADDR (if supported; may be repeated)")
     ap.add_argument("kernel", metavar="KERNEL_BIN",
                     help="Name of/path to loadable RISC-V Sim kernel library.")
     ap.add_argument("module", metavar="RISCV_ELF_BIN", nargs="?",
@@ -1133,7 +1941,8 @@ def main(argv) -> None:
                           trace_log=args.trace_log,
                           debug_log=args.debug_log,
                           checksum=args.checksum,
-                          disasm_func=rsk.disasm if args.disasm else None)
+                          disasm_func=RISCVSimDisasmCache(rsk) if args.disasm else None,
+                          native_host=ctypes.cdll.LoadLibrary(args.native_host) if args.native_host else None)
 
     # If so asked, pause and wait for input at this point
     if args.pause:
@@ -1159,6 +1968,10 @@ def main(argv) -> None:
     # Validate args/features; warn about possibly bad stuff
     if args.cache and ("cache" not in info):
         print("WARNING: --cache specified, but {0} does not implement 'cache'...".format(args.kernel))
+    if "jit" in info:
+        print("JIT: {0}".format("enabled" if args.jit else "available (use --jit)"))
+    elif args.jit:
+        print("WARNING: --jit specified, but {0} does not implement 'jit'...".format(args.kernel))
     if ("usr" in info) and (args.mem_size < 64*1024):
         print("WARNING: {0} supports 'usr' mode; you should probably have at least 64KB of RAM...".format(args.kernel))
 
@@ -1166,6 +1979,8 @@ def main(argv) -> None:
     if args.module:
         elf = ElfFile(args.module)
         shell.load_elf(elf)
+        if args.disasm:
+            shell._disasm_func.attach(shell.ram)
         print("MD5({0}): {1}".format(args.module, shell.md5()))
 
         console = RISCVSimConsole(source=open(args.input_file, "rt", encoding="ascii") if args.input_file else None,
@@ -1173,8 +1988,9 @@ def main(argv) -> None:
         console.attach(shell)
         SHUTDOWN.append(console.close)
 
-        # Initialize the CPU
+        # Initialize the CPU (and hand it RAM, so only MMIO goes through the callbacks)
         rsk.init(shell.host_services)
+        rsk.ram_map(shell.ram, 0, shell.ram_size)
 
         # Set config flags (if any)
         cflags = RC_NOTHING
@@ -1184,30 +2000,134 @@ def main(argv) -> None:
             cflags |= RC_TRACE_LOG
         if args.cache:
             cflags |= RC_CACHE_ON
+        if args.jit and ("jit" in info):
+            cflags |= RC_JIT
+        if args.binary_trace:
+            if rsk.trace_file(args.binary_trace):
+                cflags |= RC_TRACE_BINARY
+            else:
+                print("WARNING: --binary-trace specified, but {0} could not write '{1}'...".format(args.kernel, args.binary_trace))
         rsk.config_set(cflags)
+        if args.cache and (args.icache or args.dcache) and ("cache" in info) and not rsk.cache_config(args.icache, args.dcache):
+            print("WARNING: {0} does not accept the --icache/--dcache geometry; using its default caches...".format(args.kernel))
+        if args.profile and not rsk.profile_start(max(1, args.profile_interval)):
+            print("WARNING: --profile specified, but {0} does not implement 'profile'...".format(args.kernel))
+            args.profile = None
+        if args.stats_page and not rsk.stats_publish(args.stats_page, max(0, args.stats_interval)):
+            print("WARNING: --stats-page specified, but {0} could not publish '{1}'...".format(args.kernel, args.stats_page))
+        if args.record_mmio and not rsk.mmio_record(args.record_mmio):
+            print("WARNING: --record-mmio specified, but {0} could not record to '{1}'...".format(args.kernel, args.record_mmio))
+            args.record_mmio = None
+        if args.replay_mmio and not rsk.mmio_replay(args.replay_mmio):
+            print("WARNING: --replay-mmio specified, but {0} could not replay '{1}'...".format(args.kernel, args.replay_mmio))
+            args.replay_mmio = None
+        for spec in args.breakpoints:
+            try:
+                address = int(spec, 0)
+            except ValueError:
+                address = None
+            if address is None or not rsk.break_set(address):
+                print("WARNING: --break specified, but {0} could not set a breakpoint at '{1}'...".format(args.kernel, spec))
+        for spec in args.watchpoints:
+            try:
+                address, _, length = spec.partition(":")
+                address, length = int(address, 0), int(length, 0) if length else 1
+            except ValueError:
+                address = None
+            if address is None or not rsk.watch_set(address, length, RW_ACCESS):
+                print("WARNING: --watch specified, but {0} could not set a watchpoint at '{1}'...".format(args.kernel, spec))
 
         # Pre-configure processor based on embedded ".riscvsim" section in ELF file (if it exists)
         elf_compat = elf.get_section(".riscvsim")
         if elf_compat:
             script = RISCVSimElfCompatScript(elf_compat, elf.entry)
             script.apply(rsk)
-            shell._register_history = [rsk.reg_get(i) for i in range(32)]
+            shell._register_history = rsk.state_get()[1]
+
+        # Skip ahead to a saved checkpoint (keeping this run's config flags)
+        if args.restore_snapshot:
+            if rsk.snapshot_restore(args.restore_snapshot):
+                rsk.config_set(cflags)
+                shell._register_history = rsk.state_get()[1]
+            else:
+                print("WARNING: could not restore snapshot '{0}'; starting from the beginning...".format(args.restore_snapshot))
+
+        # Have the kernel pass on just the registers each traced instruction changes (starting from the history set up above)
+        if cflags & RC_TRACE_LOG:
+            rsk.trace_delta(shell.trace_delta_callback)
 
         print()
         print("-"*60)
         print()
         shell.flush()
+        first = rsk.stats().instructions
         start = time.perf_counter()
-        rsk.run(0)
+        finished = False
+        if args.save_snapshot and args.snapshot_after:
+            # Run up to the checkpoint (stopping there if the program ends first)
+            finished = rsk.run(args.snapshot_after) != args.snapshot_after
+            if not rsk.snapshot_save(args.save_snapshot):
+                print("WARNING: could not save snapshot to '{0}'...".format(args.save_snapshot))
+        if finished:
+            pass
+        elif cflags & RC_TRACE_LOG:
+            # Heartbeats come from the trace callbacks
+            rsk.run(0)
+        elif rsk.run_async(0):
+            # Untraced runs have no input playback to time, so the kernel can run on its own thread without heartbeats,
+            # while this one just waits (and Ctrl+C halts the guest at its next block)
+            try:
+                poll = ASYNC_POLL_SECONDS / 32
+                while rsk.is_running():
+                    time.sleep(poll)
+                    poll = min(2 * poll, ASYNC_POLL_SECONDS)
+            except KeyboardInterrupt:
+                rsk.signal(RS_HALT)
+                print("\nHalted")
+            rsk.wait()
+        else:
+            # Run in bounded slices so that heartbeat listeners still get serviced
+            while rsk.run(RUN_SLICE_CYCLES) == RUN_SLICE_CYCLES:
+                shell.heartbeat(rsk.stats().instructions)
         stop = time.perf_counter()
+        if args.save_snapshot and not args.snapshot_after:
+            if not rsk.snapshot_save(args.save_snapshot):
+                print("WARNING: could not save snapshot to '{0}'...".format(args.save_snapshot))
+        if cflags & RC_TRACE_BINARY:
+            rsk.trace_flush()
+        if args.record_mmio and not rsk.mmio_record(None):
+            print("WARNING: could not write the MMIO log to '{0}'...".format(args.record_mmio))
+        if args.replay_mmio:
+            status = rsk.mmio_replay_status()
+            if status.diverged:
+                print("MMIO replay diverged at step {0:,} after {1:,} of {2:,} events".format(status.actual.step, status.replayed, status.events))
+            elif status.replayed != status.events:
+                print("MMIO replay ended after {0:,} of {1:,} events".format(status.replayed, status.events))
+            else:
+                print("MMIO replay matched all {0:,} events".format(status.events))
+        if args.breakpoints or args.watchpoints:
+            status = rsk.debug_status()
+            if status is None or RB_NONE == status.reason:
+                pass
+            elif RB_BREAKPOINT == status.reason:
+                print("Stopped at breakpoint {0:#x} after {1:,} instructions".format(status.pc, status.step))
+            else:
+                print("Stopped at step {0:,} (pc {1:#x}) after a {2}-byte {3} at {4:#x}".format(status.step, status.pc, status.size,
+                      "store" if status.store else "load", status.address))
+        if args.profile:
+            if rsk.profile_write(args.profile):
+                ElfSymbolizer(elf).collapse(args.profile)
+            else:
+                print("WARNING: could not write profile to '{0}'...".format(args.profile))
         # Print performance stats
         stats = rsk.stats()
         span = stop - start
+        executed = stats.instructions - first
         try:
-            ips = round(stats.instructions / span, 1)
-            print("{0:,} instructions in {1:.3} seconds ({2:,} IPS)".format(stats.instructions, span, ips))
+            ips = round(executed / span, 1)
+            print("{0:,} instructions in {1:.3} seconds ({2:,} IPS)".format(executed, span, ips))
         except ZeroDivisionError:
-            print("{0:,} instructions in <mumble-mumble> seconds (<mumble-mumble> IPS)".format(stats.instructions))
+            print("{0:,} instructions in <mumble-mumble> seconds (<mumble-mumble> IPS)".format(executed))
 
         # If so requested, log raw performance stats
         if args.stats_log:
@@ -1225,15 +2145,24 @@ def main(argv) -> None:
 
         # If caching was enabled, print cache stats
         if args.cache:
-            print("Loads: {0:,} of which {1:,} missed (miss rate: {2:.2}%)".format(
-                stats.loads, stats.load_misses, (stats.load_misses / stats.loads) * 100))
-            print("Stores: {0:,} of which {1:,} missed (miss rate: {2:.2}%)".format(
-                stats.stores, stats.store_misses, (stats.store_misses / stats.stores) * 100))
+            print("Loads: {0:,} of which {1:,} missed (miss rate: {2})".format(
+                stats.loads, stats.load_misses, miss_rate(stats.load_misses, stats.loads)))
+            print("Stores: {0:,} of which {1:,} missed (miss rate: {2})".format(
+                stats.stores, stats.store_misses, miss_rate(stats.store_misses, stats.stores)))
+            cache_stats = rsk.cache_stats()
+            if cache_stats and cache_stats.fetches:
+                print("Fetches: {0:,} of which {1:,} missed (miss rate: {2})".format(
+                    cache_stats.fetches, cache_stats.fetch_misses, miss_rate(cache_stats.fetch_misses, cache_stats.fetches)))
         else:
             # Otherwise, just show load and store counts
             print("Loads: {0:,}".format(stats.loads))
             print("Stores: {0:,}".format(stats.stores))
 
+        # If the kernel has extended counters, dump them too
+        stats_ex = rsk.stats_ex()
+        if stats_ex:
+            stats_ex.dump()
+
     elif "mockup" in info:
         print("Attribute 'mockup' detected; running mockup sanity checks...")
 
@@ -0,0 +1,176 @@
+/*
+ - Native host services for rsh.py
+ - Same checks and panic messages as the memory callbacks of RISCVSimShell, without a trip through Python for every access
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rsh_host.h"
+#include "rsk_elf.h"
+
+#define HOST_MESSAGE_SIZE 96
+
+// ---------- Host Data Structures ----------
+
+// An MMIO address and its device handlers
+typedef struct rsh_mmio {
+    dword address;
+    rsh_mmio_load_t on_load;
+    rsh_mmio_store_t on_store;
+} rsh_mmio_t;
+
+// The (single) host of this process; kernel callbacks carry no context, so it has to be global like the shell's
+static struct rsh_host {
+    byte* ram;
+    dword ram_size;
+    int require_alignment;
+
+    // Nonzero once the RAM has been replaced by rsh_host_load_elf
+    int mapped;
+
+    rsh_mmio_t mmio[RSH_MMIO_MAX];
+    size_t mmio_count;
+
+    rsk_host_services_t services;
+} host;
+
+// ---------- Helpers ----------
+
+// Format a panic message and hand it to the host's panic callback
+static void host_panic(const char* format, ...) {
+    char message[HOST_MESSAGE_SIZE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    host.services.panic(message);
+}
+
+// Return the MMIO table entry for <address> (NULL if it has none)
+static const rsh_mmio_t* host_find_mmio(dword address) {
+    for (size_t i = 0; i < host.mmio_count; i++) {
+        if (host.mmio[i].address == address) return &host.mmio[i];
+    }
+    return NULL;
+}
+
+// Load <size> bytes (little-endian) from <address>, or panic about the <name> load
+static dword host_load(dword address, size_t size, const char* name) {
+    if (host.require_alignment && (address & (size - 1))) {
+        host_panic("misaligned load %s @ %016lx", name, address);
+        return 0;
+    }
+
+    if (address >= RSH_MMIO_BASE) {
+        const rsh_mmio_t* mmio = host_find_mmio(address);
+        if (NULL == mmio) {
+            host_panic("unimplemented MMIO load %s from %#lx", name, address);
+            return 0;
+        }
+        return (NULL != mmio->on_load) ? mmio->on_load(address) : 0;
+    }
+
+    if (address >= host.ram_size || host.ram_size - address < size) {
+        host_panic("out-of-RAM load %s @ %016lx", name, address);
+        return 0;
+    }
+
+    dword value = 0;
+    for (size_t i = size; i > 0; i--) value = (value << 8) | host.ram[address + i - 1];
+    return value;
+}
+
+// Store the low <size> bytes of <value> (little-endian) to <address>, or panic about the <name> store
+static void host_store(dword address, dword value, size_t size, const char* name) {
+    if (host.require_alignment && (address & (size - 1))) {
+        host_panic("misaligned store %s @ %016lx", name, address);
+        return;
+    }
+
+    if (address >= RSH_MMIO_BASE) {
+        const rsh_mmio_t* mmio = host_find_mmio(address);
+        if (NULL == mmio) {
+            host_panic("unimplemented MMIO store %s to %#lx", name, address);
+            return;
+        }
+        if (NULL != mmio->on_store) mmio->on_store(address, value);
+        return;
+    }
+
+    if (address >= host.ram_size || host.ram_size - address < size) {
+        host_panic("out-of-RAM store %s @ %016lx", name, address);
+        return;
+    }
+
+    for (size_t i = 0; i < size; i++) host.ram[address + i] = (byte) (value >> (8 * i));
+}
+
+// ---------- Host Services ----------
+
+static dword host_load_dword(dword address) { return host_load(address, 8, "dword"); }
+static void host_store_dword(dword address, dword value) { host_store(address, value, 8, "dword"); }
+
+static word host_load_word(dword address) { return (word) host_load(address, 4, "word"); }
+static void host_store_word(dword address, word value) { host_store(address, value, 4, "word"); }
+
+static hword host_load_hword(dword address) { return (hword) host_load(address, 2, "hword"); }
+static void host_store_hword(dword address, hword value) { host_store(address, value, 2, "hword"); }
+
+static byte host_load_byte(dword address) { return (byte) host_load(address, 1, "byte"); }
+static void host_store_byte(dword address, byte value) { host_store(address, value, 1, "byte"); }
+
+// ---------- Host API ----------
+
+const rsk_host_services_t* rsh_host_init(byte* ram, dword ram_size, int require_alignment,
+    void (*log_trace)(unsigned step, dword pc, dword* registers), void (*log_msg)(const char* msg), void (*panic)(const char* msg)) {
+    host.ram = ram;
+    host.ram_size = ram_size;
+    host.require_alignment = require_alignment;
+    host.mapped = 0;
+    host.mmio_count = 0;
+
+    host.services.mem_load_dword  = host_load_dword;
+    host.services.mem_store_dword = host_store_dword;
+    host.services.mem_load_word   = host_load_word;
+    host.services.mem_store_word  = host_store_word;
+    host.services.mem_load_hword  = host_load_hword;
+    host.services.mem_store_hword = host_store_hword;
+    host.services.mem_load_byte   = host_load_byte;
+    host.services.mem_store_byte  = host_store_byte;
+
+    host.services.log_trace = log_trace;
+    host.services.log_msg   = log_msg;
+    host.services.panic     = panic;
+
+    return &host.services;
+}
+
+int rsh_host_mmio(dword address, rsh_mmio_load_t on_load, rsh_mmio_store_t on_store) {
+    if (address < RSH_MMIO_BASE) return 0;
+
+    rsh_mmio_t* mmio = (rsh_mmio_t*) host_find_mmio(address);
+    if (NULL == mmio) {
+        if (RSH_MMIO_MAX == host.mmio_count) return 0;
+        mmio = &host.mmio[host.mmio_count++];
+    }
+
+    mmio->address = address;
+    mmio->on_load = on_load;
+    mmio->on_store = on_store;
+    return 1;
+}
+
+byte* rsh_host_load_elf(const char* filename) {
+    rsk_elf_t elf;
+    if (!elf_open(&elf, filename)) return NULL;
+    byte* ram = elf_map(&elf, host.ram_size);
+    elf_close(&elf);
+    if (NULL == ram) return NULL;
+
+    if (host.mapped) elf_unmap(host.ram, host.ram_size);
+    host.ram = ram;
+    host.mapped = 1;
+    return ram;
+}
@@ -0,0 +1,31 @@
+/*
+ - Native host services for rsh.py
+ - RAM and MMIO dispatch in C, so that kernel callbacks only reach Python for device events
+*/
+
+#ifndef SIM_RSH_HOST
+#define SIM_RSH_HOST
+
+#include "rskapi.h"
+
+// Guest addresses from here on are MMIO (matches RISCVSimShell.MMIO_BASE)
+#define RSH_MMIO_BASE 0x80000000
+
+// Maximum number of MMIO addresses with handlers
+#define RSH_MMIO_MAX 64
+
+// Device handlers for an MMIO address (loads of any size get the same handler, as do stores)
+typedef dword (*rsh_mmio_load_t)(dword address);
+typedef void (*rsh_mmio_store_t)(dword address, dword value);
+
+// Set up the host with <ram_size> bytes of guest RAM at <ram> and an empty MMIO table, passing traces, messages, and panics on to the given callbacks. Returns the host services to hand to rsk_init.
+const rsk_host_services_t* rsh_host_init(byte* ram, dword ram_size, int require_alignment,
+    void (*log_trace)(unsigned step, dword pc, dword* registers), void (*log_msg)(const char* msg), void (*panic)(const char* msg));
+
+// Replace the host's RAM with new RAM of the same size holding the loadable segments of the ELF file <filename>, mapped rather than copied (see elf_map). Returns the new RAM, which is guest address 0 onwards, or NULL (keeping the old RAM) if the file cannot be loaded.
+byte* rsh_host_load_elf(const char* filename);
+
+// Send loads and stores at <address> (which must be an MMIO address) to the given handlers, replacing any handlers it already has (a NULL handler is a no-op). Returns 0 if the address is invalid or the table is full.
+int rsh_host_mmio(dword address, rsh_mmio_load_t on_load, rsh_mmio_store_t on_store);
+
+#endif
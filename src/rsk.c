@@ -7,6 +7,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 // RISC-V Sim Kernel/Shell Interface definition
 #include "rskapi.h"
@@ -20,24 +21,237 @@ const char* const riscv_sim_info[] = {
     "author=jdoug344",
     "api=1.0",
     "disasm",
+    "disasm_range",
+    "state",
+    "ram_map",
+    "multi",
+    "trace_binary",
+    "profile",
+    "snapshot",
+    "fork",
+    "async",
+    "cache",
+    "trace_delta",
+    "stats_page",
+    "mmio_replay",
+    "debug",
+#ifdef RISCV_JIT
+    "jit",
+#endif
+#ifdef RISCV_PERF_COUNTERS
+    "stats_ex",
+#endif
     NULL
 };
 
+// Default instance, used by the handle-less API functions
 riscv_cpu_t* cpu = NULL;
 
-// ---------- API Function Definitions ----------
+// Kernel instances handed out to hosts are CPUs
+#define HANDLE_CPU(handle) ((riscv_cpu_t*) (handle))
 
-const char* const* rsk_info(void) {
-    return riscv_sim_info;
+// ---------- Instance API Function Definitions ----------
+
+rsk_handle_t rsk_create(const rsk_host_services_t* services) {
+    riscv_cpu_t* instance = cpu_init(NULL, services);
+    cpu_log_message(instance, "CPU initialized");
+    return (rsk_handle_t) instance;
 }
 
-void rsk_disasm(dword address, word instruction, char* buffer, size_t size) {
+void rsk_destroy(rsk_handle_t handle) {
+    cpu_free(HANDLE_CPU(handle));
+}
+
+rsk_handle_t rsk_fork_h(rsk_handle_t handle, const rsk_host_services_t* services) {
+    return (rsk_handle_t) cpu_fork(HANDLE_CPU(handle), services);
+}
+
+void rsk_disasm_h(rsk_handle_t handle, dword address, word instruction, char* buffer, size_t size) {
     // add address
     if (size < 22) return;
     snprintf(buffer, size, "%#.16lx   ", address);
 
     // add instruction disassembly
-	cpu_disassemble_instr(cpu, buffer + 21, size - 21, instruction);
+	cpu_disassemble_instr(HANDLE_CPU(handle), buffer + 21, size - 21, instruction);
+}
+
+size_t rsk_disasm_range_h(rsk_handle_t handle, dword address, const void* code, size_t count, char* buffer, size_t stride) {
+    // (rsk_disasm_h writes nothing at all into less than 22 bytes)
+    if (stride < 22) return 0;
+
+    for (size_t i = 0; i < count; i++) {
+        // (the code need not be word aligned in host memory)
+        word instruction;
+        memcpy(&instruction, (const byte*) code + 4 * i, sizeof(instruction));
+        rsk_disasm_h(handle, address + 4 * i, instruction, buffer + i * stride, stride);
+    }
+    return count;
+}
+
+void rsk_init_h(rsk_handle_t handle, const rsk_host_services_t* services) {
+    if (NULL == handle) return;
+    cpu_init(HANDLE_CPU(handle), services);
+    cpu_log_message(HANDLE_CPU(handle), "CPU initialized");
+}
+
+void rsk_config_set_h(rsk_handle_t handle, rsk_config_t flags) {
+    cpu_set_config(HANDLE_CPU(handle), flags);
+}
+
+rsk_config_t rsk_config_get_h(rsk_handle_t handle) {
+    return cpu_get_config(HANDLE_CPU(handle));
+}
+
+void rsk_stats_report_h(rsk_handle_t handle, rsk_stat_t* stats) {
+    cpu_fill_stats(HANDLE_CPU(handle), stats);
+}
+
+dword rsk_reg_get_h(rsk_handle_t handle, int index) {
+    return cpu_read_register(HANDLE_CPU(handle), index);
+}
+
+void rsk_reg_set_h(rsk_handle_t handle, int index, dword value) {
+    cpu_write_register(HANDLE_CPU(handle), index, value);
+}
+
+dword rsk_pc_get_h(rsk_handle_t handle) {
+    return cpu_get_pc(HANDLE_CPU(handle));
+}
+
+void rsk_pc_set_h(rsk_handle_t handle, dword value) {
+    cpu_set_pc(HANDLE_CPU(handle), value);
+}
+
+int rsk_state_get_h(rsk_handle_t handle, rsk_state_t* state) {
+    return cpu_get_state(HANDLE_CPU(handle), state);
+}
+
+int rsk_state_set_h(rsk_handle_t handle, const rsk_state_t* state) {
+    return cpu_set_state(HANDLE_CPU(handle), state);
+}
+
+int rsk_cpu_running_h(rsk_handle_t handle) {
+    return cpu_is_running(HANDLE_CPU(handle));
+}
+
+void rsk_cpu_signal_h(rsk_handle_t handle, rsk_signal_t signal) {
+    cpu_process_signal(HANDLE_CPU(handle), signal);
+}
+
+void rsk_ram_map_h(rsk_handle_t handle, void* base, dword address, dword length) {
+    cpu_map_ram(HANDLE_CPU(handle), base, address, length, 1);
+}
+
+void rsk_rom_map_h(rsk_handle_t handle, const void* base, dword address, dword length) {
+    cpu_map_ram(HANDLE_CPU(handle), (void*) base, address, length, 0);
+}
+
+int rsk_trace_sink_h(rsk_handle_t handle, rsk_trace_sink_t sink, size_t size) {
+    return cpu_trace_sink(HANDLE_CPU(handle), sink, size);
+}
+
+int rsk_trace_file_h(rsk_handle_t handle, const char* path, size_t size) {
+    return cpu_trace_file(HANDLE_CPU(handle), path, size);
+}
+
+void rsk_trace_flush_h(rsk_handle_t handle) {
+    cpu_trace_flush(HANDLE_CPU(handle));
+}
+
+int rsk_trace_delta_h(rsk_handle_t handle, rsk_trace_delta_t callback) {
+    return cpu_trace_delta(HANDLE_CPU(handle), callback);
+}
+
+int rsk_snapshot_save_h(rsk_handle_t handle, const char* path) {
+    return cpu_snapshot_save(HANDLE_CPU(handle), path);
+}
+
+int rsk_snapshot_restore_h(rsk_handle_t handle, const char* path) {
+    return cpu_snapshot_restore(HANDLE_CPU(handle), path);
+}
+
+int rsk_profile_start_h(rsk_handle_t handle, dword interval) {
+    return cpu_profile_start(HANDLE_CPU(handle), interval);
+}
+
+int rsk_profile_write_h(rsk_handle_t handle, const char* path) {
+    return cpu_profile_write(HANDLE_CPU(handle), path);
+}
+
+int rsk_stats_report_ex_h(rsk_handle_t handle, rsk_stats_ex_t* stats) {
+    return cpu_fill_stats_ex(HANDLE_CPU(handle), stats);
+}
+
+int rsk_cache_config_h(rsk_handle_t handle, const rsk_cache_config_t* icache, const rsk_cache_config_t* dcache) {
+    return cpu_cache_config(HANDLE_CPU(handle), icache, dcache);
+}
+
+void rsk_cache_report_h(rsk_handle_t handle, rsk_cache_stats_t* stats) {
+    cpu_cache_report(HANDLE_CPU(handle), stats);
+}
+
+int rsk_cpu_run_h(rsk_handle_t handle, int cycles) {
+    if (cycles < 0) return 0;
+    return (int) cpu_run(HANDLE_CPU(handle), (unsigned int) cycles);
+}
+
+int rsk_cpu_run_async_h(rsk_handle_t handle, int cycles) {
+    if (cycles < 0) return 0;
+    return cpu_run_async(HANDLE_CPU(handle), (unsigned int) cycles);
+}
+
+int rsk_cpu_wait_h(rsk_handle_t handle) {
+    return (int) cpu_wait(HANDLE_CPU(handle));
+}
+
+int rsk_stats_publish_h(rsk_handle_t handle, const char* path, dword interval) {
+    return cpu_stats_publish(HANDLE_CPU(handle), path, interval);
+}
+
+int rsk_mmio_record_h(rsk_handle_t handle, const char* path) {
+    return cpu_mmio_record(HANDLE_CPU(handle), path);
+}
+
+int rsk_mmio_replay_h(rsk_handle_t handle, const char* path) {
+    return cpu_mmio_replay(HANDLE_CPU(handle), path);
+}
+
+int rsk_mmio_replay_status_h(rsk_handle_t handle, rsk_mmio_status_t* status) {
+    return cpu_mmio_replay_status(HANDLE_CPU(handle), status);
+}
+
+int rsk_break_set_h(rsk_handle_t handle, dword address) {
+    return cpu_break_set(HANDLE_CPU(handle), address);
+}
+
+int rsk_break_clear_h(rsk_handle_t handle, dword address) {
+    return cpu_break_clear(HANDLE_CPU(handle), address);
+}
+
+int rsk_watch_set_h(rsk_handle_t handle, dword address, dword length, int kind) {
+    return cpu_watch_set(HANDLE_CPU(handle), address, length, kind);
+}
+
+int rsk_watch_clear_h(rsk_handle_t handle, dword address, dword length) {
+    return cpu_watch_clear(HANDLE_CPU(handle), address, length);
+}
+
+int rsk_debug_status_h(rsk_handle_t handle, rsk_debug_status_t* status) {
+    return cpu_debug_status(HANDLE_CPU(handle), status);
+}
+
+// ---------- API Function Definitions ----------
+
+const char* const* rsk_info(void) {
+    return riscv_sim_info;
+}
+
+void rsk_disasm(dword address, word instruction, char* buffer, size_t size) {
+    rsk_disasm_h((rsk_handle_t) cpu, address, instruction, buffer, size);
+}
+
+size_t rsk_disasm_range(dword address, const void* code, size_t count, char* buffer, size_t stride) {
+    return rsk_disasm_range_h((rsk_handle_t) cpu, address, code, count, buffer, stride);
 }
 
 void rsk_init(const rsk_host_services_t* services) {
@@ -46,44 +260,149 @@ void rsk_init(const rsk_host_services_t* services) {
 }
 
 void rsk_config_set(rsk_config_t flags) {
-    cpu_set_config(cpu, flags);
+    rsk_config_set_h((rsk_handle_t) cpu, flags);
 }
 
 rsk_config_t rsk_config_get(void) {
-    return cpu_get_config(cpu);
+    return rsk_config_get_h((rsk_handle_t) cpu);
 }
 
 void rsk_stats_report(rsk_stat_t* stats) {
-    cpu_fill_stats(cpu, stats);
+    rsk_stats_report_h((rsk_handle_t) cpu, stats);
 }
 
 dword rsk_reg_get(int index) {
-    return cpu_read_register(cpu, index);
+    return rsk_reg_get_h((rsk_handle_t) cpu, index);
 }
 
 void rsk_reg_set(int index, dword value) {
-    cpu_write_register(cpu, index, value);
+    rsk_reg_set_h((rsk_handle_t) cpu, index, value);
 }
 
 dword rsk_pc_get(void) {
-    return cpu_get_pc(cpu);
+    return rsk_pc_get_h((rsk_handle_t) cpu);
 }
 
 void rsk_pc_set(dword value) {
-    cpu_set_pc(cpu, value);
+    rsk_pc_set_h((rsk_handle_t) cpu, value);
+}
+
+int rsk_state_get(rsk_state_t* state) {
+    return rsk_state_get_h((rsk_handle_t) cpu, state);
+}
+
+int rsk_state_set(const rsk_state_t* state) {
+    return rsk_state_set_h((rsk_handle_t) cpu, state);
 }
 
 int rsk_cpu_running(void) {
-    return cpu_is_running(cpu);
+    return rsk_cpu_running_h((rsk_handle_t) cpu);
 }
 
 void rsk_cpu_signal(rsk_signal_t signal) {
-    cpu_process_signal(cpu, signal);
+    rsk_cpu_signal_h((rsk_handle_t) cpu, signal);
+}
+
+void rsk_ram_map(void* base, dword address, dword length) {
+    rsk_ram_map_h((rsk_handle_t) cpu, base, address, length);
+}
+
+void rsk_rom_map(const void* base, dword address, dword length) {
+    rsk_rom_map_h((rsk_handle_t) cpu, base, address, length);
+}
+
+int rsk_trace_sink(rsk_trace_sink_t sink, size_t size) {
+    return rsk_trace_sink_h((rsk_handle_t) cpu, sink, size);
+}
+
+int rsk_trace_file(const char* path, size_t size) {
+    return rsk_trace_file_h((rsk_handle_t) cpu, path, size);
+}
+
+void rsk_trace_flush(void) {
+    rsk_trace_flush_h((rsk_handle_t) cpu);
+}
+
+int rsk_trace_delta(rsk_trace_delta_t callback) {
+    return rsk_trace_delta_h((rsk_handle_t) cpu, callback);
+}
+
+int rsk_snapshot_save(const char* path) {
+    return rsk_snapshot_save_h((rsk_handle_t) cpu, path);
+}
+
+int rsk_snapshot_restore(const char* path) {
+    return rsk_snapshot_restore_h((rsk_handle_t) cpu, path);
+}
+
+rsk_handle_t rsk_fork(const rsk_host_services_t* services) {
+    return rsk_fork_h((rsk_handle_t) cpu, services);
+}
+
+int rsk_profile_start(dword interval) {
+    return rsk_profile_start_h((rsk_handle_t) cpu, interval);
+}
+
+int rsk_profile_write(const char* path) {
+    return rsk_profile_write_h((rsk_handle_t) cpu, path);
+}
+
+int rsk_stats_report_ex(rsk_stats_ex_t* stats) {
+    return rsk_stats_report_ex_h((rsk_handle_t) cpu, stats);
+}
+
+int rsk_cache_config(const rsk_cache_config_t* icache, const rsk_cache_config_t* dcache) {
+    return rsk_cache_config_h((rsk_handle_t) cpu, icache, dcache);
+}
+
+void rsk_cache_report(rsk_cache_stats_t* stats) {
+    rsk_cache_report_h((rsk_handle_t) cpu, stats);
 }
 
 int rsk_cpu_run(int cycles) {
-    unsigned int record = cpu_stat_instructions(cpu);
-	while (cpu_execute(cpu));
-	
-    return cpu_stat_instructions(cpu) - record;
+    return rsk_cpu_run_h((rsk_handle_t) cpu, cycles);
+}
+
+int rsk_cpu_run_async(int cycles) {
+    return rsk_cpu_run_async_h((rsk_handle_t) cpu, cycles);
+}
+
+int rsk_cpu_wait(void) {
+    return rsk_cpu_wait_h((rsk_handle_t) cpu);
+}
+
+int rsk_stats_publish(const char* path, dword interval) {
+    return rsk_stats_publish_h((rsk_handle_t) cpu, path, interval);
+}
+
+int rsk_mmio_record(const char* path) {
+    return rsk_mmio_record_h((rsk_handle_t) cpu, path);
+}
+
+int rsk_mmio_replay(const char* path) {
+    return rsk_mmio_replay_h((rsk_handle_t) cpu, path);
+}
+
+int rsk_mmio_replay_status(rsk_mmio_status_t* status) {
+    return rsk_mmio_replay_status_h((rsk_handle_t) cpu, status);
+}
+
+int rsk_break_set(dword address) {
+    return rsk_break_set_h((rsk_handle_t) cpu, address);
+}
+
+int rsk_break_clear(dword address) {
+    return rsk_break_clear_h((rsk_handle_t) cpu, address);
+}
+
+int rsk_watch_set(dword address, dword length, int kind) {
+    return rsk_watch_set_h((rsk_handle_t) cpu, address, length, kind);
+}
+
+int rsk_watch_clear(dword address, dword length) {
+    return rsk_watch_clear_h((rsk_handle_t) cpu, address, length);
+}
+
+int rsk_debug_status(rsk_debug_status_t* status) {
+    return rsk_debug_status_h((rsk_handle_t) cpu, status);
 }
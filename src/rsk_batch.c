@@ -0,0 +1,484 @@
+/*
+ - RISC-V Sim batch runner
+ - Runs many ELF programs at once, each on its own kernel instance, over a work-stealing thread pool
+*/
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rskapi.h"
+#include "rsk_elf.h"
+#include "md5.h"
+
+// MMIO layout of the host system (matches RISCVSimShell and RISCVSimConsole in rsh.py)
+#define BATCH_MMIO_BASE     0x80000000
+#define BATCH_CONSOLE_WRITE (BATCH_MMIO_BASE + 0)
+#define BATCH_CONSOLE_READ  (BATCH_MMIO_BASE + 4)
+
+// Number of instructions run between checks of the instruction limit
+#define BATCH_SLICE_CYCLES  100000
+
+#define BATCH_MESSAGE_SIZE  160
+
+// ---------- Batch Data Structures ----------
+
+// One program of the batch, along with its results
+typedef struct batch_job {
+    const char* module;
+
+    // guest system
+    rsk_handle_t handle;
+    byte* ram;
+    dword ram_size;
+
+    // console output, collected so that programs running side by side do not interleave
+    char* output;
+    size_t output_size;
+    size_t output_capacity;
+
+    // results
+    int failed;
+    char message[BATCH_MESSAGE_SIZE];
+    dword instructions;
+    double span;
+    rsk_stat_t stats;
+    char ram_md5[MD5_HEX_SIZE];
+    char reg_md5[MD5_HEX_SIZE];
+} batch_job_t;
+
+// Per-worker queue of job indices; the owner pops from the tail, idle workers steal from the head
+typedef struct batch_deque {
+    pthread_mutex_t lock;
+    size_t* jobs;
+    size_t head;
+    size_t tail;
+} batch_deque_t;
+
+// Settings and shared state of a batch run
+typedef struct batch_pool {
+    batch_job_t* jobs;
+    size_t job_count;
+
+    batch_deque_t* deques;
+    size_t worker_count;
+
+    dword ram_size;
+    dword limit;
+} batch_pool_t;
+
+// A worker thread's view of the pool
+typedef struct batch_worker {
+    batch_pool_t* pool;
+    size_t index;
+} batch_worker_t;
+
+// The job running on this thread (host services carry no context, so callbacks find their system through this)
+static _Thread_local batch_job_t* batch_current = NULL;
+
+// ---------- Timing ----------
+
+static double batch_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+// ---------- Host Services ----------
+
+// Record why a job failed (keeping the first reason) and halt its CPU
+static void batch_fail(batch_job_t* job, const char* format, ...) {
+    if (!job->failed) {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(job->message, sizeof(job->message), format, args);
+        va_end(args);
+        job->failed = 1;
+    }
+    if (NULL != job->handle) rsk_cpu_signal_h(job->handle, rs_halt);
+}
+
+// Append a character to the job's console output
+static void batch_console_put(batch_job_t* job, char c) {
+    if (job->output_size == job->output_capacity) {
+        size_t capacity = job->output_capacity ? 2 * job->output_capacity : 256;
+        char* output = (char*) realloc(job->output, capacity);
+        if (NULL == output) {
+            batch_fail(job, "Malloc failure while buffering console output");
+            return;
+        }
+        job->output = output;
+        job->output_capacity = capacity;
+    }
+    job->output[job->output_size++] = c;
+}
+
+// Load <size> bytes from RAM or MMIO
+static dword batch_load(dword address, size_t size) {
+    batch_job_t* job = batch_current;
+
+    if (address >= BATCH_MMIO_BASE) {
+        // the console has no input in batch mode, and its write port reads as zero
+        if (BATCH_CONSOLE_READ == address || BATCH_CONSOLE_WRITE == address) return 0;
+        batch_fail(job, "unimplemented MMIO load from %#lx", address);
+        return 0;
+    }
+
+    if (address >= job->ram_size || size > job->ram_size - address) {
+        batch_fail(job, "out-of-RAM load @ %016lx", address);
+        return 0;
+    }
+
+    dword value = 0;
+    for (size_t i = 0; i < size; i++) value |= (dword) job->ram[address + i] << (8 * i);
+    return value;
+}
+
+// Store <size> bytes to RAM or MMIO
+static void batch_store(dword address, dword value, size_t size) {
+    batch_job_t* job = batch_current;
+
+    if (address >= BATCH_MMIO_BASE) {
+        if (BATCH_CONSOLE_WRITE == address) {
+            batch_console_put(job, (13 == value) ? '\n' : (char) (value & 0xff));
+        } else if (BATCH_CONSOLE_READ != address) {
+            batch_fail(job, "unimplemented MMIO store to %#lx", address);
+        }
+        return;
+    }
+
+    if (address >= job->ram_size || size > job->ram_size - address) {
+        batch_fail(job, "out-of-RAM store @ %016lx", address);
+        return;
+    }
+
+    for (size_t i = 0; i < size; i++) job->ram[address + i] = (byte) (value >> (8 * i));
+}
+
+dword z_batch_load_dword(dword address) { return batch_load(address, 8); }
+void z_batch_store_dword(dword address, dword value) { batch_store(address, value, 8); }
+
+word z_batch_load_word(dword address) { return (word) batch_load(address, 4); }
+void z_batch_store_word(dword address, word value) { batch_store(address, value, 4); }
+
+hword z_batch_load_hword(dword address) { return (hword) batch_load(address, 2); }
+void z_batch_store_hword(dword address, hword value) { batch_store(address, value, 2); }
+
+byte z_batch_load_byte(dword address) { return (byte) batch_load(address, 1); }
+void z_batch_store_byte(dword address, byte value) { batch_store(address, value, 1); }
+
+void z_batch_log_trace(unsigned step, dword pc, dword *registers) { return; }
+
+void z_batch_log_message(const char *msg) { return; }
+void z_batch_panic(const char *msg)       { batch_fail(batch_current, "%s", msg); }
+
+rsk_host_services_t batch_services = {
+    .mem_load_dword =  z_batch_load_dword,
+    .mem_store_dword = z_batch_store_dword,
+    .mem_load_word =   z_batch_load_word,
+    .mem_store_word =  z_batch_store_word,
+    .mem_load_hword =  z_batch_load_hword,
+    .mem_store_hword = z_batch_store_hword,
+    .mem_load_byte =   z_batch_load_byte,
+    .mem_store_byte =  z_batch_store_byte,
+    .log_trace =       z_batch_log_trace,
+    .log_msg =         z_batch_log_message,
+    .panic =           z_batch_panic
+};
+
+// ---------- Running Programs ----------
+
+// Checksum the final register file: x0..x31 followed by pc, each as a little-endian dword
+static void batch_register_md5(rsk_handle_t handle, char hex[MD5_HEX_SIZE]) {
+    byte image[33 * 8];
+    for (int i = 0; i < 33; i++) {
+        dword value = (i < 32) ? rsk_reg_get_h(handle, i) : rsk_pc_get_h(handle);
+        for (int b = 0; b < 8; b++) image[8 * i + b] = (byte) (value >> (8 * b));
+    }
+    md5_hex(image, sizeof(image), hex);
+}
+
+// Load, run, and checksum one program on the calling thread
+static void batch_run_job(const batch_pool_t* pool, batch_job_t* job) {
+    batch_current = job;
+
+    rsk_elf_t elf;
+    if (!elf_open(&elf, job->module)) {
+        batch_fail(job, "cannot load ELF file");
+        return;
+    }
+
+    // programs of the batch share the (read-only) pages of their files instead of each holding a copy
+    rsk_elf_compat_t compat;
+    job->ram_size = pool->ram_size;
+    job->ram = elf_map(&elf, job->ram_size);
+    if (NULL == job->ram) {
+        batch_fail(job, "cannot map segments into %lu bytes of RAM", job->ram_size);
+    } else if (!elf_compat_parse(&elf, &compat)) {
+        batch_fail(job, "malformed .riscvsim section");
+    }
+    elf_close(&elf);
+    if (job->failed) {
+        elf_unmap(job->ram, job->ram_size);
+        job->ram = NULL;
+        return;
+    }
+
+    // the instance gets the RAM directly, so only MMIO goes through the callbacks
+    job->handle = rsk_create(&batch_services);
+    if (NULL == job->handle) {
+        batch_fail(job, "cannot create kernel instance");
+        return;
+    }
+    rsk_ram_map_h(job->handle, job->ram, 0, job->ram_size);
+    rsk_config_set_h(job->handle, rc_nothing);
+    elf_compat_apply(&compat, job->handle);
+
+    double start = batch_seconds();
+    while (!job->failed) {
+        int budget = BATCH_SLICE_CYCLES;
+        if (pool->limit && pool->limit - job->instructions < (dword) budget) budget = (int) (pool->limit - job->instructions);
+
+        int ran = rsk_cpu_run_h(job->handle, budget);
+        job->instructions += (dword) ran;
+        if (ran < budget) break;
+        if (pool->limit && job->instructions >= pool->limit) batch_fail(job, "instruction limit reached");
+    }
+    job->span = batch_seconds() - start;
+
+    rsk_stats_report_h(job->handle, &job->stats);
+    md5_hex(job->ram, job->ram_size, job->ram_md5);
+    batch_register_md5(job->handle, job->reg_md5);
+
+    rsk_destroy(job->handle);
+    job->handle = NULL;
+    elf_unmap(job->ram, job->ram_size);
+    job->ram = NULL;
+}
+
+// ---------- Work-Stealing Pool ----------
+
+// Take the next job from the worker's own queue (returns 0 when it is empty)
+static int batch_pop(batch_deque_t* deque, size_t* job) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        *job = deque->jobs[--deque->tail];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// Take the oldest job from another worker's queue (returns 0 when it is empty)
+static int batch_steal(batch_deque_t* deque, size_t* job) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        *job = deque->jobs[deque->head++];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// Run jobs until every queue is empty (no jobs are added once the pool starts, so an empty sweep means done)
+static void* batch_worker(void* arg) {
+    batch_worker_t* worker = (batch_worker_t*) arg;
+    batch_pool_t* pool = worker->pool;
+
+    for (;;) {
+        size_t job;
+        int found = batch_pop(&pool->deques[worker->index], &job);
+        for (size_t i = 1; !found && i < pool->worker_count; i++) {
+            found = batch_steal(&pool->deques[(worker->index + i) % pool->worker_count], &job);
+        }
+        if (!found) break;
+
+        batch_run_job(pool, &pool->jobs[job]);
+    }
+    return NULL;
+}
+
+// Deal the jobs out round-robin and run the pool to completion (returns 0 if the pool could not be started)
+static int batch_run_pool(batch_pool_t* pool) {
+    pool->deques = (batch_deque_t*) calloc(pool->worker_count, sizeof(batch_deque_t));
+    size_t* slots = (size_t*) calloc(pool->job_count, sizeof(size_t));
+    batch_worker_t* workers = (batch_worker_t*) calloc(pool->worker_count, sizeof(batch_worker_t));
+    pthread_t* threads = (pthread_t*) calloc(pool->worker_count, sizeof(pthread_t));
+    if (NULL == pool->deques || NULL == slots || NULL == workers || NULL == threads) {
+        fprintf(stderr, "Malloc failure while starting workers\n");
+        free(pool->deques);
+        free(slots);
+        free(workers);
+        free(threads);
+        return 0;
+    }
+
+    // each deque owns a slice of the slot array, sized for its share of the jobs
+    size_t offset = 0;
+    for (size_t w = 0; w < pool->worker_count; w++) {
+        batch_deque_t* deque = &pool->deques[w];
+        pthread_mutex_init(&deque->lock, NULL);
+        deque->jobs = slots + offset;
+        offset += (pool->job_count - w + pool->worker_count - 1) / pool->worker_count;
+    }
+    for (size_t j = 0; j < pool->job_count; j++) {
+        batch_deque_t* deque = &pool->deques[j % pool->worker_count];
+        deque->jobs[deque->tail++] = j;
+    }
+
+    // the calling thread is worker 0
+    size_t started = 1;
+    for (size_t w = 0; w < pool->worker_count; w++) {
+        workers[w].pool = pool;
+        workers[w].index = w;
+    }
+    for (size_t w = 1; w < pool->worker_count; w++, started++) {
+        if (0 != pthread_create(&threads[w], NULL, batch_worker, &workers[w])) break;
+    }
+    batch_worker(&workers[0]);
+    for (size_t w = 1; w < started; w++) pthread_join(threads[w], NULL);
+
+    for (size_t w = 0; w < pool->worker_count; w++) {
+        pthread_mutex_destroy(&pool->deques[w].lock);
+    }
+    free(pool->deques);
+    free(slots);
+    free(workers);
+    free(threads);
+    return 1;
+}
+
+// ---------- Command Line ----------
+
+// Parse a memory size like rsh.py's --ram (e.g. "32k", "4mb"), returning 0 if it is invalid
+static dword batch_scaled_size(const char* text) {
+    char* end;
+    unsigned long long size = strtoull(text, &end, 10);
+    if (end == text) return 0;
+
+    dword scale;
+    switch (tolower((unsigned char) *end)) {
+        case 'k': scale = 1024; break;
+        case 'm': scale = 1024 * 1024; break;
+        case 'g': scale = 1024 * 1024 * 1024; break;
+        default: return 0;
+    }
+    end++;
+    if ('b' == tolower((unsigned char) *end)) end++;
+    if ('\0' != *end) return 0;
+    return (dword) size * scale;
+}
+
+static void batch_usage(const char* program) {
+    fprintf(stderr, "usage: %s [-j WORKERS] [-r SIZE] [-n LIMIT] [-s CSV_FILE] [-o] RISCV_ELF_BIN...\n", program);
+    fprintf(stderr, "  -j WORKERS   number of worker threads (default: one per core)\n");
+    fprintf(stderr, "  -r SIZE      size of each program's memory in bytes (k/m/g valid as scale suffixen, default 32k)\n");
+    fprintf(stderr, "  -n LIMIT     fail programs that are still running after LIMIT instructions\n");
+    fprintf(stderr, "  -s CSV_FILE  append performance stats to CSV_FILE (same columns as rsh.py --stats-log)\n");
+    fprintf(stderr, "  -o           print each program's console output after its results\n");
+}
+
+int main(int argc, char** argv) {
+    batch_pool_t pool = { .ram_size = 32 * 1024 };
+    const char* stats_log = NULL;
+    int show_output = 0;
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    pool.worker_count = (cores > 0) ? (size_t) cores : 1;
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "j:r:n:s:oh"))) {
+        switch (opt) {
+            case 'j': pool.worker_count = (size_t) strtoul(optarg, NULL, 10); break;
+            case 'r': pool.ram_size = batch_scaled_size(optarg); break;
+            case 'n': pool.limit = (dword) strtoull(optarg, NULL, 0); break;
+            case 's': stats_log = optarg; break;
+            case 'o': show_output = 1; break;
+            default:
+                batch_usage(argv[0]);
+                return 2;
+        }
+    }
+    if (optind >= argc || 0 == pool.worker_count) {
+        batch_usage(argv[0]);
+        return 2;
+    }
+    if (pool.ram_size < 32 * 1024 || pool.ram_size >= BATCH_MMIO_BASE || (pool.ram_size & 0b11)) {
+        fprintf(stderr, "Memory size must be word-aligned, at least 32KB, and below the MMIO base!\n");
+        return 2;
+    }
+
+    // check core metadata
+    const char* author = NULL;
+    int multi = 0;
+    for (const char* const* info = rsk_info(); NULL != *info; info++) {
+        if (0 == strncmp(*info, "author=", 7)) author = *info + 7;
+        if (0 == strcmp(*info, "multi")) multi = 1;
+    }
+    if (!multi) {
+        fprintf(stderr, "Kernel does not support multiple instances; aborting...\n");
+        return 1;
+    }
+
+    pool.job_count = (size_t) (argc - optind);
+    pool.jobs = (batch_job_t*) calloc(pool.job_count, sizeof(batch_job_t));
+    if (NULL == pool.jobs) {
+        fprintf(stderr, "Malloc failure while reading arguments\n");
+        return 1;
+    }
+    for (size_t j = 0; j < pool.job_count; j++) pool.jobs[j].module = argv[optind + j];
+    if (pool.worker_count > pool.job_count) pool.worker_count = pool.job_count;
+
+    double start = batch_seconds();
+    if (!batch_run_pool(&pool)) return 1;
+    double span = batch_seconds() - start;
+
+    // report in argument order, regardless of which worker finished first
+    FILE* csv = NULL;
+    if (NULL != stats_log && NULL == (csv = fopen(stats_log, "a"))) {
+        fprintf(stderr, "Cannot open %s; stats will not be logged\n", stats_log);
+    }
+
+    int failures = 0;
+    dword total = 0;
+    printf("%-32s %14s %10s %10s  %-32s  %-32s\n", "program", "instructions", "seconds", "MIPS", "MD5(RAM)", "MD5(registers)");
+    for (size_t j = 0; j < pool.job_count; j++) {
+        batch_job_t* job = &pool.jobs[j];
+        double mips = (job->span > 0) ? (double) job->instructions / job->span / 1e6 : 0.0;
+        total += job->instructions;
+
+        if (job->failed && '\0' == job->ram_md5[0]) {
+            printf("%-32s FAILED: %s\n", job->module, job->message);
+        } else {
+            printf("%-32s %14lu %10.4f %10.2f  %s  %s\n", job->module, job->instructions, job->span, mips, job->ram_md5, job->reg_md5);
+            if (job->failed) printf("%-32s FAILED: %s\n", "", job->message);
+        }
+        if (job->failed) failures++;
+
+        if (show_output && job->output_size) {
+            fwrite(job->output, 1, job->output_size, stdout);
+            if ('\n' != job->output[job->output_size - 1]) putchar('\n');
+        }
+
+        // author, module, span, instructions, loads, load_misses, stores, store_misses
+        if (NULL != csv && !job->failed) {
+            fprintf(csv, "%s,%s,%.17g,%u,%u,%u,%u,%u\r\n", author ? author : "", job->module, job->span,
+                    job->stats.instructions, job->stats.loads, job->stats.load_misses, job->stats.stores, job->stats.store_misses);
+        }
+        free(job->output);
+    }
+    if (NULL != csv) fclose(csv);
+
+    printf("%zu programs (%d failed) on %zu workers: %lu instructions in %.3f seconds (%.2f MIPS)\n",
+           pool.job_count, failures, pool.worker_count, total, span, (span > 0) ? (double) total / span / 1e6 : 0.0);
+
+    free(pool.jobs);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,284 @@
+#include "rsk_elf.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---------- ELF Layout ----------
+
+#define EH_SIZE       64
+#define EH_ENTRY      24
+#define EH_PHOFF      32
+#define EH_SHOFF      40
+#define EH_PHENTSIZE  54
+#define EH_PHENTNUM   56
+#define EH_SHENTSIZE  58
+#define EH_SHENTNUM   60
+#define EH_SHSTRNDX   62
+
+#define PH_SIZE       56
+#define PH_TYPE       0
+#define PH_FLAGS      4
+#define PH_OFFSET     8
+#define PH_VADDR      16
+#define PH_FILESZ     32
+#define PH_MEMSZ      40
+
+#define SH_SIZE       64
+#define SH_NAME       0
+#define SH_OFFSET     24
+#define SH_FILESZ     32
+
+#define PT_LOAD       1
+#define PF_W          2
+#define EM_RISCV      0xf3
+
+// Read little-endian fields out of the mapped file
+static hword elf_hword(const byte* p) { return (hword) (p[0] | (p[1] << 8)); }
+static word elf_word(const byte* p) { return (word) elf_hword(p) | ((word) elf_hword(p + 2) << 16); }
+static dword elf_dword(const byte* p) { return (dword) elf_word(p) | ((dword) elf_word(p + 4) << 32); }
+
+// Does [offset, offset + length) lie within the file?
+static int elf_contains(const rsk_elf_t* elf, dword offset, dword length) {
+    return offset <= elf->size && length <= elf->size - offset;
+}
+
+// Index of a register in the ABI/numeric name table (-1 if unknown)
+static int elf_register_index(const char* name) {
+    static const char* const abi_names[32] = {
+        "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+        "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+        "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+        "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+    };
+
+    if (0 == strcmp(name, "fp")) return 8;
+    for (int i = 0; i < 32; i++) {
+        if (0 == strcmp(name, abi_names[i])) return i;
+    }
+
+    if ('x' == name[0] && isdigit((unsigned char) name[1])) {
+        char* end;
+        long index = strtol(name + 1, &end, 10);
+        if ('\0' == *end && index >= 0 && index < 32) return (int) index;
+    }
+    return -1;
+}
+
+// ---------- ELF Functions ----------
+
+int elf_open(rsk_elf_t* elf, const char* filename) {
+    memset(elf, 0, sizeof(*elf));
+    elf->fd = -1;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "%s: cannot open file\n", filename);
+        return 0;
+    }
+
+    // map the file into memory instead of slurping it into an array
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < EH_SIZE) {
+        fprintf(stderr, "%s is *not* an ELF file!\n", filename);
+        close(fd);
+        return 0;
+    }
+    void* raw = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == raw) {
+        fprintf(stderr, "%s: cannot map file\n", filename);
+        close(fd);
+        return 0;
+    }
+    elf->raw = (const byte*) raw;
+    elf->size = (size_t) st.st_size;
+    elf->fd = fd;
+
+    // simple sanity checks
+    const byte* eh = elf->raw;
+    const char* problem = NULL;
+    if (0 != memcmp(eh, "\x7f" "ELF", 4)) problem = "is *not* an ELF file!";
+    else if (2 != eh[4]) problem = "is not a 64-bit ELF file!";
+    else if (1 != eh[5]) problem = "uses big-endian data formatting!";
+    else if (EM_RISCV != elf_hword(eh + 18)) problem = "is not an RISCV binary!";
+    if (NULL != problem) {
+        fprintf(stderr, "%s %s\n", filename, problem);
+        elf_close(elf);
+        return 0;
+    }
+
+    elf->entry = elf_dword(eh + EH_ENTRY);
+
+    // find all loadable program header entries
+    dword ph_offset = elf_dword(eh + EH_PHOFF);
+    hword ph_size = elf_hword(eh + EH_PHENTSIZE);
+    hword ph_count = elf_hword(eh + EH_PHENTNUM);
+    if (ph_count && (ph_size < PH_SIZE || !elf_contains(elf, ph_offset, (dword) ph_size * ph_count))) {
+        fprintf(stderr, "%s has a truncated program header table\n", filename);
+        elf_close(elf);
+        return 0;
+    }
+
+    elf->segments = (rsk_elf_segment_t*) calloc(ph_count ? ph_count : 1, sizeof(rsk_elf_segment_t));
+    if (NULL == elf->segments) {
+        fprintf(stderr, "Malloc failure while loading %s\n", filename);
+        elf_close(elf);
+        return 0;
+    }
+    for (hword i = 0; i < ph_count; i++) {
+        const byte* ph = elf->raw + ph_offset + (dword) i * ph_size;
+        if (PT_LOAD != elf_word(ph + PH_TYPE)) continue;
+
+        dword offset = elf_dword(ph + PH_OFFSET);
+        rsk_elf_segment_t* segment = &elf->segments[elf->segment_count++];
+        segment->address = elf_dword(ph + PH_VADDR);
+        segment->flags = elf_word(ph + PH_FLAGS);
+        segment->file_size = elf_dword(ph + PH_FILESZ);
+        segment->mem_size = elf_dword(ph + PH_MEMSZ);
+        if (!elf_contains(elf, offset, segment->file_size) || segment->mem_size < segment->file_size) {
+            fprintf(stderr, "%s has a truncated segment\n", filename);
+            elf_close(elf);
+            return 0;
+        }
+        segment->data = elf->raw + offset;
+    }
+
+    // find the section-name string table, and the ".riscvsim" section through it
+    dword sh_offset = elf_dword(eh + EH_SHOFF);
+    hword sh_size = elf_hword(eh + EH_SHENTSIZE);
+    hword sh_count = elf_hword(eh + EH_SHENTNUM);
+    hword sh_strndx = elf_hword(eh + EH_SHSTRNDX);
+    if (0 == sh_count || sh_size < SH_SIZE || sh_strndx >= sh_count || !elf_contains(elf, sh_offset, (dword) sh_size * sh_count)) return 1;
+
+    const byte* strtab_sh = elf->raw + sh_offset + (dword) sh_strndx * sh_size;
+    dword strtab_offset = elf_dword(strtab_sh + SH_OFFSET);
+    dword strtab_size = elf_dword(strtab_sh + SH_FILESZ);
+    if (!elf_contains(elf, strtab_offset, strtab_size)) return 1;
+    const char* strtab = (const char*) elf->raw + strtab_offset;
+
+    for (hword i = 0; i < sh_count; i++) {
+        const byte* sh = elf->raw + sh_offset + (dword) i * sh_size;
+        word name = elf_word(sh + SH_NAME);
+        if (name >= strtab_size || NULL == memchr(strtab + name, '\0', strtab_size - name)) continue;
+        if (0 != strcmp(strtab + name, ".riscvsim")) continue;
+
+        dword offset = elf_dword(sh + SH_OFFSET);
+        dword size = elf_dword(sh + SH_FILESZ);
+        if (!elf_contains(elf, offset, size)) break;
+        elf->compat = (const char*) elf->raw + offset;
+        elf->compat_size = size;
+        break;
+    }
+
+    return 1;
+}
+
+void elf_close(rsk_elf_t* elf) {
+    if (NULL == elf) return;
+
+    if (NULL != elf->raw) munmap((void*) elf->raw, elf->size);
+    if (elf->fd >= 0) close(elf->fd);
+    free(elf->segments);
+    memset(elf, 0, sizeof(*elf));
+    elf->fd = -1;
+}
+
+int elf_load(const rsk_elf_t* elf, byte* ram, dword ram_size) {
+    for (size_t i = 0; i < elf->segment_count; i++) {
+        const rsk_elf_segment_t* segment = &elf->segments[i];
+        if (segment->address > ram_size || segment->mem_size > ram_size - segment->address) return 0;
+
+        memcpy(ram + segment->address, segment->data, segment->file_size);
+        memset(ram + segment->address + segment->file_size, 0, segment->mem_size - segment->file_size);
+    }
+    return 1;
+}
+
+byte* elf_map(const rsk_elf_t* elf, dword ram_size) {
+    void* mapped = mmap(NULL, ram_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == mapped) return NULL;
+    byte* ram = (byte*) mapped;
+    dword page = (dword) sysconf(_SC_PAGESIZE);
+
+    for (size_t i = 0; i < elf->segment_count; i++) {
+        const rsk_elf_segment_t* segment = &elf->segments[i];
+        if (segment->address > ram_size || segment->mem_size > ram_size - segment->address) {
+            elf_unmap(ram, ram_size);
+            return NULL;
+        }
+
+        // whole pages of read-only segments laid out in the file like they are in RAM can be mapped straight from it (guest stores still only reach a private copy)
+        dword start = segment->address;
+        dword end = start + segment->file_size;
+        dword offset = (dword) (segment->data - elf->raw);
+        dword first = (start + page - 1) / page * page;
+        dword last = end / page * page;
+        if ((segment->flags & PF_W) || (offset - start) % page || first >= last) {
+            first = last = end;
+        } else if (MAP_FAILED == mmap(ram + first, last - first, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, elf->fd, offset + (first - start))) {
+            elf_unmap(ram, ram_size);
+            return NULL;
+        }
+
+        // the partial pages around them (or the whole segment) are copied, and the zero-filled rest is already zero
+        memcpy(ram + start, segment->data, first - start);
+        memcpy(ram + last, segment->data + (last - start), end - last);
+    }
+    return ram;
+}
+
+void elf_unmap(byte* ram, dword ram_size) {
+    if (NULL != ram) munmap(ram, ram_size);
+}
+
+int elf_compat_parse(const rsk_elf_t* elf, rsk_elf_compat_t* compat) {
+    memset(compat, 0, sizeof(*compat));
+    if (NULL == elf->compat) return 1;
+
+    // the script is a whitespace-separated list of case-insensitive name=value pairs
+    size_t at = 0;
+    while (at < elf->compat_size) {
+        while (at < elf->compat_size && (isspace((unsigned char) elf->compat[at]) || '\0' == elf->compat[at])) at++;
+        size_t start = at;
+        while (at < elf->compat_size && !isspace((unsigned char) elf->compat[at]) && '\0' != elf->compat[at]) at++;
+        if (start == at) break;
+
+        char chunk[64];
+        size_t length = at - start;
+        if (length >= sizeof(chunk)) return 0;
+        for (size_t i = 0; i < length; i++) chunk[i] = (char) tolower((unsigned char) elf->compat[start + i]);
+        chunk[length] = '\0';
+
+        char* value_text = strchr(chunk, '=');
+        if (NULL == value_text) return 0;
+        *value_text++ = '\0';
+
+        dword value;
+        if (0 == strcmp(value_text, "entry")) {
+            value = elf->entry;
+        } else {
+            char* end;
+            value = (dword) strtoull(value_text, &end, 0);
+            if (end == value_text || '\0' != *end) return 0;
+        }
+
+        if (0 == strcmp(chunk, "pc")) {
+            compat->has_pc = 1;
+            compat->pc = value;
+            continue;
+        }
+
+        int reg = elf_register_index(chunk);
+        if (reg < 0 || compat->count >= ELF_COMPAT_MAX) return 0;
+        compat->regs[compat->count] = reg;
+        compat->values[compat->count] = value;
+        compat->count++;
+    }
+
+    return 1;
+}
@@ -0,0 +1,87 @@
+/*
+ - Native ELF loader for RISC-V Sim hosts
+ - Mirrors ElfFile and RISCVSimElfCompatScript from rsh.py
+*/
+
+#ifndef SIM_RSK_ELF
+#define SIM_RSK_ELF
+
+#include <stddef.h>
+
+#include "rskapi.h"
+
+// Maximum number of register assignments in a ".riscvsim" compat script
+#define ELF_COMPAT_MAX 64
+
+// ---------- ELF Data Structures ----------
+
+// A loadable (PT_LOAD) segment of an ELF file
+typedef struct rsk_elf_segment {
+	// Guest address of the segment
+	dword address;
+
+	// Segment flags (PF_R/PF_W/PF_X)
+	word flags;
+
+	// Bytes of the segment stored in the file (the rest, up to mem_size, is zero-filled)
+	const byte* data;
+	dword file_size;
+	dword mem_size;
+} rsk_elf_segment_t;
+
+// A memory-mapped 64-bit little-endian RISC-V ELF executable
+typedef struct rsk_elf {
+	// The whole file, mapped read-only, and kept open for elf_map
+	const byte* raw;
+	size_t size;
+	int fd;
+
+	// Entry point address
+	dword entry;
+
+	// Loadable segments
+	rsk_elf_segment_t* segments;
+	size_t segment_count;
+
+	// Contents of the ".riscvsim" section (NULL if there is none)
+	const char* compat;
+	size_t compat_size;
+} rsk_elf_t;
+
+// Initial CPU state requested by an ELF file's ".riscvsim" section
+typedef struct rsk_elf_compat {
+	size_t count;
+	int regs[ELF_COMPAT_MAX];
+	dword values[ELF_COMPAT_MAX];
+
+	int has_pc;
+	dword pc;
+} rsk_elf_compat_t;
+
+// ---------- ELF Functions ----------
+
+// Map and parse an ELF file (returns 0 and reports why to stderr if it is not a RISC-V executable)
+int elf_open(rsk_elf_t* elf, const char* filename);
+
+// Unmap an ELF file opened by elf_open (RAM made by elf_map stays valid)
+void elf_close(rsk_elf_t* elf);
+
+// Copy every loadable segment into <ram> (returns 0 if a segment does not fit)
+int elf_load(const rsk_elf_t* elf, byte* ram, dword ram_size);
+
+// Create <ram_size> bytes of zeroed RAM holding every loadable segment without copying them: the pages of read-only segments are private mappings of the file, and the rest of the RAM (writable data and .bss included) is anonymous memory only allocated once it is touched. Returns NULL if a segment does not fit or the memory cannot be mapped.
+byte* elf_map(const rsk_elf_t* elf, dword ram_size);
+
+// Release RAM created by elf_map
+void elf_unmap(byte* ram, dword ram_size);
+
+// Parse the ".riscvsim" section of an ELF file, replacing "entry" with its entry point (returns 0 on a malformed script)
+int elf_compat_parse(const rsk_elf_t* elf, rsk_elf_compat_t* compat);
+
+// Apply a parsed compat script to an already-initialized kernel instance (inline, so that the loader itself can be linked into hosts that only load a kernel at run time, like librsh.so)
+static inline void elf_compat_apply(const rsk_elf_compat_t* compat, rsk_handle_t handle) {
+	for (size_t i = 0; i < compat->count; i++) rsk_reg_set_h(handle, compat->regs[i], compat->values[i]);
+	if (compat->has_pc) rsk_pc_set_h(handle, compat->pc);
+}
+
+#endif
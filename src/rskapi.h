@@ -41,7 +41,7 @@ typedef uint64_t dword;
 // A 64 bit signed value
 typedef int64_t sdword;
 
-// What sort of signal are we giving the CPU? (used to control concurrent simulation on a background thread)
+// What sort of signal are we giving the CPU? (used to control concurrent simulation on a background thread; see rsk_cpu_run_async)
 typedef enum rsk_signal {
 	rs_halt,
 } rsk_signal_t;
@@ -52,6 +52,12 @@ typedef enum rsk_config {
 	rc_nothing = 0x00000000,
 	// Require a trace log after every instruction
 	rc_trace_log = 0x00000001,
+	// ["cache"] Simulate the I-cache and D-cache (see rsk_cache_config); load_misses and store_misses then count D-cache misses
+	rc_cache_on = 0x00000004,
+	// ["trace_binary"] Record a binary trace after every instruction (see rsk_trace_sink/rsk_trace_file)
+	rc_trace_binary = 0x00000008,
+	// ["jit"] Compile frequently executed blocks to host machine code (ignored while tracing)
+	rc_jit = 0x00000010,
 } rsk_config_t;
 
 // Structure of function pointers for services provided by the host
@@ -150,6 +156,414 @@ void rsk_cpu_signal(rsk_signal_t signal);
 // Start the CPU running for <cycles> instructions, or until EBREAK if <cycles> is 0. Returns the number of instructions executed, which should match <cycles>, unless <cycles> was 0.
 int rsk_cpu_run(int cycles);
 
+// ------------- Kernel API Extensions ------------- //
+// (backwards-compatible additions to API version 1.0, advertised through rsk_info)
+
+// ["state"] The architectural state of the CPU, copied in or out with a single call. The host sets <version> and <size> to RSK_STATE_VERSION and sizeof(rsk_state_t) as it was compiled; later versions only ever append fields (e.g. floating point registers and CSRs), and kernels only touch the fields of the versions both sides know, so the layout stays compatible in both directions.
+#define RSK_STATE_VERSION 1
+
+typedef struct rsk_state {
+	// Layout of the struct, as set by the host
+	word version;
+	word size;
+
+	// [version 1] Program counter and general purpose registers (x[0] always reads as 0, and writes to it are ignored)
+	dword pc;
+	dword x[32];
+} rsk_state_t;
+
+// ["state"] Copy the architectural state into <state>, whose version and size must already be set. Returns the version of the fields written (at most <version>), or 0 if <state> is too small for any version the kernel knows.
+int rsk_state_get(rsk_state_t* state);
+
+// ["state"] Replace the architectural state with <state>, like rsk_state_get does the reverse. Returns 0 (changing nothing) if <state> is too small for any version the kernel knows.
+int rsk_state_set(const rsk_state_t* state);
+
+// ["disasm_range"] Disassemble the <count> consecutive instruction words at <code> (host memory holding guest address <address> onwards) into <buffer>, one string per instruction every <stride> bytes, each just as rsk_disasm would write it. Returns the number of instructions disassembled (0, writing nothing, if <stride> is too small for rsk_disasm to write any text).
+size_t rsk_disasm_range(dword address, const void* code, size_t count, char* buffer, size_t stride);
+
+// ["ram_map"] Serve guest addresses [<address>, <address> + <length>) directly from the host memory at <base> (which must stay valid until it is unmapped or the CPU is reset). Accesses outside of mapped regions (MMIO) still use the host services. A new region replaces any regions it overlaps, and passing a NULL <base> just removes them; rsk_init removes all regions.
+void rsk_ram_map(void* base, dword address, dword length);
+
+// ["ram_map"] Like rsk_ram_map, but for read-only memory: loads and instruction fetches are served directly, while stores are passed on to the host services
+void rsk_rom_map(const void* base, dword address, dword length);
+
+// ["trace_binary"] Binary trace format: a trace is a sequence of chunks, each made of an rsk_trace_chunk_t header followed by <count> records (all fields little-endian). Every chunk starts with a keyframe of the full register file, so chunks can be decoded independently. A record describes one instruction: its address (dword), a mask of the registers it changed (word, bit i for x<i>), and then the new value of each changed register (dword each, in ascending register order). Records are packed, so their fields are unaligned.
+#define RSK_TRACE_MAGIC 0x4b535254
+#define RSK_TRACE_VERSION 1
+#define RSK_TRACE_DEFAULT_SIZE (1 << 20)
+
+typedef struct rsk_trace_chunk {
+	// RSK_TRACE_MAGIC ("TRSK")
+	word magic;
+
+	// RSK_TRACE_VERSION
+	word version;
+
+	// Step number of the first record (the <step> log_trace would have been called with)
+	dword first_step;
+
+	// Number of records in the chunk
+	dword count;
+
+	// Bytes of record data following the header
+	dword size;
+
+	// Register values before the first record's instruction was executed
+	dword registers[32];
+} rsk_trace_chunk_t;
+
+// Receives one complete chunk (header and records) of a binary trace; the data is only valid during the call
+typedef void (*rsk_trace_sink_t)(const void* chunk, size_t size);
+
+// ["trace_binary"] With rc_trace_binary set, the kernel appends a record for every executed instruction to a buffer of <size> bytes (0 for RSK_TRACE_DEFAULT_SIZE) and hands each full chunk to <sink> (log_trace is then only called if rc_trace_log is set as well). Returns 0 if the buffer cannot be allocated.
+int rsk_trace_sink(rsk_trace_sink_t sink, size_t size);
+
+// ["trace_binary"] Like rsk_trace_sink, but chunks are written straight to the file at <path> (which is truncated). Returns 0 if the file cannot be opened.
+int rsk_trace_file(const char* path, size_t size);
+
+// ["trace_binary"] Hand the partially filled chunk (if any) to the sink or file; call this once a run is complete. rsk_init closes any trace file.
+void rsk_trace_flush(void);
+
+// A register changed by an instruction, and its new value
+typedef struct rsk_reg_delta {
+	dword index;
+	dword value;
+} rsk_reg_delta_t;
+
+// Receives the trace of one instruction (with the <step> and <pc> log_trace would have been called with) as the <count> registers whose values differ from the previous call, in ascending register order; <deltas> is only valid during the call
+typedef void (*rsk_trace_delta_t)(unsigned step, dword pc, const rsk_reg_delta_t* deltas, size_t count);
+
+// ["trace_delta"] While rc_trace_log is set, call <callback> after every instruction instead of log_trace, so that only the changed registers are passed on (NULL goes back to log_trace). Changes are relative to the registers at the time of the call; registers the host changes between runs are reported along with the next instruction. rsk_init goes back to log_trace. Returns 1.
+int rsk_trace_delta(rsk_trace_delta_t callback);
+
+// ["snapshot"] Save the CPU state (registers, pc, config flags, and stats) along with the contents of all RAM mapped by rsk_ram_map to the file at <path>. RAM pages that hold only zeros are left out, so snapshots of mostly unused RAM stay small. Memory that is only reachable through the host services is not saved. Returns 0 if the file cannot be written.
+int rsk_snapshot_save(const char* path);
+
+// ["snapshot"] Restore a snapshot saved by rsk_snapshot_save. The same RAM regions (same guest addresses and lengths) must already be mapped with rsk_ram_map; their contents are replaced. Returns 0, leaving the CPU and RAM unchanged, if the file cannot be read or does not match the mapped RAM.
+int rsk_snapshot_restore(const char* path);
+
+// ["profile"] Sample the guest call stack every <interval> instructions (0 stops profiling), discarding any earlier samples; rsk_init stops profiling. Calls and returns are recognized by the link register convention (jal/jalr writing ra or t0, and jalr through one of them without linking). Returns 0 if the profile cannot be allocated.
+int rsk_profile_start(dword interval);
+
+// ["profile"] Write the samples taken so far to the file at <path> (which is truncated) as collapsed stacks, the input format of flamegraph.pl: one line per distinct stack, with its frames separated by ';' and followed by a space and the number of samples. The frames are the addresses of the calls that had not returned yet, outermost first, and then the sampled pc. Returns 0 if the file cannot be written.
+int rsk_profile_write(const char* path);
+
+// ["stats_ex"] Extended counters, only collected by kernels built with RISCV_PERF_COUNTERS (they cost nothing otherwise)
+#define RSK_STATS_TYPES_MAX 128
+#define RSK_STATS_CALLBACKS 9
+#define RSK_STATS_LATENCY_BUCKETS 32
+#define RSK_STATS_HOT_MAX 16
+
+// Execution counts of one instruction type
+typedef struct rsk_stats_type {
+	// Instruction name (e.g. "addi")
+	const char* name;
+
+	// Number of instructions of this type executed
+	dword executed;
+
+	// Number of them that changed the pc (taken branches and jumps)
+	dword taken;
+} rsk_stats_type_t;
+
+// Calls made to one host service
+typedef struct rsk_stats_callback {
+	// Name of the rsk_host_services_t field (e.g. "mem_load_word")
+	const char* name;
+
+	// Number of calls, and the total time spent in them
+	dword calls;
+	dword total_ns;
+
+	// Latency histogram: bucket i counts the calls that took [2^i, 2^(i+1)) nanoseconds (bucket 0 also counts calls under 1ns)
+	dword latency[RSK_STATS_LATENCY_BUCKETS];
+} rsk_stats_callback_t;
+
+// Execution count of one instruction address
+typedef struct rsk_stats_hot_pc {
+	dword pc;
+	dword executed;
+} rsk_stats_hot_pc_t;
+
+// Structure of extended event counters (everything counts from rsk_init)
+typedef struct rsk_stats_ex {
+	// Every registered instruction type, in registry order
+	size_t type_count;
+	rsk_stats_type_t types[RSK_STATS_TYPES_MAX];
+
+	// Conditional branches taken and not taken
+	dword branches_taken;
+	dword branches_not_taken;
+
+	// Host services called while executing (instruction fetches and data accesses that missed guest RAM, and trace logs)
+	rsk_stats_callback_t callbacks[RSK_STATS_CALLBACKS];
+
+	// The most executed instruction addresses, most executed first
+	size_t hot_count;
+	rsk_stats_hot_pc_t hot[RSK_STATS_HOT_MAX];
+
+	// Instruction executions at addresses the kernel ran out of room to count (if nonzero, the hot list may be incomplete)
+	dword hot_dropped;
+} rsk_stats_ex_t;
+
+// ["stats_ex"] Populate an extended stats struct. Returns 0 (leaving <stats> untouched) if the kernel was built without the extended counters.
+int rsk_stats_report_ex(rsk_stats_ex_t* stats);
+
+// ["cache"] Replacement policies of the cache model
+typedef enum rsk_cache_policy {
+	// Evict the least recently used line of the set
+	rcp_lru,
+	// Evict the line picked by a binary tree of recency bits per set (tree pseudo-LRU, as most hardware does it)
+	rcp_plru,
+} rsk_cache_policy_t;
+
+// ["cache"] Geometry of a modeled cache. The sizes and the number of ways must be powers of two, with lines of at least 4 bytes, at most 32 ways, and room for at least one set.
+typedef struct rsk_cache_config {
+	// Total capacity in bytes
+	dword size;
+
+	// Bytes per line
+	dword line_size;
+
+	// Lines per set
+	dword ways;
+
+	// Replacement policy
+	rsk_cache_policy_t policy;
+} rsk_cache_config_t;
+
+// ["cache"] Counters of the cache model
+typedef struct rsk_cache_stats {
+	// Instructions fetched, and how many of those fetches missed the I-cache
+	dword fetches;
+	dword fetch_misses;
+
+	// Loads, and how many of them missed the D-cache
+	dword loads;
+	dword load_misses;
+
+	// Stores, and how many of them missed the D-cache (stores allocate lines like loads do)
+	dword stores;
+	dword store_misses;
+} rsk_cache_stats_t;
+
+// ["cache"] Set the geometry of the I-cache and the D-cache (NULL keeps a cache's geometry); both caches are emptied and their counters reset. Every instance starts out with 16 KiB, 4-way LRU caches of 64-byte lines, which rsk_init restores. Returns 0, changing nothing, if either geometry is invalid or cannot be allocated.
+int rsk_cache_config(const rsk_cache_config_t* icache, const rsk_cache_config_t* dcache);
+
+// ["cache"] Populate <stats> with the counters of the cache model (only accesses made while rc_cache_on was set are counted)
+void rsk_cache_report(rsk_cache_stats_t* stats);
+
+// ["async"] Start running like rsk_cpu_run(<cycles>), but on a thread owned by the kernel, and return right away. Signals reach the run through a lock-free mailbox that it checks between blocks, so rsk_cpu_signal(rs_halt) from any thread stops it promptly without ever blocking. Host services are called on the kernel's thread in the meantime. Until rsk_cpu_wait returns, the host may only call rsk_cpu_running, rsk_cpu_signal, and rsk_cpu_wait. Returns 0 if a background run is already in progress or the thread cannot be started.
+int rsk_cpu_run_async(int cycles);
+
+// ["async"] Wait for the background run started by rsk_cpu_run_async to end. Returns the number of instructions it executed (0 if there was no background run).
+int rsk_cpu_wait(void);
+
+// ["stats_page"] Live counters page: a file the kernel keeps up to date while it runs, so that another process can map it and watch a long run without calling into the kernel. The kernel never waits for readers; instead, <sequence> is odd while the page is being written and is advanced again once the write is done. A consistent copy is one made between two reads of the same even <sequence> (with acquire ordering), so readers retry until they get one. All fields are native-endian.
+#define RSK_STATS_PAGE_MAGIC 0x4b535253
+#define RSK_STATS_PAGE_VERSION 1
+
+// ["stats_page"] Instructions between updates of the live counters page when the host doesn't choose
+#define RSK_STATS_PAGE_INTERVAL 1000000
+
+typedef struct rsk_stats_page {
+	// RSK_STATS_PAGE_MAGIC ("SRSK"), RSK_STATS_PAGE_VERSION, and sizeof(rsk_stats_page_t)
+	word magic;
+	word version;
+	word size;
+	word running;
+
+	// Seqlock counter (odd while an update is in progress), and the number of updates so far
+	dword sequence;
+	dword updates;
+
+	// Monotonic clock (in nanoseconds) when publishing started and at the last update
+	dword start_ns;
+	dword time_ns;
+
+	// The counters of rsk_stats_report, counted since publishing started (so they don't wrap around like those do). The misses are always TLB misses here, even while rc_cache_on is set.
+	dword instructions;
+	dword loads;
+	dword stores;
+	dword load_misses;
+	dword store_misses;
+
+	// The counters of rsk_cache_report (accesses made while rc_cache_on was set)
+	dword fetches;
+	dword fetch_misses;
+	dword cache_loads;
+	dword cache_load_misses;
+	dword cache_stores;
+	dword cache_store_misses;
+
+	// Block cache lookups, and how many of them had to decode a block
+	dword block_lookups;
+	dword block_decodes;
+
+	// Program counter at the last update
+	dword pc;
+
+	// Rates over the interval since the previous update: millions of instructions per second, and the fraction of loads and stores that hit the TLB, of block lookups that found a decoded block, and of accesses made while rc_cache_on was set that hit the I-cache and the D-cache (1.0 when there were none)
+	double mips;
+	double tlb_hit_rate;
+	double block_hit_rate;
+	double icache_hit_rate;
+	double dcache_hit_rate;
+} rsk_stats_page_t;
+
+// ["stats_page"] Publish the live counters page to the file at <path> (created or truncated, e.g. under /dev/shm), updating it at least every <interval> instructions (0 for RSK_STATS_PAGE_INTERVAL) and at the end of every run, background runs included. Any page published before is left with its last contents, and a NULL <path> just stops publishing; so does rsk_init. Returns 0 if the file cannot be created.
+int rsk_stats_publish(const char* path, dword interval);
+
+// ["mmio_replay"] MMIO log format: an rsk_mmio_header_t followed by one rsk_mmio_event_t per load or store that went to the host services (everything outside of mapped RAM except instruction fetches), in the order they were made. All fields are native-endian.
+#define RSK_MMIO_MAGIC 0x4b53524d
+#define RSK_MMIO_VERSION 1
+
+typedef struct rsk_mmio_header {
+	// RSK_MMIO_MAGIC ("MRSK") and RSK_MMIO_VERSION
+	word magic;
+	word version;
+} rsk_mmio_header_t;
+
+typedef struct rsk_mmio_event {
+	// Instructions executed before the one making the access (the step of trace logs)
+	dword step;
+
+	// Guest address and the value loaded or stored (zero-extended)
+	dword address;
+	dword value;
+
+	// Access size in bytes (1, 2, 4, or 8), and whether it was a store
+	word size;
+	word store;
+} rsk_mmio_event_t;
+
+// ["mmio_replay"] Progress of an MMIO replay
+typedef struct rsk_mmio_status {
+	// Events in the log, and how many of them have been replayed
+	dword events;
+	dword replayed;
+
+	// Nonzero once an access didn't match the log, together with the event the log expected (all zeros past its end) and the access made instead (the value is only set for stores)
+	int diverged;
+	rsk_mmio_event_t expected;
+	rsk_mmio_event_t actual;
+} rsk_mmio_status_t;
+
+// ["mmio_replay"] Record every load and store that goes to the host services into the MMIO log at <path> (created or truncated). A NULL <path> stops recording, as does rsk_init, and starting a replay. Returns 0 if the file cannot be created (or, when stopping, written).
+int rsk_mmio_record(const char* path);
+
+// ["mmio_replay"] Answer the loads that would go to the host services from the MMIO log at <path>, and check the stores against it, without calling the host at all. Both have to match the next event of the log, step included; the first access that doesn't is reported through log_msg, replay stops (that access and all later ones go to the host services again), and the run halts at the end of the current block. While recording or replaying, blocks always run on the function pointer core, so that steps are exact. A NULL <path> stops replaying, as does rsk_init, and starting a recording. Returns 0 if the file is not a readable MMIO log.
+int rsk_mmio_replay(const char* path);
+
+// ["mmio_replay"] Populate <status> with the progress of the current (or last) replay. Returns nonzero if it diverged.
+int rsk_mmio_replay_status(rsk_mmio_status_t* status);
+
+// ["debug"] Number of breakpoints and watchpoints that can be set at once
+#define RSK_BREAKPOINT_MAX 32
+#define RSK_WATCHPOINT_MAX 8
+
+// ["debug"] Accesses a watchpoint stops on (bit flags)
+typedef enum rsk_watch {
+	rw_load = 1,
+	rw_store = 2,
+	rw_access = rw_load | rw_store,
+} rsk_watch_t;
+
+// ["debug"] Why a run stopped early
+typedef enum rsk_stop {
+	rb_none,
+	rb_breakpoint,
+	rb_watchpoint,
+} rsk_stop_t;
+
+// ["debug"] Where the last run stopped
+typedef struct rsk_debug_status {
+	// rb_breakpoint or rb_watchpoint if the last run stopped at one (rb_none otherwise)
+	int reason;
+
+	// Instructions executed before the one at the breakpoint, or the one making the access (the step of trace logs)
+	dword step;
+
+	// pc of that instruction
+	dword pc;
+
+	// The access that set off a watchpoint: guest address, size in bytes, and whether it was a store
+	dword address;
+	word size;
+	word store;
+} rsk_debug_status_t;
+
+// ["debug"] Stop runs before they execute the instruction at <address>. Blocks are decoded to end before a breakpoint, and the block at one is left empty, so only runs reaching it take the function pointer core's check; code elsewhere runs as fast as before. A run resumed from the breakpoint it stopped at executes that instruction (rsk_cpu_run(1) steps over it). Returns 0 if RSK_BREAKPOINT_MAX breakpoints are set already.
+int rsk_break_set(dword address);
+
+// ["debug"] Remove the breakpoint at <address>. Returns 0 if there is none.
+int rsk_break_clear(dword address);
+
+// ["debug"] Stop runs right after an instruction makes a load or store (<kind>, an rsk_watch_t) that overlaps [<address>, <address> + <length>). Instruction fetches don't count. The TLB sends accesses to the pages of watchpoints down the slow path, where they are checked; accesses to other pages run as fast as before. Threaded and compiled blocks leave right after a watched store, but, while load watchpoints are set, blocks always run on the function pointer core, so that they stop right after a watched load too. Returns 0 if <length> is 0, <kind> is not valid, or RSK_WATCHPOINT_MAX watchpoints are set already.
+int rsk_watch_set(dword address, dword length, int kind);
+
+// ["debug"] Remove the watchpoints set for [<address>, <address> + <length>). Returns 0 if there are none.
+int rsk_watch_clear(dword address, dword length);
+
+// ["debug"] Populate <status> with where the last run (or rsk_cpu_run(1) step) stopped. Breakpoints and watchpoints are all removed by rsk_init. Returns the reason (nonzero if it stopped at a breakpoint or watchpoint).
+int rsk_debug_status(rsk_debug_status_t* status);
+
+// ------------ Multi-Instance Kernel API ------------ //
+// ["multi"] Every API function above (except rsk_info) has a variant taking the handle of an independent kernel instance. Different instances may be used concurrently from different threads, but each instance must only be used by one thread at a time. The handle-less functions operate on a default instance that rsk_init creates.
+
+// Handle to a kernel instance
+typedef struct rsk_instance* rsk_handle_t;
+
+// Create and initialize a new kernel instance bound to the provided host services (returns NULL on failure)
+rsk_handle_t rsk_create(const rsk_host_services_t* services);
+
+// Release a kernel instance created by rsk_create or rsk_fork
+void rsk_destroy(rsk_handle_t handle);
+
+// ["fork"] Create a new kernel instance in the same state as the default instance (registers, pc, config flags, and stats), bound to the provided host services (or the default instance's, if NULL). RAM mapped with rsk_ram_map is shared copy-on-write, so the fork starts out with the same contents but neither instance sees the other's later stores; ROM is shared as it is. The image of the RAM the fork maps is written once and reused by every fork made until the parent executes an instruction or stores to RAM again, so changes the host makes directly to the parent's RAM in between are not seen by those forks. Returns NULL on failure.
+rsk_handle_t rsk_fork(const rsk_host_services_t* services);
+rsk_handle_t rsk_fork_h(rsk_handle_t handle, const rsk_host_services_t* services);
+
+void rsk_disasm_h(rsk_handle_t handle, dword address, word instruction, char* buffer, size_t size);
+size_t rsk_disasm_range_h(rsk_handle_t handle, dword address, const void* code, size_t count, char* buffer, size_t stride);
+void rsk_init_h(rsk_handle_t handle, const rsk_host_services_t* services);
+void rsk_config_set_h(rsk_handle_t handle, rsk_config_t flags);
+rsk_config_t rsk_config_get_h(rsk_handle_t handle);
+void rsk_stats_report_h(rsk_handle_t handle, rsk_stat_t* stats);
+dword rsk_reg_get_h(rsk_handle_t handle, int index);
+void rsk_reg_set_h(rsk_handle_t handle, int index, dword value);
+dword rsk_pc_get_h(rsk_handle_t handle);
+void rsk_pc_set_h(rsk_handle_t handle, dword value);
+int rsk_state_get_h(rsk_handle_t handle, rsk_state_t* state);
+int rsk_state_set_h(rsk_handle_t handle, const rsk_state_t* state);
+int rsk_cpu_running_h(rsk_handle_t handle);
+void rsk_cpu_signal_h(rsk_handle_t handle, rsk_signal_t signal);
+int rsk_cpu_run_h(rsk_handle_t handle, int cycles);
+void rsk_ram_map_h(rsk_handle_t handle, void* base, dword address, dword length);
+void rsk_rom_map_h(rsk_handle_t handle, const void* base, dword address, dword length);
+int rsk_trace_sink_h(rsk_handle_t handle, rsk_trace_sink_t sink, size_t size);
+int rsk_trace_file_h(rsk_handle_t handle, const char* path, size_t size);
+void rsk_trace_flush_h(rsk_handle_t handle);
+int rsk_trace_delta_h(rsk_handle_t handle, rsk_trace_delta_t callback);
+int rsk_snapshot_save_h(rsk_handle_t handle, const char* path);
+int rsk_snapshot_restore_h(rsk_handle_t handle, const char* path);
+int rsk_profile_start_h(rsk_handle_t handle, dword interval);
+int rsk_profile_write_h(rsk_handle_t handle, const char* path);
+int rsk_stats_report_ex_h(rsk_handle_t handle, rsk_stats_ex_t* stats);
+int rsk_cache_config_h(rsk_handle_t handle, const rsk_cache_config_t* icache, const rsk_cache_config_t* dcache);
+void rsk_cache_report_h(rsk_handle_t handle, rsk_cache_stats_t* stats);
+int rsk_cpu_run_async_h(rsk_handle_t handle, int cycles);
+int rsk_cpu_wait_h(rsk_handle_t handle);
+int rsk_stats_publish_h(rsk_handle_t handle, const char* path, dword interval);
+int rsk_mmio_record_h(rsk_handle_t handle, const char* path);
+int rsk_mmio_replay_h(rsk_handle_t handle, const char* path);
+int rsk_mmio_replay_status_h(rsk_handle_t handle, rsk_mmio_status_t* status);
+int rsk_break_set_h(rsk_handle_t handle, dword address);
+int rsk_break_clear_h(rsk_handle_t handle, dword address);
+int rsk_watch_set_h(rsk_handle_t handle, dword address, dword length, int kind);
+int rsk_watch_clear_h(rsk_handle_t handle, dword address, dword length);
+int rsk_debug_status_h(rsk_handle_t handle, rsk_debug_status_t* status);
+
 #ifdef __cplusplus
 }
 #endif
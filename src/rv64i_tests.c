@@ -31,7 +31,54 @@ int main() {
     instr = OPCODE(0110011) | RD(01011) | FUNCT3(000) | RS1(00000) | RS2(10010) | FUNCT7(0000000);
     INSTR_ASSERT("add");
 
-    // TODO: SUB+ tests
+    instr = OPCODE(0110011) | RD(01011) | FUNCT3(000) | RS1(00000) | RS2(10010) | FUNCT7(0100000);
+    INSTR_ASSERT("sub");
+
+    instr = OPCODE(0010111) | RD(00110) | utype_immediate(5120);
+    INSTR_ASSERT("auipc");
+    DISASM_ASSERT("0x00001317   auipc x6, 0x1000");
+
+    // the remaining instructions only differ from their neighbours in funct3/funct7, using x3 = x1 op x2 (or an immediate)
+    instr = EXEC_I(0010011, 010, -4);
+    INSTR_ASSERT("slti");
+    instr = EXEC_I(0010011, 011, -4);
+    INSTR_ASSERT("sltiu");
+    instr = EXEC_R(0110011, 001, 0000000);
+    INSTR_ASSERT("sll");
+    instr = EXEC_R(0110011, 010, 0000000);
+    INSTR_ASSERT("slt");
+    instr = EXEC_R(0110011, 011, 0000000);
+    INSTR_ASSERT("sltu");
+    instr = EXEC_R(0110011, 100, 0000000);
+    INSTR_ASSERT("xor");
+    instr = EXEC_R(0110011, 101, 0000000);
+    INSTR_ASSERT("srl");
+    instr = EXEC_R(0110011, 101, 0100000);
+    INSTR_ASSERT("sra");
+    instr = EXEC_R(0110011, 110, 0000000);
+    INSTR_ASSERT("or");
+    instr = EXEC_R(0110011, 111, 0000000);
+    INSTR_ASSERT("and");
+    DISASM_ASSERT("0x0020f1b3   and x3, x1, x2");
+    instr = OPCODE(0001111) | FUNCT3(000) | itype_immediate(0x0ff);
+    INSTR_ASSERT("fence");
+
+    instr = OPCODE(0000011) | FUNCT3(000) | RD(00011) | RS1(00001) | itype_immediate(-1);
+    INSTR_ASSERT("lb");
+    DISASM_ASSERT("0xfff08183   lb x3, -1(x1)");
+    instr = OPCODE(0000011) | FUNCT3(001) | RD(00011) | RS1(00001) | itype_immediate(2);
+    INSTR_ASSERT("lh");
+    instr = OPCODE(0000011) | FUNCT3(100) | RD(00011) | RS1(00001) | itype_immediate(2);
+    INSTR_ASSERT("lbu");
+    instr = OPCODE(0000011) | FUNCT3(101) | RD(00011) | RS1(00001) | itype_immediate(2);
+    INSTR_ASSERT("lhu");
+    instr = OPCODE(0000011) | FUNCT3(110) | RD(00011) | RS1(00001) | itype_immediate(2);
+    INSTR_ASSERT("lwu");
+    instr = OPCODE(0100011) | FUNCT3(000) | RS1(00001) | RS2(00010) | stype_immediate(2);
+    INSTR_ASSERT("sb");
+    instr = OPCODE(0100011) | FUNCT3(001) | RS1(00001) | RS2(00010) | stype_immediate(2);
+    INSTR_ASSERT("sh");
+    DISASM_ASSERT("0x00209123   sh x2, 0x2(x1)");
 
     instr = OPCODE(1110011) | RD(00000) | FUNCT3(000) | RS1(00000) | RS2(00001) | FUNCT7(0000000);
     INSTR_ASSERT("ebreak");
@@ -42,11 +89,1221 @@ int main() {
     instr = OPCODE(0100011) | FUNCT3(010) | RS1(10000) | RS2(00000) | stype_immediate(76);
     INSTR_ASSERT("sw");
 
-    // TODO: JAL+ tests
+    instr = OPCODE(1101111) | RD(00001) | jtype_immediate(0x100);
+    INSTR_ASSERT("jal");
+
+    instr = OPCODE(1100111) | FUNCT3(000) | RD(00011) | RS1(00001) | itype_immediate(4);
+    INSTR_ASSERT("jalr");
+
+    instr = OPCODE(1100011) | FUNCT3(000) | RS1(00001) | RS2(00010) | btype_immediate(8);
+    INSTR_ASSERT("beq");
+    instr = OPCODE(1100011) | FUNCT3(001) | RS1(00001) | RS2(00010) | btype_immediate(8);
+    INSTR_ASSERT("bne");
+    instr = OPCODE(1100011) | FUNCT3(100) | RS1(00001) | RS2(00010) | btype_immediate(8);
+    INSTR_ASSERT("blt");
+    instr = OPCODE(1100011) | FUNCT3(101) | RS1(00001) | RS2(00010) | btype_immediate(8);
+    INSTR_ASSERT("bge");
+    instr = OPCODE(1100011) | FUNCT3(110) | RS1(00001) | RS2(00010) | btype_immediate(8);
+    INSTR_ASSERT("bltu");
+    instr = OPCODE(1100011) | FUNCT3(111) | RS1(00001) | RS2(00010) | btype_immediate(8);
+    INSTR_ASSERT("bgeu");
 
     instr = OPCODE(0011011) | RD(00010) | FUNCT3(000) | RS1(00000) | itype_immediate(-95);
     INSTR_ASSERT("addiw");
 
+    instr = EXEC_I(0011011, 001, 5);
+    INSTR_ASSERT("slliw");
+    DISASM_ASSERT("0x0050919b   slliw x3, x1, 0x5");
+    instr = EXEC_I(0011011, 101, 5);
+    INSTR_ASSERT("srliw");
+    instr = EXEC_I(0011011, 101, 5) | (INSTR_SIGN >> 1);
+    INSTR_ASSERT("sraiw");
+    instr = EXEC_R(0111011, 000, 0000000);
+    INSTR_ASSERT("addw");
+    instr = EXEC_R(0111011, 000, 0100000);
+    INSTR_ASSERT("subw");
+    instr = EXEC_R(0111011, 001, 0000000);
+    INSTR_ASSERT("sllw");
+    instr = EXEC_R(0111011, 101, 0000000);
+    INSTR_ASSERT("srlw");
+    instr = EXEC_R(0111011, 101, 0100000);
+    INSTR_ASSERT("sraw");
+
+    instr = EXEC_R(0110011, 000, 0000001);
+    INSTR_ASSERT("mul");
+    instr = EXEC_R(0110011, 001, 0000001);
+    INSTR_ASSERT("mulh");
+    instr = EXEC_R(0110011, 010, 0000001);
+    INSTR_ASSERT("mulhsu");
+    instr = EXEC_R(0110011, 011, 0000001);
+    INSTR_ASSERT("mulhu");
+    instr = EXEC_R(0110011, 100, 0000001);
+    INSTR_ASSERT("div");
+    DISASM_ASSERT("0x0220c1b3   div x3, x1, x2");
+    instr = EXEC_R(0110011, 101, 0000001);
+    INSTR_ASSERT("divu");
+    instr = EXEC_R(0110011, 110, 0000001);
+    INSTR_ASSERT("rem");
+    instr = EXEC_R(0110011, 111, 0000001);
+    INSTR_ASSERT("remu");
+    instr = EXEC_R(0111011, 000, 0000001);
+    INSTR_ASSERT("mulw");
+    instr = EXEC_R(0111011, 100, 0000001);
+    INSTR_ASSERT("divw");
+    instr = EXEC_R(0111011, 101, 0000001);
+    INSTR_ASSERT("divuw");
+    instr = EXEC_R(0111011, 110, 0000001);
+    INSTR_ASSERT("remw");
+    instr = EXEC_R(0111011, 111, 0000001);
+    INSTR_ASSERT("remuw");
+
     instr = OPCODE(0000011) | RD(00010) | FUNCT3(011) | RS1(00000) | itype_immediate(67);
     INSTR_ASSERT("ld");
+    DISASM_ASSERT("0x04303103   ld x2, 0x43(x0)");
+
+    // every disassembly syntax names registers the same way
+    instr = OPCODE(0100011) | FUNCT3(011) | RS1(00010) | RS2(00101) | stype_immediate(-16);
+    DISASM_ASSERT("0xfe513823   sd x5, -16(x2)");
+    instr = OPCODE(1100011) | FUNCT3(001) | RS1(00101) | RS2(00111) | btype_immediate(-16);
+    DISASM_ASSERT("0xfe7298e3   bne x5, x7, -16");
+    instr = OPCODE(1101111) | RD(00001) | jtype_immediate(0x100);
+    DISASM_ASSERT("0x100000ef   jal x1, 0x100");
+    instr = OPCODE(0010011) | RD(01110) | FUNCT3(101) | RS1(01001) | itype_immediate(32) | (INSTR_SIGN >> 1);
+    DISASM_ASSERT("0x4204d713   srai x14, x9, 0x20");
+    instr = INSTR_EBREAK;
+    DISASM_ASSERT("0x00100073   ebreak");
+
+    // ---------- Instruction Semantics ----------
+
+    // auipc adds to the address of the instruction itself
+    EXEC_ASSERT("auipc", OPCODE(0010111) | RD(00011) | utype_immediate(0x12345000), 0, 0, TESTING_EXEC_ADDRESS + 0x12345000);
+    EXEC_ASSERT("auipc", OPCODE(0010111) | RD(00011) | utype_immediate(-4096), 0, 0, TESTING_EXEC_ADDRESS - 4096);
+
+    // comparisons (sltiu sign-extends its immediate before comparing unsigned)
+    EXEC_ASSERT("slti", EXEC_I(0010011, 010, -4), -5, 0, 1);
+    EXEC_ASSERT("slti", EXEC_I(0010011, 010, -4), 3, 0, 0);
+    EXEC_ASSERT("sltiu", EXEC_I(0010011, 011, -1), 5, 0, 1);
+    EXEC_ASSERT("sltiu", EXEC_I(0010011, 011, -1), UINT64_MAX, 0, 0);
+    EXEC_ASSERT("sltiu", EXEC_I(0010011, 011, 1), 0, 0, 1);
+    EXEC_ASSERT("slt", EXEC_R(0110011, 010, 0000000), -1, 1, 1);
+    EXEC_ASSERT("slt", EXEC_R(0110011, 010, 0000000), 1, -1, 0);
+    EXEC_ASSERT("sltu", EXEC_R(0110011, 011, 0000000), -1, 1, 0);
+    EXEC_ASSERT("sltu", EXEC_R(0110011, 011, 0000000), 1, -1, 1);
+
+    // bitwise operations
+    EXEC_ASSERT("xor", EXEC_R(0110011, 100, 0000000), 0xff00ff00ff00ff00, 0x0ff00ff00ff00ff0, 0xf0f0f0f0f0f0f0f0);
+    EXEC_ASSERT("or", EXEC_R(0110011, 110, 0000000), 0xff00ff00ff00ff00, 0x0ff00ff00ff00ff0, 0xfff0fff0fff0fff0);
+    EXEC_ASSERT("and", EXEC_R(0110011, 111, 0000000), 0xff00ff00ff00ff00, 0x0ff00ff00ff00ff0, 0x0f000f000f000f00);
+
+    // shifts only use the low 6 bits of rs2 (5 bits for the word forms)
+    EXEC_ASSERT("sll", EXEC_R(0110011, 001, 0000000), 1, 65, 2);
+    EXEC_ASSERT("srl", EXEC_R(0110011, 101, 0000000), 0x8000000000000000, 127, 1);
+    EXEC_ASSERT("sra", EXEC_R(0110011, 101, 0100000), 0x8000000000000000, 0x43, 0xf000000000000000);
+    EXEC_ASSERT("slliw", EXEC_I(0011011, 001, 1), 0xc0000001, 0, 0xffffffff80000002);
+    EXEC_ASSERT("srliw", EXEC_I(0011011, 101, 4), 0xffffffff80000000, 0, 0x08000000);
+    EXEC_ASSERT("srliw", EXEC_I(0011011, 101, 0), 0x80000000, 0, 0xffffffff80000000);
+    EXEC_ASSERT("sraiw", EXEC_I(0011011, 101, 4) | (INSTR_SIGN >> 1), 0x80000000, 0, 0xfffffffff8000000);
+    EXEC_ASSERT("sllw", EXEC_R(0111011, 001, 0000000), 1, 33, 2);
+    EXEC_ASSERT("sllw", EXEC_R(0111011, 001, 0000000), 1, 31, 0xffffffff80000000);
+    EXEC_ASSERT("srlw", EXEC_R(0111011, 101, 0000000), 0xffffffff80000000, 63, 1);
+    EXEC_ASSERT("sraw", EXEC_R(0111011, 101, 0100000), 0x80000000, 31, UINT64_MAX);
+
+    // word arithmetic ignores the upper halves of its operands and sign-extends its result
+    EXEC_ASSERT("addw", EXEC_R(0111011, 000, 0000000), 0x7fffffff, 1, 0xffffffff80000000);
+    EXEC_ASSERT("addw", EXEC_R(0111011, 000, 0000000), INT64_MAX, 1, 0);
+    EXEC_ASSERT("addw", EXEC_R(0111011, 000, 0000000), INT64_MIN, UINT64_MAX, UINT64_MAX);
+    EXEC_ASSERT("addiw", EXEC_I(0011011, 000, 1), INT64_MAX, 0, 0);
+    EXEC_ASSERT("addiw", EXEC_I(0011011, 000, -1), INT64_MIN, 0, UINT64_MAX);
+    EXEC_ASSERT("subw", EXEC_R(0111011, 000, 0100000), 0, 1, UINT64_MAX);
+    EXEC_ASSERT("subw", EXEC_R(0111011, 000, 0100000), 0x100000005, 2, 3);
+
+    // loads sign- or zero-extend their element
+    test_store(0x7900, 0x8899aabbccddeeff, 8);
+    test_store(0x7908, 0x0011223344556677, 8);
+    EXEC_ASSERT("lb", OPCODE(0000011) | FUNCT3(000) | RD(00011) | RS1(00001), 0x7900, 0, UINT64_MAX);
+    EXEC_ASSERT("lb", OPCODE(0000011) | FUNCT3(000) | RD(00011) | RS1(00001) | itype_immediate(8), 0x7900, 0, 0x77);
+    EXEC_ASSERT("lbu", OPCODE(0000011) | FUNCT3(100) | RD(00011) | RS1(00001), 0x7900, 0, 0xff);
+    EXEC_ASSERT("lh", OPCODE(0000011) | FUNCT3(001) | RD(00011) | RS1(00001), 0x7900, 0, 0xffffffffffffeeff);
+    EXEC_ASSERT("lh", OPCODE(0000011) | FUNCT3(001) | RD(00011) | RS1(00001) | itype_immediate(8), 0x7900, 0, 0x6677);
+    EXEC_ASSERT("lhu", OPCODE(0000011) | FUNCT3(101) | RD(00011) | RS1(00001), 0x7900, 0, 0xeeff);
+    EXEC_ASSERT("lw", OPCODE(0000011) | FUNCT3(010) | RD(00011) | RS1(00001), 0x7900, 0, 0xffffffffccddeeff);
+    EXEC_ASSERT("lw", OPCODE(0000011) | FUNCT3(010) | RD(00011) | RS1(00001) | itype_immediate(8), 0x7900, 0, 0x44556677);
+    EXEC_ASSERT("lwu", OPCODE(0000011) | FUNCT3(110) | RD(00011) | RS1(00001), 0x7900, 0, 0xccddeeff);
+    EXEC_ASSERT("ld", OPCODE(0000011) | FUNCT3(011) | RD(00011) | RS1(00001) | itype_immediate(-8), 0x7908, 0, 0x8899aabbccddeeff);
+
+    // stores only write their element
+    test_store(0x7910, UINT64_MAX, 8);
+    test_store(0x7918, UINT64_MAX, 8);
+    test_exec(cpu, OPCODE(0100011) | FUNCT3(000) | RS1(00001) | RS2(00010) | stype_immediate(0x10), 0x7900, 0x1122334455667788);
+    VALUE_ASSERT("sb", test_load(0x7910, 8), 0xffffffffffffff88);
+    test_exec(cpu, OPCODE(0100011) | FUNCT3(001) | RS1(00001) | RS2(00010) | stype_immediate(0x18), 0x7900, 0x1122334455667788);
+    VALUE_ASSERT("sh", test_load(0x7918, 8), 0xffffffffffff7788);
+    test_store(0x7920, UINT64_MAX, 8);
+    test_store(0x7928, UINT64_MAX, 8);
+    test_exec(cpu, OPCODE(0100011) | FUNCT3(011) | RS1(00001) | RS2(00010) | stype_immediate(0x20), 0x7900, 0x1122334455667788);
+    VALUE_ASSERT("sd", test_load(0x7920, 8), 0x1122334455667788);
+    VALUE_ASSERT("sd little-endian", test_load(0x7920, 1) == 0x88 && test_load(0x7923, 1) == 0x55 && test_load(0x7927, 1) == 0x11, 1);
+    VALUE_ASSERT("sd", test_load(0x7928, 8), UINT64_MAX);
+
+    // ordered branches compare signed or unsigned (ties go to bge and bgeu)
+    BRANCH_ASSERT("blt", 100, -1, 1, 1);
+    BRANCH_ASSERT("blt", 100, 1, -1, 0);
+    BRANCH_ASSERT("blt", 100, INT64_MIN, INT64_MAX, 1);
+    BRANCH_ASSERT("blt", 100, 5, 5, 0);
+    BRANCH_ASSERT("bge", 101, -1, 1, 0);
+    BRANCH_ASSERT("bge", 101, 1, -1, 1);
+    BRANCH_ASSERT("bge", 101, INT64_MIN, INT64_MAX, 0);
+    BRANCH_ASSERT("bge", 101, -5, -5, 1);
+    BRANCH_ASSERT("bltu", 110, -1, 1, 0);
+    BRANCH_ASSERT("bltu", 110, 1, -1, 1);
+    BRANCH_ASSERT("bltu", 110, INT64_MAX, INT64_MIN, 1);
+    BRANCH_ASSERT("bltu", 110, 5, 5, 0);
+    BRANCH_ASSERT("bgeu", 111, -1, 1, 1);
+    BRANCH_ASSERT("bgeu", 111, 1, -1, 0);
+    BRANCH_ASSERT("bgeu", 111, INT64_MAX, INT64_MIN, 0);
+    BRANCH_ASSERT("bgeu", 111, -5, -5, 1);
+
+    // jalr links the address of the next instruction, and clears bit 0 of its target
+    EXEC_ASSERT("jalr", OPCODE(1100111) | FUNCT3(000) | RD(00011) | RS1(00001) | itype_immediate(4), TESTING_EXEC_ADDRESS, 0, TESTING_EXEC_ADDRESS + 4);
+    EXEC_ASSERT("jalr", OPCODE(1100111) | FUNCT3(000) | RD(00011) | RS1(00001) | itype_immediate(3), TESTING_EXEC_ADDRESS + 1, 0, TESTING_EXEC_ADDRESS + 4);
+    VALUE_ASSERT("jalr pc", cpu_get_pc(cpu), TESTING_EXEC_ADDRESS + 4);
+
+    // fence has no effect
+    EXEC_ASSERT("fence", OPCODE(0001111) | FUNCT3(000) | itype_immediate(0x0ff), 1, 2, 0);
+
+    // multiplication (the high halves come from the full 128-bit product)
+    EXEC_ASSERT("mul", EXEC_R(0110011, 000, 0000001), -3, 5, -15);
+    EXEC_ASSERT("mulh", EXEC_R(0110011, 001, 0000001), -1, -1, 0);
+    EXEC_ASSERT("mulh", EXEC_R(0110011, 001, 0000001), -1, 2, UINT64_MAX);
+    EXEC_ASSERT("mulh", EXEC_R(0110011, 001, 0000001), INT64_MIN, INT64_MIN, 0x4000000000000000);
+    EXEC_ASSERT("mulhsu", EXEC_R(0110011, 010, 0000001), -1, UINT64_MAX, UINT64_MAX);
+    EXEC_ASSERT("mulhsu", EXEC_R(0110011, 010, 0000001), 2, UINT64_MAX, 1);
+    EXEC_ASSERT("mulhu", EXEC_R(0110011, 011, 0000001), UINT64_MAX, UINT64_MAX, 0xfffffffffffffffe);
+    EXEC_ASSERT("mulhu", EXEC_R(0110011, 011, 0000001), 0x100000000, 0x100000000, 1);
+    EXEC_ASSERT("mulw", EXEC_R(0111011, 000, 0000001), 0x10000, 0x10000, 0);
+    EXEC_ASSERT("mulw", EXEC_R(0111011, 000, 0000001), 0x7fffffff, 2, 0xfffffffffffffffe);
+    EXEC_ASSERT("mulw", EXEC_R(0111011, 000, 0000001), 0x100000003, 5, 15);
+
+    // division rounds towards zero; dividing by zero gives all ones (and the dividend as the remainder), overflow gives the dividend (and 0)
+    EXEC_ASSERT("div", EXEC_R(0110011, 100, 0000001), 7, -2, -3);
+    EXEC_ASSERT("div", EXEC_R(0110011, 100, 0000001), -7, 2, -3);
+    EXEC_ASSERT("div by zero", EXEC_R(0110011, 100, 0000001), 5, 0, UINT64_MAX);
+    EXEC_ASSERT("div overflow", EXEC_R(0110011, 100, 0000001), INT64_MIN, -1, INT64_MIN);
+    EXEC_ASSERT("divu", EXEC_R(0110011, 101, 0000001), 7, 2, 3);
+    EXEC_ASSERT("divu", EXEC_R(0110011, 101, 0000001), INT64_MIN, -1, 0);
+    EXEC_ASSERT("divu by zero", EXEC_R(0110011, 101, 0000001), 5, 0, UINT64_MAX);
+    EXEC_ASSERT("rem", EXEC_R(0110011, 110, 0000001), -7, 2, -1);
+    EXEC_ASSERT("rem", EXEC_R(0110011, 110, 0000001), 7, -2, 1);
+    EXEC_ASSERT("rem by zero", EXEC_R(0110011, 110, 0000001), -7, 0, -7);
+    EXEC_ASSERT("rem overflow", EXEC_R(0110011, 110, 0000001), INT64_MIN, -1, 0);
+    EXEC_ASSERT("remu", EXEC_R(0110011, 111, 0000001), 7, 2, 1);
+    EXEC_ASSERT("remu by zero", EXEC_R(0110011, 111, 0000001), -7, 0, -7);
+    EXEC_ASSERT("divw", EXEC_R(0111011, 100, 0000001), 0xfffffff9, 2, -3);
+    EXEC_ASSERT("divw", EXEC_R(0111011, 100, 0000001), 0x100000006, 0x200000003, 2);
+    EXEC_ASSERT("divw by zero", EXEC_R(0111011, 100, 0000001), 5, 0x100000000, UINT64_MAX);
+    EXEC_ASSERT("divw overflow", EXEC_R(0111011, 100, 0000001), 0x80000000, -1, 0xffffffff80000000);
+    EXEC_ASSERT("divuw", EXEC_R(0111011, 101, 0000001), 0xffffffff, 2, 0x7fffffff);
+    EXEC_ASSERT("divuw", EXEC_R(0111011, 101, 0000001), 0x80000000, 1, 0xffffffff80000000);
+    EXEC_ASSERT("divuw by zero", EXEC_R(0111011, 101, 0000001), 5, 0, UINT64_MAX);
+    EXEC_ASSERT("remw", EXEC_R(0111011, 110, 0000001), 0xfffffff9, 2, -1);
+    EXEC_ASSERT("remw by zero", EXEC_R(0111011, 110, 0000001), 0x80000000, 0, 0xffffffff80000000);
+    EXEC_ASSERT("remw overflow", EXEC_R(0111011, 110, 0000001), 0x80000000, -1, 0);
+    EXEC_ASSERT("remuw", EXEC_R(0111011, 111, 0000001), 0x80000007, 0x10, 7);
+    EXEC_ASSERT("remuw by zero", EXEC_R(0111011, 111, 0000001), 0xfffffff7, 0, 0xfffffffffffffff7);
+
+    // ---------- Block Cache ----------
+
+    // counted loop: the loop block is decoded once and reused on every iteration
+    dword addr = 0x1000;
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00001) | RS1(00000) | itype_immediate(0));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00010) | RS1(00000) | itype_immediate(10));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00001) | RS1(00001) | itype_immediate(1));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(001) | RS1(00001) | RS2(00010) | btype_immediate(-4));
+    EMIT(addr, INSTR_EBREAK);
+
+    cpu_set_pc(cpu, 0x1000);
+    unsigned int start = cpu_stat_instructions(cpu);
+    while (cpu_execute(cpu));
+    REG_ASSERT(1, 10);
+    VALUE_ASSERT("loop instructions", cpu_stat_instructions(cpu) - start, 22);
+    VALUE_ASSERT("loop pc", cpu_get_pc(cpu), 0x1010);
+
+    // bounded runs execute exactly the requested number of instructions, even mid-block
+    cpu_set_pc(cpu, 0x1000);
+    VALUE_ASSERT("bounded run", cpu_run(cpu, 5), 5);
+    REG_ASSERT(1, 2);
+    VALUE_ASSERT("bounded run pc", cpu_get_pc(cpu), 0x100c);
+    VALUE_ASSERT("bounded run (continued)", cpu_run(cpu, 3), 3);
+    REG_ASSERT(1, 3);
+    VALUE_ASSERT("bounded run pc (continued)", cpu_get_pc(cpu), 0x1008);
+
+    // ...unless ebreak is reached first
+    VALUE_ASSERT("bounded run to ebreak", cpu_run(cpu, 100), 14);
+    REG_ASSERT(1, 10);
+    VALUE_ASSERT("running after ebreak", cpu_is_running(cpu), 0);
+
+    // and 0 means "until ebreak"
+    cpu_set_pc(cpu, 0x1000);
+    VALUE_ASSERT("unbounded run", cpu_run(cpu, 0), 22);
+
+    // self-modifying store: rewrite a later instruction of the block that is currently executing
+    addr = 0x2000;
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00011) | RS1(00000) | itype_immediate(5));
+    EMIT(addr, OPCODE(0100011) | FUNCT3(010) | RS1(00101) | RS2(00100) | stype_immediate(12));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00000) | itype_immediate(1));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00000) | itype_immediate(2));
+    EMIT(addr, INSTR_EBREAK);
+
+    cpu_write_register(cpu, 4, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00000) | itype_immediate(7));
+    cpu_write_register(cpu, 5, 0x2000);
+    cpu_set_pc(cpu, 0x2000);
+    while (cpu_execute(cpu));
+    REG_ASSERT(3, 5);
+    REG_ASSERT(6, 7);
+
+    // run it again, so the blocks decoded by the first run are now the stale ones
+    cpu_write_register(cpu, 4, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00000) | itype_immediate(9));
+    cpu_set_pc(cpu, 0x2000);
+    while (cpu_execute(cpu));
+    REG_ASSERT(6, 9);
+
+    // ---------- Direct RAM Mapping ----------
+
+    // mapped addresses bypass the host services entirely
+    byte mapped[0x100] = { 0 };
+    cpu_map_ram(cpu, mapped, 0x8000, sizeof(mapped), 1);
+    cpu_store_word(cpu, 0x8010, 0xdeadbeef);
+    cpu_store_dword(cpu, 0x8020, 0x0123456789abcdef);
+    VALUE_ASSERT("mapped store", mapped[0x10] | ((dword) mapped[0x13] << 24), 0xde0000ef);
+    VALUE_ASSERT("mapped load", cpu_load_hword(cpu, 0x8012), 0xdead);
+    VALUE_ASSERT("mapped load", cpu_load_dword(cpu, 0x8020), 0x0123456789abcdef);
+    VALUE_ASSERT("host RAM behind mapping", test_load(0x8010, 4), 0);
+
+    // ...but accesses that don't fit entirely within the region still go to the host
+    cpu_store_word(cpu, 0x80fe, 0x11223344);
+    VALUE_ASSERT("straddling store", test_load(0x80fe, 4), 0x11223344);
+    VALUE_ASSERT("straddling store", mapped[0xfe], 0);
+    cpu_map_ram(cpu, NULL, 0x8000, sizeof(mapped), 0);
+    VALUE_ASSERT("unmapped load", cpu_load_word(cpu, 0x8010), 0);
+
+    // ---------- Software TLB ----------
+
+    // accesses within one page only miss the TLB once (and a load miss fills the translation for stores too)
+    rsk_stat_t before, after;
+    cpu_map_ram(cpu, z_test_ram, 0, TESTING_RAM_SIZE, 1);
+    cpu_fill_stats(cpu, &before);
+    for (int i = 0; i < 64; i++) VALUE_ASSERT("TLB load", cpu_load_word(cpu, 0x9000 + 4 * i), 0);
+    for (int i = 0; i < 64; i++) cpu_store_word(cpu, 0x9000 + 4 * i, i);
+    VALUE_ASSERT("TLB store", test_load(0x9000 + 4 * 63, 4), 63);
+    cpu_fill_stats(cpu, &after);
+    VALUE_ASSERT("TLB loads", after.loads - before.loads, 64);
+    VALUE_ASSERT("TLB load misses", after.load_misses - before.load_misses, 1);
+    VALUE_ASSERT("TLB stores", after.stores - before.stores, 64);
+    VALUE_ASSERT("TLB store misses", after.store_misses - before.store_misses, 0);
+
+    // instruction fetches aren't loads, so their TLB misses aren't load misses
+    cpu_map_ram(cpu, z_test_ram, 0, TESTING_RAM_SIZE, 1);
+    cpu_fill_stats(cpu, &before);
+    cpu_set_pc(cpu, 0x1000);
+    cpu_run(cpu, 0);
+    cpu_fill_stats(cpu, &after);
+    VALUE_ASSERT("TLB fetch loads", after.loads - before.loads, 0);
+    VALUE_ASSERT("TLB fetch load misses", after.load_misses - before.load_misses, 0);
+
+    // stores into pages holding cached code still invalidate blocks
+    cpu_write_register(cpu, 4, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00000) | itype_immediate(11));
+    cpu_set_pc(cpu, 0x2000);
+    while (cpu_execute(cpu));
+    REG_ASSERT(6, 11);
+    cpu_write_register(cpu, 4, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00000) | itype_immediate(13));
+    cpu_set_pc(cpu, 0x2000);
+    while (cpu_execute(cpu));
+    REG_ASSERT(6, 13);
+
+    // stores to ROM are passed on to the host
+    byte rom[0x1000] = { 0x5a };
+    cpu_map_ram(cpu, rom, 0xa000, sizeof(rom), 0);
+    VALUE_ASSERT("ROM load", cpu_load_byte(cpu, 0xa000), 0x5a);
+    cpu_store_byte(cpu, 0xa000, 0xa5);
+    VALUE_ASSERT("ROM store", rom[0], 0x5a);
+    VALUE_ASSERT("ROM store", test_load(0xa000, 1), 0xa5);
+    cpu_map_ram(cpu, NULL, 0, TESTING_RAM_SIZE, 0);
+
+    // ---------- Binary Trace ----------
+
+    // a small buffer splits the trace of repeated runs of the counted loop into several chunks, which still replay to the final registers
+    VALUE_ASSERT("trace sink", cpu_trace_sink(cpu, z_test_trace_sink, 0x1000), 1);
+    cpu_set_config(cpu, rc_trace_binary);
+    unsigned int traced = cpu_stat_instructions(cpu);
+    for (int i = 0; i < 50; i++) {
+        // registers changed by the host between runs are picked up by a fresh keyframe
+        if (49 == i) cpu_write_register(cpu, 7, 0x77);
+        cpu_set_pc(cpu, 0x1000);
+        cpu_run(cpu, 0);
+    }
+    cpu_trace_flush(cpu);
+    cpu_set_config(cpu, rc_nothing);
+
+    dword replayed[32];
+    VALUE_ASSERT("trace records", test_trace_replay(replayed), cpu_stat_instructions(cpu) - traced);
+    VALUE_ASSERT("trace chunks", z_test_trace_chunks > 2, 1);
+    for (int i = 0; i < 32; i++) VALUE_ASSERT("trace registers", replayed[i], cpu_read_register(cpu, i));
+
+    // every keyframe holds the registers from before its first record, so the trace replays to the right registers at every step (chunk boundaries included)
+    VALUE_ASSERT("trace sink", cpu_trace_sink(cpu, z_test_trace_sink, 0x1000), 1);
+    z_test_trace_size = 0;
+    z_test_trace_chunks = 0;
+    cpu_set_config(cpu, rc_trace_binary);
+    dword stepped[1000][2];
+    traced = cpu_stat_instructions(cpu);
+    cpu_set_pc(cpu, 0x1000);
+    for (unsigned int steps = 0; steps < 1000; steps = cpu_stat_instructions(cpu) - traced) {
+        stepped[steps][0] = cpu_read_register(cpu, 1);
+        stepped[steps][1] = cpu_read_register(cpu, 2);
+        if (!cpu_execute(cpu)) cpu_set_pc(cpu, 0x1000);
+    }
+    cpu_trace_flush(cpu);
+    cpu_set_config(cpu, rc_nothing);
+
+    VALUE_ASSERT("trace chunks", z_test_trace_chunks > 2, 1);
+    for (long steps = 0; steps < 1000; steps++) {
+        VALUE_ASSERT("trace steps", test_trace_replay_steps(replayed, steps), steps);
+        VALUE_ASSERT("trace step registers", replayed[1], stepped[steps][0]);
+        VALUE_ASSERT("trace step registers", replayed[2], stepped[steps][1]);
+    }
+
+    // a delta trace of the counted loop only hears about the registers that changed (x1 on every addi; x2 already holds 10)
+    for (int i = 0; i < 32; i++) z_test_delta_registers[i] = cpu_read_register(cpu, i);
+    VALUE_ASSERT("trace delta", cpu_trace_delta(cpu, z_test_trace_delta), 1);
+    cpu_set_config(cpu, rc_trace_log);
+    cpu_set_pc(cpu, 0x1000);
+    traced = cpu_stat_instructions(cpu);
+    cpu_run(cpu, 0);
+    VALUE_ASSERT("trace delta calls", z_test_delta_calls, 22);
+    VALUE_ASSERT("trace delta changes", z_test_delta_changes, 11);
+    VALUE_ASSERT("trace delta step", z_test_delta_step, traced + 21);
+
+    // registers the host changes between runs come along with the next instruction
+    cpu_write_register(cpu, 9, 0x99);
+    cpu_write_register(cpu, 10, 0xaa);
+    cpu_set_pc(cpu, 0x1000);
+    cpu_run(cpu, 0);
+    VALUE_ASSERT("trace delta host changes", z_test_delta_changes, 11 + 2 + 11);
+    for (int i = 0; i < 32; i++) VALUE_ASSERT("trace delta registers", z_test_delta_registers[i], cpu_read_register(cpu, i));
+    cpu_set_config(cpu, rc_nothing);
+    cpu_trace_delta(cpu, NULL);
+
+    // ---------- Multiple Instances ----------
+
+    // a second CPU shares nothing with the first
+    riscv_cpu_t* other = cpu_init(NULL, &test_services);
+    cpu_write_register(cpu, 7, 1);
+    cpu_write_register(other, 7, 2);
+    cpu_set_pc(other, 0x3000);
+    VALUE_ASSERT("instance registers", cpu_read_register(cpu, 7), 1);
+    VALUE_ASSERT("instance registers", cpu_read_register(other, 7), 2);
+    VALUE_ASSERT("instance pc", cpu_get_pc(other), 0x3000);
+
+    // re-running a program on a fresh instance gives the same result as the first one
+    cpu_write_register(other, 4, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00000) | itype_immediate(17));
+    cpu_write_register(other, 5, 0x2000);
+    cpu_set_pc(other, 0x2000);
+    while (cpu_execute(other)) continue;
+    VALUE_ASSERT("instance execution", cpu_read_register(other, 6), 17);
+    REG_ASSERT(6, 13);
+
+    // re-initializing an instance resets it in place, so the counted loop has to be decoded again (and is only decoded once per init)
+    dword lookups, decodes;
+    for (int i = 0; i < 2; i++) {
+        cpu_set_pc(other, 0x1000);
+        cpu_run(other, 0);
+    }
+    VALUE_ASSERT("re-init", cpu_init(other, &test_services) == other, 1);
+    VALUE_ASSERT("re-init registers", cpu_read_register(other, 6), 0);
+    cpu_block_stats(other, &lookups, &decodes);
+    VALUE_ASSERT("re-init decodes", decodes, 0);
+    for (int i = 0; i < 2; i++) {
+        cpu_set_pc(other, 0x1000);
+        VALUE_ASSERT("re-init run", cpu_run(other, 0), 22);
+    }
+    cpu_block_stats(other, &lookups, &decodes);
+    VALUE_ASSERT("re-init decodes", decodes, 3);
+    cpu_free(other);
+
+    // ---------- State ----------
+
+    // the pc and all registers travel in one struct, with x0 pinned to zero both ways
+    rsk_state_t state = { .version = RSK_STATE_VERSION, .size = sizeof(rsk_state_t) };
+    VALUE_ASSERT("state get", cpu_get_state(cpu, &state), 1);
+    VALUE_ASSERT("state pc", state.pc, cpu_get_pc(cpu));
+    for (int i = 0; i < 32; i++) VALUE_ASSERT("state registers", state.x[i], cpu_read_register(cpu, i));
+
+    rsk_state_t saved = state;
+    for (int i = 0; i < 32; i++) state.x[i] = 0x1000 + i;
+    state.pc = 0x5000;
+    VALUE_ASSERT("state set", cpu_set_state(cpu, &state), 1);
+    VALUE_ASSERT("state set pc", cpu_get_pc(cpu), 0x5000);
+    REG_ASSERT(0, 0);
+    REG_ASSERT(31, 0x101f);
+
+    // hosts from a later version get the fields the kernel knows, and layouts too small for any version are refused
+    state.version = RSK_STATE_VERSION + 1;
+    VALUE_ASSERT("state newer version", cpu_get_state(cpu, &state), RSK_STATE_VERSION);
+    state.size = offsetof(rsk_state_t, x);
+    VALUE_ASSERT("state too small", cpu_set_state(cpu, &saved) && !cpu_get_state(cpu, &state), 1);
+    VALUE_ASSERT("state restored pc", cpu_get_pc(cpu), saved.pc);
+
+    // ---------- Profiler ----------
+
+    // main calls f (through ra), f calls g (through t0), and g loops 100 times before both return
+    addr = 0x6000;
+    EMIT(addr, OPCODE(1101111) | RD(00001) | jtype_immediate(0x100));
+    EMIT(addr, INSTR_EBREAK);
+    addr = 0x6100;
+    EMIT(addr, OPCODE(1101111) | RD(00101) | jtype_immediate(0x100));
+    EMIT(addr, OPCODE(1100111) | FUNCT3(000) | RD(00000) | RS1(00001) | itype_immediate(0));
+    addr = 0x6200;
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00000) | itype_immediate(0));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00111) | RS1(00000) | itype_immediate(100));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00110) | itype_immediate(1));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(001) | RS1(00110) | RS2(00111) | btype_immediate(-4));
+    EMIT(addr, OPCODE(1100111) | FUNCT3(000) | RD(00000) | RS1(00101) | itype_immediate(0));
+
+    // every 10th of the 206 instructions is sampled, all of them inside g
+    VALUE_ASSERT("profile start", cpu_profile_start(cpu, 10), 1);
+    cpu_set_pc(cpu, 0x6000);
+    VALUE_ASSERT("profiled run", cpu_run(cpu, 0), 206);
+    VALUE_ASSERT("profiled run pc", cpu_get_pc(cpu), 0x6004);
+    VALUE_ASSERT("profile write", cpu_profile_write(cpu, "build/rv64i_profile.txt"), 1);
+    cpu_profile_start(cpu, 0);
+
+    FILE* profile = fopen("build/rv64i_profile.txt", "r");
+    char stack[128];
+    unsigned long samples, total_samples = 0;
+    while (NULL != profile && 2 == fscanf(profile, "%127s %lu", stack, &samples)) {
+        VALUE_ASSERT("profile stack", strncmp(stack, "0x6000;0x6100;0x620", 19), 0);
+        total_samples += samples;
+    }
+    VALUE_ASSERT("profile samples", total_samples, 20);
+    if (NULL != profile) fclose(profile);
+
+    // sampling every instruction also catches both returns: the last sample is back in main, with nothing left on the stack
+    cpu_profile_start(cpu, 1);
+    cpu_set_pc(cpu, 0x6000);
+    cpu_run(cpu, 0);
+    cpu_profile_write(cpu, "build/rv64i_profile.txt");
+    cpu_profile_start(cpu, 0);
+
+    profile = fopen("build/rv64i_profile.txt", "r");
+    unsigned long main_samples = 0;
+    total_samples = 0;
+    while (NULL != profile && 2 == fscanf(profile, "%127s %lu", stack, &samples)) {
+        if (0 == strcmp(stack, "0x6004")) main_samples += samples;
+        total_samples += samples;
+    }
+    VALUE_ASSERT("profile samples", total_samples, 206);
+    VALUE_ASSERT("profile samples in main", main_samples, 1);
+    if (NULL != profile) fclose(profile);
+
+    // ---------- Snapshots ----------
+
+    // save halfway through the profiled program, then clobber everything it depends on
+    static byte snapshot_ram[0x100000];
+    memcpy(snapshot_ram, z_test_ram, TESTING_RAM_SIZE);
+    cpu_map_ram(cpu, snapshot_ram, 0, sizeof(snapshot_ram), 1);
+    cpu_set_pc(cpu, 0x6000);
+    VALUE_ASSERT("run to snapshot", cpu_run(cpu, 103), 103);
+    unsigned int snapshot_instructions = cpu_stat_instructions(cpu);
+    VALUE_ASSERT("snapshot save", cpu_snapshot_save(cpu, "build/rv64i_snapshot.bin"), 1);
+
+    for (int i = 1; i < 32; i++) cpu_write_register(cpu, i, 0xbad);
+    cpu_set_pc(cpu, 0);
+    memset(snapshot_ram + 0x6000, 0, 0x1000);
+    snapshot_ram[0xf0000] = 1;
+
+    // the rest of the run picks up where the snapshot left off
+    VALUE_ASSERT("snapshot restore", cpu_snapshot_restore(cpu, "build/rv64i_snapshot.bin"), 1);
+    VALUE_ASSERT("restored instructions", cpu_stat_instructions(cpu), snapshot_instructions);
+    VALUE_ASSERT("restored RAM", snapshot_ram[0xf0000], 0);
+    VALUE_ASSERT("run from snapshot", cpu_run(cpu, 0), 103);
+    VALUE_ASSERT("run from snapshot pc", cpu_get_pc(cpu), 0x6004);
+    REG_ASSERT(6, 100);
+
+    // pages of zeros are left out of the file
+    struct stat snapshot_stat;
+    VALUE_ASSERT("snapshot size", 0 == stat("build/rv64i_snapshot.bin", &snapshot_stat) && snapshot_stat.st_size < 0x10000, 1);
+
+    // a snapshot only restores into the RAM layout it was saved from
+    cpu_map_ram(cpu, NULL, 0, sizeof(snapshot_ram), 0);
+    cpu_map_ram(cpu, snapshot_ram, 0, TESTING_RAM_SIZE, 1);
+    VALUE_ASSERT("snapshot layout mismatch", cpu_snapshot_restore(cpu, "build/rv64i_snapshot.bin"), 0);
+    VALUE_ASSERT("snapshot layout mismatch pc", cpu_get_pc(cpu), 0x6004);
+    VALUE_ASSERT("missing snapshot", cpu_snapshot_restore(cpu, "build/no_such_snapshot.bin"), 0);
+    cpu_map_ram(cpu, NULL, 0, TESTING_RAM_SIZE, 0);
+
+    // ---------- Forks ----------
+
+    // a fork starts out in the same state and runs the same program to the same result
+    cpu_map_ram(cpu, snapshot_ram, 0, sizeof(snapshot_ram), 1);
+    cpu_store_word(cpu, 0x8000, 1);
+    cpu_write_register(cpu, 7, 0x77);
+    cpu_set_pc(cpu, 0x6000);
+    riscv_cpu_t* fork = cpu_fork(cpu, NULL);
+    VALUE_ASSERT("fork", NULL != fork, 1);
+    VALUE_ASSERT("fork pc", cpu_get_pc(fork), 0x6000);
+    VALUE_ASSERT("fork registers", cpu_read_register(fork, 7), 0x77);
+    VALUE_ASSERT("fork instructions", cpu_stat_instructions(fork), cpu_stat_instructions(cpu));
+    VALUE_ASSERT("fork run", cpu_run(fork, 0), 206);
+    VALUE_ASSERT("fork run registers", cpu_read_register(fork, 6), 100);
+    VALUE_ASSERT("fork run parent pc", cpu_get_pc(cpu), 0x6000);
+
+    // stores made by a fork are private to it, including from other forks of the same image
+    cpu_store_word(fork, 0x8000, 2);
+    riscv_cpu_t* sibling = cpu_fork(cpu, NULL);
+    VALUE_ASSERT("fork store", cpu_load_word(fork, 0x8000), 2);
+    VALUE_ASSERT("fork store parent", snapshot_ram[0x8000], 1);
+    VALUE_ASSERT("fork store sibling", cpu_load_word(sibling, 0x8000), 1);
+
+    // stores made by the parent are only seen by forks made afterwards
+    cpu_store_word(cpu, 0x8000, 3);
+    riscv_cpu_t* late = cpu_fork(cpu, NULL);
+    VALUE_ASSERT("parent store fork", cpu_load_word(sibling, 0x8000), 1);
+    VALUE_ASSERT("parent store late fork", cpu_load_word(late, 0x8000), 3);
+    cpu_free(late);
+    cpu_free(sibling);
+    cpu_free(fork);
+    cpu_map_ram(cpu, NULL, 0, sizeof(snapshot_ram), 0);
+
+    // ---------- Background Runs ----------
+
+    // a background run of the profiled program gets as far as a foreground one
+    cpu_set_pc(cpu, 0x6000);
+    VALUE_ASSERT("async start", cpu_run_async(cpu, 0), 1);
+    VALUE_ASSERT("async wait", cpu_wait(cpu), 206);
+    VALUE_ASSERT("async pc", cpu_get_pc(cpu), 0x6004);
+    VALUE_ASSERT("async running", cpu_is_running(cpu), 0);
+    REG_ASSERT(6, 100);
+
+    // an endless loop (on its own CPU, to keep it out of the counters) only stops when halted from the controlling thread, and just one background run can be in progress
+    addr = 0x7000;
+    EMIT(addr, OPCODE(1101111) | RD(00000) | jtype_immediate(0));
+    riscv_cpu_t* runner = cpu_init(NULL, &test_services);
+    cpu_set_pc(runner, 0x7000);
+    VALUE_ASSERT("async loop start", cpu_run_async(runner, 0), 1);
+    VALUE_ASSERT("async loop running", cpu_is_running(runner), 1);
+    VALUE_ASSERT("async second start", cpu_run_async(runner, 0), 0);
+    usleep(10000);
+    cpu_process_signal(runner, rs_halt);
+    VALUE_ASSERT("async halt", cpu_wait(runner) > 0, 1);
+    VALUE_ASSERT("async halt pc", cpu_get_pc(runner), 0x7000);
+    VALUE_ASSERT("async halt running", cpu_is_running(runner), 0);
+    VALUE_ASSERT("async wait without run", cpu_wait(runner), 0);
+
+    // freeing a CPU stops its background run first
+    VALUE_ASSERT("async free start", cpu_run_async(runner, 0), 1);
+    cpu_free(runner);
+
+    // halts sent while stopped do not cut the next run short
+    cpu_process_signal(cpu, rs_halt);
+    cpu_set_pc(cpu, 0x6000);
+    VALUE_ASSERT("stale halt", cpu_run(cpu, 0), 206);
+
+    // ---------- Stats Page ----------
+
+    // the profiled program updates a page published every 50 instructions 4 times while running, and once more when it ends
+    riscv_cpu_t* publisher = cpu_init(NULL, &test_services);
+    VALUE_ASSERT("stats page bad path", cpu_stats_publish(publisher, "build/no_such_dir/rv64i_stats.page", 50), 0);
+    VALUE_ASSERT("stats page publish", cpu_stats_publish(publisher, "build/rv64i_stats.page", 50), 1);
+    int page_fd = open("build/rv64i_stats.page", O_RDONLY);
+    const rsk_stats_page_t* page = (const rsk_stats_page_t*) mmap(NULL, sizeof(rsk_stats_page_t), PROT_READ, MAP_SHARED, page_fd, 0);
+    close(page_fd);
+    VALUE_ASSERT("stats page map", MAP_FAILED != (void*) page, 1);
+    if (MAP_FAILED == (void*) page) return 1;
+    VALUE_ASSERT("stats page magic", page->magic, RSK_STATS_PAGE_MAGIC);
+    VALUE_ASSERT("stats page version", page->version, RSK_STATS_PAGE_VERSION);
+    VALUE_ASSERT("stats page size", page->size, sizeof(rsk_stats_page_t));
+
+    cpu_set_pc(publisher, 0x6000);
+    cpu_run(publisher, 0);
+    VALUE_ASSERT("stats page updates", page->updates, 5);
+    VALUE_ASSERT("stats page sequence", page->sequence, 10);
+    VALUE_ASSERT("stats page instructions", page->instructions, 206);
+    VALUE_ASSERT("stats page pc", page->pc, 0x6004);
+    VALUE_ASSERT("stats page running", page->running, 0);
+    dword publisher_lookups, publisher_decodes;
+    cpu_block_stats(publisher, &publisher_lookups, &publisher_decodes);
+    VALUE_ASSERT("stats page blocks", page->block_lookups, publisher_lookups);
+    VALUE_ASSERT("stats page block hit rate", page->block_hit_rate >= 0.0 && page->block_hit_rate < 1.0, 1);
+    VALUE_ASSERT("stats page clock", page->time_ns >= page->start_ns, 1);
+
+    // a background run can be watched while it goes on, and publishing stops (leaving the page as it was) when asked to
+    cpu_set_pc(publisher, 0x7000);
+    cpu_run_async(publisher, 0);
+    while (page->updates < 8) usleep(1000);
+    VALUE_ASSERT("stats page live", page->running, 1);
+    cpu_process_signal(publisher, rs_halt);
+    cpu_wait(publisher);
+    VALUE_ASSERT("stats page halted", page->running, 0);
+    VALUE_ASSERT("stats page stop", cpu_stats_publish(publisher, NULL, 0), 1);
+    dword page_updates = page->updates;
+    cpu_set_pc(publisher, 0x6000);
+    cpu_run(publisher, 0);
+    VALUE_ASSERT("stats page stopped", page->updates, page_updates);
+    munmap((void*) page, sizeof(rsk_stats_page_t));
+    cpu_free(publisher);
+
+    // ---------- MMIO Replay ----------
+
+    // with no RAM mapped, the load and the store of x5 = mem[x1] + 1; mem[x1 + 4] = x5 both go to the host services, and are recorded
+    addr = 0x7400;
+    EMIT(addr, OPCODE(0000011) | FUNCT3(010) | RD(00101) | RS1(00001) | itype_immediate(0));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00101) | RS1(00101) | itype_immediate(1));
+    EMIT(addr, OPCODE(0100011) | FUNCT3(010) | RS1(00001) | RS2(00101) | stype_immediate(4));
+    EMIT(addr, INSTR_EBREAK);
+    test_store(0xd900, 41, 4);
+    test_store(0xd904, 0, 4);
+    riscv_cpu_t* replayer = cpu_init(NULL, &quiet_services);
+    VALUE_ASSERT("mmio record bad path", cpu_mmio_record(replayer, "build/no_such_dir/rv64i_mmio.log"), 0);
+    VALUE_ASSERT("mmio record", cpu_mmio_record(replayer, "build/rv64i_mmio.log"), 1);
+    cpu_write_register(replayer, 1, 0xd900);
+    cpu_set_pc(replayer, 0x7400);
+    VALUE_ASSERT("mmio recorded run", cpu_run(replayer, 0), 3);
+    VALUE_ASSERT("mmio record stop", cpu_mmio_record(replayer, NULL), 1);
+    VALUE_ASSERT("mmio recorded store", test_load(0xd904, 4), 42);
+    struct stat mmio_stat;
+    VALUE_ASSERT("mmio log size", 0 == stat("build/rv64i_mmio.log", &mmio_stat) && (size_t) mmio_stat.st_size == sizeof(rsk_mmio_header_t) + 2 * sizeof(rsk_mmio_event_t), 1);
+
+    // a replay loads what was recorded and checks the store without passing either on to the host
+    rsk_mmio_status_t mmio_status;
+    test_store(0xd900, 0, 4);
+    test_store(0xd904, 0, 4);
+    cpu_init(replayer, &quiet_services);
+    VALUE_ASSERT("mmio replay missing", cpu_mmio_replay(replayer, "build/no_such_mmio.log"), 0);
+    VALUE_ASSERT("mmio replay bad log", cpu_mmio_replay(replayer, "build/rv64i_stats.page"), 0);
+    VALUE_ASSERT("mmio replay", cpu_mmio_replay(replayer, "build/rv64i_mmio.log"), 1);
+    cpu_write_register(replayer, 1, 0xd900);
+    cpu_set_pc(replayer, 0x7400);
+    VALUE_ASSERT("mmio replayed run", cpu_run(replayer, 0), 3);
+    VALUE_ASSERT("mmio replayed load", cpu_read_register(replayer, 5), 42);
+    VALUE_ASSERT("mmio replayed store", test_load(0xd904, 4), 0);
+    VALUE_ASSERT("mmio replay status", cpu_mmio_replay_status(replayer, &mmio_status), 0);
+    VALUE_ASSERT("mmio replay events", mmio_status.events, 2);
+    VALUE_ASSERT("mmio replay replayed", mmio_status.replayed, 2);
+
+    // a store that doesn't match is reported with its step, and it (and the rest of the run) goes to the host again
+    cpu_init(replayer, &quiet_services);
+    cpu_mmio_replay(replayer, "build/rv64i_mmio.log");
+    test_store(0x7404, OPCODE(0010011) | FUNCT3(000) | RD(00101) | RS1(00101) | itype_immediate(2), 4);
+    cpu_write_register(replayer, 1, 0xd900);
+    cpu_set_pc(replayer, 0x7400);
+    z_test_quiet_messages = 0;
+    cpu_run(replayer, 0);
+    VALUE_ASSERT("mmio divergence", cpu_mmio_replay_status(replayer, &mmio_status), 1);
+    VALUE_ASSERT("mmio divergence message", z_test_quiet_messages, 1);
+    VALUE_ASSERT("mmio divergence step", mmio_status.actual.step, 2);
+    VALUE_ASSERT("mmio divergence expected", mmio_status.expected.value, 42);
+    VALUE_ASSERT("mmio divergence actual", mmio_status.actual.value, 43);
+    VALUE_ASSERT("mmio divergence replayed", mmio_status.replayed, 1);
+    VALUE_ASSERT("mmio divergence store", test_load(0xd904, 4), 43);
+
+    // running past the end of the log diverges as well, with nothing expected
+    test_store(0x7404, OPCODE(0010011) | FUNCT3(000) | RD(00101) | RS1(00101) | itype_immediate(1), 4);
+    cpu_init(replayer, &quiet_services);
+    cpu_mmio_replay(replayer, "build/rv64i_mmio.log");
+    cpu_write_register(replayer, 1, 0xd900);
+    cpu_set_pc(replayer, 0x7400);
+    cpu_run(replayer, 0);
+    cpu_set_pc(replayer, 0x7400);
+    cpu_run(replayer, 0);
+    VALUE_ASSERT("mmio past the end", cpu_mmio_replay_status(replayer, &mmio_status), 1);
+    VALUE_ASSERT("mmio past the end step", mmio_status.actual.step, 3);
+    VALUE_ASSERT("mmio past the end expected", mmio_status.expected.size, 0);
+    cpu_free(replayer);
+
+    // ---------- Breakpoints and Watchpoints ----------
+
+    // a loop storing x1 to mem[x3] and loading x4 from mem[x5] 100 times, hot enough for the JIT
+    addr = 0x7600;
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00001) | RS1(00000) | itype_immediate(0));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00010) | RS1(00000) | itype_immediate(100));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00001) | RS1(00001) | itype_immediate(1));
+    EMIT(addr, OPCODE(0100011) | FUNCT3(010) | RS1(00011) | RS2(00001) | stype_immediate(0));
+    EMIT(addr, OPCODE(0000011) | FUNCT3(010) | RD(00100) | RS1(00101) | itype_immediate(0));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(001) | RS1(00001) | RS2(00010) | btype_immediate(-12));
+    EMIT(addr, INSTR_EBREAK);
+    rsk_debug_status_t debug_status;
+    riscv_cpu_t* debugger = cpu_init(NULL, &test_services);
+    cpu_map_ram(debugger, z_test_ram, 0, TESTING_RAM_SIZE, 1);
+    cpu_set_config(debugger, rc_jit);
+    cpu_write_register(debugger, 3, 0xf100);
+    cpu_write_register(debugger, 5, 0xf900);
+    cpu_set_pc(debugger, 0x7600);
+    VALUE_ASSERT("debug warm-up run", cpu_run(debugger, 0), 402);
+    VALUE_ASSERT("debug no stop", cpu_debug_status(debugger, &debug_status), rb_none);
+
+    // a breakpoint in the middle of a block stops the run right before it
+    VALUE_ASSERT("break set", cpu_break_set(debugger, 0x7610), 1);
+    unsigned int debug_start = cpu_stat_instructions(debugger);
+    cpu_set_pc(debugger, 0x7600);
+    VALUE_ASSERT("break run", cpu_run(debugger, 0), 4);
+    VALUE_ASSERT("break pc", cpu_get_pc(debugger), 0x7610);
+    VALUE_ASSERT("break status", cpu_debug_status(debugger, &debug_status), rb_breakpoint);
+    VALUE_ASSERT("break status step", debug_status.step, debug_start + 4);
+    VALUE_ASSERT("break status pc", debug_status.pc, 0x7610);
+
+    // resuming executes the instruction at the breakpoint, and stops there again on the next iteration
+    VALUE_ASSERT("break resume", cpu_run(debugger, 0), 4);
+    VALUE_ASSERT("break resume x1", cpu_read_register(debugger, 1), 2);
+    VALUE_ASSERT("break resume pc", cpu_get_pc(debugger), 0x7610);
+    VALUE_ASSERT("break step over", cpu_run(debugger, 1), 1);
+    VALUE_ASSERT("break step over pc", cpu_get_pc(debugger), 0x7614);
+    VALUE_ASSERT("break step over status", cpu_debug_status(debugger, &debug_status), rb_none);
+
+    // once cleared, the run goes on to the ebreak
+    VALUE_ASSERT("break clear", cpu_break_clear(debugger, 0x7610), 1);
+    VALUE_ASSERT("break clear missing", cpu_break_clear(debugger, 0x7610), 0);
+    cpu_run(debugger, 0);
+    VALUE_ASSERT("break cleared x1", cpu_read_register(debugger, 1), 100);
+    VALUE_ASSERT("break cleared", cpu_debug_status(debugger, &debug_status), rb_none);
+    for (int i = 0; i < RSK_BREAKPOINT_MAX; i++) cpu_break_set(debugger, 0x100 + 4 * i);
+    VALUE_ASSERT("break full", cpu_break_set(debugger, 0x7610), 0);
+    for (int i = 0; i < RSK_BREAKPOINT_MAX; i++) cpu_break_clear(debugger, 0x100 + 4 * i);
+
+    // a watched store (to mapped RAM, from compiled code) completes, and the run stops right after it
+    VALUE_ASSERT("watch set", cpu_watch_set(debugger, 0xf100, 4, rw_store), 1);
+    debug_start = cpu_stat_instructions(debugger);
+    cpu_set_pc(debugger, 0x7600);
+    VALUE_ASSERT("watch store run", cpu_run(debugger, 0), 4);
+    VALUE_ASSERT("watch store pc", cpu_get_pc(debugger), 0x7610);
+    VALUE_ASSERT("watch store value", test_load(0xf100, 4), 1);
+    VALUE_ASSERT("watch store status", cpu_debug_status(debugger, &debug_status), rb_watchpoint);
+    VALUE_ASSERT("watch store step", debug_status.step, debug_start + 3);
+    VALUE_ASSERT("watch store status pc", debug_status.pc, 0x760c);
+    VALUE_ASSERT("watch store address", debug_status.address, 0xf100);
+    VALUE_ASSERT("watch store kind", debug_status.size == 4 && debug_status.store, 1);
+    VALUE_ASSERT("watch store resume", cpu_run(debugger, 0), 4);
+    VALUE_ASSERT("watch store resume x1", cpu_read_register(debugger, 1), 2);
+
+    // loads (even from the same page) don't set off a store watchpoint
+    VALUE_ASSERT("watch clear", cpu_watch_clear(debugger, 0xf100, 4), 1);
+    VALUE_ASSERT("watch clear missing", cpu_watch_clear(debugger, 0xf100, 4), 0);
+    cpu_watch_set(debugger, 0xf900, 4, rw_store);
+    cpu_set_pc(debugger, 0x7600);
+    VALUE_ASSERT("watch unwatched run", cpu_run(debugger, 0), 402);
+    VALUE_ASSERT("watch unwatched status", cpu_debug_status(debugger, &debug_status), rb_none);
+    cpu_watch_clear(debugger, 0xf900, 4);
+
+    // a watched load stops the run right after it
+    cpu_watch_set(debugger, 0xf900, 4, rw_load);
+    debug_start = cpu_stat_instructions(debugger);
+    cpu_set_pc(debugger, 0x7600);
+    VALUE_ASSERT("watch load run", cpu_run(debugger, 0), 5);
+    VALUE_ASSERT("watch load pc", cpu_get_pc(debugger), 0x7614);
+    VALUE_ASSERT("watch load status", cpu_debug_status(debugger, &debug_status), rb_watchpoint);
+    VALUE_ASSERT("watch load step", debug_status.step, debug_start + 4);
+    VALUE_ASSERT("watch load kind", debug_status.address == 0xf900 && !debug_status.store, 1);
+    cpu_watch_clear(debugger, 0xf900, 4);
+
+    // any overlap counts, and invalid watchpoints are refused
+    cpu_watch_set(debugger, 0xf103, 1, rw_access);
+    cpu_set_pc(debugger, 0x7600);
+    VALUE_ASSERT("watch overlap", cpu_run(debugger, 0), 4);
+    VALUE_ASSERT("watch empty", cpu_watch_set(debugger, 0xf100, 0, rw_store), 0);
+    VALUE_ASSERT("watch no kind", cpu_watch_set(debugger, 0xf100, 4, 0), 0);
+    VALUE_ASSERT("watch bad kind", cpu_watch_set(debugger, 0xf100, 4, 4), 0);
+
+    // rsk_init removes everything
+    cpu_break_set(debugger, 0x7610);
+    cpu_init(debugger, &test_services);
+    cpu_map_ram(debugger, z_test_ram, 0, TESTING_RAM_SIZE, 1);
+    cpu_write_register(debugger, 3, 0xf100);
+    cpu_write_register(debugger, 5, 0xf900);
+    cpu_set_pc(debugger, 0x7600);
+    VALUE_ASSERT("debug reset run", cpu_run(debugger, 0), 402);
+    cpu_free(debugger);
+
+    // ---------- Cache Model ----------
+
+    // geometries that don't describe a cache are refused
+    riscv_cpu_t* model = cpu_init(NULL, &test_services);
+    rsk_cache_config_t odd_line = { 1024, 48, 4, rcp_lru };
+    rsk_cache_config_t too_many_ways = { 4096, 64, 128, rcp_lru };
+    rsk_cache_config_t too_small = { 128, 64, 4, rcp_lru };
+    VALUE_ASSERT("cache odd line", cpu_cache_config(model, NULL, &odd_line), 0);
+    VALUE_ASSERT("cache too many ways", cpu_cache_config(model, &too_many_ways, NULL), 0);
+    VALUE_ASSERT("cache too small", cpu_cache_config(model, NULL, &too_small), 0);
+
+    // five lines of the same set of a 4-way cache: LRU evicts B for E, while tree PLRU evicts C (and so still hits B)
+    rsk_cache_config_t lru = { 1024, 64, 4, rcp_lru };
+    rsk_cache_config_t plru = { 1024, 64, 4, rcp_plru };
+    const dword same_set[] = { 0x9000, 0x9100, 0x9200, 0x9300, 0x9000, 0x9400, 0x9100 };
+    rsk_cache_stats_t cache_stats;
+    rsk_stat_t cache_counts;
+    cpu_set_config(model, rc_cache_on);
+    VALUE_ASSERT("cache LRU", cpu_cache_config(model, NULL, &lru), 1);
+    for (size_t i = 0; i < sizeof(same_set) / sizeof(dword); i++) cpu_load_word(model, same_set[i]);
+    cpu_cache_report(model, &cache_stats);
+    cpu_fill_stats(model, &cache_counts);
+    VALUE_ASSERT("LRU loads", cache_stats.loads, 7);
+    VALUE_ASSERT("LRU load misses", cache_stats.load_misses, 6);
+    VALUE_ASSERT("LRU stats load misses", cache_counts.load_misses, 6);
+    VALUE_ASSERT("cache PLRU", cpu_cache_config(model, NULL, &plru), 1);
+    for (size_t i = 0; i < sizeof(same_set) / sizeof(dword); i++) cpu_load_word(model, same_set[i]);
+    cpu_cache_report(model, &cache_stats);
+    VALUE_ASSERT("PLRU load misses", cache_stats.load_misses, 5);
+
+    // an access straddling two lines fills both, and stores allocate lines too
+    cpu_cache_config(model, NULL, &lru);
+    cpu_load_word(model, 0x903e);
+    cpu_load_byte(model, 0x9040);
+    cpu_store_dword(model, 0x9800, 0);
+    cpu_load_dword(model, 0x9800);
+    cpu_cache_report(model, &cache_stats);
+    VALUE_ASSERT("straddling loads", cache_stats.loads, 3);
+    VALUE_ASSERT("straddling load misses", cache_stats.load_misses, 1);
+    VALUE_ASSERT("allocating stores", cache_stats.stores, 1);
+    VALUE_ASSERT("allocating store misses", cache_stats.store_misses, 1);
+
+    // the profiled program fetches 206 instructions from three lines, and nothing is counted with the model off
+    cpu_set_pc(model, 0x6000);
+    VALUE_ASSERT("cached run", cpu_run(model, 0), 206);
+    cpu_cache_report(model, &cache_stats);
+    VALUE_ASSERT("cached run fetches", cache_stats.fetches, 206);
+    VALUE_ASSERT("cached run fetch misses", cache_stats.fetch_misses, 3);
+    cpu_set_config(model, rc_nothing);
+    cpu_set_pc(model, 0x6000);
+    cpu_run(model, 0);
+    cpu_cache_report(model, &cache_stats);
+    VALUE_ASSERT("uncached run fetches", cache_stats.fetches, 206);
+    cpu_free(model);
+
+    // ---------- Bulk Memory ----------
+
+    // a word copy loop runs all but its last iteration as one bulk copy, with the same memory, registers and counts as stepping it
+    cpu_map_ram(cpu, z_test_ram, 0, TESTING_RAM_SIZE, 1);
+    addr = 0x7100;
+    EMIT(addr, OPCODE(0000011) | FUNCT3(010) | RD(01000) | RS1(00101) | itype_immediate(0));
+    EMIT(addr, OPCODE(0100011) | FUNCT3(010) | RS1(00110) | RS2(01000) | stype_immediate(0));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00101) | RS1(00101) | itype_immediate(4));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00110) | itype_immediate(4));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(001) | RS1(00101) | RS2(00111) | btype_immediate(-16));
+    EMIT(addr, INSTR_EBREAK);
+    for (int i = 0; i < 64; i++) test_store(0xb000 + 4 * i, 0x1000 + i, 4);
+
+    rsk_stat_t bulk_before, bulk_after;
+    cpu_fill_stats(cpu, &bulk_before);
+    cpu_write_register(cpu, 5, 0xb000);
+    cpu_write_register(cpu, 6, 0xc000);
+    cpu_write_register(cpu, 7, 0xb100);
+    cpu_set_pc(cpu, 0x7100);
+    VALUE_ASSERT("bulk copy run", cpu_run(cpu, 0), 320);
+    cpu_fill_stats(cpu, &bulk_after);
+    VALUE_ASSERT("bulk copy loads", bulk_after.loads - bulk_before.loads, 64);
+    VALUE_ASSERT("bulk copy stores", bulk_after.stores - bulk_before.stores, 64);
+    VALUE_ASSERT("bulk copy first", test_load(0xc000, 4), 0x1000);
+    VALUE_ASSERT("bulk copy last", test_load(0xc0fc, 4), 0x103f);
+    VALUE_ASSERT("bulk copy end", test_load(0xc100, 4), 0);
+    REG_ASSERT(5, 0xb100);
+    REG_ASSERT(6, 0xc100);
+    REG_ASSERT(8, 0x103f);
+
+    // bounded runs stop on the same instruction as stepping would, part way through an iteration
+    cpu_write_register(cpu, 5, 0xb000);
+    cpu_write_register(cpu, 6, 0xd000);
+    cpu_set_pc(cpu, 0x7100);
+    VALUE_ASSERT("bulk bounded run", cpu_run(cpu, 17), 17);
+    REG_ASSERT(5, 0xb00c);
+    REG_ASSERT(8, 0x1003);
+    VALUE_ASSERT("bulk bounded run pc", cpu_get_pc(cpu), 0x7108);
+    VALUE_ASSERT("bulk bounded run memory", test_load(0xd00c, 4) == 0x1003 && test_load(0xd010, 4) == 0, 1);
+    VALUE_ASSERT("bulk bounded run (continued)", cpu_run(cpu, 0), 303);
+    VALUE_ASSERT("bulk bounded run (continued) memory", test_load(0xd0fc, 4), 0x103f);
+
+    // a fill loop counting down to zero, and a doubleword fill whose end isn't a whole number of elements away
+    addr = 0x7200;
+    EMIT(addr, OPCODE(0100011) | FUNCT3(010) | RS1(00110) | RS2(01001) | stype_immediate(0));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00110) | itype_immediate(4));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(01010) | RS1(01010) | itype_immediate(-1));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(001) | RS1(01010) | RS2(00000) | btype_immediate(-12));
+    EMIT(addr, OPCODE(0100011) | FUNCT3(011) | RS1(00110) | RS2(01001) | stype_immediate(0));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00110) | itype_immediate(8));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(110) | RS1(00110) | RS2(00111) | btype_immediate(-8));
+    EMIT(addr, INSTR_EBREAK);
+
+    cpu_write_register(cpu, 6, 0xe000);
+    cpu_write_register(cpu, 7, 0xe100 + 8 * 10 + 3);
+    cpu_write_register(cpu, 9, 0x5a5a5a5a);
+    cpu_write_register(cpu, 10, 64);
+    cpu_fill_stats(cpu, &bulk_before);
+    cpu_set_pc(cpu, 0x7200);
+    VALUE_ASSERT("bulk fill run", cpu_run(cpu, 0), 4 * 64 + 3 * 11);
+    cpu_fill_stats(cpu, &bulk_after);
+    VALUE_ASSERT("bulk fill stores", bulk_after.stores - bulk_before.stores, 64 + 11);
+    VALUE_ASSERT("bulk fill words", test_load(0xe000, 4) == 0x5a5a5a5a && test_load(0xe0fc, 4) == 0x5a5a5a5a, 1);
+    VALUE_ASSERT("bulk fill dwords", test_load(0xe100, 8) == 0x5a5a5a5a && test_load(0xe150, 8) == 0x5a5a5a5a, 1);
+    VALUE_ASSERT("bulk fill end", test_load(0xe158, 8), 0);
+    REG_ASSERT(6, 0xe158);
+    REG_ASSERT(10, 0);
+
+    // byte copies too, leaving the last element sign-extended in the value register as lb would
+    addr = 0x7300;
+    EMIT(addr, OPCODE(0000011) | FUNCT3(000) | RD(01000) | RS1(00101) | itype_immediate(0));
+    EMIT(addr, OPCODE(0100011) | FUNCT3(000) | RS1(00110) | RS2(01000) | stype_immediate(0));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00101) | RS1(00101) | itype_immediate(1));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00110) | itype_immediate(1));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(110) | RS1(00101) | RS2(00111) | btype_immediate(-16));
+    EMIT(addr, INSTR_EBREAK);
+    for (int i = 0; i < 64; i++) test_store(0xd700 + i, 0x80 + i, 1);
+
+    cpu_write_register(cpu, 5, 0xd700);
+    cpu_write_register(cpu, 6, 0xd800);
+    cpu_write_register(cpu, 7, 0xd740);
+    cpu_set_pc(cpu, 0x7300);
+    VALUE_ASSERT("bulk byte copy run", cpu_run(cpu, 0), 320);
+    VALUE_ASSERT("bulk byte copy", test_load(0xd800, 8) == 0x8786858483828180 && test_load(0xd838, 8) == 0xbfbebdbcbbbab9b8, 1);
+    VALUE_ASSERT("bulk byte copy end", test_load(0xd840, 1), 0);
+    REG_ASSERT(8, 0xffffffffffffffbf);
+
+    // copies reaching past mapped RAM (i.e. into MMIO) and overlapping copies that a forward copy would get wrong are stepped as usual
+    cpu_map_ram(cpu, NULL, 0, TESTING_RAM_SIZE, 0);
+    cpu_map_ram(cpu, z_test_ram, 0, 0xc080, 1);
+    cpu_write_register(cpu, 5, 0xb000);
+    cpu_write_register(cpu, 6, 0xc000);
+    cpu_write_register(cpu, 7, 0xb100);
+    memset(z_test_ram + 0xc000, 0, 0x100);
+    cpu_set_pc(cpu, 0x7100);
+    VALUE_ASSERT("MMIO copy run", cpu_run(cpu, 0), 320);
+    VALUE_ASSERT("MMIO copy memory", test_load(0xc07c, 4) == 0x101f && test_load(0xc080, 4) == 0x1020 && test_load(0xc0fc, 4) == 0x103f, 1);
+    cpu_map_ram(cpu, NULL, 0, 0xc080, 0);
+
+    cpu_map_ram(cpu, z_test_ram, 0, TESTING_RAM_SIZE, 1);
+    cpu_write_register(cpu, 5, 0xb000);
+    cpu_write_register(cpu, 6, 0xb004);
+    cpu_write_register(cpu, 7, 0xb080);
+    cpu_set_pc(cpu, 0x7100);
+    VALUE_ASSERT("overlapping copy run", cpu_run(cpu, 0), 32 * 5);
+    VALUE_ASSERT("overlapping copy memory", test_load(0xb004, 4) == 0x1000 && test_load(0xb080, 4) == 0x1000, 1);
+    REG_ASSERT(8, 0x1000);
+    cpu_map_ram(cpu, NULL, 0, TESTING_RAM_SIZE, 0);
+
+    // with the cache model on, bulk copies and fills still run in bulk, with the same I-cache and D-cache counts as stepping them (in direct-mapped caches whose source and destination lines evict each other, and with elements straddling lines, too)
+    rsk_cache_config_t bulk_caches[3] = { { 1024, 64, 4, rcp_lru }, { 1024, 64, 4, rcp_plru }, { 256, 64, 1, rcp_lru } };
+    for (int c = 0; c < 3; c++) {
+        rsk_cache_stats_t bulk_stats[2];
+        for (int stepped = 0; stepped < 2; stepped++) {
+            riscv_cpu_t* cached = cpu_init(NULL, &test_services);
+            cpu_map_ram(cached, z_test_ram, 0, TESTING_RAM_SIZE, 1);
+            cpu_set_config(cached, rc_cache_on);
+            cpu_cache_config(cached, &bulk_caches[c], &bulk_caches[c]);
+
+            // a word copy from an unaligned source, then fills of 64 words and 11 doublewords
+            cpu_write_register(cached, 5, 0xb002);
+            cpu_write_register(cached, 6, 0xc000);
+            cpu_write_register(cached, 7, 0xb102);
+            cpu_write_register(cached, 9, 0x5a5a5a5a);
+            cpu_write_register(cached, 10, 64);
+            dword executed = 0;
+            for (dword pc = 0x7100; pc <= 0x7200; pc += 0x100) {
+                cpu_set_pc(cached, pc);
+                if (stepped) while (cpu_execute(cached)) executed++;
+                else executed += cpu_run(cached, 0);
+                if (0x7100 == pc) cpu_write_register(cached, 7, 0xc200 + 8 * 10 + 3);
+            }
+            VALUE_ASSERT("cached bulk run", executed, 320 + 4 * 64 + 3 * 11);
+
+            dword lookups, decodes;
+            cpu_block_stats(cached, &lookups, &decodes);
+#ifndef RISCV_PERF_COUNTERS
+            if (!stepped) VALUE_ASSERT("cached bulk run in bulk", lookups < 16, 1);
+#endif
+            cpu_cache_report(cached, &bulk_stats[stepped]);
+            cpu_free(cached);
+        }
+        VALUE_ASSERT("cached bulk fetches", bulk_stats[0].fetches, bulk_stats[1].fetches);
+        VALUE_ASSERT("cached bulk fetch misses", bulk_stats[0].fetch_misses, bulk_stats[1].fetch_misses);
+        VALUE_ASSERT("cached bulk loads", bulk_stats[0].loads, bulk_stats[1].loads);
+        VALUE_ASSERT("cached bulk load misses", bulk_stats[0].load_misses, bulk_stats[1].load_misses);
+        VALUE_ASSERT("cached bulk stores", bulk_stats[0].stores, bulk_stats[1].stores);
+        VALUE_ASSERT("cached bulk store misses", bulk_stats[0].store_misses, bulk_stats[1].store_misses);
+    }
+
+#ifdef RISCV_JIT
+    // ---------- JIT ----------
+
+    // a loop over every natively compiled instruction type (and a few that are called) gives the same results compiled as interpreted
+    addr = 0x4000;
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00010) | RS1(00000) | itype_immediate(200));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(11011) | RS1(00000) | itype_immediate(100));
+    EMIT(addr, OPCODE(0110111) | RD(10100) | utype_immediate(0x4000));
+    EMIT(addr, OPCODE(0110111) | RD(01010) | utype_immediate(0x80000000));
+    dword jit_loop = addr;
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00001) | RS1(00001) | itype_immediate(1));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(100) | RD(00011) | RS1(00001) | itype_immediate(-1));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(110) | RD(00100) | RS1(00011) | itype_immediate(0x70));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(111) | RD(00101) | RS1(00100) | itype_immediate(-16));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(001) | RD(00110) | RS1(00001) | itype_immediate(60));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(101) | RD(00111) | RS1(00110) | itype_immediate(3));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(101) | RD(01000) | RS1(00110) | itype_immediate(3) | (INSTR_SIGN >> 1));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(000) | RD(01001) | RS1(01001) | RS2(01000) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(000) | RD(01011) | RS1(01011) | RS2(00011) | FUNCT7(0100000));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(001) | RD(01100) | RS1(00011) | RS2(00001) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(101) | RD(01101) | RS1(00011) | RS2(00001) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(101) | RD(01110) | RS1(00011) | RS2(00001) | FUNCT7(0100000));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(000) | RD(01111) | RS1(01001) | RS2(00011) | FUNCT7(0000001));
+    EMIT(addr, OPCODE(0011011) | FUNCT3(000) | RD(10000) | RS1(01111) | itype_immediate(-2048));
+    EMIT(addr, OPCODE(0111011) | FUNCT3(000) | RD(10001) | RS1(01111) | RS2(01001) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(0100011) | FUNCT3(011) | RS1(10100) | RS2(01111) | stype_immediate(0x100));
+    EMIT(addr, OPCODE(0000011) | FUNCT3(010) | RD(10010) | RS1(10100) | itype_immediate(0x100));
+    EMIT(addr, OPCODE(0000011) | FUNCT3(011) | RD(10011) | RS1(10100) | itype_immediate(0x100));
+    EMIT(addr, OPCODE(0100011) | FUNCT3(010) | RS1(10100) | RS2(00001) | stype_immediate(0x108));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00000) | RS1(00001) | itype_immediate(5));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(100) | RS1(01000) | RS2(00000) | btype_immediate(8));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(11010) | RS1(11010) | itype_immediate(1));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(111) | RS1(00001) | RS2(11011) | btype_immediate(8));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(11100) | RS1(11100) | itype_immediate(1));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(101) | RS1(00110) | RS2(00000) | btype_immediate(8));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(11101) | RS1(11101) | itype_immediate(1));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(000) | RS1(00101) | RS2(00100) | btype_immediate(8));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(11110) | RS1(11110) | itype_immediate(1));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(110) | RS1(01100) | RS2(01101) | btype_immediate(8));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(11111) | RS1(11111) | itype_immediate(1));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(001) | RS1(00001) | RS2(00010) | btype_immediate((sword) (jit_loop - addr)));
+    EMIT(addr, OPCODE(1101111) | RD(10101) | jtype_immediate(8));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(10110) | RS1(00000) | itype_immediate(1));
+    EMIT(addr, OPCODE(0110111) | RD(10111) | utype_immediate(0x7ffff000));
+    EMIT(addr, INSTR_EBREAK);
+
+    dword interpreted[32];
+    for (int i = 1; i < 32; i++) cpu_write_register(cpu, i, 0);
+    cpu_set_pc(cpu, 0x4000);
+    unsigned int jit_start = cpu_stat_instructions(cpu);
+    cpu_run(cpu, 0);
+    unsigned int jit_count = cpu_stat_instructions(cpu) - jit_start;
+    dword jit_end = cpu_get_pc(cpu);
+    for (int i = 0; i < 32; i++) interpreted[i] = cpu_read_register(cpu, i);
+
+    // (in uneven slices, so that some blocks don't fit the remaining budget)
+    cpu_set_config(cpu, rc_jit);
+    for (int i = 1; i < 32; i++) cpu_write_register(cpu, i, 0);
+    cpu_set_pc(cpu, 0x4000);
+    jit_start = cpu_stat_instructions(cpu);
+    while (cpu_run(cpu, 37) == 37) continue;
+    VALUE_ASSERT("JIT instructions", cpu_stat_instructions(cpu) - jit_start, jit_count);
+    VALUE_ASSERT("JIT pc", cpu_get_pc(cpu), jit_end);
+    for (int i = 0; i < 32; i++) VALUE_ASSERT("JIT registers", cpu_read_register(cpu, i), interpreted[i]);
+
+    // and so does one over the compiled bitwise and word instructions (with shift counts past 31)
+    cpu_set_config(cpu, rc_nothing);
+    addr = 0x4400;
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00010) | RS1(00000) | itype_immediate(100));
+    EMIT(addr, OPCODE(0110111) | RD(10100) | utype_immediate(0x9e378000));
+    jit_loop = addr;
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00001) | RS1(00001) | itype_immediate(1));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(000) | RD(00011) | RS1(00001) | RS2(10100) | FUNCT7(0000001));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(100) | RD(00100) | RS1(00011) | RS2(00001) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(110) | RD(00101) | RS1(00100) | RS2(10100) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(111) | RD(00110) | RS1(00101) | RS2(00011) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(0011011) | FUNCT3(001) | RD(00111) | RS1(00011) | itype_immediate(7));
+    EMIT(addr, OPCODE(0011011) | FUNCT3(101) | RD(01000) | RS1(00011) | itype_immediate(9));
+    EMIT(addr, OPCODE(0011011) | FUNCT3(101) | RD(01001) | RS1(00011) | itype_immediate(11) | (INSTR_SIGN >> 1));
+    EMIT(addr, OPCODE(0111011) | FUNCT3(000) | RD(01010) | RS1(00001) | RS2(00011) | FUNCT7(0100000));
+    EMIT(addr, OPCODE(0111011) | FUNCT3(001) | RD(01011) | RS1(00011) | RS2(00001) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(0111011) | FUNCT3(101) | RD(01100) | RS1(00011) | RS2(00001) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(0111011) | FUNCT3(101) | RD(01101) | RS1(00011) | RS2(00001) | FUNCT7(0100000));
+    EMIT(addr, OPCODE(0111011) | FUNCT3(000) | RD(01110) | RS1(00011) | RS2(00100) | FUNCT7(0000001));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(000) | RD(01111) | RS1(01111) | RS2(01110) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(100) | RD(10000) | RS1(10000) | RS2(01101) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(0110011) | FUNCT3(010) | RD(10001) | RS1(00011) | RS2(00100) | FUNCT7(0000000));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(001) | RS1(00001) | RS2(00010) | btype_immediate((sword) (jit_loop - addr)));
+    EMIT(addr, INSTR_EBREAK);
+
+    for (int i = 1; i < 32; i++) cpu_write_register(cpu, i, 0);
+    cpu_set_pc(cpu, 0x4400);
+    cpu_run(cpu, 0);
+    for (int i = 0; i < 32; i++) interpreted[i] = cpu_read_register(cpu, i);
+
+    cpu_set_config(cpu, rc_jit);
+    for (int i = 1; i < 32; i++) cpu_write_register(cpu, i, 0);
+    cpu_set_pc(cpu, 0x4400);
+    cpu_run(cpu, 0);
+    for (int i = 0; i < 32; i++) VALUE_ASSERT("JIT word registers", cpu_read_register(cpu, i), interpreted[i]);
+
+    // compiled blocks are dropped when their code is stored over
+    for (int i = 0; i < 100; i++) {
+        cpu_set_pc(cpu, 0x1000);
+        cpu_run(cpu, 0);
+    }
+    REG_ASSERT(1, 10);
+    cpu_store_word(cpu, 0x1004, OPCODE(0010011) | FUNCT3(000) | RD(00010) | RS1(00000) | itype_immediate(20));
+    cpu_set_pc(cpu, 0x1000);
+    VALUE_ASSERT("JIT after store", cpu_run(cpu, 0), 42);
+    REG_ASSERT(1, 20);
+    cpu_store_word(cpu, 0x1004, OPCODE(0010011) | FUNCT3(000) | RD(00010) | RS1(00000) | itype_immediate(10));
+
+    // a compiled block that stores over cached code stops right after the store
+    addr = 0x5000;
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00001) | RS1(00001) | itype_immediate(1));
+    EMIT(addr, OPCODE(0100011) | FUNCT3(010) | RS1(00101) | RS2(00100) | stype_immediate(0));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00111) | RS1(00111) | itype_immediate(1));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(001) | RS1(00001) | RS2(00010) | btype_immediate(-12));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00000) | itype_immediate(1));
+    EMIT(addr, INSTR_EBREAK);
+
+    for (int i = 3; i < 6; i++) {
+        cpu_write_register(cpu, 1, 0);
+        cpu_write_register(cpu, 2, 100);
+        cpu_write_register(cpu, 4, OPCODE(0010011) | FUNCT3(000) | RD(00110) | RS1(00000) | itype_immediate(i));
+        cpu_write_register(cpu, 5, 0x5010);
+        cpu_write_register(cpu, 7, 0);
+        cpu_set_pc(cpu, 0x5000);
+        VALUE_ASSERT("JIT self-modifying run", cpu_run(cpu, 0), 401);
+        REG_ASSERT(6, i);
+        REG_ASSERT(7, 100);
+    }
+    cpu_set_config(cpu, rc_nothing);
+#endif
+
+#ifdef RISCV_PERF_COUNTERS
+    // ---------- Performance Counters ----------
+
+    // one run of the counted loop: 12 addi, and a bne taken 9 times out of 10
+    static rsk_stats_ex_t perf_before, perf_after;
+    VALUE_ASSERT("stats_ex", cpu_fill_stats_ex(cpu, &perf_before), 1);
+    cpu_set_pc(cpu, 0x1000);
+    cpu_run(cpu, 0);
+    cpu_load_byte(cpu, 0xc000);
+    cpu_fill_stats_ex(cpu, &perf_after);
+
+    VALUE_ASSERT("stats_ex types", perf_after.type_count > 0, 1);
+    for (size_t i = 0; i < perf_after.type_count; i++) {
+        dword executed = perf_after.types[i].executed - perf_before.types[i].executed;
+        dword taken = perf_after.types[i].taken - perf_before.types[i].taken;
+        if (0 == strcmp("addi", perf_after.types[i].name)) VALUE_ASSERT("addi executed", executed, 12);
+        if (0 == strcmp("bne", perf_after.types[i].name)) {
+            VALUE_ASSERT("bne executed", executed, 10);
+            VALUE_ASSERT("bne taken", taken, 9);
+        }
+    }
+    VALUE_ASSERT("branches taken", perf_after.branches_taken - perf_before.branches_taken, 9);
+    VALUE_ASSERT("branches not taken", perf_after.branches_not_taken - perf_before.branches_not_taken, 1);
+
+    // the load missed guest RAM, so it went through (and was timed in) the host service
+    rsk_stats_callback_t* load_cb = &perf_after.callbacks[6];
+    dword latency_calls = 0;
+    for (int i = 0; i < RSK_STATS_LATENCY_BUCKETS; i++) latency_calls += load_cb->latency[i] - perf_before.callbacks[6].latency[i];
+    VALUE_ASSERT("mem_load_byte callback", strcmp("mem_load_byte", load_cb->name), 0);
+    VALUE_ASSERT("mem_load_byte calls", load_cb->calls - perf_before.callbacks[6].calls, 1);
+    VALUE_ASSERT("mem_load_byte latency", latency_calls, 1);
+
+    // the loop body is the hottest code of the whole test, most executed first
+    VALUE_ASSERT("hottest pc", perf_after.hot[0].pc == 0x1008 || perf_after.hot[0].pc == 0x100c, 1);
+    dword hot_delta = 0;
+    for (size_t i = 0; i < perf_after.hot_count; i++) if (0x1008 == perf_after.hot[i].pc) hot_delta += perf_after.hot[i].executed;
+    for (size_t i = 0; i < perf_before.hot_count; i++) if (0x1008 == perf_before.hot[i].pc) hot_delta -= perf_before.hot[i].executed;
+    VALUE_ASSERT("hot pc executed", hot_delta, 10);
+    for (size_t i = 1; i < perf_after.hot_count; i++) VALUE_ASSERT("hot pc order", perf_after.hot[i].executed <= perf_after.hot[i - 1].executed, 1);
+    VALUE_ASSERT("hot pcs dropped", perf_after.hot_dropped, 0);
+#endif
+
+    cpu_free(cpu);
 }
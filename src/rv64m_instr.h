@@ -3,45 +3,90 @@
 
 // The RV64M Standard Extension for Integer Multiplication and Division
 
-// ---------- Disassembly and Execution Functions ----------
+// Division by zero doesn't trap: quotients are all ones and remainders are the dividend. Overflow (the most negative value divided by -1) gives the dividend as the quotient and 0 as the remainder.
 
-// Multiply (mul)
-DISASM_DEF(mul) {
-    return DISASM_FMT("mul %hhu, %hhu, %hhu", GET_RD, GET_RS1, GET_RS2);
-}
+// ---------- Instruction Types ----------
 
-EXEC_DEF(mul) {
-    WRITE_REG(GET_RD, ((sdword) READ_REG(GET_RS1)) * ((sdword) READ_REG(GET_RS2)));
-}
+// Every implemented rv64m instruction type, described like RV64I_INSTRUCTIONS
+#define RV64M_INSTRUCTIONS(X) \
+	/* Multiply (mul) */ \
+	X(mul, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0110011) | FUNCT3(000) | FUNCT7(0000001), \
+		WRITE_REG(OP_RD, READ_REG(OP_RS1) * READ_REG(OP_RS2))) \
+	\
+	/* Multiply high, signed (mulh) */ \
+	X(mulh, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0110011) | FUNCT3(001) | FUNCT7(0000001), \
+		__int128 product = (__int128) (sdword) READ_REG(OP_RS1) * (__int128) (sdword) READ_REG(OP_RS2); \
+		WRITE_REG(OP_RD, (dword) (product >> 64))) \
+	\
+	/* Multiply high, signed by unsigned (mulhsu) */ \
+	X(mulhsu, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0110011) | FUNCT3(010) | FUNCT7(0000001), \
+		__int128 product = (__int128) (sdword) READ_REG(OP_RS1) * (__int128) READ_REG(OP_RS2); \
+		WRITE_REG(OP_RD, (dword) (product >> 64))) \
+	\
+	/* Multiply high, unsigned (mulhu) */ \
+	X(mulhu, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0110011) | FUNCT3(011) | FUNCT7(0000001), \
+		unsigned __int128 product = (unsigned __int128) READ_REG(OP_RS1) * (unsigned __int128) READ_REG(OP_RS2); \
+		WRITE_REG(OP_RD, (dword) (product >> 64))) \
+	\
+	/* Divide, signed (div) */ \
+	X(div, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0110011) | FUNCT3(100) | FUNCT7(0000001), \
+		sdword dividend = (sdword) READ_REG(OP_RS1); \
+		sdword divisor = (sdword) READ_REG(OP_RS2); \
+		if (0 == divisor) { WRITE_REG(OP_RD, UINT64_MAX); } \
+		else if (INT64_MIN == dividend && -1 == divisor) { WRITE_REG(OP_RD, dividend); } \
+		else { WRITE_REG(OP_RD, dividend / divisor); }) \
+	\
+	/* Divide, unsigned (divu) */ \
+	X(divu, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0110011) | FUNCT3(101) | FUNCT7(0000001), \
+		dword divisor = READ_REG(OP_RS2); \
+		WRITE_REG(OP_RD, (0 == divisor) ? UINT64_MAX : READ_REG(OP_RS1) / divisor)) \
+	\
+	/* Remainder, signed (rem) */ \
+	X(rem, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0110011) | FUNCT3(110) | FUNCT7(0000001), \
+		sdword dividend = (sdword) READ_REG(OP_RS1); \
+		sdword divisor = (sdword) READ_REG(OP_RS2); \
+		if (0 == divisor) { WRITE_REG(OP_RD, dividend); } \
+		else if (INT64_MIN == dividend && -1 == divisor) { WRITE_REG(OP_RD, 0); } \
+		else { WRITE_REG(OP_RD, dividend % divisor); }) \
+	\
+	/* Remainder, unsigned (remu) */ \
+	X(remu, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0110011) | FUNCT3(111) | FUNCT7(0000001), \
+		dword dividend = READ_REG(OP_RS1); \
+		dword divisor = READ_REG(OP_RS2); \
+		WRITE_REG(OP_RD, (0 == divisor) ? dividend : dividend % divisor)) \
+	\
+	/* ---------- Word RV64M Instructions ---------- */ \
+	\
+	/* Multiply word (mulw) */ \
+	X(mulw, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0111011) | FUNCT3(000) | FUNCT7(0000001), \
+		WRITE_REG(OP_RD, (sdword) (sword) ((word) READ_REG(OP_RS1) * (word) READ_REG(OP_RS2)))) \
+	\
+	/* Divide word, signed (divw) */ \
+	X(divw, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0111011) | FUNCT3(100) | FUNCT7(0000001), \
+		sword dividend = (sword) READ_REG(OP_RS1); \
+		sword divisor = (sword) READ_REG(OP_RS2); \
+		if (0 == divisor) { WRITE_REG(OP_RD, UINT64_MAX); } \
+		else if (INT32_MIN == dividend && -1 == divisor) { WRITE_REG(OP_RD, (sdword) dividend); } \
+		else { WRITE_REG(OP_RD, (sdword) (dividend / divisor)); }) \
+	\
+	/* Divide word, unsigned (divuw) */ \
+	X(divuw, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0111011) | FUNCT3(101) | FUNCT7(0000001), \
+		word dividend = (word) READ_REG(OP_RS1); \
+		word divisor = (word) READ_REG(OP_RS2); \
+		WRITE_REG(OP_RD, (0 == divisor) ? UINT64_MAX : (sdword) (sword) (dividend / divisor))) \
+	\
+	/* Remainder word, signed (remw) */ \
+	X(remw, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0111011) | FUNCT3(110) | FUNCT7(0000001), \
+		sword dividend = (sword) READ_REG(OP_RS1); \
+		sword divisor = (sword) READ_REG(OP_RS2); \
+		if (0 == divisor) { WRITE_REG(OP_RD, (sdword) dividend); } \
+		else if (INT32_MIN == dividend && -1 == divisor) { WRITE_REG(OP_RD, 0); } \
+		else { WRITE_REG(OP_RD, (sdword) (dividend % divisor)); }) \
+	\
+	/* Remainder word, unsigned (remuw) */ \
+	X(remuw, rf_r, ds_reg, INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7, OPCODE(0111011) | FUNCT3(111) | FUNCT7(0000001), \
+		word dividend = (word) READ_REG(OP_RS1); \
+		word divisor = (word) READ_REG(OP_RS2); \
+		WRITE_REG(OP_RD, (sdword) (sword) ((0 == divisor) ? dividend : dividend % divisor)))
 
-// TODO: mulh
-// TODO: mulhsu
-// TODO: mulhu
-// TODO: div
-// TODO: divu
-// TODO: rem
-// TODO: remu
-
-// ---------- Word RV64M Instructions ----------
-
-// TODO: mulw
-// TODO: divw
-// TODO: divuw
-// TODO: remw
-// TODO: remuw
-
-// Array of all implemented rv64m instruction types
-riscv_instr_t rv64m_instructions[] = {
-    // Multiply (mul)
-    {
-        .name = "mul",
-        .mask = INSTR_OPCODE | INSTR_FUNCT3 | INSTR_FUNCT7,
-        .required_bits = OPCODE(0110011) | FUNCT3(000) | FUNCT7(0000001),
-        INSTR_LINKS(mul)
-    },
-};
-
-// Number of implemented rv64m instructions
-const size_t rv64m_size = sizeof(rv64m_instructions) / sizeof(riscv_instr_t);
-
-#endif
\ No newline at end of file
+#endif
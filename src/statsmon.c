@@ -0,0 +1,133 @@
+/*
+ - RISC-V Sim live counters monitor
+ - Watches the stats page a kernel publishes (rsk_stats_publish, rsh.py --stats-page) from another process
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rskapi.h"
+
+// Attempts at a consistent copy before giving up on a poll (the kernel holds the page for well under a microsecond)
+#define READ_ATTEMPTS 1000
+
+// ---------- Page Access ----------
+
+// Copy the page into <copy> without disturbing the kernel, returning 0 if it kept changing
+static int read_page(const rsk_stats_page_t* page, rsk_stats_page_t* copy) {
+    for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+        dword before = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;
+
+        memcpy(copy, (const void*) page, sizeof(*copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (before == __atomic_load_n(&page->sequence, __ATOMIC_RELAXED)) return 1;
+    }
+    return 0;
+}
+
+// ---------- Output ----------
+
+static void print_header(void) {
+    printf("%10s %16s %10s %16s %8s %8s %8s %8s %s\n", "seconds", "instructions", "mips", "pc", "tlb", "blocks", "icache", "dcache", "state");
+}
+
+// Format a cache hit <rate> into <text>, or "-" if the cache has made no more than its <previous> accesses (the cache model is off, or was for the whole interval, and the kernel reports 100%)
+static const char* cache_rate(char text[16], double rate, dword accesses, dword previous) {
+    if (accesses == previous) return "-";
+    snprintf(text, 16, "%.2f%%", rate * 100.0);
+    return text;
+}
+
+// Print one line for the page as copied at one poll, whose I-cache and D-cache had made <fetches> and <data> accesses at the previous line
+static void print_page(const rsk_stats_page_t* page, dword fetches, dword data) {
+    char icache[16], dcache[16];
+    printf("%10.3f %16lu %10.2f %16lx %7.2f%% %7.2f%% %8s %8s %s\n",
+        (double) (page->time_ns - page->start_ns) / 1e9, page->instructions, page->mips, page->pc,
+        page->tlb_hit_rate * 100.0, page->block_hit_rate * 100.0,
+        cache_rate(icache, page->icache_hit_rate, page->fetches, fetches),
+        cache_rate(dcache, page->dcache_hit_rate, page->cache_loads + page->cache_stores, data),
+        page->running ? "running" : "stopped");
+    fflush(stdout);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "usage: %s [-i MS] [-n COUNT] [-x] PAGE_FILE\n", program);
+    fprintf(stderr, "  -i MS     milliseconds between polls (default 1000)\n");
+    fprintf(stderr, "  -n COUNT  stop after COUNT polls (default: poll until interrupted)\n");
+    fprintf(stderr, "  -x        stop once the kernel reports its run has ended\n");
+}
+
+int main(int argc, char** argv) {
+    long interval = 1000;
+    long count = 0;
+    int until_stopped = 0;
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "i:n:xh"))) {
+        switch (opt) {
+            case 'i': interval = atol(optarg); break;
+            case 'n': count = atol(optarg); break;
+            case 'x': until_stopped = 1; break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (optind + 1 != argc || interval < 1 || count < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // (a MAP_SHARED mapping sees every update the kernel makes to its own mapping of the file)
+    int fd = open(argv[optind], O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "%s: cannot open file\n", argv[optind]);
+        return 1;
+    }
+    void* mapped = mmap(NULL, sizeof(rsk_stats_page_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == mapped) {
+        fprintf(stderr, "%s: cannot map file\n", argv[optind]);
+        return 1;
+    }
+    const rsk_stats_page_t* page = (const rsk_stats_page_t*) mapped;
+
+    if (RSK_STATS_PAGE_MAGIC != __atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) || RSK_STATS_PAGE_VERSION != page->version || page->size < sizeof(rsk_stats_page_t)) {
+        fprintf(stderr, "%s: not a version %d stats page\n", argv[optind], RSK_STATS_PAGE_VERSION);
+        munmap(mapped, sizeof(rsk_stats_page_t));
+        return 1;
+    }
+
+    print_header();
+    struct timespec pause = { interval / 1000, (interval % 1000) * 1000000 };
+    dword last_update = (dword) -1;
+    dword last_fetches = 0;
+    dword last_data = 0;
+    for (long polls = 0; 0 == count || polls < count; polls++) {
+        if (0 != polls) nanosleep(&pause, NULL);
+
+        rsk_stats_page_t copy;
+        if (!read_page(page, &copy)) {
+            fprintf(stderr, "%s: page kept changing while being read\n", argv[optind]);
+            continue;
+        }
+
+        // a stopped kernel doesn't update the page, so only new updates are printed
+        if (copy.updates != last_update) {
+            print_page(&copy, last_fetches, last_data);
+            last_fetches = copy.fetches;
+            last_data = copy.cache_loads + copy.cache_stores;
+        }
+        last_update = copy.updates;
+        if (until_stopped && 0 != copy.updates && !copy.running) break;
+    }
+
+    munmap(mapped, sizeof(rsk_stats_page_t));
+    return 0;
+}
@@ -0,0 +1,333 @@
+/*
+ - Tests of the hosts and tools built around the kernel
+ - Runs from the repository root (make tool_test), on files written to build/tests/
+*/
+
+#include <stdlib.h>
+
+#include "riscv64_testing.h"
+#include "rsh_host.h"
+#include "rsk_elf.h"
+
+#define TOOL_DIR "build/"
+#define TOOL_FILES "build/tests/"
+
+// ---------- Batch Runner Helpers ----------
+
+// Assemble a counted loop to <count> that stores its counter at 0x200, at address 0 of test RAM (returns the size of the code)
+static dword batch_program(sword count) {
+    memset(z_test_ram, 0, TESTING_RAM_SIZE);
+    dword addr = 0;
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00001) | RS1(00000) | itype_immediate(0));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00010) | RS1(00000) | itype_immediate(count));
+    EMIT(addr, OPCODE(0010011) | FUNCT3(000) | RD(00001) | RS1(00001) | itype_immediate(1));
+    EMIT(addr, OPCODE(1100011) | FUNCT3(001) | RS1(00001) | RS2(00010) | btype_immediate(-4));
+    EMIT(addr, OPCODE(0100011) | FUNCT3(010) | RS1(00000) | RS2(00001) | stype_immediate(0x200));
+    EMIT(addr, INSTR_EBREAK);
+    return addr;
+}
+
+// Find the result line of <module> in the output of rsk_batch, returning 0 if it isn't there (or reports a failure)
+static int batch_result(const char* output, const char* module, dword* instructions, char ram_md5[33], char reg_md5[33]) {
+    for (const char* line = output; NULL != line && '\0' != *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL) {
+        size_t length = strlen(module);
+        if (0 != strncmp(line, module, length) || ' ' != line[length]) continue;
+        return 3 == sscanf(line + length, " %lu %*f %*f %32s %32s", instructions, ram_md5, reg_md5);
+    }
+    return 0;
+}
+
+// Read the rows of a stats CSV without their (timing) span column into <rows>, returning the number of rows
+static size_t batch_rows(const char* path, char rows[][256], size_t max) {
+    FILE* file = fopen(path, "r");
+    if (NULL == file) return 0;
+
+    size_t count = 0;
+    char line[128];
+    while (count < max && NULL != fgets(line, sizeof(line), file)) {
+        char* span = strchr(line, ',') ? strchr(strchr(line, ',') + 1, ',') : NULL;
+        char* rest = span ? strchr(span + 1, ',') : NULL;
+        if (NULL == rest) continue;
+        *span = '\0';
+        snprintf(rows[count++], 256, "%s%s", line, rest);
+    }
+    fclose(file);
+    return count;
+}
+
+// ---------- Native Host Helpers ----------
+
+char z_host_panic[TESTING_BUFFER_SIZE];
+size_t z_host_panics = 0;
+
+// Keep the last panic of the native host services (instead of ending the test like RISCVSimShell would)
+void z_host_record_panic(const char* msg) {
+    snprintf(z_host_panic, sizeof(z_host_panic), "%s", msg);
+    z_host_panics++;
+}
+
+dword z_host_device_value = 0;
+
+dword z_host_device_load(dword address) { return z_host_device_value; }
+void z_host_device_store(dword address, dword value) { z_host_device_value = value; }
+
+// Did the last access make the host panic with exactly <message>?
+static int host_panicked(const char* message) {
+    int matched = (0 != z_host_panics) && 0 == strcmp(z_host_panic, message);
+    z_host_panics = 0;
+    z_host_panic[0] = '\0';
+    return matched;
+}
+
+// ---------- Trace Tool Helpers ----------
+
+// Run <steps> instructions one at a time, writing the registers before each step to <log> in the layout of tests/expected/*.log (with x<reg> set to <value> between the runs before step <poke>)
+static void trace_steps(FILE* log, dword steps, dword poke, int reg, dword value) {
+    for (dword step = 0; step < steps; step++) {
+        if (step == poke) rsk_reg_set(reg, value);
+        if (NULL != log) {
+            fprintf(log, "%06lu %08lx -------------------------------- --- 0000 ", step + 1, rsk_pc_get());
+            for (int i = 0; i < 32; i++) fprintf(log, " %d=%08lx", i, rsk_reg_get(i));
+            fputc('\n', log);
+        }
+        rsk_cpu_run(1);
+    }
+}
+
+// Record a binary trace of the first <steps> instructions of the batch program counting to <count> into <path>, in the smallest chunks there are (see trace_steps). Returns 0 if the trace file can't be written.
+static int trace_record(const char* path, FILE* log, sword count, dword steps, dword poke, int reg, dword value) {
+    rsk_init(&quiet_services);
+    batch_program(count);
+    rsk_ram_map(z_test_ram, 0, TESTING_RAM_SIZE);
+    if (!rsk_trace_file(path, 1)) return 0;
+    rsk_config_set(rc_trace_binary);
+    trace_steps(log, steps, poke, reg, value);
+    rsk_trace_flush();
+    rsk_config_set(rc_nothing);
+    return 1;
+}
+
+// Count the chunks of the trace at <path> (-1 if it can't be read)
+static long trace_chunks(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (NULL == file) return -1;
+
+    long chunks = 0;
+    rsk_trace_chunk_t chunk;
+    while (1 == fread(&chunk, sizeof(chunk), 1, file) && RSK_TRACE_MAGIC == chunk.magic && 0 == fseek(file, chunk.size, SEEK_CUR)) chunks++;
+    fclose(file);
+    return chunks;
+}
+
+int main() {
+    char output[TESTING_OUTPUT_SIZE];
+
+    // ---------- Kernel API ----------
+
+    // a range is disassembled just like its instructions one at a time, from code that need not be word aligned (undecodable words included)
+    rsk_init(&quiet_services);
+    word range_code[3] = { OPCODE(0110111) | RD(00110) | utype_immediate(5120), 0xffffffff, OPCODE(1101111) | RD(00001) | jtype_immediate(0x100) };
+    byte range_bytes[sizeof(range_code) + 1];
+    memcpy(range_bytes + 1, range_code, sizeof(range_code));
+    char range_text[3][64];
+    memset(range_text, 0, sizeof(range_text));
+    VALUE_ASSERT("disasm range", rsk_disasm_range(0x1000, range_bytes + 1, 3, range_text[0], sizeof(range_text[0])), 3);
+    VALUE_ASSERT("disasm range text", strcmp(range_text[0], "0x0000000000001000   0x00001337   lui x6, 0x1000"), 0);
+    VALUE_ASSERT("disasm range undecodable", strcmp(range_text[1], "0x0000000000001004   0xffffffff   ?"), 0);
+    for (int i = 0; i < 3; i++) {
+        char single[64];
+        rsk_disasm(0x1000 + 4 * i, range_code[i], single, sizeof(single));
+        VALUE_ASSERT("disasm range matches", strcmp(range_text[i], single), 0);
+    }
+
+    // strides too small for any text write nothing
+    memset(range_text, 'x', sizeof(range_text));
+    VALUE_ASSERT("disasm range small stride", rsk_disasm_range(0x1000, range_code, 3, range_text[0], 21), 0);
+    VALUE_ASSERT("disasm range small stride", range_text[0][0], 'x');
+
+    // ---------- Batch Runner ----------
+
+    // two programs run side by side on the pool end up exactly like they do one at a time
+    const char* batch_modules[2] = { TOOL_FILES "batch_a.exe", TOOL_FILES "batch_b.exe" };
+    for (int i = 0; i < 2; i++) {
+        test_segment_t code = { .address = 0, .offset = 0x1000, .flags = 5, .data = z_test_ram, .file_size = batch_program(10 + 90 * i) };
+        code.mem_size = code.file_size;
+        int written = test_write_elf(batch_modules[i], 0, &code, 1, 0);
+        VALUE_ASSERT("batch ELF", written, 1);
+        if (!written) return 1;
+    }
+
+    remove(TOOL_FILES "batch_pool.csv");
+    remove(TOOL_FILES "batch_single.csv");
+    VALUE_ASSERT("batch pool", test_command(TOOL_DIR "rsk_batch -j 2 -s " TOOL_FILES "batch_pool.csv " TOOL_FILES "batch_a.exe " TOOL_FILES "batch_b.exe", output), 0);
+
+    char pool_output[TESTING_OUTPUT_SIZE];
+    memcpy(pool_output, output, sizeof(output));
+    for (int i = 0; i < 2; i++) {
+        char command[256];
+        snprintf(command, sizeof(command), TOOL_DIR "rsk_batch -j 1 -s " TOOL_FILES "batch_single.csv %s", batch_modules[i]);
+        VALUE_ASSERT("batch single", test_command(command, output), 0);
+
+        dword pool_instructions = 0, single_instructions = 1;
+        char pool_ram[33] = "", pool_regs[33] = "", single_ram[33] = "-", single_regs[33] = "-";
+        VALUE_ASSERT("batch pool result", batch_result(pool_output, batch_modules[i], &pool_instructions, pool_ram, pool_regs), 1);
+        VALUE_ASSERT("batch single result", batch_result(output, batch_modules[i], &single_instructions, single_ram, single_regs), 1);
+        VALUE_ASSERT("batch instructions", pool_instructions, single_instructions);
+        VALUE_ASSERT("batch instructions", pool_instructions, 2 + 2 * (10 + 90 * i) + 1);
+        VALUE_ASSERT("batch RAM MD5", strcmp(pool_ram, single_ram), 0);
+        VALUE_ASSERT("batch register MD5", strcmp(pool_regs, single_regs), 0);
+    }
+
+    char pool_rows[4][256], single_rows[4][256];
+    VALUE_ASSERT("batch pool rows", batch_rows(TOOL_FILES "batch_pool.csv", pool_rows, 4), 2);
+    VALUE_ASSERT("batch single rows", batch_rows(TOOL_FILES "batch_single.csv", single_rows, 4), 2);
+    for (int i = 0; i < 2; i++) VALUE_ASSERT("batch rows", strcmp(pool_rows[i], single_rows[i]), 0);
+
+    // ---------- Native Host ----------
+
+    // RAM accesses are served little-endian, without any panic
+    byte host_ram[0x100];
+    const rsk_host_services_t* host = rsh_host_init(host_ram, sizeof(host_ram), 1, z_test_log_trace, z_test_log_message, z_host_record_panic);
+    host->mem_store_dword(0x10, 0x1122334455667788);
+    VALUE_ASSERT("host RAM", host->mem_load_word(0x14), 0x11223344);
+    VALUE_ASSERT("host RAM", host->mem_load_byte(0x10), 0x88);
+    VALUE_ASSERT("host RAM", host_ram[0x17], 0x11);
+    VALUE_ASSERT("host RAM panics", z_host_panics, 0);
+
+    // accesses beyond the RAM (or straddling its end) panic like RISCVSimShell's callbacks
+    VALUE_ASSERT("host out-of-RAM load", host->mem_load_word(0x100), 0);
+    VALUE_ASSERT("host out-of-RAM load", host_panicked("out-of-RAM load word @ 0000000000000100"), 1);
+    host->mem_store_dword(0xf8 + 8, 1);
+    VALUE_ASSERT("host out-of-RAM store", host_panicked("out-of-RAM store dword @ 0000000000000100"), 1);
+    host->mem_load_hword(0xff);
+    VALUE_ASSERT("host straddling load", host_panicked("misaligned load hword @ 00000000000000ff"), 1);
+
+    // with alignment required, misaligned accesses panic first
+    host->mem_load_dword(0x14);
+    VALUE_ASSERT("host misaligned load", host_panicked("misaligned load dword @ 0000000000000014"), 1);
+    host->mem_store_word(0x12, 1);
+    VALUE_ASSERT("host misaligned store", host_panicked("misaligned store word @ 0000000000000012"), 1);
+    host->mem_store_byte(0x13, 0x5a);
+    VALUE_ASSERT("host byte store", z_host_panics, 0);
+
+    // without it, misaligned accesses are fine, but straddling the end of RAM still isn't
+    host = rsh_host_init(host_ram, sizeof(host_ram), 0, z_test_log_trace, z_test_log_message, z_host_record_panic);
+    VALUE_ASSERT("host misaligned load", host->mem_load_word(0x13), 0x2233445a);
+    VALUE_ASSERT("host misaligned load", z_host_panics, 0);
+    host->mem_load_hword(0xff);
+    VALUE_ASSERT("host straddling load", host_panicked("out-of-RAM load hword @ 00000000000000ff"), 1);
+
+    // MMIO addresses without handlers panic, and those with handlers reach them (a NULL handler is a no-op)
+    VALUE_ASSERT("host MMIO load", host->mem_load_word(RSH_MMIO_BASE + 8), 0);
+    VALUE_ASSERT("host unimplemented MMIO load", host_panicked("unimplemented MMIO load word from 0x80000008"), 1);
+    host->mem_store_byte(RSH_MMIO_BASE + 8, 1);
+    VALUE_ASSERT("host unimplemented MMIO store", host_panicked("unimplemented MMIO store byte to 0x80000008"), 1);
+    VALUE_ASSERT("host MMIO handlers", rsh_host_mmio(RSH_MMIO_BASE + 8, z_host_device_load, z_host_device_store), 1);
+    VALUE_ASSERT("host MMIO handlers", rsh_host_mmio(RSH_MMIO_BASE + 16, NULL, NULL), 1);
+    VALUE_ASSERT("host MMIO handlers", rsh_host_mmio(0x10, z_host_device_load, z_host_device_store), 0);
+    host->mem_store_hword(RSH_MMIO_BASE + 8, 0x1234);
+    VALUE_ASSERT("host MMIO store", z_host_device_value, 0x1234);
+    VALUE_ASSERT("host MMIO load", host->mem_load_dword(RSH_MMIO_BASE + 8), 0x1234);
+    host->mem_store_word(RSH_MMIO_BASE + 16, 1);
+    VALUE_ASSERT("host no-op MMIO load", host->mem_load_word(RSH_MMIO_BASE + 16), 0);
+    VALUE_ASSERT("host MMIO panics", z_host_panics, 0);
+
+    // ---------- ELF Loader ----------
+
+    // an unaligned read-only segment whose middle page can be mapped from the file, then a writable one (with .bss) sharing its last page, and more data past a gap of filler bytes
+    for (dword i = 0; i < TESTING_RAM_SIZE; i++) z_test_ram[i] = (byte) (7 * i + 1);
+    test_segment_t segments[3] = {
+        { .address = 0x1100, .offset = 0x1100, .flags = 5, .data = z_test_ram + 0x1100, .file_size = 0x2200, .mem_size = 0x2200 },
+        { .address = 0x3300, .offset = 0x3300, .flags = 6, .data = z_test_ram + 0x3300, .file_size = 0x100, .mem_size = 0x500 },
+        { .address = 0x5000, .offset = 0x5000, .flags = 4, .data = z_test_ram + 0x5000, .file_size = 0x10, .mem_size = 0x10 },
+    };
+    int written = test_write_elf(TOOL_FILES "segments.exe", 0x1100, segments, 3, 0xee);
+    VALUE_ASSERT("ELF file", written, 1);
+
+    rsk_elf_t elf;
+    int opened = written && elf_open(&elf, TOOL_FILES "segments.exe");
+    VALUE_ASSERT("ELF open", opened, 1);
+    if (!opened) return 1;
+    VALUE_ASSERT("ELF segments", elf.segment_count, 3);
+    VALUE_ASSERT("ELF entry", elf.entry, 0x1100);
+
+    // mapped RAM holds exactly what copying the segments gives
+    static byte copied[0x8000];
+    VALUE_ASSERT("ELF load", elf_load(&elf, copied, sizeof(copied)), 1);
+    byte* mapped = elf_map(&elf, sizeof(copied));
+    VALUE_ASSERT("ELF map", NULL != mapped, 1);
+    if (NULL != mapped) {
+        VALUE_ASSERT("ELF map contents", memcmp(mapped, copied, sizeof(copied)), 0);
+        VALUE_ASSERT("ELF map before segment", mapped[0x10ff], 0);
+        VALUE_ASSERT("ELF map partial page", mapped[0x1100], z_test_ram[0x1100]);
+        VALUE_ASSERT("ELF map whole page", mapped[0x2abc], z_test_ram[0x2abc]);
+        VALUE_ASSERT("ELF map shared page", mapped[0x32ff], z_test_ram[0x32ff]);
+        VALUE_ASSERT("ELF map shared page", mapped[0x3300], z_test_ram[0x3300]);
+        VALUE_ASSERT("ELF map shared page", mapped[0x33ff], z_test_ram[0x33ff]);
+
+        // .bss and the gaps are zero, not the filler that follows the data in the file
+        int zeroed = 1;
+        for (dword i = 0x3400; i < 0x5000; i++) zeroed = zeroed && (0 == mapped[i]);
+        VALUE_ASSERT("ELF map .bss", zeroed, 1);
+        VALUE_ASSERT("ELF map last segment", mapped[0x5000], z_test_ram[0x5000]);
+        VALUE_ASSERT("ELF map after segment", mapped[0x5010], 0);
+
+        // stores to mapped pages only change the RAM, not the file
+        mapped[0x2abc] ^= 0xff;
+        VALUE_ASSERT("ELF map private", elf.segments[0].data[0x2abc - 0x1100], z_test_ram[0x2abc]);
+        elf_unmap(mapped, sizeof(copied));
+    }
+
+    // segments that don't fit aren't loaded
+    VALUE_ASSERT("ELF map too small", NULL == elf_map(&elf, 0x3400), 1);
+    VALUE_ASSERT("ELF load too small", elf_load(&elf, copied, 0x3400), 0);
+    elf_close(&elf);
+
+    // ---------- Trace Tools ----------
+
+    // a trace spanning many chunks matches the log of the registers it was recorded from, in one segment or several (whose chunks start mid-log)
+    FILE* trace_log = fopen(TOOL_FILES "trace.log", "w");
+    VALUE_ASSERT("trace log", NULL != trace_log, 1);
+    if (NULL == trace_log) return 1;
+    const dword trace_length = 3 + 2 * 3000;
+    int recorded = trace_record(TOOL_FILES "trace.bin", trace_log, 3000, trace_length, -1, 0, 0);
+    fclose(trace_log);
+    VALUE_ASSERT("trace file", recorded, 1);
+    if (!recorded) return 1;
+    VALUE_ASSERT("trace chunks", trace_chunks(TOOL_FILES "trace.bin") > 10, 1);
+
+    char trace_match[64];
+    snprintf(trace_match, sizeof(trace_match), "%lu steps match\n", trace_length);
+    VALUE_ASSERT("tracediff log", test_command(TOOL_DIR "tracediff -j 1 " TOOL_FILES "trace.bin " TOOL_FILES "trace.log", output), 0);
+    VALUE_ASSERT("tracediff log output", strcmp(output, trace_match), 0);
+    VALUE_ASSERT("tracediff log segments", test_command(TOOL_DIR "tracediff -j 4 " TOOL_FILES "trace.bin " TOOL_FILES "trace.log", output), 0);
+    VALUE_ASSERT("tracediff log segments output", strcmp(output, trace_match), 0);
+    VALUE_ASSERT("tracediff self", test_command(TOOL_DIR "tracediff -j 4 " TOOL_FILES "trace.bin " TOOL_FILES "trace.bin", output), 0);
+    VALUE_ASSERT("tracediff self output", strcmp(output, trace_match), 0);
+
+    // so does the expected log trace2log writes from it
+    VALUE_ASSERT("trace2log", test_command(TOOL_DIR "trace2log -x " TOOL_FILES "trace.bin " TOOL_FILES "trace_x.log", output), 0);
+    VALUE_ASSERT("trace2log lines", test_count_lines(TOOL_FILES "trace_x.log"), 6 * trace_length);
+    VALUE_ASSERT("tracediff trace2log", test_command(TOOL_DIR "tracediff " TOOL_FILES "trace.bin " TOOL_FILES "trace_x.log", output), 0);
+    VALUE_ASSERT("tracediff trace2log output", strcmp(output, trace_match), 0);
+
+    // a register the host changes midway through a chunk is found at the step that first runs with it, against the log and the trace alike
+    VALUE_ASSERT("trace file", trace_record(TOOL_FILES "trace_poked.bin", NULL, 3000, trace_length, 4321, 7, 0x77), 1);
+    const char* poked = "step 4321 (pc 0xc): x7 is 0x77 in " TOOL_FILES "trace_poked.bin but 0 in ";
+    VALUE_ASSERT("tracediff divergence", test_command(TOOL_DIR "tracediff -j 4 " TOOL_FILES "trace_poked.bin " TOOL_FILES "trace.log", output), 1);
+    VALUE_ASSERT("tracediff divergence output", strncmp(output, poked, strlen(poked)), 0);
+    VALUE_ASSERT("tracediff divergence output", strcmp(output + strlen(poked), TOOL_FILES "trace.log\n"), 0);
+    VALUE_ASSERT("tracediff trace divergence", test_command(TOOL_DIR "tracediff -j 4 " TOOL_FILES "trace_poked.bin " TOOL_FILES "trace.bin", output), 1);
+    VALUE_ASSERT("tracediff trace divergence output", strncmp(output, poked, strlen(poked)), 0);
+
+    // as is the end of a trace that stops before the log does
+    VALUE_ASSERT("trace file", trace_record(TOOL_FILES "trace_short.bin", NULL, 3000, 1000, -1, 0, 0), 1);
+    VALUE_ASSERT("tracediff end", test_command(TOOL_DIR "tracediff " TOOL_FILES "trace_short.bin " TOOL_FILES "trace.log", output), 1);
+    VALUE_ASSERT("tracediff end output", strcmp(output, "step 1000: " TOOL_FILES "trace_short.bin ends, but " TOOL_FILES "trace.log goes on\n"), 0);
+
+    // files that can't be compared are errors
+    VALUE_ASSERT("tracediff missing", test_command(TOOL_DIR "tracediff " TOOL_FILES "trace.bin " TOOL_FILES "missing.log 2>/dev/null", output), 2);
+    VALUE_ASSERT("tracediff usage", test_command(TOOL_DIR "tracediff " TOOL_FILES "trace.bin 2>/dev/null", output), 2);
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ - RISC-V Sim binary trace converter
+ - Turns a binary trace (rc_trace_binary) back into the text trace logs written by rsh.py
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rskapi.h"
+
+#define REGISTER_COUNT 32
+
+// Placeholder for the RAM checksum column (binary traces carry no checksums, like rsh.py without --checksum)
+#define NO_CHECKSUM "--------------------------------"
+
+// ---------- Text Formats ----------
+
+// Print a record the way RISCVSimShell.log_trace does: step and pc after the instruction, then the registers that differ from <history>
+static void print_shell(FILE* out, dword step, dword pc, const dword* registers, dword* history) {
+    fprintf(out, "%06lu %08lx %s\n", step, pc, NO_CHECKSUM);
+
+    int col = 0;
+    fputs("\t\t", out);
+    for (int i = 0; i < REGISTER_COUNT; i++) {
+        if (history[i] == registers[i]) continue;
+
+        fprintf(out, "%d=%08lx ", i, registers[i]);
+        if (4 == ++col) {
+            fputs("\n\t\t", out);
+            col = 0;
+        }
+        history[i] = registers[i];
+    }
+    fputc('\n', out);
+}
+
+// Print a record in the layout of tests/expected/*.log: 1-based step and pc, followed by the first <count> registers as they were before the instruction
+static void print_expected(FILE* out, dword step, dword pc, const dword* registers, int count) {
+    fprintf(out, "%06lu %08lx %s --- 0000 ", step + 1, pc, NO_CHECKSUM);
+
+    // three registers share the first line, then six per continuation line in aligned columns
+    for (int i = 0; i < count; i++) {
+        if (i < 3) {
+            fprintf(out, " %d=%08lx", i, registers[i]);
+            continue;
+        }
+        fputs((3 == i % 6) ? "\n       " : " ", out);
+        fprintf(out, "%2d=%08lx", i, registers[i]);
+    }
+    fputc('\n', out);
+}
+
+// ---------- Conversion ----------
+
+// Convert every chunk of the trace in <data>, returning 0 (after reporting why) if it is malformed
+static int convert(FILE* out, const byte* data, size_t size, int expected, int count) {
+    dword registers[REGISTER_COUNT];
+    dword history[REGISTER_COUNT];
+    int first = 1;
+
+    size_t at = 0;
+    while (at < size) {
+        rsk_trace_chunk_t chunk;
+        if (size - at < sizeof(chunk)) {
+            fprintf(stderr, "Truncated chunk header at offset %zu\n", at);
+            return 0;
+        }
+        memcpy(&chunk, data + at, sizeof(chunk));
+        if (RSK_TRACE_MAGIC != chunk.magic || RSK_TRACE_VERSION != chunk.version) {
+            fprintf(stderr, "Not a version %d binary trace chunk at offset %zu\n", RSK_TRACE_VERSION, at);
+            return 0;
+        }
+        at += sizeof(chunk);
+        if (size - at < chunk.size) {
+            fprintf(stderr, "Truncated chunk at offset %zu\n", at - sizeof(chunk));
+            return 0;
+        }
+
+        // each chunk restarts from its keyframe; the shell's history only starts from the very first one
+        memcpy(registers, chunk.registers, sizeof(registers));
+        if (first) memcpy(history, chunk.registers, sizeof(history));
+        first = 0;
+
+        const byte* record = data + at;
+        const byte* end = record + chunk.size;
+        for (dword r = 0; r < chunk.count; r++) {
+            dword pc;
+            word mask;
+            if ((size_t) (end - record) < sizeof(pc) + sizeof(mask)) {
+                fprintf(stderr, "Truncated record at step %lu\n", chunk.first_step + r);
+                return 0;
+            }
+            memcpy(&pc, record, sizeof(pc));
+            memcpy(&mask, record + sizeof(pc), sizeof(mask));
+            record += sizeof(pc) + sizeof(mask);
+
+            if (expected) print_expected(out, chunk.first_step + r, pc, registers, count);
+
+            for (int i = 0; i < REGISTER_COUNT; i++) {
+                if (0 == (mask & ((word) 1 << i))) continue;
+                if ((size_t) (end - record) < sizeof(dword)) {
+                    fprintf(stderr, "Truncated record at step %lu\n", chunk.first_step + r);
+                    return 0;
+                }
+                memcpy(&registers[i], record, sizeof(dword));
+                record += sizeof(dword);
+            }
+
+            if (!expected) print_shell(out, chunk.first_step + r, pc, registers, history);
+        }
+
+        at += chunk.size;
+    }
+
+    return 1;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "usage: %s [-x] [-n COUNT] TRACE_FILE [LOG_FILE]\n", program);
+    fprintf(stderr, "  -x        use the layout of tests/expected/*.log (full register dump before each instruction)\n");
+    fprintf(stderr, "  -n COUNT  number of registers listed by -x (default %d)\n", REGISTER_COUNT);
+}
+
+int main(int argc, char** argv) {
+    int expected = 0;
+    int count = REGISTER_COUNT;
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "xn:h"))) {
+        switch (opt) {
+            case 'x': expected = 1; break;
+            case 'n': count = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (optind >= argc || argc - optind > 2 || count < 1 || count > REGISTER_COUNT) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int fd = open(argv[optind], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "%s: cannot open file\n", argv[optind]);
+        return 1;
+    }
+
+    // an empty trace (nothing was executed) converts to an empty log
+    const byte* data = NULL;
+    if (st.st_size > 0) {
+        void* mapped = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED == mapped) {
+            fprintf(stderr, "%s: cannot map file\n", argv[optind]);
+            close(fd);
+            return 1;
+        }
+        data = (const byte*) mapped;
+    }
+    close(fd);
+
+    FILE* out = stdout;
+    if (argc - optind == 2 && NULL == (out = fopen(argv[optind + 1], "w"))) {
+        fprintf(stderr, "%s: cannot create file\n", argv[optind + 1]);
+        return 1;
+    }
+
+    int ok = (NULL == data) || convert(out, data, (size_t) st.st_size, expected, count);
+
+    if (stdout != out) fclose(out);
+    if (NULL != data) munmap((void*) data, (size_t) st.st_size);
+    return ok ? 0 : 1;
+}
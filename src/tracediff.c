@@ -0,0 +1,671 @@
+/*
+ - RISC-V Sim trace comparison tool
+ - Finds the first step where two binary traces (rc_trace_binary), or a binary trace and a text log in the layout of tests/expected/proto_test logs, disagree
+*/
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// vector compares for register files
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "rskapi.h"
+
+#define REGISTER_COUNT 32
+
+// Work is cut into about this many segments per thread, so that threads that finish early can take over the rest
+#define SEGMENTS_PER_THREAD 8
+
+// Text logs are not cut into segments smaller than this
+#define LOG_SEGMENT_MIN (1 << 20)
+
+// ---------- Mapped Files ----------
+
+// A file mapped read-only (an empty file has no data)
+typedef struct mapped {
+    const char* path;
+    const byte* data;
+    size_t size;
+} mapped_t;
+
+// Map the file at <path>, returning 0 (after reporting why) if it cannot be read
+static int map_file(const char* path, mapped_t* file) {
+    file->path = path;
+    file->data = NULL;
+    file->size = 0;
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "%s: cannot open file\n", path);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    if (st.st_size > 0) {
+        void* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED == data) {
+            fprintf(stderr, "%s: cannot map file\n", path);
+            close(fd);
+            return 0;
+        }
+        madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+        file->data = (const byte*) data;
+        file->size = (size_t) st.st_size;
+    }
+    close(fd);
+    return 1;
+}
+
+static void unmap_file(mapped_t* file) {
+    if (NULL != file->data) munmap((void*) file->data, file->size);
+    file->data = NULL;
+}
+
+// ---------- Trace Index ----------
+
+// Where a chunk of a binary trace is, and which steps it holds
+typedef struct chunk {
+    const byte* header;
+    const byte* records;
+    dword first_step;
+    dword count;
+    dword size;
+} chunk_t;
+
+typedef struct trace {
+    mapped_t file;
+    chunk_t* chunks;
+    size_t chunk_count;
+
+    // Step after the last record
+    dword end_step;
+} trace_t;
+
+// Find every chunk of the trace, returning 0 (after reporting why) if the headers are malformed or their steps don't line up
+static int index_trace(trace_t* trace) {
+    const byte* data = trace->file.data;
+    size_t size = trace->file.size;
+    size_t capacity = 0;
+    trace->chunks = NULL;
+    trace->chunk_count = 0;
+    trace->end_step = 0;
+
+    size_t at = 0;
+    while (at < size) {
+        rsk_trace_chunk_t header;
+        if (size - at < sizeof(header)) {
+            fprintf(stderr, "%s: truncated chunk header at offset %zu\n", trace->file.path, at);
+            return 0;
+        }
+        memcpy(&header, data + at, sizeof(header));
+        if (RSK_TRACE_MAGIC != header.magic || RSK_TRACE_VERSION != header.version) {
+            fprintf(stderr, "%s: not a version %d binary trace chunk at offset %zu\n", trace->file.path, RSK_TRACE_VERSION, at);
+            return 0;
+        }
+        if (size - at - sizeof(header) < header.size) {
+            fprintf(stderr, "%s: truncated chunk at offset %zu\n", trace->file.path, at);
+            return 0;
+        }
+        if (0 != trace->chunk_count && header.first_step != trace->end_step) {
+            fprintf(stderr, "%s: chunk at offset %zu starts at step %lu instead of %lu\n", trace->file.path, at, header.first_step, trace->end_step);
+            return 0;
+        }
+
+        if (trace->chunk_count == capacity) {
+            capacity = (0 == capacity) ? 1024 : 2 * capacity;
+            chunk_t* chunks = (chunk_t*) realloc(trace->chunks, capacity * sizeof(chunk_t));
+            if (NULL == chunks) {
+                fprintf(stderr, "%s: out of memory\n", trace->file.path);
+                return 0;
+            }
+            trace->chunks = chunks;
+        }
+        chunk_t* chunk = &trace->chunks[trace->chunk_count++];
+        chunk->header = data + at;
+        chunk->records = data + at + sizeof(header);
+        chunk->first_step = header.first_step;
+        chunk->count = header.count;
+        chunk->size = header.size;
+
+        trace->end_step = header.first_step + header.count;
+        at += sizeof(header) + header.size;
+    }
+    return 1;
+}
+
+// ---------- Trace Cursors ----------
+
+// Position in a binary trace, with the registers as they are before its next step and the pc of the step before that
+typedef struct cursor {
+    const trace_t* trace;
+    size_t chunk;
+    const byte* at;
+    const byte* end;
+    dword step;
+    dword pc;
+    dword registers[REGISTER_COUNT];
+} cursor_t;
+
+// Move the cursor to the start of <chunk>, whose keyframe holds the registers
+static void cursor_enter(cursor_t* cursor, size_t chunk) {
+    const chunk_t* k = &cursor->trace->chunks[chunk];
+    cursor->chunk = chunk;
+    cursor->at = k->records;
+    cursor->end = k->records + k->size;
+    cursor->step = k->first_step;
+    memcpy(cursor->registers, k->header + offsetof(rsk_trace_chunk_t, registers), sizeof(cursor->registers));
+}
+
+// Whether the cursor is at the start of its chunk
+static int cursor_at_chunk(const cursor_t* cursor) {
+    return cursor->at == cursor->trace->chunks[cursor->chunk].records;
+}
+
+// Decode the next step, returning 0 at the end of the trace (or of malformed records)
+static int cursor_next(cursor_t* cursor) {
+    const trace_t* trace = cursor->trace;
+    while (cursor->step == trace->chunks[cursor->chunk].first_step + trace->chunks[cursor->chunk].count) {
+        if (cursor->chunk + 1 >= trace->chunk_count) return 0;
+        cursor_enter(cursor, cursor->chunk + 1);
+    }
+
+    word mask;
+    if ((size_t) (cursor->end - cursor->at) < sizeof(dword) + sizeof(mask)) return 0;
+    memcpy(&cursor->pc, cursor->at, sizeof(dword));
+    memcpy(&mask, cursor->at + sizeof(dword), sizeof(mask));
+    cursor->at += sizeof(dword) + sizeof(mask);
+
+    if ((size_t) (cursor->end - cursor->at) < sizeof(dword) * (size_t) __builtin_popcount(mask)) return 0;
+    while (0 != mask) {
+        int i = __builtin_ctz(mask);
+        memcpy(&cursor->registers[i], cursor->at, sizeof(dword));
+        cursor->at += sizeof(dword);
+        mask &= mask - 1;
+    }
+
+    cursor->step += 1;
+    return 1;
+}
+
+// Place the cursor before <step> of <trace>, returning 0 if the trace ends first
+static int cursor_seek(cursor_t* cursor, const trace_t* trace, dword step) {
+    cursor->trace = trace;
+    if (step >= trace->end_step) return 0;
+
+    // the last chunk starting at or before the step
+    size_t low = 0;
+    size_t high = trace->chunk_count;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (trace->chunks[middle].first_step <= step) low = middle;
+        else high = middle;
+    }
+    cursor_enter(cursor, low);
+    while (cursor->step < step) {
+        if (!cursor_next(cursor)) return 0;
+    }
+    return 1;
+}
+
+// ---------- Comparison ----------
+
+// Index of the first of the <count> registers that differs between <a> and <b>, or -1 if they are all the same
+static int registers_differ(const dword* a, const dword* b, int count) {
+    int i = 0;
+#if defined(__SSE2__)
+    // eight registers per round while they all match
+    for (; i + 8 <= count; i += 8) {
+        __m128i same = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (a + i)), _mm_loadu_si128((const __m128i*) (b + i)));
+        same = _mm_and_si128(same, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (a + i + 2)), _mm_loadu_si128((const __m128i*) (b + i + 2))));
+        same = _mm_and_si128(same, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (a + i + 4)), _mm_loadu_si128((const __m128i*) (b + i + 4))));
+        same = _mm_and_si128(same, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (a + i + 6)), _mm_loadu_si128((const __m128i*) (b + i + 6))));
+        if (0xffff != _mm_movemask_epi8(same)) break;
+    }
+#endif
+    for (; i < count; i++) {
+        if (a[i] != b[i]) return i;
+    }
+    return -1;
+}
+
+// What differs first
+typedef enum difference {
+    // a register, before the first step compared
+    dk_initial,
+    // the pc of a step
+    dk_pc,
+    // a register, after a step
+    dk_register,
+    // one side has no more steps
+    dk_end,
+} difference_t;
+
+typedef struct divergence {
+    difference_t kind;
+
+    // The step concerned (for dk_end, the first step the shorter side lacks) and its pc (in A)
+    dword step;
+    dword pc;
+
+    // Side that ends (dk_end), or register index, and the values in A and B
+    int which;
+    dword a;
+    dword b;
+} divergence_t;
+
+// Order of divergences: steps first, then the state before a step, its pc, and the state after it
+static dword divergence_position(const divergence_t* divergence) {
+    switch (divergence->kind) {
+        case dk_initial: return 4 * divergence->step;
+        case dk_pc:
+        case dk_end: return 4 * divergence->step + 1;
+        default: return 4 * divergence->step + 2;
+    }
+}
+
+// ---------- Parallel Segments ----------
+
+// A comparison cut into segments (in step order), shared by the worker threads
+typedef struct job {
+    const trace_t* a;
+    const trace_t* b;
+    const mapped_t* log;
+
+    // First chunk of A (trace comparisons) or byte offset into the log of every segment, followed by the end
+    size_t* bounds;
+    size_t segment_count;
+    atomic_size_t next;
+
+    // Earliest divergence found so far (best is its position, or -1 if there is none), and whether either file was malformed
+    pthread_mutex_t lock;
+    atomic_uint_fast64_t best;
+    divergence_t found;
+    atomic_int failed;
+} job_t;
+
+// Record <divergence> if it comes before every other found so far
+static void job_report(job_t* job, const divergence_t* divergence) {
+    dword position = divergence_position(divergence);
+    pthread_mutex_lock(&job->lock);
+    if (position < atomic_load(&job->best)) {
+        job->found = *divergence;
+        atomic_store(&job->best, position);
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+// ---------- Trace Against Trace ----------
+
+// Compare chunks [first, last) of A with the same steps of B, returning 1 (filling in <out>) at the first divergence
+static int diff_trace_segment(job_t* job, size_t first, size_t last, divergence_t* out) {
+    const trace_t* a = job->a;
+    const trace_t* b = job->b;
+    dword start = a->chunks[first].first_step;
+    dword end = a->chunks[last - 1].first_step + a->chunks[last - 1].count;
+
+    cursor_t ca = { .trace = a };
+    cursor_t cb;
+    cursor_enter(&ca, first);
+    if (start == end) return 0;
+    if (!cursor_seek(&cb, b, start)) {
+        *out = (divergence_t) { dk_end, b->end_step, 0, 1, 0, 0 };
+        return 1;
+    }
+
+    // (a wrong keyframe is only seen here at the very start; elsewhere the previous segment compares the state it leads to)
+    int reg = registers_differ(ca.registers, cb.registers, REGISTER_COUNT);
+    if (0 == first && reg >= 0) {
+        *out = (divergence_t) { dk_initial, start, 0, reg, ca.registers[reg], cb.registers[reg] };
+        return 1;
+    }
+
+    while (ca.step < end) {
+        // whole chunks that are the same in both traces are skipped (each one starts from its own keyframe)
+        if (cursor_at_chunk(&ca) && ca.step == a->chunks[ca.chunk].first_step && cursor_at_chunk(&cb) && cb.step == b->chunks[cb.chunk].first_step) {
+            if (4 * (dword) ca.step >= atomic_load_explicit(&job->best, memory_order_relaxed)) return 0;
+
+            const chunk_t* ka = &a->chunks[ca.chunk];
+            const chunk_t* kb = &b->chunks[cb.chunk];
+            if (ka->count == kb->count && ka->size == kb->size && 0 != ka->count && ca.chunk + 1 < a->chunk_count && cb.chunk + 1 < b->chunk_count
+                && 0 == memcmp(ka->header, kb->header, sizeof(rsk_trace_chunk_t)) && 0 == memcmp(ka->records, kb->records, ka->size)) {
+                cursor_enter(&ca, ca.chunk + 1);
+                cursor_enter(&cb, cb.chunk + 1);
+                continue;
+            }
+        }
+
+        if (!cursor_next(&ca)) {
+            fprintf(stderr, "%s: malformed record at step %lu\n", a->file.path, ca.step);
+            atomic_store(&job->failed, 1);
+            return 0;
+        }
+        if (!cursor_next(&cb)) {
+            *out = (divergence_t) { dk_end, ca.step - 1, ca.pc, 1, 0, 0 };
+            return 1;
+        }
+        if (ca.pc != cb.pc) {
+            *out = (divergence_t) { dk_pc, ca.step - 1, ca.pc, 0, ca.pc, cb.pc };
+            return 1;
+        }
+        reg = registers_differ(ca.registers, cb.registers, REGISTER_COUNT);
+        if (reg >= 0) {
+            *out = (divergence_t) { dk_register, ca.step - 1, ca.pc, reg, ca.registers[reg], cb.registers[reg] };
+            return 1;
+        }
+    }
+
+    // the last segment also checks that B doesn't go on
+    if (last == a->chunk_count && b->end_step > a->end_step) {
+        *out = (divergence_t) { dk_end, a->end_step, 0, 0, 0, 0 };
+        return 1;
+    }
+    return 0;
+}
+
+// ---------- Trace Against Text Log ----------
+
+static int is_space(byte c) {
+    return ' ' == c || '\t' == c || '\r' == c;
+}
+
+static int is_digit(byte c) {
+    return c >= '0' && c <= '9';
+}
+
+// Parse a number in <base> (10 or 16) at <*at>, returning 0 if there are no digits
+static int parse_number(const byte** at, const byte* end, int base, dword* value) {
+    const byte* p = *at;
+    dword v = 0;
+    for (; p < end; p++) {
+        int digit;
+        if (is_digit(*p)) digit = *p - '0';
+        else if (16 == base && *p >= 'a' && *p <= 'f') digit = *p - 'a' + 10;
+        else if (16 == base && *p >= 'A' && *p <= 'F') digit = *p - 'A' + 10;
+        else break;
+        v = v * (dword) base + (dword) digit;
+    }
+    if (p == *at) return 0;
+    *at = p;
+    *value = v;
+    return 1;
+}
+
+// A record of a text log: its step (counted from 1), pc, and the registers before its instruction
+typedef struct log_record {
+    dword step;
+    dword pc;
+    dword registers[REGISTER_COUNT];
+    dword present;
+} log_record_t;
+
+// Parse the record starting at <*at> (the start of a line beginning with a digit), leaving <*at> at the start of the next one. Returns 0 if the record is malformed.
+static int parse_record(const byte** at, const byte* end, log_record_t* record) {
+    const byte* p = *at;
+    record->present = 0;
+    if (!parse_number(&p, end, 10, &record->step)) return 0;
+    while (p < end && is_space(*p)) p++;
+    if (!parse_number(&p, end, 16, &record->pc)) return 0;
+
+    // then any number of tokens, on continuation lines too; only those of the form N=VALUE are registers
+    while (p < end) {
+        if ('\n' == *p) {
+            if (p + 1 >= end || !is_space(p[1])) {
+                p++;
+                break;
+            }
+            p++;
+            continue;
+        }
+        if (is_space(*p)) {
+            p++;
+            continue;
+        }
+
+        const byte* token = p;
+        while (p < end && !is_space(*p) && '\n' != *p) p++;
+        const byte* equals = memchr(token, '=', (size_t) (p - token));
+        if (NULL == equals) continue;
+
+        const byte* digits = token;
+        dword index, value;
+        if (!parse_number(&digits, equals, 10, &index) || digits != equals || index >= REGISTER_COUNT) return 0;
+        digits = equals + 1;
+        if (!parse_number(&digits, p, 16, &value) || digits != p) return 0;
+        record->registers[index] = value;
+        record->present |= (dword) 1 << index;
+    }
+
+    *at = p;
+    return 1;
+}
+
+// Start of the first record at or after <at> (a line of <data> beginning with a digit)
+static const byte* next_record(const byte* data, const byte* at, const byte* end) {
+    if (at < end && (at == data || '\n' == at[-1]) && is_digit(*at)) return at;
+    while (at < end) {
+        const byte* newline = memchr(at, '\n', (size_t) (end - at));
+        if (NULL == newline) return end;
+        at = newline + 1;
+        if (at < end && is_digit(*at)) return at;
+    }
+    return end;
+}
+
+// Compare the log records starting in [first, last) with the binary trace, returning 1 (filling in <out>) at the first divergence
+static int diff_log_segment(job_t* job, size_t first, size_t last, divergence_t* out) {
+    const trace_t* a = job->a;
+    const byte* data = job->log->data;
+    const byte* at = data + first;
+    const byte* stop = data + last;
+    const byte* end = data + job->log->size;
+
+    cursor_t cursor = { .trace = a, .step = (dword) -1 };
+    log_record_t record;
+    while (at < stop) {
+        const byte* start = at;
+        if (!parse_record(&at, end, &record) || 0 == record.step) {
+            fprintf(stderr, "%s: malformed record at offset %zu\n", job->log->path, (size_t) (start - data));
+            atomic_store(&job->failed, 1);
+            return 0;
+        }
+        at = next_record(data, at, end);
+        dword step = record.step - 1;
+        if (4 * step >= atomic_load_explicit(&job->best, memory_order_relaxed)) return 0;
+
+        if (cursor.step != step && !cursor_seek(&cursor, a, step)) {
+            *out = (divergence_t) { dk_end, a->end_step, 0, 0, 0, 0 };
+            return 1;
+        }
+
+        // the log holds the registers before the step, so they differ after the one before it
+        for (dword present = record.present; 0 != present; present &= present - 1) {
+            int reg = __builtin_ctz(present);
+            if (cursor.registers[reg] == record.registers[reg]) continue;
+            if (0 == step) *out = (divergence_t) { dk_initial, 0, 0, reg, cursor.registers[reg], record.registers[reg] };
+            else *out = (divergence_t) { dk_register, step - 1, cursor.pc, reg, cursor.registers[reg], record.registers[reg] };
+            return 1;
+        }
+
+        // the log goes on past the last step of the trace
+        if (cursor.step >= a->end_step) {
+            *out = (divergence_t) { dk_end, a->end_step, 0, 0, 0, 0 };
+            return 1;
+        }
+        if (!cursor_next(&cursor)) {
+            fprintf(stderr, "%s: malformed record at step %lu\n", a->file.path, step);
+            atomic_store(&job->failed, 1);
+            return 0;
+        }
+        if (cursor.pc != record.pc) {
+            *out = (divergence_t) { dk_pc, step, cursor.pc, 0, cursor.pc, record.pc };
+            return 1;
+        }
+    }
+
+    // the last segment also checks that the trace doesn't go on
+    if (last == job->log->size && cursor.step != (dword) -1 && a->end_step > cursor.step) {
+        *out = (divergence_t) { dk_end, cursor.step, 0, 1, 0, 0 };
+        return 1;
+    }
+    return 0;
+}
+
+// ---------- Workers ----------
+
+static void* worker_main(void* arg) {
+    job_t* job = (job_t*) arg;
+    for (;;) {
+        size_t segment = atomic_fetch_add(&job->next, 1);
+        if (segment >= job->segment_count) break;
+
+        divergence_t divergence;
+        int diverged = (NULL == job->log)
+            ? diff_trace_segment(job, job->bounds[segment], job->bounds[segment + 1], &divergence)
+            : diff_log_segment(job, job->bounds[segment], job->bounds[segment + 1], &divergence);
+        if (diverged) job_report(job, &divergence);
+    }
+    return NULL;
+}
+
+// Cut the comparison into segments: runs of chunks of A, or byte ranges of the log starting at records
+static int cut_segments(job_t* job, size_t threads) {
+    size_t wanted = threads * SEGMENTS_PER_THREAD;
+    job->bounds = (size_t*) malloc((wanted + 1) * sizeof(size_t));
+    if (NULL == job->bounds) return 0;
+
+    size_t count = 0;
+    if (NULL == job->log) {
+        size_t chunks = job->a->chunk_count;
+        size_t step = (chunks + wanted - 1) / wanted;
+        for (size_t i = 0; i < chunks; i += step) job->bounds[count++] = i;
+        job->bounds[count] = chunks;
+    } else {
+        const byte* data = job->log->data;
+        size_t size = job->log->size;
+        size_t step = size / wanted;
+        if (step < LOG_SEGMENT_MIN) step = LOG_SEGMENT_MIN;
+        size_t at = (size_t) (next_record(data, data, data + size) - data);
+        while (at < size) {
+            job->bounds[count++] = at;
+            size_t next = (size_t) (next_record(data, data + at + step < data + size ? data + at + step : data + size, data + size) - data);
+            if (count == wanted) next = size;
+            at = next;
+        }
+        job->bounds[count] = size;
+    }
+    job->segment_count = count;
+    return 1;
+}
+
+// ---------- Output ----------
+
+// Print what diverged, naming the files as A and B
+static void print_divergence(const divergence_t* d, const char* a, const char* b) {
+    switch (d->kind) {
+        case dk_initial:
+            printf("before step %lu: x%d is %#lx in %s but %#lx in %s\n", d->step, d->which, d->a, a, d->b, b);
+            break;
+        case dk_pc:
+            printf("step %lu: pc is %#lx in %s but %#lx in %s\n", d->step, d->a, a, d->b, b);
+            break;
+        case dk_register:
+            printf("step %lu (pc %#lx): x%d is %#lx in %s but %#lx in %s\n", d->step, d->pc, d->which, d->a, a, d->b, b);
+            break;
+        case dk_end:
+            printf("step %lu: %s ends, but %s goes on\n", d->step, d->which ? b : a, d->which ? a : b);
+            break;
+    }
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "usage: %s [-j THREADS] TRACE_FILE TRACE_FILE|LOG_FILE\n", program);
+    fprintf(stderr, "  -j THREADS  number of threads comparing segments in parallel (default: one per core)\n");
+    fprintf(stderr, "Text logs use the layout of tests/expected/proto_test*.log (as written by trace2log -x).\n");
+}
+
+int main(int argc, char** argv) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "j:h"))) {
+        switch (opt) {
+            case 'j': threads = atol(optarg); break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (optind + 2 != argc || threads < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    trace_t a = { 0 };
+    trace_t b = { 0 };
+    mapped_t log = { 0 };
+    if (!map_file(argv[optind], &a.file) || !index_trace(&a)) return 2;
+    if (!map_file(argv[optind + 1], &log)) return 2;
+
+    // the second file is a trace if it starts like one
+    word magic = 0;
+    if (log.size >= sizeof(magic)) memcpy(&magic, log.data, sizeof(magic));
+    int is_trace = (0 == log.size || RSK_TRACE_MAGIC == magic);
+    if (is_trace) {
+        b.file = log;
+        log = (mapped_t) { 0 };
+        if (!index_trace(&b)) return 2;
+    }
+
+    job_t job = { .a = &a, .b = &b, .log = is_trace ? NULL : &log };
+    pthread_mutex_init(&job.lock, NULL);
+    atomic_init(&job.next, 0);
+    atomic_init(&job.best, UINT64_MAX);
+    atomic_init(&job.failed, 0);
+    if (!cut_segments(&job, (size_t) threads)) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+
+    // (nothing to compare in an empty trace, except whether the other side is empty too)
+    if (0 == job.segment_count) {
+        dword other = is_trace ? b.end_step : (0 == log.size ? 0 : 1);
+        if (0 != a.end_step || 0 != other) {
+            divergence_t d = { dk_end, 0, 0, (0 == a.end_step) ? 0 : 1, 0, 0 };
+            job_report(&job, &d);
+        }
+    }
+
+    if ((size_t) threads > job.segment_count) threads = (long) job.segment_count;
+    pthread_t* workers = (pthread_t*) calloc((size_t) threads + 1, sizeof(pthread_t));
+    long started = 0;
+    for (; NULL != workers && started < threads; started++) {
+        if (0 != pthread_create(&workers[started], NULL, worker_main, &job)) break;
+    }
+    // (whatever is left runs on this thread)
+    worker_main(&job);
+    for (long i = 0; i < started; i++) pthread_join(workers[i], NULL);
+    free(workers);
+
+    int failed = atomic_load(&job.failed);
+    int diverged = (UINT64_MAX != atomic_load(&job.best));
+    if (!failed && diverged) print_divergence(&job.found, argv[optind], argv[optind + 1]);
+    else if (!failed) printf("%lu steps match\n", a.end_step);
+
+    free(job.bounds);
+    free(a.chunks);
+    free(b.chunks);
+    unmap_file(&a.file);
+    unmap_file(&b.file);
+    unmap_file(&log);
+    pthread_mutex_destroy(&job.lock);
+    return failed ? 2 : (diverged ? 1 : 0);
+}